@@ -5,6 +5,7 @@
 #include <sstream>
 #include <ostream>
 #include "nio.h"
+#include "iobuf.h"
 
 namespace snf {
 namespace http {
@@ -34,6 +35,10 @@ operator<< (std::ostream &os, const chunk_ext_t &extensions)
  *     // process data
  * }
  *
+ * The data of the bodies that are read from the socket, file
+ * or functor is in pooled iobufs; next_buffer() hands out the
+ * chunk as an iobuf, so that it can be kept (e.g. added to a
+ * response body) without copying.
  */
 class body
 {
@@ -48,6 +53,14 @@ public:
 	virtual chunk_ext_t chunk_extensions() { return chunk_ext_t(); }
 	virtual bool has_next() = 0;
 	virtual const void *next(size_t &) = 0;
+	virtual snf::net::iobuf next_buffer();
+
+	/*
+	 * Gets the file the body is read from, so that it can be
+	 * sent without copying it through the user space. Null
+	 * if the body is not file backed or has been read from.
+	 */
+	virtual snf::file *source_file() { return nullptr; }
 };
 
 using body_functor_t = std::function<int(void *, size_t, size_t *, chunk_ext_t *)>;
@@ -59,6 +72,8 @@ using body_functor_t = std::function<int(void *, size_t, size_t *, chunk_ext_t *
  * - from string:         body constructed from string.
  * - from_file:           body constructed from file content.
  * - from_functor:        body constructed from a callable.
+ * - from_buffers:        body constructed from the iobufs,
+ *                        without copying the data.
  * - from socket:         body constructed from data read
  *                        from socket. The size of the data
  *                        to be read in known in advance,
@@ -91,6 +106,7 @@ public:
 	body *from_string(std::string &&);
 	body *from_file(const std::string &);
 	body *from_functor(body_functor_t &&);
+	body *from_buffers(const snf::net::iobuf_chain &);
 	body *from_socket(snf::net::nio *, size_t);
 	body *from_socket_chunked(snf::net::nio *);
 };
@@ -2,6 +2,7 @@
 #define _SNF_HTTP_CMN_TRANSMIT_H_
 
 #include "nio.h"
+#include "iobuf.h"
 #include "request.h"
 #include "response.h"
 #include "status.h"
@@ -10,15 +11,18 @@ namespace snf {
 namespace http {
 
 /*
- * Transmits HTTP request/response message.
+ * Transmits HTTP request/response message. The message head
+ * is formatted into pooled iobufs and written together with
+ * the body chunks.
  */
 class transmitter
 {
 private:
 	snf::net::nio   *m_io = nullptr;
 
-	int send_data(const void *, size_t, const std::string &);
-	int send_body(body *);
+	int send_data(const iovec *, int, const std::string &);
+	int send_parts(body *, const snf::net::iobuf_chain &);
+	int send_body(body *, const snf::net::iobuf_chain &);
 	int recv_line(std::string &, const std::string &);
 
 public:
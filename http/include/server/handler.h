@@ -2,7 +2,9 @@
 #define _SNF_HTTP_HANDLER_H_
 
 #include "sock.h"
+#include "cnxn.h"
 #include "reactor.h"
+#include <chrono>
 
 namespace snf {
 namespace http {
@@ -13,12 +15,25 @@ protected:
 	std::unique_ptr<snf::net::socket>   m_sock;
 	snf::net::event                     m_event;
 	bool                                m_secured;
+	snf::net::reactor                   *m_reactor;
+
+	snf::net::reactor &next_reactor();
+	void add_connection(std::unique_ptr<snf::net::socket> &);
 
 public:
-	accept_handler(snf::net::socket *s, snf::net::event e, bool secured = false)
+	/*
+	 * If the reactor is specified, the accepted connections
+	 * are registered with it. Otherwise, they are spread over
+	 * all the reactors of the server. On every readiness event,
+	 * the pending connections are accepted, up to the accept
+	 * budget of the server configuration.
+	 */
+	accept_handler(snf::net::socket *s, snf::net::event e, bool secured = false,
+		snf::net::reactor *r = nullptr)
 		: m_sock(s)
 		, m_event(e)
 		, m_secured(secured)
+		, m_reactor(r)
 	{
 	}
 
@@ -36,23 +51,72 @@ public:
 	virtual bool operator()(sock_t, snf::net::event) override;
 };
 
+/*
+ * Drives the TLS handshake of an accepted connection from the
+ * reactor: each step runs when the socket is ready for the
+ * direction the handshake waits on, so no worker thread is held
+ * by a slow client. The handshake is abandoned if it is not
+ * complete by the deadline, however many steps it takes.
+ */
+class handshake_handler : public snf::net::handler
+{
+public:
+	using clock_type = std::chrono::steady_clock;
+
+protected:
+	snf::net::reactor                           &m_reactor;
+	std::unique_ptr<snf::net::ssl::connection>  m_cnxn;
+	std::unique_ptr<snf::net::socket>           m_sock;
+	snf::net::event                             m_event;
+	clock_type::time_point                      m_deadline;
+
+	int remaining() const;
+
+public:
+	handshake_handler(snf::net::reactor &r, snf::net::ssl::connection *c,
+		snf::net::socket *s, snf::net::event e, clock_type::time_point deadline)
+		: m_reactor(r)
+		, m_cnxn(c)
+		, m_sock(s)
+		, m_event(e)
+		, m_deadline(deadline)
+	{
+	}
+
+	virtual ~handshake_handler() {}
+
+	virtual const char *name() const
+	{
+		return "handshake-handler";
+	}
+
+	virtual bool operator()(sock_t, snf::net::event) override;
+};
+
 class read_handler : public snf::net::handler
 {
 protected:
+	snf::net::reactor                  &m_reactor;
 	std::unique_ptr<snf::net::nio>     m_io;
 	std::unique_ptr<snf::net::socket>  m_sock;
 	snf::net::event                    m_event;
 
 public:
-	read_handler(snf::net::nio *io, snf::net::event e)
-		: m_io(io)
+	/*
+	 * The connection stays with the reactor: it is
+	 * registered with the same reactor after every request.
+	 */
+	read_handler(snf::net::reactor &r, snf::net::nio *io, snf::net::event e)
+		: m_reactor(r)
+		, m_io(io)
 		, m_sock(nullptr)
 		, m_event(e)
 	{
 	}
 
-	read_handler(snf::net::nio *io, snf::net::socket *s, snf::net::event e)
-		: m_io(io)
+	read_handler(snf::net::reactor &r, snf::net::nio *io, snf::net::socket *s, snf::net::event e)
+		: m_reactor(r)
+		, m_io(io)
 		, m_sock(s)
 		, m_event(e)
 	{
@@ -62,7 +126,7 @@ public:
 
 	virtual const char *name() const
 	{
-		if (*m_sock)
+		if (m_sock)
 			return "secured-read-handler";
 		return "read-handler";
 	}
@@ -6,6 +6,7 @@
 #include "cnxn.h"
 #include "reactor.h"
 #include "thrdpool.h"
+#include <functional>
 #include <memory>
 
 namespace snf {
@@ -16,7 +17,8 @@ class server
 private:
 	const server_config                 *m_config = nullptr;
 	snf::net::ssl::context              m_ctx;
-	snf::net::reactor                   m_reactor;
+	std::unique_ptr<snf::net::reactor_group>
+	                                    m_reactors;
 	std::unique_ptr<snf::thread_pool>   m_thrdpool;
 	bool                                m_started = false;
 	bool                                m_stopped = false;
@@ -24,7 +26,9 @@ private:
 	server() {}
 
 	int setup_context();
-	snf::net::socket *setup_socket(in_port_t);
+	void setup_option(snf::net::socket &, const char *, const std::function<void(snf::net::socket &)> &);
+	snf::net::socket *setup_socket(in_port_t, bool);
+	int setup_listener(in_port_t, bool);
 
 public:
 	server(const server &) = delete;
@@ -43,8 +47,9 @@ public:
 
 	int start(const server_config *);
 	int stop();
+	const server_config *config() const { return m_config; }
 	snf::net::ssl::context &ssl_context() { return m_ctx; }
-	snf::net::reactor &reactor() { return m_reactor; }
+	snf::net::reactor_group &reactors() { return *m_reactors; }
 	snf::thread_pool *thread_pool() { return m_thrdpool.get(); }
 };
 
@@ -2,6 +2,7 @@
 #define _SNF_HTTP_SERVER_CONFIG_H_
 
 #include "net.h"
+#include "reactor.h"
 #include "cmncfg.h"
 
 namespace snf {
@@ -11,13 +12,57 @@ class server_config : public common_config
 {
 private:
 	int         m_nthreads = 20;    // default worker threads
-	
+	int         m_nreactors = 0;    // reactors, <= 0 for one per hardware thread
+	bool        m_reuseport = false;// one listening socket per reactor?
+	snf::net::poller_type m_poller = snf::net::poller_type::dflt;  // poller of the reactors
+	bool        m_ktls = false;     // offload TLS records to the kernel?
+	int         m_hsto = 10000;     // TLS handshake timeout in milliseconds
+	int         m_backlog = SOMAXCONN;  // listen backlog
+	int         m_acceptbudget = 64;    // connections accepted per readiness event
+	int         m_deferaccept = 0;  // seconds to defer accept until data arrives, 0 to disable
+	int         m_fastopen = 0;     // TCP fast open queue length, 0 to disable
+	std::string m_scfile;           // session cache file shared by the server processes
+	std::string m_tkfile;           // ticket key file shared by the server processes
+
 public:
 	server_config() : common_config() {}
 	virtual ~server_config() {}
 
 	int worker_thread_count() const { return m_nthreads; }
 	void worker_thread_count(int n) { m_nthreads = n; }
+
+	int reactor_count() const { return m_nreactors; }
+	void reactor_count(int n) { m_nreactors = n; }
+
+	bool reuseport() const { return m_reuseport; }
+	void reuseport(bool reuse) { m_reuseport = reuse; }
+
+	snf::net::poller_type poller() const { return m_poller; }
+	void poller(snf::net::poller_type type) { m_poller = type; }
+
+	bool kernel_tls() const { return m_ktls; }
+	void kernel_tls(bool ktls) { m_ktls = ktls; }
+
+	int handshake_timeout() const { return m_hsto; }
+	void handshake_timeout(int to) { m_hsto = to; }
+
+	int listen_backlog() const { return m_backlog; }
+	void listen_backlog(int n) { m_backlog = n; }
+
+	int accept_budget() const { return m_acceptbudget; }
+	void accept_budget(int n) { m_acceptbudget = n; }
+
+	int defer_accept() const { return m_deferaccept; }
+	void defer_accept(int secs) { m_deferaccept = secs; }
+
+	int fast_open() const { return m_fastopen; }
+	void fast_open(int qlen) { m_fastopen = qlen; }
+
+	const std::string &session_cache_file() const { return m_scfile; }
+	void session_cache_file(const std::string &f) { m_scfile = f; }
+
+	const std::string &ticket_key_file() const { return m_tkfile; }
+	void ticket_key_file(const std::string &f) { m_tkfile = f; }
 };
 
 } // namespace http
@@ -11,49 +11,122 @@
 namespace snf {
 namespace http {
 
+/*
+ * Gets the next chunk of data as an iobuf. The default copies
+ * the data returned by next().
+ */
+snf::net::iobuf
+body::next_buffer()
+{
+	size_t buflen = 0;
+	const void *buf = next(buflen);
+	if (buf && buflen)
+		return snf::net::iobuf(buf, static_cast<int>(buflen));
+	return snf::net::iobuf();
+}
+
+/*
+ * Gets the chunk buffer ready to be filled: reuses it if it is
+ * not shared, otherwise takes a new one from the pool.
+ */
+static void
+reuse_or_alloc(snf::net::iobuf &buf)
+{
+	if (buf.unique())
+		buf.truncate(0);
+	else
+		buf = snf::net::iobuf(body::CHUNKSIZE);
+}
+
 /*
  * Get the HTTP body from the specified buffer.
  */
 class body_from_buffer : public body
 {
 private:
-	size_t  m_buflen = 0;
-	char    *m_buf = nullptr;
-	char    *m_begin = nullptr;
-	char    *m_end = nullptr;
+	snf::net::iobuf m_buf;
+	bool            m_done = false;
 
 public:
 	body_from_buffer(const void *buf, size_t buflen)
-		: m_buflen(buflen)
+		: m_buf(buf, static_cast<int>(buflen))
+		, m_done(buflen == 0)
+	{
+	}
+
+	virtual ~body_from_buffer() {}
+
+	size_t length() const { return static_cast<size_t>(m_buf.size()); }
+	bool has_next() { return !m_done; }
+
+	const void *next(size_t &buflen)
 	{
-		m_buf = DBG_NEW char[m_buflen];
-		memcpy(m_buf, buf, m_buflen);
-		m_begin = static_cast<char *>(m_buf);
-		m_end = m_begin + m_buflen;
+		const void *ptr = nullptr;
+
+		if (!m_done) {
+			buflen = static_cast<size_t>(m_buf.size());
+			m_done = true;
+			ptr = m_buf.data();
+		} else {
+			buflen = 0;
+		}
+
+		return ptr;
 	}
 
-	virtual ~body_from_buffer()
+	snf::net::iobuf next_buffer()
 	{
-		delete [] m_buf;
+		if (m_done)
+			return snf::net::iobuf();
+		m_done = true;
+		return m_buf;
 	}
+};
 
-	size_t length() const { return m_buflen; }
-	bool has_next() { return (m_begin < m_end); }
+/*
+ * Get the HTTP body from the specified iobufs. The data
+ * is not copied.
+ */
+class body_from_buffers : public body
+{
+private:
+	snf::net::iobuf_chain   m_chain;
+	size_t                  m_length;
+	size_t                  m_next = 0;
+
+public:
+	body_from_buffers(const snf::net::iobuf_chain &chain)
+		: m_chain(chain)
+		, m_length(chain.length())
+	{
+	}
+
+	virtual ~body_from_buffers() {}
+
+	size_t length() const { return m_length; }
+	bool has_next() { return (m_next < m_chain.count()); }
 
 	const void *next(size_t &buflen)
 	{
 		const void *ptr = nullptr;
 
-		if (m_begin < m_end) {
-			buflen = m_buflen;
-			m_begin += buflen;
-			ptr = m_buf;
+		if (m_next < m_chain.count()) {
+			const snf::net::iobuf &buf = m_chain.at(m_next++);
+			buflen = static_cast<size_t>(buf.size());
+			ptr = buf.data();
 		} else {
 			buflen = 0;
 		}
 
 		return ptr;
 	}
+
+	snf::net::iobuf next_buffer()
+	{
+		if (m_next < m_chain.count())
+			return m_chain.at(m_next++);
+		return snf::net::iobuf();
+	}
 };
 
 /*
@@ -114,7 +187,7 @@ private:
 	std::string         m_filename;
 	size_t              m_filesize;
 	size_t              m_read;
-	char                m_buf[CHUNKSIZE];
+	snf::net::iobuf     m_buf;
 
 public:
 	body_from_file(const std::string &filename)
@@ -145,6 +218,7 @@ public:
 
 	size_t length() const { return m_filesize; }
 	bool has_next() { return (m_read < m_filesize); }
+	snf::file *source_file() { return (m_read == 0) ? m_file : nullptr; }
 
 	const void *next(size_t &buflen)
 	{
@@ -152,7 +226,9 @@ public:
 		int syserr = 0;
 		const void *ptr = nullptr;
 
-		if (m_file->read(m_buf, CHUNKSIZE, &bread, &syserr) != E_ok) {
+		reuse_or_alloc(m_buf);
+
+		if (m_file->read(m_buf.tail(), CHUNKSIZE, &bread, &syserr) != E_ok) {
 			std::ostringstream oss;
 			oss << "failed to read from file (" << m_filename << ") at index " << m_read;
 			throw std::system_error(
@@ -162,15 +238,23 @@ public:
 		}
 
 		if (bread) {
+			m_buf.commit(bread);
 			m_read += bread;
 			buflen = bread;
-			ptr = m_buf;
+			ptr = m_buf.data();
 		} else {
 			buflen = 0;
 		}
 
 		return ptr;
 	}
+
+	snf::net::iobuf next_buffer()
+	{
+		size_t buflen = 0;
+		next(buflen);
+		return m_buf;
+	}
 };
 
 /*
@@ -184,7 +268,7 @@ class body_from_functor : public body
 private:
 	body_functor_t      m_functor;
 	size_t              m_chunk_size;
-	char                m_buf[CHUNKSIZE];
+	snf::net::iobuf     m_buf;
 	chunk_ext_t         m_extensions;
 
 public:
@@ -214,9 +298,11 @@ public:
 			return true;
 
 		m_extensions.clear();
-		if (m_functor(m_buf, CHUNKSIZE, &m_chunk_size, &m_extensions) != E_ok)
+		reuse_or_alloc(m_buf);
+		if (m_functor(m_buf.tail(), CHUNKSIZE, &m_chunk_size, &m_extensions) != E_ok)
 			throw std::runtime_error("call to the functor failed");
 
+		m_buf.commit(static_cast<int>(m_chunk_size));
 		return (m_chunk_size != 0);
 	}
 
@@ -227,13 +313,21 @@ public:
 		if (m_chunk_size) {
 			buflen = m_chunk_size;
 			m_chunk_size = 0;
-			ptr = m_buf;
+			ptr = m_buf.data();
 		} else {
 			buflen = 0;
 		}
 
 		return ptr;
 	}
+
+	snf::net::iobuf next_buffer()
+	{
+		if (m_chunk_size == 0)
+			return snf::net::iobuf();
+		m_chunk_size = 0;
+		return m_buf;
+	}
 };
 
 /*
@@ -247,7 +341,7 @@ private:
 	snf::net::nio       *m_io;
 	size_t              m_size;
 	size_t              m_read;
-	char                m_buf[CHUNKSIZE];
+	snf::net::iobuf     m_buf;
 
 public:
 	body_from_socket(snf::net::nio *io, size_t len)
@@ -267,26 +361,32 @@ public:
 		int to_read = static_cast<int>(m_size - m_read);
 		if (to_read > CHUNKSIZE)
 			to_read = CHUNKSIZE;
-		int bread = 0;
 		int syserr = 0;
 		const void *ptr = nullptr;
 
-		if (m_io->read(m_buf, to_read, &bread, 1000, &syserr) != E_ok)
+		if (m_io->read(m_buf, to_read, 1000, &syserr) != E_ok)
 			throw std::system_error(
 				syserr,
 				std::system_category(),
 				"failed to read from socket");
 
-		if (bread) {
-			m_read += bread;
-			buflen = bread;
-			ptr = m_buf;
+		if (m_buf.size()) {
+			m_read += m_buf.size();
+			buflen = m_buf.size();
+			ptr = m_buf.data();
 		} else {
 			buflen = 0;
 		}
 
 		return ptr;
 	}
+
+	snf::net::iobuf next_buffer()
+	{
+		size_t buflen = 0;
+		next(buflen);
+		return m_buf;
+	}
 };
 
 /*
@@ -300,7 +400,7 @@ private:
 	snf::net::nio       *m_io;
 	size_t              m_chunk_size;
 	size_t              m_chunk_offset;
-	char                m_buf[CHUNKSIZE];
+	snf::net::iobuf     m_buf;
 	chunk_ext_t         m_extensions;
 
 	int getc()
@@ -393,20 +493,19 @@ public:
 		if (to_read > CHUNKSIZE)
 			to_read = CHUNKSIZE;
 
-		int bread = 0;
 		int syserr = 0;
 		const void *ptr = nullptr;
 
-		if (m_io->read(m_buf, to_read, &bread, 1000, &syserr) != E_ok)
+		if (m_io->read(m_buf, to_read, 1000, &syserr) != E_ok)
 			throw std::system_error(
 				syserr,
 				std::system_category(),
 				"failed to read from socket");
 
-		if (bread) {
-			m_chunk_offset += bread;
-			buflen = bread;
-			ptr = m_buf;
+		if (m_buf.size()) {
+			m_chunk_offset += m_buf.size();
+			buflen = m_buf.size();
+			ptr = m_buf.data();
 		} else {
 			buflen = 0;
 		}
@@ -417,6 +516,13 @@ public:
 
 		return ptr;
 	}
+
+	snf::net::iobuf next_buffer()
+	{
+		size_t buflen = 0;
+		next(buflen);
+		return m_buf;
+	}
 };
 
 body *
@@ -449,6 +555,12 @@ body_factory::from_functor(body_functor_t &&f)
 	return DBG_NEW body_from_functor(f);
 }
 
+body *
+body_factory::from_buffers(const snf::net::iobuf_chain &chain)
+{
+	return DBG_NEW body_from_buffers(chain);
+}
+
 body *
 body_factory::from_socket(snf::net::nio *io, size_t length)
 {
@@ -4,15 +4,16 @@
 #include "error.h"
 #include "timeutil.h"
 #include "json.h"
+#include <cstdio>
 
 namespace snf {
 namespace http {
 
 /*
- * Sends the HTTP message data.
+ * Sends the HTTP message data from the scatter/gather elements.
  *
- * @param [in] data      - data to send.
- * @param [in] datalen   - length of the data to be sent.
+ * @param [in] iov       - scatter/gather elements.
+ * @param [in] iovcnt    - number of elements.
  * @param [in] exceptstr - exception message in case of error.
  *
  * @throws std::system_error in case of write error.
@@ -20,14 +21,17 @@ namespace http {
  * @return E_ok on success, -ve error code on failure.
  */
 int
-transmitter::send_data(const void *data, size_t datalen, const std::string &exceptstr)
+transmitter::send_data(const iovec *iov, int iovcnt, const std::string &exceptstr)
 {
 	int retval = E_ok;
-	int to_write = static_cast<int>(datalen);
+	int to_write = 0;
 	int bwritten = 0;
 	int syserr = 0;
 
-	retval = m_io->write(data, to_write, &bwritten, 1000, &syserr);
+	for (int i = 0; i < iovcnt; ++i)
+		to_write += static_cast<int>(iov[i].iov_len);
+
+	retval = m_io->write(iov, iovcnt, &bwritten, 1000, &syserr);
 	if (retval != E_ok) {
 		throw std::system_error(
 			syserr,
@@ -41,67 +45,212 @@ transmitter::send_data(const void *data, size_t datalen, const std::string &exce
 }
 
 /*
- * Sends HTTP message body.
+ * Gets the scatter/gather elements for the message head.
+ *
+ * @return the number of elements filled, -1 if the head does
+ *         not fit in the elements and must be sent by itself.
+ */
+static int
+head_iovec(const snf::net::iobuf_chain &head, iovec *iov, int iovcnt)
+{
+	if (head.count() > static_cast<size_t>(iovcnt))
+		return -1;
+	return head.to_iovec(iov, iovcnt);
+}
+
+/*
+ * Sends the HTTP message head and body. The head goes out
+ * with the first chunk of the body, and each chunk with its
+ * size line and terminator, in a single write. The head and
+ * the body chunks are written from their pooled buffers, as
+ * they are.
  *
- * @param [in] body - message body.
+ * @param [in] body - message body, can be null.
+ * @param [in] head - message line and headers.
  *
  * @throws std::system_error in case of write errors.
  *
  * @return E_ok on success, -ve error code in case of failure.
  */
 int
-transmitter::send_body(body *body)
+transmitter::send_parts(body *body, const snf::net::iobuf_chain &head)
 {
+	static constexpr int HEAD_IOVCNT = 8;
+
 	int     retval = E_ok;
 	size_t  chunklen;
-	bool    body_chunked = body->chunked();
-	int64_t body_length = body->length();
+	bool    body_chunked = body ? body->chunked() : false;
+	int64_t body_length = body ? body->length() : 0;
+	bool    head_sent = head.empty();
+	iovec   iov[HEAD_IOVCNT + 3];
+	int     iovcnt;
+
+	if (!head_sent && (head_iovec(head, iov, HEAD_IOVCNT) < 0)) {
+		int bwritten = 0;
+		int syserr = 0;
+
+		retval = m_io->write(head, &bwritten, 1000, &syserr);
+		if (retval != E_ok)
+			throw std::system_error(
+				syserr,
+				std::system_category(),
+				"failed to send message line and headers");
+
+		head_sent = true;
+	}
+
+	snf::file *f = body ? body->source_file() : nullptr;
+	if (f && !body_chunked && (body_length > 0)) {
+		if (!head_sent) {
+			iovcnt = head_iovec(head, iov, HEAD_IOVCNT);
+			retval = send_data(iov, iovcnt, "failed to send message line and headers");
+			if (retval != E_ok)
+				return retval;
+		}
+
+		int64_t bsent = 0;
+		int syserr = 0;
+
+		// Zero copy for plain sockets; chunked read and write otherwise.
+		retval = m_io->sendfile(*f, 0, body_length, &bsent, 1000, &syserr);
+		if (retval != E_ok) {
+			throw std::system_error(
+				syserr,
+				std::system_category(),
+				"failed to send body");
+		} else if (bsent != body_length) {
+			retval = E_write_failed;
+		}
 
-	while (body->has_next()) {
+		return retval;
+	}
+
+	while (body && body->has_next()) {
+		iovcnt = 0;
 		chunklen = 0;
 		chunk_ext_t cext = std::move(body->chunk_extensions());
 		const void *buf = body->next(chunklen);
-	
-		if (body_chunked) {
-			std::ostringstream oss;
-			oss << std::hex << chunklen << cext << "\r\n";
-			std::string s = std::move(oss.str());
+		char sizeline[32];
+		std::string extline;
 
-			retval = send_data(
-					s.data(),
-					s.size(),
-					"failed to send chunk size");
-			if (retval != E_ok)
-				break;
+		if (!head_sent)
+			iovcnt = head_iovec(head, iov, HEAD_IOVCNT);
+
+		if (body_chunked) {
+			if (cext.empty()) {
+				int n = snprintf(sizeline, sizeof(sizeline), "%zx\r\n", chunklen);
+				iov[iovcnt].iov_base = sizeline;
+				iov[iovcnt++].iov_len = static_cast<size_t>(n);
+			} else {
+				std::ostringstream oss;
+				oss << std::hex << chunklen << cext << "\r\n";
+				extline = std::move(oss.str());
+				iov[iovcnt].iov_base = const_cast<char *>(extline.data());
+				iov[iovcnt++].iov_len = extline.size();
+			}
 		}
 
-		retval = send_data(
-				buf,
-				chunklen,
-				body_chunked ? "failed to send chunk" : "failed to send body");
-		if (retval != E_ok)
-			break;
+		if (chunklen > 0) {
+			iov[iovcnt].iov_base = const_cast<void *>(buf);
+			iov[iovcnt++].iov_len = chunklen;
+		}
 
 		if (body_chunked) {
-			retval = send_data("\r\n", 2, "failed to send chunk terminator");
-			if (retval != E_ok)
-				break;
+			iov[iovcnt].iov_base = const_cast<char *>("\r\n");
+			iov[iovcnt++].iov_len = 2;
 		} else {
 			body_length -= chunklen;
 		}
+
+		if (iovcnt == 0)
+			continue;
+
+		retval = send_data(
+				iov,
+				iovcnt,
+				head_sent
+					? (body_chunked ? "failed to send chunk" : "failed to send body")
+					: "failed to send message line and headers");
+		if (retval != E_ok)
+			break;
+
+		head_sent = true;
 	}
 
 	if (retval == E_ok) {
+		iovcnt = 0;
+
+		if (!head_sent)
+			iovcnt = head_iovec(head, iov, HEAD_IOVCNT);
+
 		if (body_chunked) {
-			retval = send_data(
-					"0\r\n\r\n",
-					5,
-					"failed to send last chunk");
+			iov[iovcnt].iov_base = const_cast<char *>("0\r\n\r\n");
+			iov[iovcnt++].iov_len = 5;
 		} else if (body_length != 0) {
 			retval = E_write_failed;
 		}
+
+		if ((retval == E_ok) && (iovcnt > 0))
+			retval = send_data(
+					iov,
+					iovcnt,
+					head_sent ? "failed to send last chunk" : "failed to send message line and headers");
+	}
+
+	return retval;
+}
+
+/*
+ * Sends the HTTP message head and body. A message that takes
+ * more than one write (chunked body, file body, or large
+ * body) is sent in a write batch, so that the pieces go out
+ * in full segments/TLS records rather than a packet/record
+ * per write. The batch is ended whether or not the message
+ * could be sent.
+ *
+ * @param [in] body - message body, can be null.
+ * @param [in] head - message line and headers.
+ *
+ * @throws std::system_error in case of write errors.
+ *
+ * @return E_ok on success, -ve error code in case of failure.
+ */
+int
+transmitter::send_body(body *body, const snf::net::iobuf_chain &head)
+{
+	bool batched = body &&
+		(body->chunked() ||
+		 body->source_file() ||
+		 (body->length() > static_cast<size_t>(snf::http::body::CHUNKSIZE)));
+
+	if (!batched)
+		return send_parts(body, head);
+
+	m_io->begin_batch();
+
+	int retval = E_ok;
+	int syserr = 0;
+
+	try {
+		retval = send_parts(body, head);
+	} catch (...) {
+		// End the batch even on failure, so that the error
+		// response that may follow is not held back; the
+		// original exception is the one that matters.
+		try {
+			m_io->end_batch(1000, &syserr);
+		} catch (...) {
+		}
+		throw;
 	}
 
+	int batch_retval = m_io->end_batch(1000, &syserr);
+	if ((retval == E_ok) && (batch_retval != E_ok))
+		throw std::system_error(
+			syserr,
+			std::system_category(),
+			"failed to send body");
+
 	return retval;
 }
 
@@ -151,19 +300,15 @@ transmitter::recv_line(std::string &line, const std::string &exceptstr)
 int
 transmitter::send_request(const request &req)
 {
-	std::ostringstream oss;
+	snf::net::iobuf_chain head;
 
-	oss << req;
-
-	std::string s = std::move(oss.str());
-	int retval = send_data(s.data(), s.size(), "failed to send request and headers");
-	if (retval == E_ok) {
-		body *req_body = req.get_body();
-		if (req_body)
-			retval = send_body(req_body);
+	{
+		snf::net::chainbuf buf(head);
+		std::ostream os(&buf);
+		os << req;
 	}
 
-	return retval;
+	return send_body(req.get_body(), head);
 }
 
 /*
@@ -220,19 +365,15 @@ transmitter::recv_request()
 int
 transmitter::send_response(const response &resp)
 {
-	std::ostringstream oss;
-
-	oss << resp;
+	snf::net::iobuf_chain head;
 
-	std::string s = std::move(oss.str());
-	int retval = send_data(s.data(), s.size(), "failed to send response and headers");
-	if (retval == E_ok) {
-		body *resp_body = resp.get_body();
-		if (resp_body)
-			retval = send_body(resp_body);
+	{
+		snf::net::chainbuf buf(head);
+		std::ostream os(&buf);
+		os << resp;
 	}
 
-	return retval;
+	return send_body(resp.get_body(), head);
 }
 
 /*
@@ -12,93 +12,227 @@
 namespace snf {
 namespace http {
 
+/*
+ * Gets the reactor to register the accepted connection with.
+ */
+snf::net::reactor &
+accept_handler::next_reactor()
+{
+	if (m_reactor)
+		return *m_reactor;
+	return server::instance().reactors().next();
+}
+
+bool
+accept_handler::operator()(sock_t s, snf::net::event e)
+{
+	if (*m_sock != s) {
+		ERROR_STRM("accept_handler")
+			<< "socket mismatch"
+			<< snf::log::record::endl;
+		return false;
+	}
+
+	if (e != snf::net::event::read) {
+		ERROR_STRM("accept_handler")
+			<< "unexpected event received "
+			<< snf::net::eventstr(e)
+			<< snf::log::record::endl;
+		return false;
+	}
+
+	int budget = server::instance().config()->accept_budget();
+	if (budget <= 0)
+		budget = 1;
+
+	// Drain the pending connections, up to the budget, so that a
+	// burst of connections does not overflow the listen backlog.
+	for (int i = 0; i < budget; ++i) {
+		std::unique_ptr<snf::net::socket> nsock;
+		int oserr = 0;
+
+		int retval = m_sock->accept(nsock, true, &oserr);
+		if (retval == E_try_again)
+			break;
+
+		if (retval != E_ok) {
+			ERROR_STRM("accept_handler", oserr)
+				<< "failed to accept connection on socket "
+				<< *m_sock
+				<< ": error "
+				<< retval
+				<< snf::log::record::endl;
+			break;
+		}
+
+		INFO_STRM("accept_handler")
+			<< "accepted socket "
+			<< *nsock
+			<< snf::log::record::endl;
+
+		try {
+			add_connection(nsock);
+		} catch (std::system_error &ex) {
+			ERROR_STRM("accept_handler", ex.code().value())
+				<< ex.what()
+				<< snf::log::record::endl;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Registers the accepted, non-blocking, connection with the
+ * next reactor: with the handshake handler if the listener is
+ * secured, otherwise with the read handler.
+ */
 void
-process_ssl_handshake(snf::net::socket *s)
+accept_handler::add_connection(std::unique_ptr<snf::net::socket> &sock)
 {
-	std::unique_ptr<snf::net::socket> sock(s);
+	snf::net::reactor &r = next_reactor();
+	sock_t thesock = *sock;
 
-	try {
+	if (is_secured()) {
 		std::unique_ptr<snf::net::ssl::connection> cnxn(
 			DBG_NEW snf::net::ssl::connection(
 				snf::net::connection_mode::server,
 				server::instance().ssl_context())
 			);
-		cnxn->handshake(*sock);
-		std::string errstr;
-		if (cnxn->is_verification_successful(errstr)) {
-			DEBUG_STRM(nullptr)
-				<< "SSL handshake successful for socket "
-				<< *sock
-				<< snf::log::record::endl;
 
-			sock_t thesock = *sock;
-			server::instance().reactor().add_handler(
+		// The client speaks first; the whole handshake has to
+		// complete within the handshake timeout.
+		int to = server::instance().config()->handshake_timeout();
+		handshake_handler::clock_type::time_point deadline =
+			handshake_handler::clock_type::now() + std::chrono::milliseconds(to);
+		r.add_handler(
 				thesock,
 				snf::net::event::read,
-				DBG_NEW read_handler(cnxn.release(), sock.release(), snf::net::event::read));
-		} else {
-			ERROR_STRM(nullptr)
-				<< "SSL handshake failed for socket "
-				<< *sock
-				<< ": "
-				<< errstr
-				<< snf::log::record::endl;
-		}
-	} catch (snf::net::ssl::exception &ex) {
-		ERROR_STRM(nullptr)
-			<< ex.what()
-			<< snf::log::record::endl;
-		for (auto I = ex.begin(); I != ex.end(); ++I)
-			ERROR_STRM(nullptr)
-				<< *I
-				<< snf::log::record::endl;
+				DBG_NEW handshake_handler(r, cnxn.release(), sock.release(),
+					snf::net::event::read, deadline),
+				to);
+	} else {
+		// The requests are received into the poller's buffers if it
+		// has multishot receive. Not for the secured connections,
+		// whose data OpenSSL reads from the socket itself.
+		r.recv_multishot(*sock);
+		r.add_handler(
+				thesock,
+				snf::net::event::read,
+				DBG_NEW read_handler(r, sock.release(), snf::net::event::read));
 	}
 }
 
+/*
+ * Gets the time left to the deadline in milliseconds (at
+ * least 1 if it has not passed), 0 if the deadline has passed.
+ */
+int
+handshake_handler::remaining() const
+{
+	clock_type::time_point now = clock_type::now();
+	if (now >= m_deadline)
+		return 0;
+
+	int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(m_deadline - now).count();
+	return (ms > 0) ? static_cast<int>(ms) : 1;
+}
+
 bool
-accept_handler::operator()(sock_t s, snf::net::event e)
+handshake_handler::operator()(sock_t s, snf::net::event e)
 {
 	if (*m_sock != s) {
-		ERROR_STRM("accept_handler")
+		ERROR_STRM("handshake_handler")
 			<< "socket mismatch"
 			<< snf::log::record::endl;
 		return false;
 	}
 
-	if (e != snf::net::event::read) {
-		ERROR_STRM("accept_handler")
-			<< "unexpected event received "
+	if (e != m_event) {
+		ERROR_STRM("handshake_handler")
+			<< "SSL handshake abandoned for socket "
+			<< *m_sock
+			<< " on "
 			<< snf::net::eventstr(e)
 			<< snf::log::record::endl;
 		return false;
 	}
 
 	try {
-		snf::net::socket *nsock = DBG_NEW snf::net::socket(std::move(m_sock->accept()));
-		INFO_STRM("accept_handler")
-			<< "accepted socket "
-			<< *nsock
-			<< snf::log::record::endl;
+		bool want_write = false;
+		int retval = m_cnxn->try_handshake(*m_sock, &want_write);
+
+		if (retval == E_try_again) {
+			int to = remaining();
+			if (to <= 0) {
+				ERROR_STRM("handshake_handler")
+					<< "SSL handshake timed out for socket "
+					<< *m_sock
+					<< snf::log::record::endl;
+				return false;
+			}
 
-		if (is_secured()) {
-			server::instance().thread_pool()->submit(process_ssl_handshake, nsock);
-		} else {
-			server::instance().reactor().add_handler(
-					*nsock,
-					snf::net::event::read,
-					DBG_NEW read_handler(nsock, snf::net::event::read));
+			/*
+			 * The new handler takes over the connection, and waits
+			 * only for the time left. If it waits for the same event,
+			 * it replaces this handler and the return value is ignored.
+			 */
+			snf::net::event next = want_write ? snf::net::event::write : snf::net::event::read;
+			m_reactor.add_handler(
+				s,
+				next,
+				DBG_NEW handshake_handler(m_reactor, m_cnxn.release(), m_sock.release(), next, m_deadline),
+				to);
+			return false;
+		} else if (retval != E_ok) {
+			ERROR_STRM("handshake_handler")
+				<< "SSL handshake failed for socket "
+				<< *m_sock
+				<< ": error "
+				<< retval
+				<< snf::log::record::endl;
+			return false;
 		}
-		return true;
-	} catch (std::system_error &ex) {
-		ERROR_STRM("accept_handler", ex.code().value())
+
+		std::string errstr;
+		if (!m_cnxn->is_verification_successful(errstr)) {
+			ERROR_STRM("handshake_handler")
+				<< "SSL handshake failed for socket "
+				<< *m_sock
+				<< ": "
+				<< errstr
+				<< snf::log::record::endl;
+			return false;
+		}
+
+		DEBUG_STRM("handshake_handler")
+			<< "SSL handshake successful for socket "
+			<< *m_sock
+			<< snf::log::record::endl;
+
+		/*
+		 * Replaces this handler if it is waiting for the read
+		 * event; the return value is then ignored.
+		 */
+		m_reactor.add_handler(
+			s,
+			snf::net::event::read,
+			DBG_NEW read_handler(m_reactor, m_cnxn.release(), m_sock.release(), snf::net::event::read));
+		return (m_event == snf::net::event::read);
+	} catch (snf::net::ssl::exception &ex) {
+		ERROR_STRM("handshake_handler")
 			<< ex.what()
 			<< snf::log::record::endl;
+		for (auto I = ex.begin(); I != ex.end(); ++I)
+			ERROR_STRM("handshake_handler")
+				<< *I
+				<< snf::log::record::endl;
 		return false;
 	}
 }
 
 void
-process_request(snf::net::nio *io, snf::net::socket *s)
+process_request(snf::net::reactor *r, snf::net::nio *io, snf::net::socket *s)
 {
 	std::unique_ptr<snf::net::nio> ioptr(io);
 	std::unique_ptr<snf::net::socket> sptr(s);
@@ -180,12 +314,18 @@ process_request(snf::net::nio *io, snf::net::socket *s)
 			if (cnxn)
 				cnxn->shutdown();
 		}
+	} else if (ioptr->pending() > 0) {
+		// Pipelined request already read into the buffer; poll() would not see it.
+		server::instance().thread_pool()->submit(process_request, r, ioptr.release(), sptr.release());
 	} else {
-		sock_t thesock = *s;
-		server::instance().reactor().add_handler(
+		snf::net::socket *sock = sptr
+			? sptr.get()
+			: dynamic_cast<snf::net::socket *>(ioptr.get());
+		sock_t thesock = *sock;
+		r->add_handler(
 			thesock,
 			snf::net::event::read,
-			DBG_NEW read_handler(ioptr.release(), sptr.get(), snf::net::event::read));
+			DBG_NEW read_handler(*r, ioptr.release(), sptr.release(), snf::net::event::read));
 	}
 }
 
@@ -222,7 +362,7 @@ read_handler::operator()(sock_t s, snf::net::event e)
 		return false;
 	}
 
-	server::instance().thread_pool()->submit(process_request, m_io.release(), m_sock.release());
+	server::instance().thread_pool()->submit(process_request, &m_reactor, m_io.release(), m_sock.release());
 
 	// Do not register it again.
 	return false;
@@ -52,6 +52,25 @@ server::setup_context()
 		m_ctx.verify_peer(false);
 		m_ctx.limit_certificate_chain_depth(m_config->certificate_chain_depth());
 
+		if (m_config->kernel_tls() && !m_ctx.kernel_tls(true)) {
+			WARNING_STRM("server")
+				<< "kernel TLS is not supported by the SSL library"
+				<< snf::log::record::endl;
+		}
+
+		if (!m_config->session_cache_file().empty()) {
+			m_ctx.set_session_context("snf-http");
+			snf::net::ssl::context::set_session_cache(
+				DBG_NEW snf::net::ssl::file_session_cache(m_config->session_cache_file()));
+			m_ctx.external_session_cache(true);
+		}
+
+		if (!m_config->ticket_key_file().empty()) {
+			snf::net::ssl::context::set_keymgr(
+				DBG_NEW snf::net::ssl::shared_keymgr(m_config->ticket_key_file()));
+			m_ctx.session_ticket(snf::net::connection_mode::server, true);
+		}
+
 		DEBUG_STRM("server")
 			<< "SSL context is set successfully"
 			<< snf::log::record::endl;
@@ -66,11 +85,44 @@ server::setup_context()
 				<< *I
 				<< snf::log::record::endl;
 		return E_ssl_error;
+	} catch (std::system_error &ex) {
+		ERROR_STRM("server")
+			<< ex.what()
+			<< snf::log::record::endl;
+		return E_syscall_failed;
+	}
+}
+
+/*
+ * Sets the optional listening socket option. The server runs
+ * without it if it is not supported.
+ */
+void
+server::setup_option(snf::net::socket &s, const char *optname,
+	const std::function<void(snf::net::socket &)> &setter)
+{
+	try {
+		setter(s);
+	} catch (std::system_error &ex) {
+		WARNING_STRM("server", ex.code().value())
+			<< optname
+			<< " not enabled: "
+			<< ex.what()
+			<< snf::log::record::endl;
 	}
 }
 
+/*
+ * Creates the listening socket, with the backlog and the optional
+ * deferred accept and TCP fast open from the configuration.
+ *
+ * @param [in] port      - port to listen on.
+ * @param [in] reuseport - share the port with other sockets?
+ *
+ * @return the listening socket, nullptr on failure.
+ */
 snf::net::socket *
-server::setup_socket(in_port_t port)
+server::setup_socket(in_port_t port, bool reuseport)
 {
 	try {
 		std::unique_ptr<snf::net::socket> s(
@@ -78,6 +130,8 @@ server::setup_socket(in_port_t port)
 		s->keepalive(true);
 		s->tcpnodelay(true);
 		s->reuseaddr(true);
+		if (reuseport)
+			s->reuseport(true);
 		s->blocking(false);
 		s->bind(AF_INET, port);
 
@@ -86,7 +140,18 @@ server::setup_socket(in_port_t port)
 			<< " bound to port "
 			<< port
 			<< snf::log::record::endl;
-		s->listen(20);
+
+		if (m_config->defer_accept() > 0)
+			setup_option(*s, "deferred accept", [this] (snf::net::socket &sock) {
+				sock.deferaccept(m_config->defer_accept());
+			});
+
+		if (m_config->fast_open() > 0)
+			setup_option(*s, "TCP fast open", [this] (snf::net::socket &sock) {
+				sock.fastopen(m_config->fast_open());
+			});
+
+		s->listen(m_config->listen_backlog());
 
 		return s.release();
 	} catch (std::system_error &ex) {
@@ -94,9 +159,72 @@ server::setup_socket(in_port_t port)
 			<< ex.what()
 			<< snf::log::record::endl;
 		return nullptr;
+	} catch (std::runtime_error &ex) {
+		ERROR_STRM("server")
+			<< ex.what()
+			<< snf::log::record::endl;
+		return nullptr;
 	}
 }
 
+/*
+ * Sets up the listening socket(s) for the port. If reuse
+ * port is configured, there is one listening socket per
+ * reactor, and the accepted connections stay with the
+ * reactor that accepted them. Otherwise the only listening
+ * socket is registered with the first reactor, and the
+ * accepted connections are spread over all the reactors.
+ *
+ * @param [in] port    - port to listen on.
+ * @param [in] secured - is the port secured?
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+server::setup_listener(in_port_t port, bool secured)
+{
+	const char *proto = secured ? "https" : "http";
+	size_t nsocks = m_config->reuseport() ? m_reactors->size() : 1;
+
+	for (size_t i = 0; i < nsocks; ++i) {
+		std::unique_ptr<snf::net::socket> sock(setup_socket(port, m_config->reuseport()));
+		if (!sock) {
+			ERROR_STRM("server")
+				<< "failed to get socket bound to "
+				<< proto << " port "
+				<< port
+				<< snf::log::record::endl;
+			return E_bind_failed;
+		}
+
+		INFO_STRM("server")
+			<< "created " << proto << " socket "
+			<< *sock
+			<< sock->dump_options()
+			<< snf::log::record::endl;
+
+		snf::net::reactor *r = m_config->reuseport() ? &(*m_reactors)[i] : nullptr;
+		snf::net::reactor &lr = r ? *r : (*m_reactors)[0];
+
+		// With the io_uring poller, the kernel accepts the
+		// connections as they come.
+		if (lr.accept_multishot(*sock)) {
+			INFO_STRM("server")
+				<< "multishot accept on " << proto << " socket "
+				<< *sock
+				<< snf::log::record::endl;
+		}
+
+		sock_t s = *sock;
+		lr.add_handler(
+				s,
+				snf::net::event::read,
+				DBG_NEW accept_handler(sock.release(), snf::net::event::read, secured, r));
+	}
+
+	return E_ok;
+}
+
 int
 server::start(const server_config *cfg)
 {
@@ -125,47 +253,15 @@ server::start(const server_config *cfg)
 
 	m_thrdpool.reset(DBG_NEW snf::thread_pool(m_config->worker_thread_count()));
 
-	std::unique_ptr<snf::net::socket> sock(setup_socket(m_config->http_port()));
-	if (!sock) {
-		ERROR_STRM("server")
-			<< "failed to get socket bound to http port "
-			<< m_config->http_port()
-			<< snf::log::record::endl;
-		return E_bind_failed;
-	} else {
-		INFO_STRM("server")
-			<< "created http socket "
-			<< *sock
-			<< sock->dump_options()
-			<< snf::log::record::endl;
+	m_reactors.reset(DBG_NEW snf::net::reactor_group(m_config->reactor_count(), 5000, m_config->poller()));
 
-		sock_t s = *sock;
-		m_reactor.add_handler(
-				s, 
-				snf::net::event::read,
-				DBG_NEW accept_handler(sock.release(), snf::net::event::read));
-	}
-
-	std::unique_ptr<snf::net::socket> sec_sock(setup_socket(m_config->https_port()));
-	if (!sec_sock) {
-		ERROR_STRM("server")
-			<< "failed to get socket bound to https port "
-			<< m_config->https_port()
-			<< snf::log::record::endl;
-		return E_bind_failed;
-	} else {
-		INFO_STRM("server")
-			<< "created https socket "
-			<< *sec_sock
-			<< sec_sock->dump_options()
-			<< snf::log::record::endl;
+	r = setup_listener(m_config->http_port(), false);
+	if (r != E_ok)
+		return r;
 
-		sock_t s = *sec_sock;
-		m_reactor.add_handler(
-				s,
-				snf::net::event::read,
-				DBG_NEW accept_handler(sec_sock.release(), snf::net::event::read, true));
-	}
+	r = setup_listener(m_config->https_port(), true);
+	if (r != E_ok)
+		return r;
 
 	m_started = true;
 
@@ -175,8 +271,10 @@ server::start(const server_config *cfg)
 int
 server::stop()
 {
-	m_reactor.stop();
-	m_thrdpool->stop();
+	if (m_reactors)
+		m_reactors->stop();
+	if (m_thrdpool)
+		m_thrdpool->stop();
 	m_started = false;
 	m_stopped = true;
 	return 0;
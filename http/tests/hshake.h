@@ -0,0 +1,153 @@
+#include "handler.h"
+#include "ctx.h"
+#include <thread>
+
+class hshake : public snf::tf::test
+{
+private:
+	static constexpr const char *class_name = "hshake";
+
+	using clock_type = snf::http::handshake_handler::clock_type;
+
+	/*
+	 * Hands the server end of the pair to the handshake handler,
+	 * with the deadline <to> milliseconds from now.
+	 */
+	void accept(snf::net::reactor &r, snf::net::ssl::context &ctx, snf::net::socket &s, int to)
+	{
+		snf::net::socket *sock = DBG_NEW snf::net::socket(std::move(s));
+		sock->blocking(false);
+
+		sock_t thesock = *sock;
+		r.add_handler(
+			thesock,
+			snf::net::event::read,
+			DBG_NEW snf::http::handshake_handler(r,
+				DBG_NEW snf::net::ssl::connection(snf::net::connection_mode::server, ctx),
+				sock, snf::net::event::read, clock_type::now() + std::chrono::milliseconds(to)),
+			to);
+	}
+
+	/*
+	 * Checks if the server has closed its end of the pair,
+	 * waiting up to <to> milliseconds.
+	 */
+	bool closed(snf::net::socket &s, int to)
+	{
+		char buf[1];
+		int  bread = 0;
+
+		int retval = s.readn(buf, 1, &bread, to);
+		return (retval == E_ok) && (bread == 0);
+	}
+
+public:
+	hshake() : snf::tf::test() {}
+	~hshake() {}
+
+	virtual const char *name() const
+	{
+		return "Handshake";
+	}
+
+	virtual const char *description() const
+	{
+		return "Tests reactor driven TLS handshake and its deadline";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		std::unique_ptr<snf::net::ssl::context> sctx;
+		std::unique_ptr<snf::net::ssl::context> cctx;
+
+		// The contexts need OpenSSL 1.1 or later, and the test
+		// key and certificate of libnet; skip the test without them.
+		try {
+			snf::net::initialize(true);
+			sctx.reset(DBG_NEW snf::net::ssl::context);
+			snf::net::ssl::pkey key {
+				snf::net::ssl::data_fmt::pem,
+				"../../libnet/tests/unittest.simplenfast.org/unittest.simplenfast.org.key.pem",
+				"Te5tP@55w0rd" };
+			snf::net::ssl::x509_certificate cert {
+				snf::net::ssl::data_fmt::pem,
+				"../../libnet/tests/unittest.simplenfast.org/unittest.simplenfast.org.cert.pem" };
+			sctx->use_private_key(key);
+			sctx->use_certificate(cert);
+			sctx->check_private_key();
+			cctx.reset(DBG_NEW snf::net::ssl::context);
+		} catch (const std::runtime_error &ex) {
+			std::cerr << "skipped, no usable OpenSSL or test certificate: " << ex.what() << std::endl;
+			return true;
+		}
+
+		try {
+			std::array<snf::net::socket, 2> sp1 = std::move(snf::net::socket::socketpair());
+			std::array<snf::net::socket, 2> sp2 = std::move(snf::net::socket::socketpair());
+			std::array<snf::net::socket, 2> sp3 = std::move(snf::net::socket::socketpair());
+			snf::net::ssl::connection cnxn(snf::net::connection_mode::client, *cctx);
+			char c = 0;
+			int  bwritten = 0;
+			int  bread = 0;
+
+			snf::net::reactor r { 100 };
+
+			// Handshake completes and the connection is kept.
+			sp1[1].blocking(false);
+			accept(r, *sctx, sp1[0], 2000);
+			cnxn.handshake(sp1[1], 2000);
+			ASSERT_EQ(bool, true, true, "handshake completed");
+			ASSERT_EQ(int, cnxn.readn(&c, 1, &bread, 200), E_timed_out,
+				"connection kept after the handshake");
+
+			// Client that never speaks.
+			clock_type::time_point start = clock_type::now();
+			accept(r, *sctx, sp2[0], 200);
+			ASSERT_EQ(bool, closed(sp2[1], 2000), true, "silent client closed");
+			int64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+				clock_type::now() - start).count();
+			ASSERT_EQ(bool, elapsed >= 190, true, "silent client closed at the deadline");
+
+			/*
+			 * Client that trickles a ClientHello record, one byte every
+			 * 50ms: every step is well within the timeout, but the
+			 * handshake as a whole is not.
+			 */
+			const char hdr[] = { 0x16, 0x03, 0x01, 0x02, 0x00 };
+			start = clock_type::now();
+			accept(r, *sctx, sp3[0], 300);
+			ASSERT_EQ(int, sp3[1].writen(hdr, sizeof(hdr), &bwritten), E_ok, "record header written");
+
+			bool is_closed = false;
+			for (int i = 0; (i < 40) && !is_closed; ++i) {
+				if (sp3[1].writen(&c, 1, &bwritten) != E_ok)
+					is_closed = true;
+				else
+					is_closed = closed(sp3[1], 50);
+			}
+			elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+				clock_type::now() - start).count();
+			ASSERT_EQ(bool, is_closed, true, "slow client closed");
+			ASSERT_EQ(bool, elapsed >= 290, true, "slow client closed at the deadline");
+			ASSERT_EQ(bool, elapsed < 1000, true, "slow client deadline not restarted");
+
+			// Stop before the connection is closed, so that the read
+			// handler that took over does not process a request.
+			r.stop();
+		} catch (const snf::net::ssl::exception &ex) {
+			std::cerr << ex.what() << std::endl;
+			for (auto I = ex.begin(); I != ex.end(); ++I)
+				std::cerr << *I << std::endl;
+			return false;
+		} catch (const std::system_error &ex) {
+			std::cerr << "system error: " << ex.code() << std::endl;
+			std::cerr << ex.what() << std::endl;
+			return false;
+		} catch (const std::runtime_error &ex) {
+			std::cerr << "runtime error: " << ex.what() << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+};
@@ -4,6 +4,8 @@
 #include "rqstresp.h"
 #include "bodytest.h"
 #include "routertest.h"
+#include "xmittest.h"
+#include "hshake.h"
 
 namespace snf {
 namespace tf {
@@ -13,6 +15,8 @@ test *test_list[] = {
 	DBG_NEW rqstresp(),
 	DBG_NEW bodytest(),
 	DBG_NEW routertest(),
+	DBG_NEW xmittest(),
+	DBG_NEW hshake(),
 	0
 };
 
@@ -0,0 +1,169 @@
+#include "transmit.h"
+#include "sock.h"
+#include "ia.h"
+
+class xmittest : public snf::tf::test
+{
+private:
+	static constexpr const char *class_name = "xmittest";
+
+	static snf::http::response make_response(snf::http::body *b, bool chunked)
+	{
+		snf::http::headers hdrs;
+		if (chunked)
+			hdrs.transfer_encoding(snf::http::TRANSFER_ENCODING_CHUNKED);
+		else
+			hdrs.content_length(b->length());
+
+		snf::http::response_builder resp_bldr;
+		return resp_bldr
+			.with_version(1, 1)
+			.with_status(snf::http::status_code::OK)
+			.with_headers(std::move(hdrs))
+			.with_body(b)
+			.build();
+	}
+
+	/*
+	 * Connects a pair of tcp sockets over the loopback: unlike
+	 * the unix domain socketpair, tcp writes can be batched.
+	 */
+	static std::array<snf::net::socket, 2> tcp_pair()
+	{
+		snf::net::socket lsock { AF_INET, snf::net::socket_type::tcp };
+		lsock.reuseaddr(true);
+		lsock.bind(snf::net::internet_address { "127.0.0.1" }, 0);
+		lsock.listen(1);
+
+		std::array<snf::net::socket, 2> sp = {
+			snf::net::socket { AF_INET, snf::net::socket_type::tcp },
+			snf::net::socket { AF_INET, snf::net::socket_type::tcp }
+		};
+		sp[0].connect(snf::net::internet_address { "127.0.0.1" }, lsock.local_address().port());
+		sp[1] = std::move(lsock.accept());
+		return sp;
+	}
+
+	/*
+	 * Checks if the data up to and including the marker byte
+	 * reaches the peer within <to> milliseconds.
+	 */
+	static bool received(snf::net::socket &s, char marker, int to)
+	{
+		char c = 0;
+		int  bread = 0;
+
+		while (s.readn(&c, 1, &bread, to) == E_ok) {
+			if (bread == 0)
+				return false;
+			if (c == marker)
+				return true;
+		}
+
+		return false;
+	}
+
+public:
+	xmittest() : snf::tf::test() {}
+	~xmittest() {}
+
+	virtual const char *name() const
+	{
+		return "Transmitter Test";
+	}
+
+	virtual const char *description() const
+	{
+		return "Tests HTTP message transmission over pooled buffers";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		snf::net::initialize(false);
+
+		try {
+			std::array<snf::net::socket, 2> sp = std::move(snf::net::socket::socketpair());
+			snf::http::transmitter tx(&sp[0]);
+			snf::http::transmitter rx(&sp[1]);
+
+			// Chunked body from a functor.
+			int nchunks = 0;
+			snf::http::body *b = snf::http::body_factory::instance().from_functor(
+				[&nchunks] (void *buf, size_t, size_t *len, snf::http::chunk_ext_t *) -> int {
+					*len = (nchunks < 3) ? 1000 : 0;
+					memset(buf, 'a' + nchunks, *len);
+					nchunks++;
+					return E_ok;
+				});
+			ASSERT_EQ(int, tx.send_response(make_response(b, true)), E_ok, "chunked response sent");
+
+			snf::http::response resp = std::move(rx.recv_response());
+			ASSERT_EQ(bool, resp.get_headers().is_message_chunked(), true, "response is chunked");
+
+			// Keep the received chunks, without copying them.
+			snf::net::iobuf_chain chain;
+			while (resp.get_body()->has_next())
+				chain.append(resp.get_body()->next_buffer());
+			ASSERT_EQ(size_t, chain.length(), 3000, "body received");
+			ASSERT_EQ(char, chain.at(0).data()[0], 'a', "first chunk matches");
+			ASSERT_EQ(char, chain.at(chain.count() - 1).data()[0], 'c', "last chunk matches");
+
+			// Send the chunks back as a sized body.
+			b = snf::http::body_factory::instance().from_buffers(chain);
+			ASSERT_EQ(int, rx.send_response(make_response(b, false)), E_ok, "response sent");
+
+			resp = std::move(tx.recv_response());
+			ASSERT_EQ(size_t, resp.get_headers().content_length(), 3000, "content length");
+
+			std::string data;
+			while (resp.get_body()->has_next()) {
+				size_t len = 0;
+				const void *p = resp.get_body()->next(len);
+				data.append(static_cast<const char *>(p), len);
+			}
+			ASSERT_EQ(std::string, data,
+				std::string(1000, 'a') + std::string(1000, 'b') + std::string(1000, 'c'),
+				"body matches");
+
+			/*
+			 * The functor fails in the middle of a chunked body:
+			 * the write that follows must not be held back by
+			 * the batch of the failed message (a corked socket
+			 * holds a partial segment back for 200ms).
+			 */
+			std::array<snf::net::socket, 2> tp = std::move(tcp_pair());
+			snf::http::transmitter ftx(&tp[0]);
+
+			nchunks = 0;
+			b = snf::http::body_factory::instance().from_functor(
+				[&nchunks] (void *buf, size_t, size_t *len, snf::http::chunk_ext_t *) -> int {
+					if (nchunks++ > 0)
+						return E_read_failed;
+					*len = 1000;
+					memset(buf, 'a', *len);
+					return E_ok;
+				});
+
+			bool failed = false;
+			try {
+				ftx.send_response(make_response(b, true));
+			} catch (const std::runtime_error &) {
+				failed = true;
+			}
+			ASSERT_EQ(bool, failed, true, "chunked response failed");
+
+			int bwritten = 0;
+			ASSERT_EQ(int, tp[0].writen("x", 1, &bwritten), E_ok, "data written after the failure");
+			ASSERT_EQ(bool, received(tp[1], 'x', 100), true, "data after the failure not held back");
+		} catch (const std::system_error &ex) {
+			std::cerr << "system error: " << ex.code() << std::endl;
+			std::cerr << ex.what() << std::endl;
+			return false;
+		} catch (const snf::http::bad_message &ex) {
+			std::cerr << "bad message: " << ex.what() << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+};
@@ -4,6 +4,7 @@
 
 #if !defined(_WIN32)
 	#include <fcntl.h>
+	#include <cstring>
 #endif
 
 namespace snf {
@@ -32,6 +33,21 @@ public:
 	}
 };
 
+/*
+ * The record locks are owned by the open file description
+ * where the system supports it. The traditional POSIX locks
+ * are owned by the process: opening the file again in the
+ * same process does not conflict with them, and closing any
+ * descriptor of the file drops them.
+ */
+#if defined(F_OFD_SETLK)
+	#define FILE_SETLK  F_OFD_SETLK
+	#define FILE_SETLKW F_OFD_SETLKW
+#else
+	#define FILE_SETLK  F_SETLK
+	#define FILE_SETLKW F_SETLKW
+#endif
+
 #endif // _WIN32
 
 /**
@@ -565,7 +581,8 @@ file::truncate(int64_t fsize, int *oserr)
 
 /**
  * Locks a region/section of the file. If the lock is already acquired by
- * another process, the call blocks until the other process release the lock.
+ * another process, or through another open of the file, the call blocks
+ * until the lock is released.
  *
  * @param [in] type   - Lock type: shared/exclusive
  * @param [in] start  - Starting offset of the region from the start of the file.
@@ -622,6 +639,7 @@ file::lock(lock_type type, int64_t start, int64_t len, int *oserr)
 #else
 
 	struct flock lck;
+	memset(&lck, 0, sizeof(lck));
 
 	if (type == lock_type::shared)
 	{
@@ -637,7 +655,7 @@ file::lock(lock_type type, int64_t start, int64_t len, int *oserr)
 	lck.l_len = (off_t)len;
 
 	do {
-		if (fcntl(fd, F_SETLKW, &lck) < 0) {
+		if (fcntl(fd, FILE_SETLKW, &lck) < 0) {
 			if (EINTR == system_error()) {
 				continue;
 			} else {
@@ -658,8 +676,8 @@ file::lock(lock_type type, int64_t start, int64_t len, int *oserr)
 
 /**
  * Tries to lock a region/secton of the file. If the lock is already acquired
- * by another process, the call returns immediately with the error code
- * E_try_again.
+ * by another process, or through another open of the file, the call returns
+ * immediately with the error code E_try_again.
  *
  * @param [in]  type  - Lock type: shared/exclusive
  * @param [in]  start - Starting offset of the region from the start of the file.
@@ -667,7 +685,7 @@ file::lock(lock_type type, int64_t start, int64_t len, int *oserr)
  * @param [out] oserr - OS error code.
  *
  * @return E_ok on success (after acquiring the lock), E_try_again if the lock
- * is acquired by another process, and -ve error code on failure.
+ * is acquired by another process or open, and -ve error code on failure.
  */
 int
 file::trylock(lock_type type, int64_t start, int64_t len, int *oserr)
@@ -725,6 +743,7 @@ file::trylock(lock_type type, int64_t start, int64_t len, int *oserr)
 #else
 
 	struct flock lck;
+	memset(&lck, 0, sizeof(lck));
 
 	if (type == lock_type::shared)
 	{
@@ -740,7 +759,7 @@ file::trylock(lock_type type, int64_t start, int64_t len, int *oserr)
 	lck.l_len = (off_t)len;
 
 	do {
-		if (fcntl(fd, F_SETLK, &lck) < 0) {
+		if (fcntl(fd, FILE_SETLK, &lck) < 0) {
 			int error = system_error();
 
 			if (EINTR == error) {
@@ -817,13 +836,14 @@ file::unlock(int64_t start, int64_t len, int *oserr)
 #else
 
 	struct flock lck;
+	memset(&lck, 0, sizeof(lck));
 
 	lck.l_type = F_UNLCK;
 	lck.l_whence = SEEK_SET;
 	lck.l_start = (off_t)start;
 	lck.l_len = (off_t)len;
 
-	if (fcntl(fd, F_SETLK, &lck) < 0) {
+	if (fcntl(fd, FILE_SETLK, &lck) < 0) {
 		retval = E_unlock_failed;
 		if (oserr) *oserr = system_error();
 	}
@@ -432,7 +432,7 @@ remove_file(const char *f, int *oserr)
 #else
 
 	if (unlink(f) != 0) {
-		if (*oserr) *oserr = errno;
+		if (oserr) *oserr = errno;
 		retval = E_remove_failed;
 	}
 
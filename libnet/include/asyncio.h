@@ -0,0 +1,111 @@
+#ifndef _SNF_ASYNCIO_H_
+#define _SNF_ASYNCIO_H_
+
+#include "sock.h"
+#include "reactor.h"
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+
+namespace snf {
+namespace net {
+
+/*
+ * Result of an asynchronous operation.
+ */
+struct io_result
+{
+	int status = E_ok;  // E_ok or -ve error code
+	int bytes = 0;      // bytes read/written
+	int oserr = 0;      // system error, if any
+};
+
+/*
+ * Asynchronous reads and writes on a socket (or on a TLS
+ * connection over it), driven by a reactor.
+ *
+ * The operations are started in the reactor thread. They try
+ * the I/O first and, if the socket is not ready, register a
+ * handler for the readiness; so the reactor thread multiplexes
+ * the operations of all the sockets without blocking. The
+ * completion callback is called in the reactor thread. Starting
+ * the next operation from the callback gives sequential looking
+ * protocol code:
+ *
+ *   aio.async_readn(hdr, 4, [&] (const io_result &r) {
+ *       if (r.status == E_ok) aio.async_readn(body, len(hdr), ...);
+ *   });
+ *
+ * The overloads without the callback return a future instead,
+ * for the callers outside the reactor thread (waiting on the
+ * future in the reactor thread deadlocks).
+ *
+ * One read and one write can be outstanding at a time. All the
+ * I/O on the connection happens in the reactor thread, so the
+ * reads and writes of a TLS connection do not race. The timeout
+ * applies to the inactivity of the socket. The callbacks pending
+ * when the object is destroyed are not called; the buffers must
+ * stay valid until the operation completes or the object is
+ * destroyed.
+ */
+class async_io
+{
+public:
+	using completion = std::function<void(const io_result &)>;
+
+private:
+	struct operation
+	{
+		bool        active = false;     // operation in progress
+		bool        waiting = false;    // handler registered
+		bool        some = false;       // complete on partial read
+		char        *buf = nullptr;
+		int         len = 0;
+		int         done = 0;
+		int         to = POLL_WAIT_FOREVER;
+		completion  cb;
+	};
+
+	struct state
+	{
+		std::mutex  lock;
+		reactor     &r;
+		sock_t      s;
+		nio         *io;
+		bool        closed = false;
+		operation   rd;
+		operation   wr;
+
+		state(reactor &_r, sock_t _s, nio *_io) : r(_r), s(_s), io(_io) {}
+	};
+
+	class io_handler;
+
+	std::shared_ptr<state>  m_state;
+
+	static bool attempt(state &, bool, io_result &);
+	static void run(const std::shared_ptr<state> &, bool);
+	void start(bool, char *, int, bool, const completion &, int);
+
+public:
+	async_io(reactor &, socket &, nio *io = nullptr);
+	async_io(const async_io &) = delete;
+	async_io(async_io &&) = delete;
+	const async_io &operator=(const async_io &) = delete;
+	async_io &operator=(async_io &&) = delete;
+	~async_io();
+
+	void async_read(void *, int, const completion &, int to = POLL_WAIT_FOREVER);
+	void async_readn(void *, int, const completion &, int to = POLL_WAIT_FOREVER);
+	void async_write(const void *, int, const completion &, int to = POLL_WAIT_FOREVER);
+
+	std::future<io_result> async_read(void *, int, int to = POLL_WAIT_FOREVER);
+	std::future<io_result> async_readn(void *, int, int to = POLL_WAIT_FOREVER);
+	std::future<io_result> async_write(const void *, int, int to = POLL_WAIT_FOREVER);
+};
+
+} // namespace net
+} // namespace snf
+
+#endif // _SNF_ASYNCIO_H_
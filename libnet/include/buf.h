@@ -3,19 +3,26 @@
 
 #include <streambuf>
 #include <stdexcept>
+#include <algorithm>
 #include "nio.h"
+#include "iobuf.h"
 
 namespace snf {
 namespace net {
 
 /*
- * Customized output streambuf for sockets.
- * It could be use as following:
+ * Customized output streambuf for sockets. The buffer is
+ * taken from the iobuf pool. It could be use as following:
  *
  * snf::net::outbuf buf(io, 2048); // buffer of size 2048
  * std::ostream ostrm(&buf);
  *
  * Thereafter ostrm can be used like an ordinaly std::ostream object.
+ *
+ * The data that overflows the buffer is written in a batch
+ * (nio::begin_batch()) that ends when the stream is flushed;
+ * so a message larger than the buffer still goes out in full
+ * segments/records, not in a packet per buffer.
  */
 class outbuf : public std::streambuf
 {
@@ -23,36 +30,38 @@ public:
 	outbuf(nio *io, size_t bufsize = 512)
 		: m_io(io)
 		, m_bufsize(bufsize)
+		, m_blk(static_cast<int>(bufsize))
 	{
-		m_buf = new char[m_bufsize];
+		m_buf = m_blk.data();
 		setp(&m_buf[0], &m_buf[m_bufsize - 1]);
 	}
 
 	~outbuf()
 	{
 		sync();
-		delete [] m_buf;
 	}
 
 protected:
-	virtual int_type overflow(int_type) override
+	virtual int_type overflow(int_type c) override
 	{
 		if (c != traits_type::eof()) {
 			*pptr() = c;
 			pbump(1);
 		}
 
+		batch();
 		return (flush() == traits_type::eof()) ? traits_type::eof() : c;
 	}
 
-	virtual std::streamsize xsputn(const char *, std::streamsize) override
+	virtual std::streamsize xsputn(const char *buf, std::streamsize buflen) override
 	{
 		std::streamsize free = epptr() - pptr();
 		if (buflen < free) {
 			memcpy(pptr(), buf, buflen);
-			pbump(buflen);
+			pbump(static_cast<int>(buflen));
 			return buflen;
 		} else {
+			batch();
 			flush();
 
 			int to_write = static_cast<int>(buflen);
@@ -70,13 +79,29 @@ protected:
 	virtual int sync() override
 	{
 		int_type r = flush();
+		if (m_batched) {
+			m_batched = false;
+			int syserr = 0;
+			if (m_io->end_batch(1000, &syserr) != E_ok)
+				r = traits_type::eof();
+		}
 		return (r == traits_type::eof()) ? -1 : 0;
 	}
 
 private:
 	nio     *m_io = nullptr;
 	size_t  m_bufsize;
+	iobuf   m_blk;
 	char    *m_buf = nullptr;
+	bool    m_batched = false;
+
+	void batch()
+	{
+		if (!m_batched) {
+			m_io->begin_batch();
+			m_batched = true;
+		}
+	}
 
 	int_type flush()
 	{
@@ -96,8 +121,8 @@ private:
 };
 
 /*
- * Customized input streambuf for sockets.
- * It could be use as following:
+ * Customized input streambuf for sockets. The buffer is
+ * taken from the iobuf pool. It could be use as following:
  *
  * snf::net::inbuf buf(io, 2048, 128); // buffer of size 2048, putback area of 128
  * std::istream istrm(&buf);
@@ -115,17 +140,15 @@ public:
 		if (putback_size > (bufsize / 2))
 			throw std::invalid_argument("putback area is greater than the get area");
 
-		m_buf = new char[bufsize];
+		m_blk = iobuf(static_cast<int>(bufsize));
+		m_buf = m_blk.data();
 		setg(
 			&m_buf[m_putback_size],
 			&m_buf[m_putback_size],
 			&m_buf[m_putback_size]);
 	}
 
-	~inbuf()
-	{
-		delete [] m_buf;
-	}
+	~inbuf() {}
 
 protected:
 	virtual int_type underflow() override
@@ -158,6 +181,7 @@ private:
 	nio     *m_io = nullptr;
 	size_t  m_bufsize;
 	size_t  m_putback_size;
+	iobuf   m_blk;
 	char    *m_buf = nullptr;
 };
 
@@ -27,6 +27,7 @@ struct error_info;
  *   context switch occurs transparently.
  * - supports TLS session resumption: session ID context and session ticket based.
  * - supports simple host/ip addr checks.
+ * - coalesces the batched writes into full (16KB) TLS records.
  */
 class connection : public snf::net::nio
 {
@@ -41,12 +42,26 @@ private:
 	std::vector<ctxinfo>    m_contexts;
 	std::mutex              m_lock;
 	SSL                     *m_ssl = nullptr;
+	bool                    m_ktls_send = false;
+	bool                    m_ktls_recv = false;
+	bool                    m_batched = false;  // writes are batched
+	iobuf                   m_wbuf;             // batched writes
+	int                     m_wlen = 0;         // data in m_wbuf
 
 	void switch_context(const std::string &);
+	void check_kernel_tls();
 	std::string get_sni();
 	int handle_ssl_error(sock_t, int, error_info &);
+	int write_records(const void *, int, int *, int, int *);
+	int write_batched(const void *, int, int *, int, int *);
+	int write_pending(int, int *);
+
+protected:
+	int readsome(void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0) override;
 
 public:
+	static constexpr int RECORD_SIZE = 16384;   // maximum TLS record payload
+
 	connection(connection_mode, context &);
 	connection(const connection &);
 	connection(connection &&);
@@ -66,8 +81,15 @@ public:
 	void set_session(session &);
 	bool is_session_reused();
 	void handshake(const socket &, int to = POLL_WAIT_FOREVER);
+	int try_handshake(const socket &, bool *);
 	int readn(void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
 	int writen(const void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	int writen(const iovec *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	int sendfile(snf::file &, int64_t, int64_t, int64_t *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	void begin_batch() override;
+	int end_batch(int to = POLL_WAIT_FOREVER, int *oserr = 0) override;
+	bool kernel_tls_send() const { return m_ktls_send; }
+	bool kernel_tls_recv() const { return m_ktls_recv; }
 	void shutdown();
 	void reset();
 	x509_certificate *get_peer_certificate();
@@ -0,0 +1,138 @@
+#ifndef _SNF_CNXNPOOL_H_
+#define _SNF_CNXNPOOL_H_
+
+#include "sock.h"
+#include "cnxn.h"
+#include "reactor.h"
+#include "resolver.h"
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace snf {
+namespace net {
+
+/*
+ * Pool of outbound connections, keyed by the host, port and
+ * SSL context (none for the plain TCP connections).
+ *
+ * checkout() hands out an idle connection to the endpoint if it
+ * is still healthy (not readable, i.e. neither closed by the peer
+ * nor carrying unexpected data, and without a pending error), or
+ * opens a new one. At most the specified number of connections
+ * are open per endpoint; checkout() waits for one to be released
+ * beyond that. The TLS connections are opened with the last
+ * session of the endpoint, so the new handshakes are resumed.
+ *
+ * The connection is checked out as a lease. lease::release()
+ * returns it to the pool for reuse; a lease destroyed without
+ * being released closes the connection (use it after errors or
+ * when the peer asked to close the connection). The connections
+ * idle for longer than the idle timeout are closed; by a reactor
+ * timer if a reactor is specified, and on checkout otherwise.
+ *
+ * The leases may outlive the pool; they are closed when released.
+ */
+class connection_pool
+{
+public:
+	using clock_type = std::chrono::steady_clock;
+
+	static constexpr int DEFAULT_MAX_PER_HOST = 8;
+	static constexpr int DEFAULT_IDLE_TIMEOUT = 60000;  // 1 minute
+
+private:
+	struct pooled
+	{
+		std::unique_ptr<socket>             sock;
+		std::unique_ptr<ssl::connection>    cnxn;
+		clock_type::time_point              since;  // idle since
+	};
+
+	struct endpoint
+	{
+		std::vector<pooled>             idle;
+		int                             open = 0;   // idle and checked out
+		std::unique_ptr<ssl::session>   sess;       // last TLS session
+	};
+
+	struct state
+	{
+		std::mutex                                  lock;
+		std::condition_variable                     cv;
+		std::unordered_map<std::string, endpoint>   endpoints;
+		int                                         max_per_host;
+		int                                         idle_timeout;
+		bool                                        closed = false;
+		timer_id                                    timer = INVALID_TIMER;
+	};
+
+	std::shared_ptr<state>  m_state;
+	reactor                 *m_reactor;
+	resolver                *m_resolver;
+
+	static std::string make_key(const std::string &, in_port_t, ssl::context *);
+	static void expire(state &, clock_type::time_point, std::vector<pooled> &);
+	static void schedule(const std::shared_ptr<state> &, reactor *);
+	static bool is_healthy(pooled &);
+	std::unique_ptr<socket> open(const std::string &, in_port_t, int);
+
+public:
+	/*
+	 * A connection checked out from the pool. Move only.
+	 */
+	class lease
+	{
+	private:
+		std::weak_ptr<state>                m_state;
+		std::string                         m_key;
+		std::unique_ptr<socket>             m_sock;
+		std::unique_ptr<ssl::connection>    m_cnxn;
+		bool                                m_reused = false;
+
+		friend class connection_pool;
+
+		lease(const std::shared_ptr<state> &, const std::string &, pooled &&, bool);
+		void close();
+
+	public:
+		lease(const lease &) = delete;
+		lease(lease &&);
+		const lease &operator=(const lease &) = delete;
+		lease &operator=(lease &&);
+		~lease();
+
+		bool valid() const { return (m_sock != nullptr); }
+		bool is_reused() const { return m_reused; }
+		nio &io();
+		socket &sock();
+		ssl::connection *tls() { return m_cnxn.get(); }
+		void release();
+		void discard();
+	};
+
+	connection_pool(int maxperhost = DEFAULT_MAX_PER_HOST,
+		int idleto = DEFAULT_IDLE_TIMEOUT,
+		reactor *r = nullptr,
+		resolver *res = nullptr);
+	connection_pool(const connection_pool &) = delete;
+	connection_pool(connection_pool &&) = delete;
+	const connection_pool &operator=(const connection_pool &) = delete;
+	connection_pool &operator=(connection_pool &&) = delete;
+	~connection_pool();
+
+	lease checkout(const std::string &, in_port_t, ssl::context *ctx = nullptr,
+			int to = POLL_WAIT_FOREVER);
+	size_t idle_count();
+	size_t open_count();
+	void evict();
+};
+
+} // namespace net
+} // namespace snf
+
+#endif // _SNF_CNXNPOOL_H_
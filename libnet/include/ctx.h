@@ -8,6 +8,7 @@
 #include "crl.h"
 #include "truststore.h"
 #include "keymgr.h"
+#include "sesscache.h"
 
 namespace snf {
 namespace net {
@@ -24,8 +25,9 @@ namespace ssl {
  */
 class context {
 private:
-	static keymgr   *s_km;
-	SSL_CTX         *m_ctx = nullptr;
+	static keymgr           *s_km;
+	static session_cache    *s_sc;
+	SSL_CTX                 *m_ctx = nullptr;
 
 	long get_options();
 	long clr_options(unsigned long);
@@ -57,6 +59,25 @@ public:
 		s_km = km;
 	}
 
+	/*
+	 * Gets the external session cache, nullptr if not set.
+	 */
+	static session_cache *get_session_cache()
+	{
+		return s_sc;
+	}
+
+	/*
+	 * Sets the external session cache. Like set_keymgr(),
+	 * it is not thread-safe; set it at the start of the
+	 * program, before external_session_cache() is called.
+	 */
+	static void set_session_cache(session_cache *sc)
+	{
+		if (s_sc) delete s_sc;
+		s_sc = sc;
+	}
+
 	context();
 	context(const context &);
 	context(context &&);
@@ -72,6 +93,7 @@ public:
 	time_t session_timeout(time_t);
 	void set_session_context(const std::string &);
 	void session_ticket(connection_mode, bool);
+	void external_session_cache(bool);
 	void set_ciphers(const std::string &ciphers = DEFAULT_CIPHER_LIST);
 	void use_private_key(pkey &);
 	void use_certificate(x509_certificate &);
@@ -80,8 +102,10 @@ public:
 	void check_private_key();
 	void verify_peer(bool require_certificate = false, bool do_it_once = false);
 	void limit_certificate_chain_depth(int);
+	bool kernel_tls(bool);
 
 	friend class connection;
+	friend class sni_registry;
 };
 
 } // namespace ssl
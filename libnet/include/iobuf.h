@@ -0,0 +1,243 @@
+#ifndef _SNF_NET_IOBUF_H_
+#define _SNF_NET_IOBUF_H_
+
+#include "net.h"
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <streambuf>
+#include <vector>
+
+namespace snf {
+namespace net {
+
+/*
+ * Reference counted view of a pooled buffer block.
+ *
+ * The blocks come from the iobuf_pool in a few size classes and
+ * go back to it when the last reference is gone, so buffers are
+ * recycled instead of being allocated for every request. Copying
+ * an iobuf shares the block (no data is copied); slice() shares
+ * a part of it. So the data read from a socket can be handed to
+ * the parser, the handler and back to the socket without copies.
+ *
+ * The view is [data(), data() + size()). The room after it is
+ * writable, through tail() and commit(), only while the view is
+ * the only reference to the block.
+ */
+class iobuf
+{
+private:
+	friend class iobuf_pool;
+
+	struct alignas(16) block
+	{
+		std::atomic<int>    refs;
+		int                 size;   // data capacity
+		int                 sclass; // pool size class, -1 if not pooled
+
+		char *data() { return reinterpret_cast<char *>(this + 1); }
+	};
+
+	block   *m_blk = nullptr;
+	int     m_off = 0;
+	int     m_len = 0;
+
+	void release();
+
+public:
+	iobuf() {}
+	explicit iobuf(int);
+	iobuf(const void *, int);
+	iobuf(const iobuf &);
+	iobuf(iobuf &&);
+	~iobuf() { release(); }
+
+	iobuf &operator=(const iobuf &);
+	iobuf &operator=(iobuf &&);
+
+	explicit operator bool() const { return (m_blk != nullptr); }
+
+	char *data() { return m_blk ? m_blk->data() + m_off : nullptr; }
+	const char *data() const { return m_blk ? m_blk->data() + m_off : nullptr; }
+	int size() const { return m_len; }
+	bool empty() const { return (m_len == 0); }
+	int capacity() const { return m_blk ? m_blk->size - m_off : 0; }
+	bool unique() const { return m_blk && (m_blk->refs.load(std::memory_order_acquire) == 1); }
+
+	char *tail() { return data() + m_len; }
+	int tailroom() const { return unique() ? (m_blk->size - m_off - m_len) : 0; }
+	void commit(int);
+	void advance(int);
+	void truncate(int);
+	iobuf slice(int, int) const;
+	void reset();
+};
+
+/*
+ * Pool of the iobuf blocks, in three size classes: SMALL_SIZE
+ * for the message heads, MEDIUM_SIZE (a TLS record) for the
+ * socket read buffers, and LARGE_SIZE for the body chunks.
+ * Larger buffers are not pooled. The free blocks are kept up
+ * to a limit per size class; the rest are freed.
+ */
+class iobuf_pool
+{
+public:
+	static constexpr int SMALL_SIZE = 2048;
+	static constexpr int MEDIUM_SIZE = 16384;
+	static constexpr int LARGE_SIZE = 65536;
+	static constexpr size_t DEFAULT_LIMIT = 8 * 1024 * 1024;
+
+private:
+	friend class iobuf;
+
+	static constexpr int NCLASSES = 3;
+
+	struct freelist
+	{
+		std::mutex                  lock;
+		std::vector<iobuf::block *> blocks;
+		size_t                      max = 0;
+	};
+
+	freelist                m_free[NCLASSES];
+	std::atomic<uint64_t>   m_hits { 0 };
+	std::atomic<uint64_t>   m_misses { 0 };
+
+	iobuf_pool();
+
+	static int size_class(int);
+	iobuf::block *get(int);
+	void put(iobuf::block *);
+
+public:
+	static iobuf_pool &instance()
+	{
+		static iobuf_pool pool;
+		return pool;
+	}
+
+	iobuf_pool(const iobuf_pool &) = delete;
+	iobuf_pool(iobuf_pool &&) = delete;
+	iobuf_pool &operator=(const iobuf_pool &) = delete;
+	iobuf_pool &operator=(iobuf_pool &&) = delete;
+	~iobuf_pool() { trim(); }
+
+	void limit(size_t);
+	size_t cached();
+	void trim();
+	uint64_t hits() const { return m_hits.load(); }
+	uint64_t misses() const { return m_misses.load(); }
+};
+
+/*
+ * Chain of iobufs, e.g. a message head followed by the body
+ * chunks. The data appended is copied to the room at the end
+ * of the last buffer, or to a new pooled buffer; the iobufs
+ * appended are shared. prepare()/commit() give the room at the
+ * end to write into directly. to_iovec() gives the scatter/gather
+ * elements to write the chain with a single call.
+ */
+class iobuf_chain
+{
+private:
+	std::vector<iobuf>  m_bufs;
+	size_t              m_head = 0;     // first buffer in use
+	size_t              m_len = 0;      // total data length
+	int                 m_bufsize;      // size of the new buffers
+
+public:
+	iobuf_chain(int bufsize = iobuf_pool::SMALL_SIZE) : m_bufsize(bufsize) {}
+	iobuf_chain(const iobuf_chain &) = default;
+	iobuf_chain(iobuf_chain &&) = default;
+	~iobuf_chain() {}
+
+	iobuf_chain &operator=(const iobuf_chain &) = default;
+	iobuf_chain &operator=(iobuf_chain &&) = default;
+
+	size_t length() const { return m_len; }
+	bool empty() const { return (m_len == 0); }
+	size_t count() const { return m_bufs.size() - m_head; }
+	const iobuf &at(size_t i) const { return m_bufs[m_head + i]; }
+
+	void append(const iobuf &);
+	void append(iobuf &&);
+	void append(const void *, size_t);
+	void append(const iobuf_chain &);
+	char *prepare(int *);
+	void commit(int);
+	int to_iovec(iovec *, int) const;
+	void consume(size_t);
+	void clear();
+};
+
+/*
+ * Output streambuf that appends to an iobuf chain, to format
+ * the data straight into the pooled buffers:
+ *
+ * snf::net::iobuf_chain chain;
+ * snf::net::chainbuf buf(chain);
+ * std::ostream os(&buf);
+ * os << response << std::flush;
+ *
+ * The data is in the chain once the stream is flushed or the
+ * streambuf is destroyed.
+ */
+class chainbuf : public std::streambuf
+{
+private:
+	iobuf_chain &m_chain;
+
+	void put_done()
+	{
+		int n = static_cast<int>(pptr() - pbase());
+		if (n > 0)
+			m_chain.commit(n);
+		setp(nullptr, nullptr);
+	}
+
+protected:
+	virtual int_type overflow(int_type c) override
+	{
+		put_done();
+
+		int room = 0;
+		char *p = m_chain.prepare(&room);
+		setp(p, p + room);
+
+		if (c != traits_type::eof()) {
+			*pptr() = traits_type::to_char_type(c);
+			pbump(1);
+		}
+
+		return traits_type::not_eof(c);
+	}
+
+	virtual std::streamsize xsputn(const char *s, std::streamsize n) override
+	{
+		if (n <= (epptr() - pptr())) {
+			memcpy(pptr(), s, static_cast<size_t>(n));
+			pbump(static_cast<int>(n));
+		} else {
+			put_done();
+			m_chain.append(s, static_cast<size_t>(n));
+		}
+		return n;
+	}
+
+	virtual int sync() override
+	{
+		put_done();
+		return 0;
+	}
+
+public:
+	chainbuf(iobuf_chain &chain) : m_chain(chain) {}
+	~chainbuf() { put_done(); }
+};
+
+} // namespace net
+} // namespace snf
+
+#endif // _SNF_NET_IOBUF_H_
@@ -2,6 +2,7 @@
 #define _SNF_KEYMGR_H_
 
 #include "sslfcn.h"
+#include "file.h"
 #include <mutex>
 
 namespace snf {
@@ -74,6 +75,51 @@ public:
 	const keyrec *find(const uint8_t *, size_t);
 };
 
+/*
+ * A key manager that shares the keys with the other processes
+ * on the host through a key file, so that a session ticket
+ * issued by one server process can be decrypted by the others.
+ *
+ * The key file holds the current and the old key. The keys are
+ * rotated by the first process that finds the current key has
+ * expired; the file is locked while the keys are checked and
+ * rotated so that all the processes end up with the same keys.
+ * The keys are cached in the process; the file is read again
+ * when the cached key expires or when the key name presented by
+ * a TLS client is not known (at most once per second).
+ *
+ * The key file holds the secret keys; it is created with 0600
+ * permissions and is best placed on a memory backed file system.
+ */
+class shared_keymgr : public keymgr
+{
+private:
+	std::string m_path;
+	int         m_life = 0;
+	keyrec      m_cur;
+	keyrec      m_old;
+	bool        m_has_cur = false;
+	bool        m_has_old = false;
+	time_t      m_checked = 0;
+	std::mutex  m_lock;
+
+	bool sync(bool);
+
+public:
+	shared_keymgr(const std::string &path, int n = 3600) : m_path(path), m_life(n) { }
+
+	shared_keymgr(const shared_keymgr &) = delete;
+	shared_keymgr(shared_keymgr &&) = delete;
+
+	~shared_keymgr() { }
+
+	const shared_keymgr &operator=(const shared_keymgr &) = delete;
+	shared_keymgr &operator=(shared_keymgr &&) = delete;
+
+	const keyrec *get();
+	const keyrec *find(const uint8_t *, size_t);
+};
+
 } // namespace ssl
 } // namespace net
 } // namespace snf
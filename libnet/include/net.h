@@ -119,6 +119,7 @@ enum class connection_mode { client, server };
 constexpr int POLL_WAIT_FOREVER = -1;
 constexpr int POLL_WAIT_NONE = 0;
 
+int poll(pollfd *, size_t, int, int *oserr = 0);
 int poll(std::vector<pollfd> &, int, int *oserr = 0);
 
 } // namespace net
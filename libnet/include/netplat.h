@@ -17,17 +17,28 @@ constexpr int SHUTDOWN_WRITE = SD_SEND;
 constexpr int SHUTDOWN_RDWR = SD_BOTH;
 
 constexpr bool connect_in_progress(int e) { return (e == WSAEWOULDBLOCK); }
+constexpr bool would_block(int e) { return (e == WSAEWOULDBLOCK); }
 
 #if !defined(ETIMEDOUT)
 #define WSAETIMEDOUT ETIMEDOUT
 #endif
 
+/* Scatter/gather element, converted to WSABUF when used. */
+struct iovec
+{
+	void    *iov_base;
+	size_t  iov_len;
+};
+
+constexpr int MAX_IOVEC = 1024;
+
 #else // !_WIN32
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netdb.h>
 #include <fcntl.h>
 #include <poll.h>
@@ -43,6 +54,13 @@ constexpr int SHUTDOWN_WRITE = SHUT_WR;
 constexpr int SHUTDOWN_RDWR = SHUT_RDWR;
 
 constexpr bool connect_in_progress(int e) { return (e == EINPROGRESS); }
+constexpr bool would_block(int e) { return ((e == EAGAIN) || (e == EWOULDBLOCK)); }
+
+#if defined(IOV_MAX)
+constexpr int MAX_IOVEC = IOV_MAX;
+#else
+constexpr int MAX_IOVEC = 1024;
+#endif
 
 #endif // _WIN32
 
@@ -4,6 +4,8 @@
 #include <string>
 #include "net.h"
 #include "error.h"
+#include "file.h"
+#include "iobuf.h"
 
 namespace snf {
 namespace net {
@@ -12,9 +14,31 @@ namespace net {
  * A base class (think of it as interface) that is implemented
  * by socket and ssl::connection class to provide a consistent
  * read/write interface.
+ *
+ * The reads are buffered by default. The buffer is allocated
+ * on the first read and is refilled with whatever data is
+ * available, so a line or a character is read without a system
+ * call (or SSL_read) per byte. Large reads bypass the buffer.
+ * As the buffered data is not visible to poll(), the callers
+ * driven by a reactor must check pending() before waiting for
+ * the next read event.
+ *
+ * The read buffer is a pooled iobuf. read(iobuf &, ...) hands
+ * out the buffered data as a view of it, without copying; the
+ * buffer is then refilled in a new iobuf from the pool.
+ *
+ * The writes that make one message can be batched between
+ * begin_batch() and end_batch(), so they go out in full
+ * segments (socket) or full records (TLS connection) instead
+ * of a packet or a record per write. The data may be held
+ * back until end_batch(), which must be called before waiting
+ * for the peer's response.
  */
 class nio
 {
+public:
+	static constexpr int DEFAULT_BUFSIZE = 16384;
+
 private:
 	union u4 {
 		float   r;      // real number
@@ -26,33 +50,34 @@ private:
 		int64_t i;      // hopefully an equal sized integer
 	};
 
-	bool m_buffered = false;    // is read buffered?
-	char *m_buf = nullptr;      // data buffer
-	int  m_max = 0;             // maximum buffer size
-	int  m_len = 0;             // valid data in the buffer
-	int  m_idx = 0;             // next i/o index
+	bool  m_buffered = true;            // is read buffered?
+	iobuf m_buf;                        // data buffer
+	int  m_max = DEFAULT_BUFSIZE;       // maximum buffer size
+	int  m_len = 0;                     // valid data in the buffer
+	int  m_idx = 0;                     // next i/o index
 
+	int fill(int, int *);
 	int read_buffered(void *, int, int *, int, int *);
 
+protected:
+	static int iov_length(const iovec *, int);
+	virtual int readsome(void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	virtual int receive(iobuf &, int, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+
 public:
 	nio() {}
 	nio(const nio &) = delete;
 
 	nio(nio &&io)
 		: m_buffered(io.m_buffered)
+		, m_buf(std::move(io.m_buf))
 		, m_max(io.m_max)
 		, m_len(io.m_len)
 		, m_idx(io.m_idx)
 	{
-		m_buf = io.m_buf;
-		io.m_buf = nullptr;
 	}
 	
-	virtual ~nio()
-	{
-		if (m_buf)
-			delete [] m_buf;
-	}
+	virtual ~nio() {}
 
 	const nio & operator=(const nio &) = delete;
 
@@ -60,17 +85,7 @@ public:
 	{
 		if (this != &io) {
 			m_buffered = io.m_buffered;
-
-			if (m_buf) {
-				delete [] m_buf;
-				m_buf = nullptr;
-			}
-
-			if (io.m_buf) {
-				m_buf = io.m_buf;
-				io.m_buf = nullptr;
-			}
-
+			m_buf = std::move(io.m_buf);
 			m_max = io.m_max;
 			m_len = io.m_len;
 			m_idx = io.m_idx;
@@ -81,11 +96,23 @@ public:
 
 	virtual int readn(void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0) = 0;
 	virtual int writen(const void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0) = 0;
+	virtual int writen(const iovec *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	virtual int sendfile(snf::file &, int64_t, int64_t, int64_t *,
+		int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	virtual void begin_batch() {}
+	virtual int end_batch(int to = POLL_WAIT_FOREVER, int *oserr = 0) { return E_ok; }
 
-	void setbuf(int);
+	bool setbuf(int);
+	int pending() const { return m_len - m_idx; }
+	int peek(const char **, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	void consume(int);
 
 	int read(void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
 	int write(const void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	int read(const iovec *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	int write(const iovec *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	int read(iobuf &, int, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	int write(const iobuf_chain &, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
 
 	int get_char(char &, int to = POLL_WAIT_FOREVER, int *oserr = 0);
 	int put_char(char, int to = POLL_WAIT_FOREVER, int *oserr = 0);
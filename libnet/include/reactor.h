@@ -4,9 +4,12 @@
 #include <chrono>
 #include "netplat.h"
 #include "sock.h"
+#include "timerwheel.h"
 #include <array>
 #include <vector>
-#include <map>
+#include <unordered_map>
+#include <thread>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <atomic>
@@ -94,59 +97,145 @@ public:
 	virtual bool operator()(sock_t s, event e) = 0;
 };
 
+/*
+ * Event notification mechanism used by the reactor.
+ * dflt  - the best one available on the platform: epoll
+ *         on Linux, poll elsewhere.
+ * poll  - poll(), available on all platforms.
+ * epoll - epoll(), Linux only. Falls back to poll on
+ *         other platforms.
+ * uring - io_uring, Linux only. Falls back to epoll if the
+ *         kernel does not support it, and to poll on other
+ *         platforms. The handlers are readiness based with it
+ *         too; only the sockets switched to multishot accept
+ *         or receive (see reactor::accept_multishot() and
+ *         reactor::recv_multishot()) are completion based.
+ */
+enum class poller_type { dflt, poll, epoll, uring };
+
+namespace internal { class poller; }
+
 class sockpair_handler;
 
+/*
+ * Event loop running in a separate thread. The handlers are
+ * registered once and stay registered with the poller until
+ * they are removed; only the ready sockets are dispatched. The
+ * handlers are called without holding the reactor lock, so a
+ * handler may add or remove handlers, including its own.
+ *
+ * The handler timeouts and the general purpose timers share
+ * a timer wheel; the poll timeout is the time to the nearest
+ * expiration (or the reactor timeout, if it is earlier).
+ */
 class reactor
 {
 private:
+	using clock_type = std::chrono::steady_clock;
+
 	struct ev_info
 	{
-		event                                   e;   // event
-		std::unique_ptr<handler>                h;   // handler
-		std::chrono::milliseconds               to;  // timeout
-		std::chrono::system_clock::time_point   exp; // expiration
-
-		ev_info(event _e, int _to, handler *_h)
+		event                       e;                // event
+		std::unique_ptr<handler>    h;                // handler
+		std::chrono::milliseconds   to;               // timeout
+		clock_type::time_point      exp;              // expiration
+		uint64_t                    id;               // registration ID
+		timer_id                    timer = INVALID_TIMER; // timeout timer
+		bool                        busy = false;     // handler is running
+		bool                        removed = false;  // removed while running
+		std::unique_ptr<handler>    next;             // replaced while running
+
+		ev_info(event _e, int _to, handler *_h, uint64_t _id)
 			: e(_e)
 			, h(_h)
+			, id(_id)
 		{
 			if (_to <= 0) {
 				to = std::chrono::milliseconds::zero();
-				exp = std::chrono::system_clock::time_point::max();
+				exp = clock_type::time_point::max();
 			} else {
 				to = std::chrono::milliseconds{_to};
-				exp = std::chrono::system_clock::now();
-				exp += to;
+				exp = clock_type::now() + to;
 			}
 		}
 	};
 
 	using ev_info_type    = std::vector<std::unique_ptr<ev_info>>;
-	using ev_handler_type = std::map<sock_t, ev_info_type>;
-
-	int                               m_timeout;
-	std::atomic<bool>                 m_stopped { false };
-	std::array<snf::net::socket, 2>   m_sockpair;
-	std::future<void>                 m_future;
-	std::mutex                        m_lock;
-	ev_handler_type                   m_handlers;
-
-	std::vector<pollfd> set_poll_vector();
-	void process_poll_vector(std::vector<pollfd> &);
+	using ev_handler_type = std::unordered_map<sock_t, ev_info_type>;
+	using ev_fired_type   = std::vector<std::pair<ev_info *, event>>;
+
+	int                                 m_timeout;
+	std::atomic<bool>                   m_stopped { false };
+	std::array<snf::net::socket, 2>     m_sockpair;
+	std::future<void>                   m_future;
+	std::mutex                          m_lock;
+	ev_handler_type                     m_handlers;
+	timer_wheel                         m_timers;
+	std::vector<timer_wheel::callback>  m_posted;
+	std::atomic<std::thread::id>        m_thread;
+	uint64_t                            m_next_id = 0;
+	std::unique_ptr<internal::poller>   m_poller;
+
+	void set_interest(sock_t, const ev_info_type &, bool refresh = false);
+	void set_timeout(sock_t, ev_info *);
+	void cancel_timeout(ev_info *);
+	void handler_timeout(sock_t, uint64_t);
+	void dispatch(sock_t, ev_fired_type &);
+	void process_ready(const pollfd &);
+	void process_timers();
+	int next_timeout();
+	void wakeup();
 	void start();
+	bool attach(socket &, bool);
 
 public:
-	reactor(int to = 5000);
+	reactor(int to = 5000, poller_type type = poller_type::dflt);
 	reactor(const reactor &) = delete;
 	reactor(reactor &&) = delete;
 	const reactor &operator=(const reactor &) = delete;
 	reactor &operator=(reactor &&) = delete;
-	~reactor() { stop(); m_future.wait(); }
+	~reactor();
 
+	const char *poller_name() const;
 	void stop();
+	bool accept_multishot(socket &);
+	bool recv_multishot(socket &);
 	void add_handler(sock_t, event, handler *, int to = 0);
 	void remove_handler(sock_t);
 	void remove_handler(sock_t, event);
+	timer_id add_timer(int, const timer_wheel::callback &);
+	void post(const timer_wheel::callback &);
+	bool cancel_timer(timer_id);
+};
+
+/*
+ * Group of reactors, each running its own event loop with its
+ * own poller in a separate thread. A socket is registered with
+ * one of the reactors and is expected to stay with it for its
+ * lifetime; next() picks the reactors in round robin order for
+ * the new sockets. To spread the accepts as well, bind one
+ * listening socket per reactor to the same port with
+ * socket::reuseport() set, and register each with its own
+ * reactor.
+ */
+class reactor_group
+{
+private:
+	std::vector<std::unique_ptr<reactor>>   m_reactors;
+	std::atomic<size_t>                     m_next { 0 };
+
+public:
+	reactor_group(int n = 0, int to = 5000, poller_type type = poller_type::dflt);
+	reactor_group(const reactor_group &) = delete;
+	reactor_group(reactor_group &&) = delete;
+	const reactor_group &operator=(const reactor_group &) = delete;
+	reactor_group &operator=(reactor_group &&) = delete;
+	~reactor_group() { stop(); }
+
+	size_t size() const { return m_reactors.size(); }
+	reactor &operator[](size_t i) { return *m_reactors.at(i); }
+	reactor &next();
+	void stop();
 };
 
 } // namespace net
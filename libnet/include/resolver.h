@@ -0,0 +1,116 @@
+#ifndef _SNF_RESOLVER_H_
+#define _SNF_RESOLVER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "sa.h"
+#include "reactor.h"
+#include "thrdpool.h"
+
+namespace snf {
+namespace net {
+
+/*
+ * Asynchronous host name resolver with a TTL cache.
+ *
+ * The lookups run in a small thread pool; the caller's thread
+ * does not block on the system resolver. The results are cached:
+ * the successful lookups for the positive TTL and the failed ones
+ * for the (shorter) negative TTL. The system resolver does not
+ * report the record TTL, so the TTLs are set per resolver.
+ *
+ * The concurrent lookups of the same host, service, family and
+ * socket type are coalesced: the first one is sent to the thread
+ * pool and the rest wait for its result.
+ *
+ * The completion callback is called:
+ * - in the caller's thread, before resolve() returns, if the
+ *   result is in the cache.
+ * - in the reactor thread if a reactor is specified; so a
+ *   reactor driven client can connect from the callback.
+ * - in the resolver's thread otherwise.
+ *
+ * The lookup function defaults to socket_address::get_client();
+ * it can be replaced, e.g. to resolve against a stub in tests.
+ * It reports the failure by throwing std::system_error.
+ *
+ * The callbacks pending when the resolver is destroyed are not
+ * called. The reactor, if specified, must outlive the lookup.
+ */
+class resolver
+{
+public:
+	using addresses = std::vector<socket_address>;
+	using callback = std::function<void(const std::error_code &, const addresses &)>;
+	using lookup_function = std::function<addresses(int, socket_type,
+				const std::string &, const std::string &)>;
+
+	static constexpr int DEFAULT_TTL = 300000;      // 5 minutes
+	static constexpr int DEFAULT_NEGATIVE_TTL = 30000;  // 30 seconds
+	static constexpr size_t DEFAULT_MAX_ENTRIES = 4096;
+
+private:
+	using clock_type = std::chrono::steady_clock;
+
+	struct waiter
+	{
+		callback    cb;
+		reactor     *r;
+	};
+
+	struct entry
+	{
+		std::error_code         ec;     // lookup status
+		addresses               addrs;  // lookup result
+		clock_type::time_point  exp;    // expiration
+	};
+
+	lookup_function                         m_lookup;
+	int                                     m_ttl;
+	int                                     m_negttl;
+	size_t                                  m_max;
+	std::mutex                              m_lock;
+	std::unordered_map<std::string, entry>  m_cache;
+	std::unordered_map<std::string, std::vector<waiter>> m_pending;
+	thread_pool                             m_pool;
+
+	static std::string make_key(int, socket_type, const std::string &, const std::string &);
+	static void complete(const waiter &, const std::error_code &, const addresses &);
+	void store(const std::string &, const std::error_code &, const addresses &);
+	void lookup(const std::string &, int, socket_type, const std::string &, const std::string &);
+
+public:
+	resolver(size_t nthreads = 2,
+		int ttl = DEFAULT_TTL,
+		int negttl = DEFAULT_NEGATIVE_TTL,
+		size_t maxentries = DEFAULT_MAX_ENTRIES);
+	resolver(const resolver &) = delete;
+	resolver(resolver &&) = delete;
+	const resolver &operator=(const resolver &) = delete;
+	resolver &operator=(resolver &&) = delete;
+	~resolver();
+
+	void set_lookup_function(const lookup_function &);
+
+	void resolve(int, socket_type, const std::string &, const std::string &,
+			const callback &, reactor *r = nullptr);
+	void resolve(int, socket_type, const std::string &, in_port_t,
+			const callback &, reactor *r = nullptr);
+	addresses resolve(int, socket_type, const std::string &, const std::string &);
+
+	size_t size();
+	void flush();
+};
+
+} // namespace net
+} // namespace snf
+
+#endif // _SNF_RESOLVER_H_
@@ -0,0 +1,120 @@
+#ifndef _SNF_SESSCACHE_H_
+#define _SNF_SESSCACHE_H_
+
+#include "file.h"
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <time.h>
+
+namespace snf {
+namespace net {
+namespace ssl {
+
+/*
+ * External TLS session cache interface.
+ *
+ * The TLS server keeps the sessions, created on full handshakes,
+ * in its internal cache so that the clients can resume them with
+ * an abbreviated handshake by presenting the session ID. The cache
+ * is per process; when several server processes are run behind a
+ * load balancer, a client rarely comes back to the same process.
+ * An external session cache, shared by all the processes, makes
+ * the resumption work across the processes.
+ *
+ * The sessions are stored in the DER format along with their
+ * expiration time. The implementation must be thread-safe.
+ */
+class session_cache
+{
+public:
+	virtual ~session_cache() {}
+
+	/*
+	 * Adds the session to the cache, replacing the session
+	 * with the same ID if any.
+	 *
+	 * @param [in] id     - session ID.
+	 * @param [in] idlen  - session ID length.
+	 * @param [in] data   - session in DER format.
+	 * @param [in] len    - session length.
+	 * @param [in] expire - epoch time when the session expires.
+	 *
+	 * @return true if the session is added, false otherwise.
+	 */
+	virtual bool add(const uint8_t *id, size_t idlen, const uint8_t *data, size_t len, time_t expire) = 0;
+
+	/*
+	 * Finds the session in the cache.
+	 *
+	 * @param [in]  id    - session ID.
+	 * @param [in]  idlen - session ID length.
+	 * @param [out] data  - session in DER format.
+	 *
+	 * @return true if the session is found and has not expired,
+	 *         false otherwise.
+	 */
+	virtual bool find(const uint8_t *id, size_t idlen, std::vector<uint8_t> &data) = 0;
+
+	/*
+	 * Removes the session from the cache.
+	 *
+	 * @param [in] id    - session ID.
+	 * @param [in] idlen - session ID length.
+	 */
+	virtual void remove(const uint8_t *id, size_t idlen) = 0;
+};
+
+/*
+ * Session cache in a local file shared by all the processes on
+ * the host; it is best placed on a memory backed file system
+ * such as /dev/shm. The file is a fixed size hash table of
+ * buckets of SLOTS_PER_BUCKET slots. A session goes to a free
+ * (or expired) slot in the bucket of its ID; if there is none,
+ * the session expiring first is evicted. The sessions larger
+ * than the slot are not cached.
+ *
+ * The buckets are locked with file region locks, so the processes
+ * only contend when they use the same bucket. File region locks
+ * do not exclude the threads of a process; they are serialized
+ * by a mutex.
+ */
+class file_session_cache : public session_cache
+{
+public:
+	static constexpr int SLOTS_PER_BUCKET = 4;
+	static constexpr int MAX_ID_SIZE = 32;
+	static constexpr int DEFAULT_SLOT_SIZE = 2048;
+
+private:
+	static constexpr int HEADER_SIZE = 64;
+	static constexpr int SLOT_HEADER_SIZE = 24 + MAX_ID_SIZE;
+
+	snf::file   m_file;
+	int         m_buckets;
+	int         m_slotsize;
+	std::mutex  m_lock;
+
+	void init();
+	int64_t bucket_offset(const uint8_t *, size_t) const;
+	int bucket_size() const { return SLOTS_PER_BUCKET * m_slotsize; }
+	bool read_bucket(int64_t, std::vector<uint8_t> &);
+
+public:
+	file_session_cache(const std::string &, int nsessions = 16384, int slotsize = DEFAULT_SLOT_SIZE);
+	file_session_cache(const file_session_cache &) = delete;
+	file_session_cache(file_session_cache &&) = delete;
+	const file_session_cache &operator=(const file_session_cache &) = delete;
+	file_session_cache &operator=(file_session_cache &&) = delete;
+	~file_session_cache();
+
+	bool add(const uint8_t *, size_t, const uint8_t *, size_t, time_t) override;
+	bool find(const uint8_t *, size_t, std::vector<uint8_t> &) override;
+	void remove(const uint8_t *, size_t) override;
+};
+
+} // namespace ssl
+} // namespace net
+} // namespace snf
+
+#endif // _SNF_SESSCACHE_H_
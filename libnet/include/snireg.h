@@ -0,0 +1,80 @@
+#ifndef _SNF_SNIREG_H_
+#define _SNF_SNIREG_H_
+
+#include "ctx.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+extern "C" int sni_registry_cb(SSL *, int *, void *);
+
+namespace snf {
+namespace net {
+namespace ssl {
+
+/*
+ * SNI context registry. Maps the server names to the SSL contexts
+ * (one per certificate) for a TLS server hosting many names.
+ *
+ * The registry is attached to the default SSL context, the one
+ * the connections are created with. When a TLS client presents a
+ * server name, the SNI callback finds the context in O(1): first
+ * the exact name, then the wildcard name for its parent domain
+ * (*.example.com matches www.example.com but neither example.com
+ * nor a.www.example.com). If no context is found, the handshake
+ * goes on with the default context. The names are case-insensitive.
+ *
+ * The lookups are lock-free. The name table is immutable; the
+ * updates copy it, modify the copy and publish it atomically. The
+ * replaced tables are kept (the lookups in flight may be using
+ * them) until the registry is destroyed; so the registry is meant
+ * for the names that change rarely. The contexts are shared by the
+ * tables and by all the connections; they must not be modified
+ * once added. The registry must outlive the attached context.
+ */
+class sni_registry
+{
+private:
+	using context_ptr = std::shared_ptr<context>;
+	using name_map = std::unordered_map<std::string, context_ptr>;
+
+	struct table
+	{
+		name_map    exact;      // exact names
+		name_map    wildcard;   // wildcard names, keyed by the parent domain
+	};
+
+	std::atomic<const table *>  m_table;
+	std::vector<const table *>  m_retired;
+	std::mutex                  m_lock;     // serializes the updates
+
+	static std::string normalize(const std::string &);
+	static void insert(table *, const std::string &, const context_ptr &);
+	static std::vector<std::string> names(context &);
+	void publish(table *);
+
+public:
+	sni_registry();
+	sni_registry(const sni_registry &) = delete;
+	sni_registry(sni_registry &&) = delete;
+	const sni_registry &operator=(const sni_registry &) = delete;
+	sni_registry &operator=(sni_registry &&) = delete;
+	~sni_registry();
+
+	void add(context &);
+	void add(std::vector<context> &);
+	void add(const std::string &, context &);
+	bool remove(const std::string &);
+	size_t size() const;
+	context *find(const std::string &) const;
+	void attach(context &);
+};
+
+} // namespace ssl
+} // namespace net
+} // namespace snf
+
+#endif // _SNF_SNIREG_H_
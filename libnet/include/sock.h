@@ -4,27 +4,65 @@
 #include "net.h"
 #include "nio.h"
 #include <array>
+#include <memory>
 
 namespace snf {
 namespace net {
 
+namespace internal { class feed; }
+
+class reactor;
+
+/*
+ * A datagram for the batched sends and receives.
+ * - For sends, buf/len is the data and addr is the destination;
+ *   addrlen is 0 on a connected socket.
+ * - For receives, buf/len is the buffer; bytes, addr/addrlen and
+ *   the flags are filled in for the received datagram.
+ */
+struct datagram
+{
+	void                *buf = nullptr;     // data buffer
+	int                 len = 0;            // data/buffer length
+	int                 bytes = 0;          // bytes received
+	sockaddr_storage    addr;               // destination/source address
+	socklen_t           addrlen = 0;        // address length
+	int                 segsize = 0;        // GRO segment size, 0 if not coalesced
+	bool                truncated = false;  // datagram did not fit the buffer
+
+	datagram() { memset(&addr, 0, sizeof(addr)); }
+	datagram(void *b, int l) : buf(b), len(l) { memset(&addr, 0, sizeof(addr)); }
+	datagram(const void *, int, const socket_address &);
+
+	void address(const socket_address &);
+	socket_address address() const { return socket_address(addr, addrlen); }
+};
+
 /*
  * Manages all aspects of socket.
  * - There is no copy constructor or copy operator.
  * - There are move constructor and move operator available though.
  * - A type operator is provided to get the raw socket.
+ * - A socket attached to a reactor for multishot accept or receive
+ *   takes the connections or the data the reactor has queued for
+ *   it, instead of calling accept()/recv().
  */
 class socket : public nio
 {
 private:
+	friend class reactor;
+
 	sock_t          m_sock;
 	socket_type     m_type;
 	socket_address  *m_local = nullptr;
 	socket_address  *m_peer = nullptr;
 	bool            m_skip_close = false;
+	bool            m_blocking = true;  // cached socket mode
+	bool            m_batched = false;  // corked by begin_batch()
+	std::shared_ptr<internal::feed>
+	                m_feed;             // multishot completions, if attached
 
 #if defined(_WIN32)
-	bool            m_blocking = true;
 	int64_t         m_rcvtimeo = 0L;
 	int64_t         m_sndtimeo = 0L;
 #endif
@@ -32,9 +70,15 @@ private:
 	const char *optstr(int, int);
 	void getopt(int, int, void *, int *);
 	void setopt(int, int, void *, int);
+	bool query_blocking();
+	int io_flags(int, bool *);
+	bool wait(short, int, int *);
 
 protected:
 	socket(sock_t, const sockaddr_storage &, socklen_t);
+	socket(sock_t, socket_type, bool, const sockaddr_storage &, socklen_t);
+	int readsome(void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0) override;
+	int receive(iobuf &, int, int to = POLL_WAIT_FOREVER, int *oserr = 0) override;
 
 public:
 	enum class linger_type
@@ -63,6 +107,8 @@ public:
 	void keepalive(bool);
 	bool reuseaddr();
 	void reuseaddr(bool);
+	bool reuseport();
+	void reuseport(bool);
 	linger_type linger(int *to = nullptr);
 	void linger(linger_type, int to = 60);
 	int rcvbuf();
@@ -76,6 +122,16 @@ public:
 	int error();
 	bool tcpnodelay();
 	void tcpnodelay(bool);
+	bool cork();
+	void cork(bool);
+	int udpsegment();
+	void udpsegment(int);
+	bool udpgro();
+	void udpgro(bool);
+	int deferaccept();
+	void deferaccept(int);
+	int fastopen();
+	void fastopen(int);
 	bool blocking();
 	void blocking(bool);
 	std::string dump_options();
@@ -89,10 +145,19 @@ public:
 	void bind(const socket_address &);
 	void listen(int);
 	socket accept();
+	int accept(std::unique_ptr<socket> &, bool nonblocking = true, int *oserr = 0);
 	bool is_readable(int to = POLL_WAIT_FOREVER, int *oserr = 0);
 	bool is_writable(int to = POLL_WAIT_FOREVER, int *oserr = 0);
 	int readn(void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
 	int writen(const void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	int writen(const iovec *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	int sendfile(snf::file &, int64_t, int64_t, int64_t *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	void begin_batch() override;
+	int end_batch(int to = POLL_WAIT_FOREVER, int *oserr = 0) override;
+	int sendto(const void *, int, const socket_address &, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	int recvfrom(void *, int, int *, socket_address *from = nullptr, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	int sendmmsg(datagram *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	int recvmmsg(datagram *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
 	void close();
 	void shutdown(int);
 
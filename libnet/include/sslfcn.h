@@ -18,6 +18,39 @@
 #include <openssl/bn.h>
 #include <openssl/hmac.h>
 
+/*
+ * OpenSSL 3.0 turned some of the control macros into functions
+ * and dropped the macros. The functions are looked up at run
+ * time; the control codes are needed only when the older library
+ * is loaded.
+ */
+#if !defined(SSL_CTRL_OPTIONS)
+#define SSL_CTRL_OPTIONS            32
+#endif
+
+#if !defined(SSL_CTRL_CLEAR_OPTIONS)
+#define SSL_CTRL_CLEAR_OPTIONS      77
+#endif
+
+#if !defined(SSL_CTRL_GET_SESSION_REUSED)
+#define SSL_CTRL_GET_SESSION_REUSED 8
+#endif
+
+/*
+ * Kernel TLS, available with OpenSSL 3.0 and later.
+ */
+#if !defined(SSL_OP_ENABLE_KTLS)
+#define SSL_OP_ENABLE_KTLS          (1UL << 3)
+#endif
+
+#if !defined(BIO_CTRL_GET_KTLS_SEND)
+#define BIO_CTRL_GET_KTLS_SEND      73
+#endif
+
+#if !defined(BIO_CTRL_GET_KTLS_RECV)
+#define BIO_CTRL_GET_KTLS_RECV      76
+#endif
+
 using p_openssl_version_num = unsigned long (*)(void);
 using p_openssl_version_str = const char * (*)(int);
 
@@ -30,6 +63,7 @@ using p_bio_new = BIO * (*)(const BIO_METHOD *);
 using p_bio_read = int (*)(BIO *, void *, int);
 using p_bio_new_mem_buf = BIO * (*)(const void *, int);
 using p_bio_free = int (*)(BIO *);
+using p_bio_ctrl = long (*)(BIO *, int, long, void *);
 
 using p_d2i_private_key_fp = EVP_PKEY * (*)(FILE *, EVP_PKEY **);
 using p_d2i_auto_private_key = EVP_PKEY * (*)(EVP_PKEY **, const unsigned char **, long);
@@ -123,6 +157,12 @@ using p_ssl_ctx_set_sid_ctx = int (*)(SSL_CTX *, const unsigned char *, unsigned
 using p_ssl_ctx_tlsext_ticket_key_cb = int (*)(SSL *, unsigned char *, unsigned char *, EVP_CIPHER_CTX *, HMAC_CTX *, int);
 using p_ssl_ctx_get_timeout = long (*)(const SSL_CTX *);
 using p_ssl_ctx_set_timeout = long (*)(SSL_CTX *, long);
+using p_ssl_sess_new_cb = int (*)(SSL *, SSL_SESSION *);
+using p_ssl_sess_get_cb = SSL_SESSION * (*)(SSL *, const unsigned char *, int, int *);
+using p_ssl_sess_remove_cb = void (*)(SSL_CTX *, SSL_SESSION *);
+using p_ssl_ctx_sess_set_new_cb = void (*)(SSL_CTX *, p_ssl_sess_new_cb);
+using p_ssl_ctx_sess_set_get_cb = void (*)(SSL_CTX *, p_ssl_sess_get_cb);
+using p_ssl_ctx_sess_set_remove_cb = void (*)(SSL_CTX *, p_ssl_sess_remove_cb);
 
 using p_ssl_new = SSL * (*)(SSL_CTX *);
 using p_ssl_dup = SSL * (*)(SSL *);
@@ -152,6 +192,9 @@ using p_ssl_get_session = SSL_SESSION * (*)(const SSL *);
 using p_ssl_set_session = int (*)(SSL *, SSL_SESSION *);
 using p_ssl_session_reused = int (*)(SSL *);
 using p_ssl_get0_param = X509_VERIFY_PARAM * (*)(SSL *);
+using p_ssl_get_rbio = BIO * (*)(const SSL *);
+using p_ssl_get_wbio = BIO * (*)(const SSL *);
+using p_ssl_sendfile = int64_t (*)(SSL *, int, int64_t, size_t, int);
 
 using p_ssl_session_d2i = SSL_SESSION * (*)(SSL_SESSION **, const unsigned char **, long);
 using p_ssl_session_i2d = int (*)(SSL_SESSION *, unsigned char **);
@@ -249,6 +292,7 @@ private:
 	p_bio_read                  m_bio_read = nullptr;
 	p_bio_new_mem_buf           m_bio_new_mem_buf = nullptr;
 	p_bio_free                  m_bio_free = nullptr;
+	p_bio_ctrl                  m_bio_ctrl = nullptr;
 
 	p_d2i_private_key_fp        m_d2i_private_key_fp = nullptr;
 	p_d2i_auto_private_key      m_d2i_auto_private_key = nullptr;
@@ -340,6 +384,9 @@ private:
 	p_ssl_ctx_set_sid_ctx       m_ssl_ctx_set_sid_ctx = nullptr;        
 	p_ssl_ctx_get_timeout       m_ssl_ctx_get_timeout = nullptr;
 	p_ssl_ctx_set_timeout       m_ssl_ctx_set_timeout = nullptr;
+	p_ssl_ctx_sess_set_new_cb   m_ssl_ctx_sess_set_new_cb = nullptr;
+	p_ssl_ctx_sess_set_get_cb   m_ssl_ctx_sess_set_get_cb = nullptr;
+	p_ssl_ctx_sess_set_remove_cb    m_ssl_ctx_sess_set_remove_cb = nullptr;
 
 	p_ssl_new                   m_ssl_new = nullptr;
 	p_ssl_dup                   m_ssl_dup = nullptr;
@@ -369,6 +416,9 @@ private:
 	p_ssl_set_session           m_ssl_set_session = nullptr;
 	p_ssl_session_reused        m_ssl_session_reused = nullptr;
 	p_ssl_get0_param            m_ssl_get0_param = nullptr;
+	p_ssl_get_rbio              m_ssl_get_rbio = nullptr;
+	p_ssl_get_wbio              m_ssl_get_wbio = nullptr;
+	p_ssl_sendfile              m_ssl_sendfile = nullptr;
 
 	p_ssl_session_d2i           m_ssl_session_d2i = nullptr;
 	p_ssl_session_i2d           m_ssl_session_i2d = nullptr;
@@ -433,6 +483,7 @@ public:
 	p_bio_read bio_read();
 	p_bio_new_mem_buf bio_new_mem_buf();
 	p_bio_free bio_free();
+	p_bio_ctrl bio_ctrl();
 
 	p_d2i_private_key_fp d2i_private_key_fp();
 	p_d2i_auto_private_key d2i_auto_private_key();
@@ -524,6 +575,9 @@ public:
 	p_ssl_ctx_set_sid_ctx ssl_ctx_set_sid_ctx();
 	p_ssl_ctx_get_timeout ssl_ctx_get_timeout();
 	p_ssl_ctx_set_timeout ssl_ctx_set_timeout();
+	p_ssl_ctx_sess_set_new_cb ssl_ctx_sess_set_new_cb();
+	p_ssl_ctx_sess_set_get_cb ssl_ctx_sess_set_get_cb();
+	p_ssl_ctx_sess_set_remove_cb ssl_ctx_sess_set_remove_cb();
 
 	p_ssl_new ssl_new();
 	p_ssl_dup ssl_dup();
@@ -553,6 +607,9 @@ public:
 	p_ssl_set_session ssl_set_session();
 	p_ssl_session_reused ssl_session_reused();
 	p_ssl_get0_param ssl_get0_param();
+	p_ssl_get_rbio ssl_get_rbio();
+	p_ssl_get_wbio ssl_get_wbio();
+	p_ssl_sendfile ssl_sendfile();
 
 	p_ssl_session_d2i ssl_session_d2i();
 	p_ssl_session_i2d ssl_session_i2d();
@@ -0,0 +1,93 @@
+#ifndef _SNF_TIMER_WHEEL_H_
+#define _SNF_TIMER_WHEEL_H_
+
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+namespace snf {
+namespace net {
+
+using timer_id = uint64_t;
+constexpr timer_id INVALID_TIMER = 0;
+
+/*
+ * Hierarchical timing wheel on the monotonic clock.
+ *
+ * Time is divided into ticks of the given resolution. There
+ * are 4 levels of 256 slots each; a slot at level L spans
+ * 256^L ticks. A timer is placed in the lowest level whose
+ * span covers its expiration, and is moved (cascaded) to the
+ * lower levels as the time approaches it. So scheduling and
+ * cancelling a timer are O(1), and expiring the timers costs
+ * O(1) per tick and per timer. The wheel covers 2^32 ticks
+ * (about 49 days at 1ms resolution); the timers beyond that
+ * stay at the top level until they come in range.
+ *
+ * The wheel is not thread-safe. The callbacks are not called
+ * by the wheel: expire() hands them over to the caller, so
+ * that the caller can call them without holding its locks.
+ */
+class timer_wheel
+{
+public:
+	using clock_type = std::chrono::steady_clock;
+	using callback = std::function<void()>;
+
+private:
+	static constexpr int        LEVELS = 4;
+	static constexpr int        SLOT_BITS = 8;
+	static constexpr int        SLOTS = 1 << SLOT_BITS;
+	static constexpr uint64_t   SLOT_MASK = SLOTS - 1;
+	static constexpr int        WORDS = SLOTS / 64;
+
+	struct node
+	{
+		node        *prev;
+		node        *next;
+		uint64_t    tick;   // expiration tick
+		int         level;  // wheel level
+		int         slot;   // slot in the level
+		timer_id    id;     // timer ID
+		callback    cb;     // callback
+	};
+
+	std::chrono::milliseconds               m_resolution;
+	clock_type::time_point                  m_start;
+	uint64_t                                m_current = 0;
+	timer_id                                m_next_id = INVALID_TIMER;
+	node                                    *m_slots[LEVELS][SLOTS];
+	uint64_t                                m_bitmap[LEVELS][WORDS];
+	std::unordered_map<timer_id, node *>    m_timers;
+
+	uint64_t to_tick(clock_type::time_point) const;
+	void link(node *);
+	void unlink(node *);
+	void place(node *);
+	void cascade();
+	int next_slot(int, int) const;
+
+public:
+	timer_wheel(std::chrono::milliseconds res = std::chrono::milliseconds(1));
+	timer_wheel(const timer_wheel &) = delete;
+	timer_wheel(timer_wheel &&) = delete;
+	const timer_wheel &operator=(const timer_wheel &) = delete;
+	timer_wheel &operator=(timer_wheel &&) = delete;
+	~timer_wheel();
+
+	size_t size() const { return m_timers.size(); }
+	bool empty() const { return m_timers.empty(); }
+
+	timer_id schedule(clock_type::time_point, const callback &);
+	timer_id schedule(std::chrono::milliseconds, const callback &);
+	bool cancel(timer_id);
+	int next_timeout(clock_type::time_point);
+	size_t expire(clock_type::time_point, std::vector<callback> &);
+};
+
+} // namespace net
+} // namespace snf
+
+#endif // _SNF_TIMER_WHEEL_H_
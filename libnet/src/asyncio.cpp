@@ -0,0 +1,312 @@
+#include "asyncio.h"
+#include "dbg.h"
+#include <stdexcept>
+
+namespace snf {
+namespace net {
+
+/*
+ * Reactor handler that continues the operation when the
+ * socket is ready.
+ */
+class async_io::io_handler : public handler
+{
+private:
+	std::shared_ptr<state>  m_state;
+	bool                    m_read;
+
+public:
+	io_handler(const std::shared_ptr<state> &st, bool rd)
+		: m_state(st)
+		, m_read(rd)
+	{
+	}
+
+	virtual ~io_handler() {}
+
+	virtual const char *name() const
+	{
+		return m_read ? "async-read-handler" : "async-write-handler";
+	}
+
+	virtual bool operator()(sock_t, event e) override
+	{
+		io_result res;
+		completion cb;
+
+		{
+			std::lock_guard<std::mutex> guard(m_state->lock);
+			operation &op = m_read ? m_state->rd : m_state->wr;
+			if (m_state->closed || !op.active)
+				return false;
+
+			if (e == event::timeout) {
+				res.status = E_timed_out;
+				res.bytes = op.done;
+			} else if (!attempt(*m_state, m_read, res)) {
+				return true;
+			}
+
+			cb = std::move(op.cb);
+			op.active = false;
+			op.waiting = false;
+		}
+
+		cb(res);
+		return false;
+	}
+};
+
+/*
+ * Determines if the I/O without waiting failed only because the
+ * socket is not ready. A zero wait that expires is reported as a
+ * read/write failure without a system error.
+ */
+static bool
+not_ready(int retval, int oserr)
+{
+	if ((retval == E_try_again) || (retval == E_timed_out))
+		return true;
+	if ((retval == E_read_failed) || (retval == E_write_failed))
+		return (oserr == 0);
+	return false;
+}
+
+/*
+ * Tries the I/O for the operation without waiting.
+ *
+ * @return true if the operation is complete, false if it
+ *         must wait for the socket to be ready.
+ */
+bool
+async_io::attempt(state &st, bool rd, io_result &res)
+{
+	operation &op = rd ? st.rd : st.wr;
+
+	while (op.done < op.len) {
+		int n = 0;
+		int oserr = 0;
+		int retval;
+
+		if (rd)
+			retval = st.io->read(op.buf + op.done, op.len - op.done, &n, POLL_WAIT_NONE, &oserr);
+		else
+			retval = st.io->writen(op.buf + op.done, op.len - op.done, &n, POLL_WAIT_NONE, &oserr);
+
+		op.done += n;
+
+		if (not_ready(retval, oserr)) {
+			if (op.some && (op.done > 0))
+				break;
+			return false;
+		}
+
+		if (retval != E_ok) {
+			res.status = retval;
+			res.oserr = oserr;
+			break;
+		}
+
+		// End of file, or partial read requested.
+		if (rd && ((n == 0) || op.some))
+			break;
+	}
+
+	res.bytes = op.done;
+	return true;
+}
+
+/*
+ * Runs the operation in the reactor thread: completes it if
+ * the I/O can be done right away, otherwise registers the
+ * handler to continue it when the socket is ready.
+ */
+void
+async_io::run(const std::shared_ptr<state> &st, bool rd)
+{
+	io_result res;
+	completion cb;
+
+	{
+		std::lock_guard<std::mutex> guard(st->lock);
+		operation &op = rd ? st->rd : st->wr;
+		if (st->closed || !op.active)
+			return;
+
+		if (!attempt(*st, rd, res)) {
+			op.waiting = true;
+			st->r.add_handler(st->s, rd ? event::read : event::write,
+				DBG_NEW io_handler(st, rd), op.to);
+			return;
+		}
+
+		cb = std::move(op.cb);
+		op.active = false;
+	}
+
+	cb(res);
+}
+
+/*
+ * Starts the operation.
+ *
+ * @throws std::invalid_argument if the arguments are not valid.
+ *         std::logic_error if an operation in the same direction
+ *         is in progress.
+ */
+void
+async_io::start(bool rd, char *buf, int len, bool some, const completion &cb, int to)
+{
+	if ((buf == nullptr) || (len <= 0))
+		throw std::invalid_argument("invalid buffer");
+
+	if (!cb)
+		throw std::invalid_argument("invalid completion callback");
+
+	{
+		std::lock_guard<std::mutex> guard(m_state->lock);
+		operation &op = rd ? m_state->rd : m_state->wr;
+		if (op.active)
+			throw std::logic_error(rd ? "read in progress" : "write in progress");
+
+		op.active = true;
+		op.waiting = false;
+		op.some = some;
+		op.buf = buf;
+		op.len = len;
+		op.done = 0;
+		op.to = to;
+		op.cb = cb;
+	}
+
+	std::shared_ptr<state> st = m_state;
+	m_state->r.post([st, rd] () { run(st, rd); });
+}
+
+/*
+ * Constructs the asynchronous I/O object.
+ *
+ * @param [in] r  - reactor to drive the I/O.
+ * @param [in] s  - socket.
+ * @param [in] io - I/O interface over the socket, e.g. the TLS
+ *                  connection. Defaults to the socket.
+ *
+ * The socket, and the I/O interface, must outlive the object.
+ */
+async_io::async_io(reactor &r, socket &s, nio *io)
+	: m_state(std::make_shared<state>(r, static_cast<sock_t>(s), io ? io : &s))
+{
+}
+
+/*
+ * Destructor. Cancels the operations in progress.
+ */
+async_io::~async_io()
+{
+	bool rd, wr;
+
+	{
+		std::lock_guard<std::mutex> guard(m_state->lock);
+		m_state->closed = true;
+		rd = m_state->rd.waiting;
+		wr = m_state->wr.waiting;
+		m_state->rd.cb = nullptr;
+		m_state->wr.cb = nullptr;
+	}
+
+	if (rd)
+		m_state->r.remove_handler(m_state->s, event::read);
+	if (wr)
+		m_state->r.remove_handler(m_state->s, event::write);
+}
+
+/*
+ * Reads the data that is available, at least one byte.
+ *
+ * @param [out] buf - buffer to read the data into.
+ * @param [in]  len - buffer length.
+ * @param [in]  cb  - completion callback. The result has the
+ *                    number of bytes read; 0 at end of file.
+ * @param [in]  to  - timeout in milliseconds.
+ *
+ * @throws std::invalid_argument or std::logic_error if the
+ *         operation could not be started.
+ */
+void
+async_io::async_read(void *buf, int len, const completion &cb, int to)
+{
+	start(true, static_cast<char *>(buf), len, true, cb, to);
+}
+
+/*
+ * Reads exactly len bytes, unless the end of file is reached.
+ *
+ * @param [out] buf - buffer to read the data into.
+ * @param [in]  len - number of bytes to read.
+ * @param [in]  cb  - completion callback.
+ * @param [in]  to  - timeout in milliseconds.
+ *
+ * @throws std::invalid_argument or std::logic_error if the
+ *         operation could not be started.
+ */
+void
+async_io::async_readn(void *buf, int len, const completion &cb, int to)
+{
+	start(true, static_cast<char *>(buf), len, false, cb, to);
+}
+
+/*
+ * Writes all the data.
+ *
+ * @param [in] buf - buffer to write the data from.
+ * @param [in] len - number of bytes to write.
+ * @param [in] cb  - completion callback.
+ * @param [in] to  - timeout in milliseconds.
+ *
+ * @throws std::invalid_argument or std::logic_error if the
+ *         operation could not be started.
+ */
+void
+async_io::async_write(const void *buf, int len, const completion &cb, int to)
+{
+	start(false, const_cast<char *>(static_cast<const char *>(buf)), len, false, cb, to);
+}
+
+/*
+ * Same as above, but returns the future result.
+ */
+std::future<io_result>
+async_io::async_read(void *buf, int len, int to)
+{
+	std::shared_ptr<std::promise<io_result>> p = std::make_shared<std::promise<io_result>>();
+	std::future<io_result> f = p->get_future();
+	async_read(buf, len, [p] (const io_result &r) { p->set_value(r); }, to);
+	return f;
+}
+
+/*
+ * Same as above, but returns the future result.
+ */
+std::future<io_result>
+async_io::async_readn(void *buf, int len, int to)
+{
+	std::shared_ptr<std::promise<io_result>> p = std::make_shared<std::promise<io_result>>();
+	std::future<io_result> f = p->get_future();
+	async_readn(buf, len, [p] (const io_result &r) { p->set_value(r); }, to);
+	return f;
+}
+
+/*
+ * Same as above, but returns the future result.
+ */
+std::future<io_result>
+async_io::async_write(const void *buf, int len, int to)
+{
+	std::shared_ptr<std::promise<io_result>> p = std::make_shared<std::promise<io_result>>();
+	std::future<io_result> f = p->get_future();
+	async_write(buf, len, [p] (const io_result &r) { p->set_value(r); }, to);
+	return f;
+}
+
+} // namespace net
+} // namespace snf
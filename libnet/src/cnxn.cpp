@@ -305,11 +305,18 @@ connection::connection(const connection &c)
  * Move constructor.
  */
 connection::connection(connection &&c)
+	: snf::net::nio(std::move(c))
 {
 	m_mode = c.m_mode;
 	m_contexts = std::move(c.m_contexts);
 	m_ssl = c.m_ssl;
 	c.m_ssl = nullptr;
+	m_ktls_send = c.m_ktls_send;
+	m_ktls_recv = c.m_ktls_recv;
+	m_batched = c.m_batched;
+	m_wbuf = std::move(c.m_wbuf);
+	m_wlen = c.m_wlen;
+	c.m_wlen = 0;
 }
 
 /*
@@ -353,10 +360,17 @@ connection &
 connection::operator=(connection &&c)
 {
 	if (this != &c) {
+		snf::net::nio::operator=(std::move(c));
 		m_mode = c.m_mode;
 		m_contexts = std::move(c.m_contexts);
 		m_ssl = c.m_ssl;
 		c.m_ssl = nullptr;
+		m_ktls_send = c.m_ktls_send;
+		m_ktls_recv = c.m_ktls_recv;
+		m_batched = c.m_batched;
+		m_wbuf = std::move(c.m_wbuf);
+		m_wlen = c.m_wlen;
+		c.m_wlen = 0;
 	}
 	return *this;
 }
@@ -596,6 +610,93 @@ connection::handshake(const socket &s, int to)
 		if (E_ok == retval)
 			break;
 	} while (retval == E_try_again);
+
+	if (E_ok == retval)
+		check_kernel_tls();
+}
+
+/*
+ * Performs the TLS handshake as far as it can go without
+ * waiting. Call it again when the socket is ready for the
+ * direction reported. This allows the handshake to be driven
+ * by a reactor. The socket must be in non-blocking mode.
+ *
+ * @param [in]  s          - socket.
+ * @param [out] want_write - set to true if the handshake needs the
+ *                           socket to be writable, false if it needs
+ *                           the socket to be readable. Valid only when
+ *                           E_try_again is returned.
+ *
+ * @return E_ok if the handshake is complete, E_try_again if it has
+ *         to be continued, -ve error code on failure.
+ *
+ * @throws snf::net::ssl::exception if the socket could not be set or
+ *         a SSL error occurs.
+ */
+int
+connection::try_handshake(const socket &s, bool *want_write)
+{
+	sock_t sock = s;
+	if (ssl_library::instance().ssl_get_fd()(m_ssl) != static_cast<int>(sock)) {
+		int retval = ssl_library::instance().ssl_set_fd()(m_ssl, static_cast<int>(sock));
+		if (retval != 1) {
+			std::ostringstream oss;
+			oss << "failed to set socket "
+				<< static_cast<int64_t>(sock)
+				<< " for TLS communication";
+			throw exception(oss.str());
+		}
+	}
+
+	error_info ei;
+
+	if (connection_mode::client == m_mode) {
+		ei.op = operation::connect;
+		ei.error = ssl_library::instance().ssl_connect()(m_ssl);
+	} else /* if (connection_mode::server == m_mode) */ {
+		ei.op = operation::accept;
+		ei.error = ssl_library::instance().ssl_accept()(m_ssl);
+	}
+
+	// No socket: the caller waits for the socket to be ready.
+	int retval = handle_ssl_error(INVALID_SOCKET, POLL_WAIT_NONE, ei);
+	if (E_try_again == retval) {
+		if (want_write)
+			*want_write = (ei.ssl_error == SSL_ERROR_WANT_WRITE);
+	} else if (E_ok == retval) {
+		if (ei.error <= 0) {
+			// the peer closed the connection
+			retval = E_eof_detected;
+		} else {
+			check_kernel_tls();
+		}
+	}
+
+	return retval;
+}
+
+/*
+ * Checks if the record layer is offloaded to the kernel
+ * after the handshake. This depends on the kTLS option of
+ * the context, the kernel, and the negotiated cipher.
+ */
+void
+connection::check_kernel_tls()
+{
+	m_ktls_send = m_ktls_recv = false;
+
+	if (ssl_library::instance().openssl_version_num()() < 0x30000000L)
+		return;
+
+	BIO *wbio = ssl_library::instance().ssl_get_wbio()(m_ssl);
+	if (wbio)
+		m_ktls_send = (ssl_library::instance().bio_ctrl()
+			(wbio, BIO_CTRL_GET_KTLS_SEND, 0, nullptr) > 0);
+
+	BIO *rbio = ssl_library::instance().ssl_get_rbio()(m_ssl);
+	if (rbio)
+		m_ktls_recv = (ssl_library::instance().bio_ctrl()
+			(rbio, BIO_CTRL_GET_KTLS_RECV, 0, nullptr) > 0);
 }
 
 /**
@@ -662,40 +763,153 @@ connection::readn(void *buf, int to_read, int *bread, int to, int *oserr)
 	return retval;
 }
 
-/**
- * Writes to the TLS connection. SIGPIPE must be handled
- * explicitly while using this.
+/*
+ * Reads the data available on the TLS connection, waiting for
+ * some if there is none. Used to fill the read buffer, so that
+ * a whole TLS record is read in one go.
  *
- * @param [in]  buf      - buffer to write the data from.
- * @param [in]  to_write - number of bytes to write.
- * @param [out] bwritten - number of bytes written.
- * @param [in]  to       - timeout in milliseconds.
- *                         POLL_WAIT_FOREVER for inifinite wait.
- *                         POLL_WAIT_NONE for no wait.
- * @param [out] oserr    - system error code.
+ * @param [out] buf     - buffer to read the data into.
+ * @param [in]  to_read - maximum number of bytes to read.
+ * @param [out] bread   - number of bytes read. 0 on end of file.
+ * @param [in]  to      - timeout in milliseconds.
+ *                        POLL_WAIT_FOREVER for inifinite wait.
+ *                        POLL_WAIT_NONE for no wait.
+ * @param [out] oserr   - system error code.
  *
  * @return E_ok on success, -ve error code on success.
  *
  * @throws snf::net::ssl::exception if the internal socket could not be
- *         retrieved or a SSL occurs while writing.
+ *         retrieved or a SSL occurs while reading.
  */
 int
-connection::writen(const void *buf, int to_write, int *bwritten, int to, int *oserr)
+connection::readsome(void *buf, int to_read, int *bread, int to, int *oserr)
 {
-	int         retval = E_ok;
-	int         n = 0, nbytes = 0;
-	const char  *cbuf = static_cast<const char *>(buf);
-	sock_t      sock;
+	int     retval = E_ok;
+	int     n = 0;
+	sock_t  sock;
 
 	if (buf == nullptr)
 		return E_invalid_arg;
 
-	if (to_write <= 0)
+	if (to_read <= 0)
 		return E_invalid_arg;
 
-	if (bwritten == nullptr)
+	if (bread == nullptr)
+		return E_invalid_arg;
+
+	*bread = 0;
+
+	sock = ssl_library::instance().ssl_get_fd()(m_ssl);
+	if (sock < 1)
+		throw exception("failed to get internal socket");
+
+	do {
+		error_info ei;
+
+		n = ssl_library::instance().ssl_read()(m_ssl, buf, to_read);
+		if (n <= 0) {
+			ei.op = operation::read;
+			ei.error = n;
+
+			retval = handle_ssl_error(sock, to, ei);
+			if (E_try_again != retval) {
+				if (oserr) *oserr = ei.os_error;
+				break;
+			}
+		} else {
+			retval = E_ok;
+			*bread = n;
+		}
+	} while (n <= 0);
+
+	return retval;
+}
+
+/**
+ * Sends the file content. If the transmit side is offloaded to
+ * the kernel, the file is sent with SSL_sendfile(), without being
+ * copied to the user space. Otherwise the file is read and written
+ * in chunks.
+ *
+ * @param [in]  f      - open file.
+ * @param [in]  offset - file offset to start from.
+ * @param [in]  count  - number of bytes to send.
+ * @param [out] bsent  - number of bytes sent. It is less than
+ *                       count if the end of file is reached.
+ * @param [in]  to     - timeout in milliseconds.
+ *                       POLL_WAIT_FOREVER for inifinite wait.
+ *                       POLL_WAIT_NONE for no wait.
+ * @param [out] oserr  - system error code.
+ *
+ * @return E_ok on success, -ve error code on success.
+ *
+ * @throws snf::net::ssl::exception if the internal socket could not be
+ *         retrieved or a SSL occurs while writing.
+ */
+int
+connection::sendfile(snf::file &f, int64_t offset, int64_t count, int64_t *bsent, int to, int *oserr)
+{
+	p_ssl_sendfile psendfile = ssl_library::instance().ssl_sendfile();
+	if (!m_ktls_send || (psendfile == nullptr))
+		return snf::net::nio::sendfile(f, offset, count, bsent, to, oserr);
+
+	if ((offset < 0) || (count <= 0) || (bsent == nullptr))
 		return E_invalid_arg;
 
+	int     retval = E_ok;
+	sock_t  sock;
+
+	*bsent = 0;
+
+	// The batched data goes before the file.
+	retval = write_pending(to, oserr);
+	if (retval != E_ok)
+		return retval;
+
+	sock = ssl_library::instance().ssl_get_fd()(m_ssl);
+	if (sock < 1)
+		throw exception("failed to get internal socket");
+
+	while (count > 0) {
+		error_info ei;
+
+		size_t to_send = static_cast<size_t>(std::min(count, static_cast<int64_t>(0x40000000)));
+		int64_t n = psendfile(m_ssl, static_cast<int>(static_cast<fhandle_t>(f)), offset, to_send, 0);
+		if (n > 0) {
+			*bsent += n;
+			offset += n;
+			count -= n;
+		} else if (n == 0) {
+			// end of file
+			break;
+		} else {
+			ei.op = operation::write;
+			ei.error = -1;
+
+			retval = handle_ssl_error(sock, to, ei);
+			if (E_try_again != retval) {
+				if (oserr) *oserr = ei.os_error;
+				break;
+			}
+			retval = E_ok;
+		}
+	}
+
+	return retval;
+}
+
+/*
+ * Writes the data with SSL_write(), in as many records as
+ * it takes.
+ */
+int
+connection::write_records(const void *buf, int to_write, int *bwritten, int to, int *oserr)
+{
+	int         retval = E_ok;
+	int         n = 0, nbytes = 0;
+	const char  *cbuf = static_cast<const char *>(buf);
+	sock_t      sock;
+
 	sock = ssl_library::instance().ssl_get_fd()(m_ssl);
 	if (sock < 1)
 		throw exception("failed to get internal socket");
@@ -726,6 +940,187 @@ connection::writen(const void *buf, int to_write, int *bwritten, int to, int *os
 	return retval;
 }
 
+/*
+ * Writes the batched data that is held back. If it is written
+ * only in part, the rest is kept at the start of the buffer.
+ */
+int
+connection::write_pending(int to, int *oserr)
+{
+	if (m_wlen == 0)
+		return E_ok;
+
+	int n = 0;
+	int retval = write_records(m_wbuf.data(), m_wlen, &n, to, oserr);
+	if (n < m_wlen) {
+		if (n > 0)
+			memmove(m_wbuf.data(), m_wbuf.data() + n, m_wlen - n);
+		m_wlen -= n;
+	} else {
+		m_wlen = 0;
+	}
+
+	return retval;
+}
+
+/*
+ * Adds the data to the batch. The data goes out a full record
+ * at a time; the data that is a record or more long, when
+ * nothing is held back, is written as it is.
+ */
+int
+connection::write_batched(const void *buf, int to_write, int *bwritten, int to, int *oserr)
+{
+	int         retval = E_ok;
+	const char  *cbuf = static_cast<const char *>(buf);
+
+	if (!m_wbuf)
+		m_wbuf = iobuf(RECORD_SIZE);
+
+	while ((retval == E_ok) && (to_write > 0)) {
+		if ((m_wlen == 0) && (to_write >= RECORD_SIZE)) {
+			int n = 0;
+			retval = write_records(cbuf, to_write - (to_write % RECORD_SIZE), &n, to, oserr);
+			cbuf += n;
+			to_write -= n;
+			*bwritten += n;
+			continue;
+		}
+
+		int len = std::min(RECORD_SIZE - m_wlen, to_write);
+		memcpy(m_wbuf.data() + m_wlen, cbuf, len);
+		m_wlen += len;
+		cbuf += len;
+		to_write -= len;
+		*bwritten += len;
+
+		if (m_wlen == RECORD_SIZE)
+			retval = write_pending(to, oserr);
+	}
+
+	return retval;
+}
+
+/**
+ * Writes to the TLS connection. SIGPIPE must be handled
+ * explicitly while using this. Between begin_batch() and
+ * end_batch(), the data is coalesced into full records and
+ * the last partial record is held back.
+ *
+ * @param [in]  buf      - buffer to write the data from.
+ * @param [in]  to_write - number of bytes to write.
+ * @param [out] bwritten - number of bytes written (or batched).
+ * @param [in]  to       - timeout in milliseconds.
+ *                         POLL_WAIT_FOREVER for inifinite wait.
+ *                         POLL_WAIT_NONE for no wait.
+ * @param [out] oserr    - system error code.
+ *
+ * @return E_ok on success, -ve error code on success.
+ *
+ * @throws snf::net::ssl::exception if the internal socket could not be
+ *         retrieved or a SSL occurs while writing.
+ */
+int
+connection::writen(const void *buf, int to_write, int *bwritten, int to, int *oserr)
+{
+	if (buf == nullptr)
+		return E_invalid_arg;
+
+	if (to_write <= 0)
+		return E_invalid_arg;
+
+	if (bwritten == nullptr)
+		return E_invalid_arg;
+
+	if (!m_batched)
+		return write_records(buf, to_write, bwritten, to, oserr);
+
+	*bwritten = 0;
+	return write_batched(buf, to_write, bwritten, to, oserr);
+}
+
+/**
+ * Writes the data from the scatter/gather elements to the TLS
+ * connection. The small elements are coalesced, so that the
+ * data goes out in full records.
+ *
+ * @param [in]  iov      - scatter/gather elements.
+ * @param [in]  iovcnt   - number of elements.
+ * @param [out] bwritten - number of bytes written (or batched).
+ * @param [in]  to       - timeout in milliseconds.
+ *                         POLL_WAIT_FOREVER for inifinite wait.
+ *                         POLL_WAIT_NONE for no wait.
+ * @param [out] oserr    - system error code.
+ *
+ * @return E_ok on success, -ve error code on success.
+ *
+ * @throws snf::net::ssl::exception if the internal socket could not be
+ *         retrieved or a SSL occurs while writing.
+ */
+int
+connection::writen(const iovec *iov, int iovcnt, int *bwritten, int to, int *oserr)
+{
+	if (!m_batched)
+		return snf::net::nio::writen(iov, iovcnt, bwritten, to, oserr);
+
+	if (iov_length(iov, iovcnt) <= 0)
+		return E_invalid_arg;
+
+	if (bwritten == nullptr)
+		return E_invalid_arg;
+
+	int retval = E_ok;
+
+	*bwritten = 0;
+
+	for (int i = 0; (retval == E_ok) && (i < iovcnt); ++i) {
+		if (iov[i].iov_len == 0)
+			continue;
+		retval = write_batched(iov[i].iov_base, static_cast<int>(iov[i].iov_len),
+			bwritten, to, oserr);
+	}
+
+	return retval;
+}
+
+/*
+ * Starts a batch of writes: the data written is coalesced
+ * into full TLS records until end_batch(), cutting the
+ * records (and the per-record overhead) for a message made of
+ * many small writes.
+ */
+void
+connection::begin_batch()
+{
+	m_batched = true;
+}
+
+/*
+ * Ends the batch of writes, writing the data held back.
+ *
+ * @param [in]  to    - timeout in milliseconds.
+ *                      POLL_WAIT_FOREVER for inifinite wait.
+ *                      POLL_WAIT_NONE for no wait.
+ * @param [out] oserr - system error in case of failure, if not null.
+ *
+ * @return E_ok on success, -ve error code on failure. The data
+ *         not written is kept and is written by the next write
+ *         or end_batch().
+ *
+ * @throws snf::net::ssl::exception if the internal socket could not be
+ *         retrieved or a SSL occurs while writing.
+ */
+int
+connection::end_batch(int to, int *oserr)
+{
+	int retval = write_pending(to, oserr);
+	if (retval == E_ok) {
+		m_batched = false;
+		m_wbuf.reset();
+	}
+	return retval;
+}
+
 /*
  * Shuts down the TLS connection.
  */
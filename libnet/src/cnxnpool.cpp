@@ -0,0 +1,520 @@
+#include "cnxnpool.h"
+#include "ia.h"
+#include "dbg.h"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+namespace snf {
+namespace net {
+
+/*
+ * Makes the pool key for the endpoint.
+ */
+std::string
+connection_pool::make_key(const std::string &host, in_port_t port, ssl::context *ctx)
+{
+	std::ostringstream oss;
+	oss << host << ":" << port << "/"
+		<< (ctx ? static_cast<const void *>(static_cast<SSL_CTX *>(*ctx)) : nullptr);
+	return oss.str();
+}
+
+/*
+ * Moves the connections idle for longer than the idle timeout
+ * out of the pool. The caller must hold the pool lock and must
+ * close the connections without holding it.
+ */
+void
+connection_pool::expire(state &st, clock_type::time_point now, std::vector<pooled> &expired)
+{
+	std::chrono::milliseconds idleto(st.idle_timeout);
+
+	for (auto it = st.endpoints.begin(); it != st.endpoints.end(); ) {
+		endpoint &ep = it->second;
+
+		for (auto pit = ep.idle.begin(); pit != ep.idle.end(); ) {
+			if ((pit->since + idleto) <= now) {
+				expired.push_back(std::move(*pit));
+				pit = ep.idle.erase(pit);
+				ep.open--;
+			} else {
+				++pit;
+			}
+		}
+
+		if ((ep.open == 0) && !ep.sess)
+			it = st.endpoints.erase(it);
+		else
+			++it;
+	}
+}
+
+/*
+ * Schedules the idle connection eviction on the reactor. The
+ * timer reschedules itself until the pool is destroyed.
+ */
+void
+connection_pool::schedule(const std::shared_ptr<state> &st, reactor *r)
+{
+	std::weak_ptr<state> wst = st;
+	int interval = std::max(st->idle_timeout / 2, 1);
+
+	timer_id id = r->add_timer(interval, [wst, r] () {
+		std::shared_ptr<state> st = wst.lock();
+		if (!st)
+			return;
+
+		std::vector<pooled> expired;
+
+		{
+			std::lock_guard<std::mutex> guard(st->lock);
+			if (st->closed)
+				return;
+			expire(*st, clock_type::now(), expired);
+		}
+
+		if (!expired.empty())
+			st->cv.notify_all();
+
+		expired.clear();
+		schedule(st, r);
+	});
+
+	std::lock_guard<std::mutex> guard(st->lock);
+	st->timer = id;
+}
+
+/*
+ * Determines if the idle connection can be reused. An idle
+ * connection is not expected to be readable: it is either
+ * closed by the peer or has unexpected data.
+ */
+bool
+connection_pool::is_healthy(pooled &p)
+{
+	int oserr = 0;
+
+	if (p.sock->is_readable(POLL_WAIT_NONE, &oserr) || (oserr != 0))
+		return false;
+
+	try {
+		return (p.sock->error() == 0);
+	} catch (const std::system_error &) {
+		return false;
+	}
+}
+
+/*
+ * Opens a TCP connection to the host, trying its addresses
+ * in order.
+ *
+ * @throws std::system_error if the connection could not be
+ *         established.
+ */
+std::unique_ptr<socket>
+connection_pool::open(const std::string &host, in_port_t port, int to)
+{
+	std::vector<socket_address> sas;
+	if (m_resolver)
+		sas = std::move(m_resolver->resolve(AF_UNSPEC, socket_type::tcp, host, std::to_string(port)));
+	else
+		sas = std::move(socket_address::get_client(AF_UNSPEC, socket_type::tcp, host, port));
+
+	if (sas.empty()) {
+		std::ostringstream oss;
+		oss << "no address for " << host;
+		throw std::system_error(EADDRNOTAVAIL, std::system_category(), oss.str());
+	}
+
+	for (size_t i = 0; i < sas.size(); ++i) {
+		try {
+			std::unique_ptr<socket> sock(DBG_NEW socket(
+				sas[i].is_ipv6() ? AF_INET6 : AF_INET, socket_type::tcp));
+			sock->connect(sas[i], to);
+			return sock;
+		} catch (const std::system_error &) {
+			if ((i + 1) == sas.size())
+				throw;
+		}
+	}
+
+	return nullptr;
+}
+
+/*
+ * Constructs the lease.
+ */
+connection_pool::lease::lease(const std::shared_ptr<state> &st, const std::string &key,
+	pooled &&p, bool reused)
+	: m_state(st)
+	, m_key(key)
+	, m_sock(std::move(p.sock))
+	, m_cnxn(std::move(p.cnxn))
+	, m_reused(reused)
+{
+}
+
+/*
+ * Move constructor.
+ */
+connection_pool::lease::lease(lease &&l)
+	: m_state(std::move(l.m_state))
+	, m_key(std::move(l.m_key))
+	, m_sock(std::move(l.m_sock))
+	, m_cnxn(std::move(l.m_cnxn))
+	, m_reused(l.m_reused)
+{
+}
+
+/*
+ * Move operator. The connection held, if any, is closed.
+ */
+connection_pool::lease &
+connection_pool::lease::operator=(lease &&l)
+{
+	if (this != &l) {
+		discard();
+		m_state = std::move(l.m_state);
+		m_key = std::move(l.m_key);
+		m_sock = std::move(l.m_sock);
+		m_cnxn = std::move(l.m_cnxn);
+		m_reused = l.m_reused;
+	}
+	return *this;
+}
+
+/*
+ * Destructor. The connection, if not released, is closed.
+ */
+connection_pool::lease::~lease()
+{
+	discard();
+}
+
+/*
+ * Closes the connection and lets the pool open another one.
+ */
+void
+connection_pool::lease::close()
+{
+	m_cnxn.reset();
+	m_sock.reset();
+
+	std::shared_ptr<state> st = m_state.lock();
+	m_state.reset();
+	if (!st)
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(st->lock);
+		auto it = st->endpoints.find(m_key);
+		if (it != st->endpoints.end())
+			it->second.open--;
+	}
+
+	st->cv.notify_all();
+}
+
+/*
+ * Gets the I/O interface of the connection: the TLS connection
+ * if it is secured, the socket otherwise.
+ *
+ * @throws std::logic_error if the lease is not valid.
+ */
+nio &
+connection_pool::lease::io()
+{
+	if (m_cnxn)
+		return *m_cnxn;
+	return sock();
+}
+
+/*
+ * Gets the socket of the connection.
+ *
+ * @throws std::logic_error if the lease is not valid.
+ */
+socket &
+connection_pool::lease::sock()
+{
+	if (!m_sock)
+		throw std::logic_error("connection is released");
+	return *m_sock;
+}
+
+/*
+ * Returns the connection to the pool for reuse. The connection
+ * must be idle: the responses must have been read completely.
+ * A connection with unread data is closed instead. For the TLS
+ * connections, the session is saved for resumption; the
+ * TLS 1.3 sessions are only available after the handshake.
+ */
+void
+connection_pool::lease::release()
+{
+	if (!m_sock)
+		return;
+
+	std::shared_ptr<state> st = m_state.lock();
+	if (!st || (io().pending() > 0)) {
+		discard();
+		return;
+	}
+
+	std::unique_ptr<ssl::session> sess;
+	if (m_cnxn) {
+		try {
+			sess.reset(DBG_NEW ssl::session(std::move(m_cnxn->get_session())));
+		} catch (const ssl::exception &) {
+		}
+	}
+
+	pooled p;
+	p.sock = std::move(m_sock);
+	p.cnxn = std::move(m_cnxn);
+	p.since = clock_type::now();
+
+	{
+		std::lock_guard<std::mutex> guard(st->lock);
+		auto it = st->endpoints.find(m_key);
+		if (!st->closed && (it != st->endpoints.end())) {
+			if (sess)
+				it->second.sess = std::move(sess);
+			it->second.idle.push_back(std::move(p));
+		} else if (it != st->endpoints.end()) {
+			it->second.open--;
+		}
+	}
+
+	m_state.reset();
+	st->cv.notify_all();
+}
+
+/*
+ * Closes the connection instead of returning it to the pool.
+ */
+void
+connection_pool::lease::discard()
+{
+	if (m_sock)
+		close();
+}
+
+/*
+ * Constructs the connection pool.
+ *
+ * @param [in] maxperhost - maximum number of connections open
+ *                          to an endpoint.
+ * @param [in] idleto     - time in milliseconds after which an
+ *                          idle connection is closed.
+ * @param [in] r          - reactor to run the eviction timer
+ *                          on, or nullptr. It must outlive
+ *                          the pool.
+ * @param [in] res        - resolver to resolve the host names
+ *                          with, or nullptr to resolve them
+ *                          in the calling thread.
+ *
+ * @throws std::invalid_argument if the limit or the idle
+ *         timeout is not valid.
+ */
+connection_pool::connection_pool(int maxperhost, int idleto, reactor *r, resolver *res)
+	: m_state(std::make_shared<state>())
+	, m_reactor(r)
+	, m_resolver(res)
+{
+	if (maxperhost <= 0)
+		throw std::invalid_argument("invalid number of connections per host");
+
+	if (idleto <= 0)
+		throw std::invalid_argument("invalid idle timeout");
+
+	m_state->max_per_host = maxperhost;
+	m_state->idle_timeout = idleto;
+
+	if (m_reactor)
+		schedule(m_state, m_reactor);
+}
+
+/*
+ * Destructor. Closes the idle connections. The connections
+ * checked out are closed when they are released.
+ */
+connection_pool::~connection_pool()
+{
+	std::vector<pooled> idle;
+
+	{
+		std::lock_guard<std::mutex> guard(m_state->lock);
+		m_state->closed = true;
+		for (auto &e : m_state->endpoints)
+			for (auto &p : e.second.idle)
+				idle.push_back(std::move(p));
+		m_state->endpoints.clear();
+	}
+
+	if (m_reactor)
+		m_reactor->cancel_timer(m_state->timer);
+
+	m_state->cv.notify_all();
+}
+
+/*
+ * Checks out a connection to the endpoint. An idle connection
+ * is reused if it is healthy; otherwise a new one is opened.
+ * For the TLS connections, the server name is set for SNI and
+ * for the certificate verification, and the last session of
+ * the endpoint is resumed.
+ *
+ * @param [in] host - host name or address.
+ * @param [in] port - port.
+ * @param [in] ctx  - SSL context for the TLS connections, or
+ *                    nullptr for the plain TCP connections.
+ *                    It must outlive the pool.
+ * @param [in] to   - timeout in milliseconds to wait for a
+ *                    connection, and to connect and handshake.
+ *
+ * @return the lease for the connection.
+ *
+ * @throws std::system_error if the connection could not be
+ *         established or none was available in time.
+ *         snf::net::ssl::exception if the TLS handshake failed.
+ */
+connection_pool::lease
+connection_pool::checkout(const std::string &host, in_port_t port, ssl::context *ctx, int to)
+{
+	std::string key = std::move(make_key(host, port, ctx));
+	clock_type::time_point deadline = (to == POLL_WAIT_FOREVER)
+		? clock_type::time_point::max()
+		: clock_type::now() + std::chrono::milliseconds(std::max(to, 0));
+
+	// Closed once the lock is released.
+	std::vector<pooled> expired;
+
+	std::unique_lock<std::mutex> lock(m_state->lock);
+
+	while (true) {
+		if (!m_reactor)
+			expire(*m_state, clock_type::now(), expired);
+
+		endpoint &ep = m_state->endpoints[key];
+
+		// The most recently used connection first.
+		while (!ep.idle.empty()) {
+			pooled p = std::move(ep.idle.back());
+			ep.idle.pop_back();
+
+			lock.unlock();
+			if (is_healthy(p))
+				return lease(m_state, key, std::move(p), true);
+			p.cnxn.reset();
+			p.sock.reset();
+			lock.lock();
+			ep.open--;
+		}
+
+		if (ep.open < m_state->max_per_host)
+			break;
+
+		if (deadline == clock_type::time_point::max()) {
+			m_state->cv.wait(lock);
+		} else if (m_state->cv.wait_until(lock, deadline) == std::cv_status::timeout) {
+			std::ostringstream oss;
+			oss << "no connection available to " << host << ":" << port;
+			throw std::system_error(ETIMEDOUT, std::system_category(), oss.str());
+		}
+	}
+
+	endpoint &ep = m_state->endpoints[key];
+	ep.open++;
+
+	std::unique_ptr<ssl::session> sess;
+	if (ctx && ep.sess)
+		sess.reset(DBG_NEW ssl::session(*ep.sess));
+
+	lock.unlock();
+
+	pooled p;
+
+	try {
+		p.sock = std::move(open(host, port, to));
+		if (ctx) {
+			p.cnxn.reset(DBG_NEW ssl::connection(connection_mode::client, *ctx));
+			p.cnxn->set_sni(host);
+			try {
+				internet_address ia { host };
+				p.cnxn->check_inaddr(ia);
+			} catch (std::runtime_error &) {
+				p.cnxn->check_hosts({ host });
+			}
+
+			if (sess) {
+				try {
+					p.cnxn->set_session(*sess);
+				} catch (const ssl::exception &) {
+				}
+			}
+
+			p.cnxn->handshake(*p.sock, to);
+		}
+	} catch (...) {
+		p.cnxn.reset();
+		p.sock.reset();
+
+		lock.lock();
+		m_state->endpoints[key].open--;
+		lock.unlock();
+		m_state->cv.notify_all();
+		throw;
+	}
+
+	p.since = clock_type::now();
+	return lease(m_state, key, std::move(p), false);
+}
+
+/*
+ * Gets the number of idle connections.
+ */
+size_t
+connection_pool::idle_count()
+{
+	std::lock_guard<std::mutex> guard(m_state->lock);
+	size_t n = 0;
+	for (auto &e : m_state->endpoints)
+		n += e.second.idle.size();
+	return n;
+}
+
+/*
+ * Gets the number of open connections, idle and checked out.
+ */
+size_t
+connection_pool::open_count()
+{
+	std::lock_guard<std::mutex> guard(m_state->lock);
+	size_t n = 0;
+	for (auto &e : m_state->endpoints)
+		n += static_cast<size_t>(e.second.open);
+	return n;
+}
+
+/*
+ * Closes the connections idle for longer than the idle timeout.
+ */
+void
+connection_pool::evict()
+{
+	std::vector<pooled> expired;
+
+	{
+		std::lock_guard<std::mutex> guard(m_state->lock);
+		expire(*m_state, clock_type::now(), expired);
+	}
+
+	if (!expired.empty())
+		m_state->cv.notify_all();
+}
+
+} // namespace net
+} // namespace snf
@@ -1,6 +1,7 @@
 #include "ctx.h"
 #include <time.h>
 #include <sstream>
+#include <vector>
 
 static const int NEW_SESSION_KEY = 1;
 static const int RETRIEVE_SESSION_KEY = !NEW_SESSION_KEY;
@@ -99,11 +100,104 @@ ssl_session_ticket_key_cb(
 	}
 }
 
+/*
+ * A callback function for adding new sessions to the external
+ * session cache. It is called on the TLS server when a new
+ * session is established.
+ *
+ * @param [in] ssl  - current SSL connection.
+ * @param [in] sess - new session.
+ *
+ * @return 0 as the reference to the session is not kept.
+ */
+extern "C" int
+ssl_session_new_cb(SSL *ssl, SSL_SESSION *sess)
+{
+	snf::net::ssl::session_cache *sc = snf::net::ssl::context::get_session_cache();
+	if (sc == nullptr)
+		return 0;
+
+	snf::net::ssl::ssl_library &lib = snf::net::ssl::ssl_library::instance();
+
+	unsigned int idlen = 0;
+	const unsigned char *id = lib.ssl_session_get_id()(sess, &idlen);
+	if ((id == nullptr) || (idlen == 0))
+		return 0;
+
+	int len = lib.ssl_session_i2d()(sess, nullptr);
+	if (len <= 0)
+		return 0;
+
+	std::vector<uint8_t> der(len);
+	unsigned char *ptr = der.data();
+	if (lib.ssl_session_i2d()(sess, &ptr) != len)
+		return 0;
+
+	time_t expire = static_cast<time_t>(lib.ssl_session_get_time()(sess)) +
+		static_cast<time_t>(lib.ssl_session_get_timeout()(sess));
+
+	sc->add(id, idlen, der.data(), der.size(), expire);
+	return 0;
+}
+
+/*
+ * A callback function for looking up sessions in the external
+ * session cache. It is called on the TLS server when the session
+ * presented by the TLS client is not found in the internal cache.
+ *
+ * @param [in]  ssl   - current SSL connection.
+ * @param [in]  id    - session ID.
+ * @param [in]  idlen - session ID length.
+ * @param [out] copy  - set to 0 as the session returned is owned
+ *                      by the caller.
+ *
+ * @return the session or nullptr if not found.
+ */
+extern "C" SSL_SESSION *
+ssl_session_get_cb(SSL *ssl, const unsigned char *id, int idlen, int *copy)
+{
+	*copy = 0;
+
+	snf::net::ssl::session_cache *sc = snf::net::ssl::context::get_session_cache();
+	if ((sc == nullptr) || (idlen <= 0))
+		return nullptr;
+
+	std::vector<uint8_t> der;
+	if (!sc->find(id, static_cast<size_t>(idlen), der))
+		return nullptr;
+
+	const unsigned char *ptr = der.data();
+	return snf::net::ssl::ssl_library::instance().ssl_session_d2i()
+		(nullptr, &ptr, static_cast<long>(der.size()));
+}
+
+/*
+ * A callback function for removing sessions from the external
+ * session cache. It is called when OpenSSL finds the session
+ * unusable.
+ *
+ * @param [in] ctx  - SSL context.
+ * @param [in] sess - session to remove.
+ */
+extern "C" void
+ssl_session_remove_cb(SSL_CTX *ctx, SSL_SESSION *sess)
+{
+	snf::net::ssl::session_cache *sc = snf::net::ssl::context::get_session_cache();
+	if (sc == nullptr)
+		return;
+
+	unsigned int idlen = 0;
+	const unsigned char *id = snf::net::ssl::ssl_library::instance().ssl_session_get_id()(sess, &idlen);
+	if ((id != nullptr) && (idlen != 0))
+		sc->remove(id, idlen);
+}
+
 namespace snf {
 namespace net {
 namespace ssl {
 
 keymgr *context::s_km = nullptr;
+session_cache *context::s_sc = nullptr;
 
 /*
  * Get SSL context options.
@@ -319,6 +413,31 @@ context::prefer_client_cipher()
 	clr_options(SSL_OP_CIPHER_SERVER_PREFERENCE);
 }
 
+/*
+ * Enables or disables kernel TLS (kTLS). With kTLS enabled, once
+ * the handshake is done, the record encryption and decryption is
+ * offloaded to the kernel if the kernel and the negotiated cipher
+ * support it; otherwise the connection continues in the user
+ * space. Requires OpenSSL 3.0 or later. Must be called before
+ * the connections are created.
+ *
+ * @param [in] enable - true to enable kTLS, false to disable it.
+ *
+ * @return true if the OpenSSL library supports kTLS, false otherwise.
+ */
+bool
+context::kernel_tls(bool enable)
+{
+	if (ssl_library::instance().openssl_version_num()() < 0x30000000L)
+		return false;
+
+	if (enable)
+		set_options(SSL_OP_ENABLE_KTLS);
+	else
+		clr_options(SSL_OP_ENABLE_KTLS);
+	return true;
+}
+
 /*
  * Gets the current SSL session timeout in seconds.
  */
@@ -400,6 +519,43 @@ context::session_ticket(connection_mode mode, bool enable)
 	}
 }
 
+/*
+ * Call on TLS server.
+ * Enables/disables the external session cache set using
+ * set_session_cache(), for session ID based SSL resumption.
+ * When enabled, the new sessions are added to the external
+ * cache only, and the sessions presented by the TLS clients
+ * are looked up in it; so the sessions can be resumed by any
+ * process sharing the cache. Enabling session tickets using
+ * session_ticket() disables session caching altogether.
+ *
+ * @param [in] enable - true to enable the external session
+ *                      cache, false to use the internal cache.
+ *
+ * @throws snf::net::ssl::exception if the external session cache
+ *         is to be enabled but is not set.
+ */
+void
+context::external_session_cache(bool enable)
+{
+	long mode = SSL_SESS_CACHE_SERVER;
+
+	if (enable) {
+		if (get_session_cache() == nullptr)
+			throw exception("external session cache is not set");
+		mode |= SSL_SESS_CACHE_NO_INTERNAL;
+	}
+
+	ssl_library::instance().ssl_ctx_sess_set_new_cb()
+		(m_ctx, enable ? ssl_session_new_cb : nullptr);
+	ssl_library::instance().ssl_ctx_sess_set_get_cb()
+		(m_ctx, enable ? ssl_session_get_cb : nullptr);
+	ssl_library::instance().ssl_ctx_sess_set_remove_cb()
+		(m_ctx, enable ? ssl_session_remove_cb : nullptr);
+	ssl_library::instance().ssl_ctx_ctrl()
+		(m_ctx, SSL_CTRL_SET_SESS_CACHE_MODE, mode, nullptr);
+}
+
 /*
  * Sets ciphers to use. See SSL_CTX_set_cipher_list() for the format.
  * The default is TLSv1.2:SSLv3:!aNULL:!eNULL:!aGOST:!MD5:!MEDIUM:!CAMELLIA:!PSK:!RC4::@STRENGTH.
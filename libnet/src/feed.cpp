@@ -0,0 +1,328 @@
+#include "feed.h"
+#include "poller.h"
+#include "error.h"
+#include <chrono>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+namespace snf {
+namespace net {
+namespace internal {
+
+/*
+ * Closes the raw socket of an accepted connection
+ * that is not taken.
+ */
+static void
+close_socket(sock_t s)
+{
+#if defined(_WIN32)
+	::closesocket(s);
+#else
+	::close(s);
+#endif
+}
+
+feed::~feed()
+{
+	for (sock_t s : m_accepted)
+		close_socket(s);
+}
+
+/*
+ * Accounts for the completion taken by the socket. If the
+ * poller has stopped receiving and the data queued is now
+ * within the limit, the poller is asked to start again.
+ * Must be called with the lock held.
+ *
+ * @param [in] nbytes - bytes of data taken.
+ */
+void
+feed::taken(size_t nbytes)
+{
+	m_bytes -= nbytes;
+	if (paused.load() && (m_bytes.load() <= LIMIT) && m_poller)
+		m_poller->resume(m_sock, this);
+}
+
+/*
+ * Waits for a completion to be queued. Must be called
+ * with the lock held.
+ *
+ * @param [in] lock - the feed lock.
+ * @param [in] to   - timeout in milliseconds.
+ *                    POLL_WAIT_FOREVER for inifinite wait.
+ *                    POLL_WAIT_NONE for no wait.
+ *
+ * @return E_ok if a completion is queued, E_try_again otherwise.
+ */
+int
+feed::wait_locked(std::unique_lock<std::mutex> &lock, int to)
+{
+	auto done = [this] () { return m_closed || (m_count.load() > 0); };
+
+	if (to == POLL_WAIT_FOREVER)
+		m_cond.wait(lock, done);
+	else if (to > 0)
+		m_cond.wait_for(lock, std::chrono::milliseconds(to), done);
+
+	return (m_count.load() > 0) ? E_ok : E_try_again;
+}
+
+/*
+ * Queues the accepted connection. It is closed if
+ * the listening socket has been closed.
+ */
+void
+feed::push(sock_t s)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	if (m_closed) {
+		close_socket(s);
+		return;
+	}
+
+	m_accepted.push_back(s);
+	m_count++;
+	m_cond.notify_all();
+}
+
+/*
+ * Queues the data received.
+ */
+void
+feed::push(iobuf &&buf)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	if (m_closed)
+		return;
+
+	m_bytes += static_cast<size_t>(buf.size());
+	m_data.push_back(std::move(buf));
+	m_count++;
+	m_cond.notify_all();
+}
+
+/*
+ * Queues the end of file, after the data received.
+ */
+void
+feed::push_eof()
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	if (m_closed || m_eof)
+		return;
+
+	m_eof = true;
+	m_count++;
+	m_cond.notify_all();
+}
+
+/*
+ * Queues the failure of the operation.
+ *
+ * @param [in] error - system error.
+ */
+void
+feed::push_error(int error)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	if (m_closed)
+		return;
+
+	if (m_error == 0)
+		m_count++;
+	m_error = error;
+	m_cond.notify_all();
+}
+
+/*
+ * Detaches the feed from the poller that is going away.
+ * No more completions are queued; the waiting reads
+ * fail once the data queued is taken.
+ */
+void
+feed::detach()
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	m_poller = nullptr;
+	if (!m_eof && (m_error == 0)) {
+		m_error = ECANCELED;
+		m_count++;
+	}
+	m_cond.notify_all();
+}
+
+/*
+ * Takes an accepted connection. A failure is reported once.
+ *
+ * @param [out] s     - accepted socket.
+ * @param [out] oserr - system error in case of failure, if not null.
+ *
+ * @return E_ok on success, E_try_again if there is no
+ *         connection accepted, -ve error code on failure.
+ */
+int
+feed::accept(sock_t *s, int *oserr)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	if (!m_accepted.empty()) {
+		*s = m_accepted.front();
+		m_accepted.pop_front();
+		m_count--;
+		return E_ok;
+	}
+
+	if (m_error != 0) {
+		int error = m_error;
+		m_error = 0;
+		m_count--;
+		if (oserr) *oserr = error;
+		return map_system_error(error, E_accept_failed);
+	}
+
+	if (oserr) *oserr = EAGAIN;
+	return E_try_again;
+}
+
+/*
+ * Takes the next buffer of data received, as it is.
+ *
+ * @param [out] buf   - data received, empty on end of file.
+ * @param [in]  to    - timeout in milliseconds.
+ *                      POLL_WAIT_FOREVER for inifinite wait.
+ *                      POLL_WAIT_NONE for no wait.
+ * @param [out] oserr - system error in case of failure, if not null.
+ *
+ * @return E_ok on success, E_try_again if there is no data
+ *         received in time, -ve error code on failure.
+ */
+int
+feed::recv(iobuf &buf, int to, int *oserr)
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+
+	if (wait_locked(lock, to) != E_ok) {
+		if (oserr) *oserr = EAGAIN;
+		return E_try_again;
+	}
+
+	if (!m_data.empty()) {
+		buf = std::move(m_data.front());
+		m_data.pop_front();
+		m_count--;
+		taken(static_cast<size_t>(buf.size()));
+		return E_ok;
+	}
+
+	if (m_error != 0) {
+		if (oserr) *oserr = m_error;
+		return map_system_error(m_error, E_read_failed);
+	}
+
+	buf = iobuf();
+	return E_ok;
+}
+
+/*
+ * Copies the data received, up to the buffer size,
+ * from the next buffer queued.
+ *
+ * @param [out] buf     - buffer to copy the data to.
+ * @param [in]  to_read - buffer size.
+ * @param [out] bread   - number of bytes copied. 0 on end of file.
+ * @param [in]  to      - timeout in milliseconds.
+ *                        POLL_WAIT_FOREVER for inifinite wait.
+ *                        POLL_WAIT_NONE for no wait.
+ * @param [out] oserr   - system error in case of failure, if not null.
+ *
+ * @return E_ok on success, E_try_again if there is no data
+ *         received in time, -ve error code on failure.
+ */
+int
+feed::recv(void *buf, int to_read, int *bread, int to, int *oserr)
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+
+	*bread = 0;
+
+	if (wait_locked(lock, to) != E_ok) {
+		if (oserr) *oserr = EAGAIN;
+		return E_try_again;
+	}
+
+	if (!m_data.empty()) {
+		iobuf &front = m_data.front();
+		int n = std::min(to_read, front.size());
+		memcpy(buf, front.data(), n);
+		front.advance(n);
+		if (front.empty()) {
+			m_data.pop_front();
+			m_count--;
+		}
+		*bread = n;
+		taken(static_cast<size_t>(n));
+		return E_ok;
+	}
+
+	if (m_error != 0) {
+		if (oserr) *oserr = m_error;
+		return map_system_error(m_error, E_read_failed);
+	}
+
+	return E_ok;
+}
+
+/*
+ * Waits for a completion to be queued.
+ *
+ * @param [in] to - timeout in milliseconds.
+ *                  POLL_WAIT_FOREVER for inifinite wait.
+ *                  POLL_WAIT_NONE for no wait.
+ *
+ * @return true if a completion is queued, false otherwise.
+ */
+bool
+feed::wait(int to)
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+	return (wait_locked(lock, to) == E_ok);
+}
+
+/*
+ * Called when the socket is closed: the poller cancels the
+ * operation, and the completions queued are dropped.
+ */
+void
+feed::close()
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	m_closed = true;
+
+	for (sock_t s : m_accepted)
+		close_socket(s);
+	m_accepted.clear();
+	m_data.clear();
+	m_count = 0;
+	m_bytes = 0;
+
+	if (m_poller) {
+		m_poller->detach(m_sock, this);
+		m_poller = nullptr;
+	}
+
+	m_cond.notify_all();
+}
+
+} // namespace internal
+} // namespace net
+} // namespace snf
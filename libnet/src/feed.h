@@ -0,0 +1,77 @@
+#ifndef _SNF_FEED_H_
+#define _SNF_FEED_H_
+
+#include "net.h"
+#include "iobuf.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace snf {
+namespace net {
+namespace internal {
+
+class poller;
+
+/*
+ * Completions of the multishot operation the poller runs on a
+ * socket: the connections accepted on a listening socket, or
+ * the data received on a connected socket, in the buffers the
+ * poller provides to the kernel. The poller queues them from
+ * the reactor thread; the socket takes them, on any thread,
+ * instead of calling accept()/recv().
+ *
+ * The poller stops receiving when more than LIMIT bytes are
+ * queued, and starts again once the socket has taken them.
+ */
+class feed
+{
+public:
+	static constexpr size_t LIMIT = 262144;
+
+private:
+	std::mutex              m_lock;
+	std::condition_variable m_cond;
+	poller                  *m_poller;          // null once detached
+	sock_t                  m_sock;
+	std::deque<sock_t>      m_accepted;         // accepted sockets
+	std::deque<iobuf>       m_data;             // data received
+	int                     m_error = 0;        // system error, if failed
+	bool                    m_eof = false;      // end of file received
+	bool                    m_closed = false;   // socket closed
+	std::atomic<size_t>     m_count { 0 };      // completions queued
+	std::atomic<size_t>     m_bytes { 0 };      // data queued
+
+	void taken(size_t);
+	int wait_locked(std::unique_lock<std::mutex> &, int);
+
+public:
+	std::atomic<bool>       paused { false };   // receive stopped by the poller
+
+	feed(poller *p, sock_t s) : m_poller(p), m_sock(s) {}
+	feed(const feed &) = delete;
+	feed &operator=(const feed &) = delete;
+	~feed();
+
+	bool ready() const { return m_count.load() > 0; }
+	size_t bytes() const { return m_bytes.load(); }
+
+	void push(sock_t);
+	void push(iobuf &&);
+	void push_eof();
+	void push_error(int);
+	void detach();
+
+	int accept(sock_t *, int *);
+	int recv(iobuf &, int, int *);
+	int recv(void *, int, int *, int, int *);
+	bool wait(int);
+	void close();
+};
+
+} // namespace internal
+} // namespace net
+} // namespace snf
+
+#endif // _SNF_FEED_H_
@@ -0,0 +1,468 @@
+#include "iobuf.h"
+#include <new>
+#include <stdexcept>
+
+namespace snf {
+namespace net {
+
+/*
+ * Drops the reference to the block. The last reference returns
+ * the block to the pool.
+ */
+void
+iobuf::release()
+{
+	if (m_blk) {
+		if (m_blk->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			iobuf_pool::instance().put(m_blk);
+		m_blk = nullptr;
+	}
+
+	m_off = m_len = 0;
+}
+
+/*
+ * Constructs an empty iobuf with room for the specified number
+ * of bytes. The buffer is taken from the pool.
+ *
+ * @param [in] size - minimum buffer size.
+ *
+ * @throws std::invalid_argument if the size is not valid.
+ *         std::bad_alloc if the buffer could not be allocated.
+ */
+iobuf::iobuf(int size)
+{
+	if (size <= 0)
+		throw std::invalid_argument("invalid buffer size");
+
+	m_blk = iobuf_pool::instance().get(size);
+}
+
+/*
+ * Constructs the iobuf with a copy of the data. There is
+ * no buffer if the data is empty.
+ *
+ * @throws std::invalid_argument if the length is not valid.
+ *         std::bad_alloc if the buffer could not be allocated.
+ */
+iobuf::iobuf(const void *data, int len)
+{
+	if (len < 0)
+		throw std::invalid_argument("invalid data length");
+
+	if (len > 0) {
+		m_blk = iobuf_pool::instance().get(len);
+		memcpy(m_blk->data(), data, len);
+		m_len = len;
+	}
+}
+
+iobuf::iobuf(const iobuf &buf)
+	: m_blk(buf.m_blk)
+	, m_off(buf.m_off)
+	, m_len(buf.m_len)
+{
+	if (m_blk)
+		m_blk->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+iobuf::iobuf(iobuf &&buf)
+	: m_blk(buf.m_blk)
+	, m_off(buf.m_off)
+	, m_len(buf.m_len)
+{
+	buf.m_blk = nullptr;
+	buf.m_off = buf.m_len = 0;
+}
+
+iobuf &
+iobuf::operator=(const iobuf &buf)
+{
+	if (this != &buf) {
+		if (buf.m_blk)
+			buf.m_blk->refs.fetch_add(1, std::memory_order_relaxed);
+		release();
+		m_blk = buf.m_blk;
+		m_off = buf.m_off;
+		m_len = buf.m_len;
+	}
+	return *this;
+}
+
+iobuf &
+iobuf::operator=(iobuf &&buf)
+{
+	if (this != &buf) {
+		release();
+		m_blk = buf.m_blk;
+		m_off = buf.m_off;
+		m_len = buf.m_len;
+		buf.m_blk = nullptr;
+		buf.m_off = buf.m_len = 0;
+	}
+	return *this;
+}
+
+/*
+ * Adds the bytes written at tail() to the view.
+ *
+ * @throws std::out_of_range if the bytes do not fit in the room.
+ */
+void
+iobuf::commit(int n)
+{
+	if ((n < 0) || (n > tailroom()))
+		throw std::out_of_range("commit beyond the buffer room");
+	m_len += n;
+}
+
+/*
+ * Removes the bytes from the front of the view.
+ *
+ * @throws std::out_of_range if there are not as many bytes.
+ */
+void
+iobuf::advance(int n)
+{
+	if ((n < 0) || (n > m_len))
+		throw std::out_of_range("advance beyond the buffer data");
+	m_off += n;
+	m_len -= n;
+}
+
+/*
+ * Shortens the view to the specified length.
+ *
+ * @throws std::out_of_range if the length is not valid.
+ */
+void
+iobuf::truncate(int len)
+{
+	if ((len < 0) || (len > m_len))
+		throw std::out_of_range("truncate beyond the buffer data");
+	m_len = len;
+}
+
+/*
+ * Gets a view of a part of this view, sharing the block.
+ *
+ * @param [in] off - offset from data().
+ * @param [in] len - length of the part.
+ *
+ * @throws std::out_of_range if the part is outside the view.
+ */
+iobuf
+iobuf::slice(int off, int len) const
+{
+	if ((off < 0) || (len < 0) || ((off + len) > m_len))
+		throw std::out_of_range("slice outside the buffer data");
+
+	iobuf buf(*this);
+	buf.m_off += off;
+	buf.m_len = len;
+	return buf;
+}
+
+/*
+ * Drops the view.
+ */
+void
+iobuf::reset()
+{
+	release();
+}
+
+iobuf_pool::iobuf_pool()
+{
+	limit(DEFAULT_LIMIT);
+}
+
+/*
+ * Gets the size class for the buffer size, -1 if the buffers
+ * of the size are not pooled.
+ */
+int
+iobuf_pool::size_class(int size)
+{
+	if (size <= SMALL_SIZE)
+		return 0;
+	else if (size <= MEDIUM_SIZE)
+		return 1;
+	else if (size <= LARGE_SIZE)
+		return 2;
+	return -1;
+}
+
+/*
+ * Gets a block, from the free list of the size class if there
+ * is one, with a single reference.
+ */
+iobuf::block *
+iobuf_pool::get(int size)
+{
+	static const int class_size[NCLASSES] = { SMALL_SIZE, MEDIUM_SIZE, LARGE_SIZE };
+
+	iobuf::block *blk = nullptr;
+	int sclass = size_class(size);
+
+	if (sclass >= 0) {
+		freelist &fl = m_free[sclass];
+		std::lock_guard<std::mutex> guard(fl.lock);
+		if (!fl.blocks.empty()) {
+			blk = fl.blocks.back();
+			fl.blocks.pop_back();
+		}
+	}
+
+	if (blk) {
+		m_hits.fetch_add(1, std::memory_order_relaxed);
+	} else {
+		m_misses.fetch_add(1, std::memory_order_relaxed);
+		int bsize = (sclass >= 0) ? class_size[sclass] : size;
+		void *mem = ::operator new(sizeof(iobuf::block) + static_cast<size_t>(bsize));
+		blk = new (mem) iobuf::block;
+		blk->size = bsize;
+		blk->sclass = sclass;
+	}
+
+	blk->refs.store(1, std::memory_order_relaxed);
+	return blk;
+}
+
+/*
+ * Puts the block back on the free list of its size class, or
+ * frees it if it is not pooled or the free list is full.
+ */
+void
+iobuf_pool::put(iobuf::block *blk)
+{
+	if (blk->sclass >= 0) {
+		freelist &fl = m_free[blk->sclass];
+		std::lock_guard<std::mutex> guard(fl.lock);
+		if (fl.blocks.size() < fl.max) {
+			fl.blocks.push_back(blk);
+			return;
+		}
+	}
+
+	blk->~block();
+	::operator delete(blk);
+}
+
+/*
+ * Sets the number of bytes of the free blocks kept per size
+ * class. The free blocks beyond the limit are freed.
+ *
+ * @param [in] bytes - limit in bytes; 0 disables the pooling.
+ */
+void
+iobuf_pool::limit(size_t bytes)
+{
+	static const int class_size[NCLASSES] = { SMALL_SIZE, MEDIUM_SIZE, LARGE_SIZE };
+
+	for (int i = 0; i < NCLASSES; ++i) {
+		std::vector<iobuf::block *> excess;
+
+		{
+			freelist &fl = m_free[i];
+			std::lock_guard<std::mutex> guard(fl.lock);
+			fl.max = bytes / class_size[i];
+			while (fl.blocks.size() > fl.max) {
+				excess.push_back(fl.blocks.back());
+				fl.blocks.pop_back();
+			}
+		}
+
+		for (iobuf::block *blk : excess) {
+			blk->~block();
+			::operator delete(blk);
+		}
+	}
+}
+
+/*
+ * Gets the number of free blocks in the pool.
+ */
+size_t
+iobuf_pool::cached()
+{
+	size_t n = 0;
+
+	for (int i = 0; i < NCLASSES; ++i) {
+		std::lock_guard<std::mutex> guard(m_free[i].lock);
+		n += m_free[i].blocks.size();
+	}
+
+	return n;
+}
+
+/*
+ * Frees all the free blocks.
+ */
+void
+iobuf_pool::trim()
+{
+	for (int i = 0; i < NCLASSES; ++i) {
+		std::vector<iobuf::block *> blocks;
+
+		{
+			std::lock_guard<std::mutex> guard(m_free[i].lock);
+			blocks.swap(m_free[i].blocks);
+		}
+
+		for (iobuf::block *blk : blocks) {
+			blk->~block();
+			::operator delete(blk);
+		}
+	}
+}
+
+/*
+ * Appends the iobuf, sharing its block.
+ */
+void
+iobuf_chain::append(const iobuf &buf)
+{
+	if (buf.empty())
+		return;
+	m_bufs.push_back(buf);
+	m_len += buf.size();
+}
+
+void
+iobuf_chain::append(iobuf &&buf)
+{
+	if (buf.empty())
+		return;
+	m_len += buf.size();
+	m_bufs.push_back(std::move(buf));
+}
+
+/*
+ * Appends a copy of the data, filling the room at the end of
+ * the last buffer first.
+ */
+void
+iobuf_chain::append(const void *data, size_t len)
+{
+	const char *cdata = static_cast<const char *>(data);
+
+	while (len > 0) {
+		int room = 0;
+		char *p = prepare(&room);
+		int n = (len < static_cast<size_t>(room)) ? static_cast<int>(len) : room;
+		memcpy(p, cdata, n);
+		commit(n);
+		cdata += n;
+		len -= n;
+	}
+}
+
+/*
+ * Appends the buffers of the other chain, sharing their blocks.
+ */
+void
+iobuf_chain::append(const iobuf_chain &chain)
+{
+	for (size_t i = 0; i < chain.count(); ++i)
+		append(chain.at(i));
+}
+
+/*
+ * Gets the room at the end of the chain to write into, adding
+ * a new buffer if the last one has no room. The bytes written
+ * are added to the chain with commit().
+ *
+ * @param [out] room - number of bytes that can be written.
+ *
+ * @return the pointer to write at.
+ */
+char *
+iobuf_chain::prepare(int *room)
+{
+	if ((count() == 0) || (m_bufs.back().tailroom() == 0))
+		m_bufs.emplace_back(m_bufsize);
+
+	*room = m_bufs.back().tailroom();
+	return m_bufs.back().tail();
+}
+
+/*
+ * Adds the bytes written at the pointer from prepare().
+ */
+void
+iobuf_chain::commit(int n)
+{
+	m_bufs.back().commit(n);
+	m_len += n;
+}
+
+/*
+ * Gets the scatter/gather elements for the data in the chain.
+ *
+ * @param [out] iov    - scatter/gather elements.
+ * @param [in]  iovcnt - maximum number of elements.
+ *
+ * @return the number of elements filled.
+ */
+int
+iobuf_chain::to_iovec(iovec *iov, int iovcnt) const
+{
+	int n = 0;
+
+	for (size_t i = m_head; (i < m_bufs.size()) && (n < iovcnt); ++i) {
+		if (m_bufs[i].empty())
+			continue;
+		iov[n].iov_base = const_cast<char *>(m_bufs[i].data());
+		iov[n].iov_len = static_cast<size_t>(m_bufs[i].size());
+		n++;
+	}
+
+	return n;
+}
+
+/*
+ * Removes the bytes from the front of the chain, e.g. the bytes
+ * written. The buffers that are used up are released.
+ */
+void
+iobuf_chain::consume(size_t len)
+{
+	if (len >= m_len) {
+		clear();
+		return;
+	}
+
+	m_len -= len;
+
+	while (len > 0) {
+		iobuf &buf = m_bufs[m_head];
+		if (len >= static_cast<size_t>(buf.size())) {
+			len -= buf.size();
+			buf.reset();
+			m_head++;
+		} else {
+			buf.advance(static_cast<int>(len));
+			len = 0;
+		}
+	}
+
+	if (m_head == m_bufs.size()) {
+		m_bufs.clear();
+		m_head = 0;
+	}
+}
+
+/*
+ * Releases all the buffers.
+ */
+void
+iobuf_chain::clear()
+{
+	m_bufs.clear();
+	m_head = 0;
+	m_len = 0;
+}
+
+} // namespace net
+} // namespace snf
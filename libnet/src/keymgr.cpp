@@ -1,5 +1,6 @@
 #include "keymgr.h"
 #include "dbg.h"
+#include "error.h"
 #include <time.h>
 
 namespace snf {
@@ -80,6 +81,168 @@ basic_keymgr::find(const uint8_t *name, size_t len)
 	return nullptr;
 }
 
+static constexpr uint32_t KEY_FILE_MAGIC = 0x534b4559;  // "SKEY"
+
+/*
+ * Key file layout. The key records are stored with a fixed
+ * size expiration time.
+ */
+struct key_file
+{
+	uint32_t    kf_magic;       // KEY_FILE_MAGIC once written
+	uint32_t    kf_nkeys;       // 1 if only the current key is set, 2 otherwise
+	struct
+	{
+		uint8_t key_name[KEY_SIZE];
+		uint8_t aes_key[AES_SIZE];
+		uint8_t hmac_key[HMAC_SIZE];
+		int64_t expire;
+	}           kf_keys[2];     // current key followed by the old key
+};
+
+/*
+ * Synchronizes the cached keys with the key file. The caller
+ * must hold the lock.
+ *
+ * @param [in] rotate - if true, the key file is locked exclusively
+ *                      and a new key is created if the current key
+ *                      does not exist or has expired.
+ *
+ * @return true if the keys are read (and rotated), false if the key
+ *         file could not be read or written.
+ *
+ * @throws snf::net::ssl::exception if the key could not be created.
+ */
+bool
+shared_keymgr::sync(bool rotate)
+{
+	snf::file kf(m_path, 0077);
+	snf::file::open_flags flags;
+	flags.o_read = true;
+	flags.o_write = rotate;
+	flags.o_create = rotate;
+
+	if (kf.open(flags, 0600) != E_ok)
+		return false;
+
+	snf::file::lock_type ltype = rotate
+		? snf::file::lock_type::exclusive
+		: snf::file::lock_type::shared;
+	if (kf.lock(ltype, 0, sizeof(key_file)) != E_ok)
+		return false;
+
+	key_file data;
+	int bread = 0;
+	memset(&data, 0, sizeof(data));
+	if ((kf.read(0, &data, sizeof(data), &bread) != E_ok) ||
+		(bread != sizeof(data)) ||
+		(data.kf_magic != KEY_FILE_MAGIC) ||
+		(data.kf_nkeys < 1) || (data.kf_nkeys > 2)) {
+		memset(&data, 0, sizeof(data));
+	}
+
+	time_t now = time(0);
+
+	if (rotate && ((data.kf_magic != KEY_FILE_MAGIC) || (data.kf_keys[0].expire < now))) {
+		if (data.kf_magic == KEY_FILE_MAGIC) {
+			data.kf_keys[1] = data.kf_keys[0];
+			data.kf_keys[1].expire = now + static_cast<time_t>(m_life * 0.8);
+			data.kf_nkeys = 2;
+		} else {
+			data.kf_nkeys = 1;
+		}
+
+		uint8_t buf[KEY_SIZE + AES_SIZE + HMAC_SIZE];
+		if (ssl_library::instance().rand_bytes()
+			(buf, KEY_SIZE + AES_SIZE + HMAC_SIZE) != 1)
+			throw exception("failed to generate random data");
+
+		uint8_t *ptr = buf;
+		memcpy(data.kf_keys[0].key_name, ptr, KEY_SIZE); ptr += KEY_SIZE;
+		memcpy(data.kf_keys[0].aes_key, ptr, AES_SIZE); ptr += AES_SIZE;
+		memcpy(data.kf_keys[0].hmac_key, ptr, HMAC_SIZE);
+		data.kf_keys[0].expire = now + m_life;
+		data.kf_magic = KEY_FILE_MAGIC;
+
+		int bwritten = 0;
+		if (kf.write(0, &data, sizeof(data), &bwritten) != E_ok)
+			return false;
+	}
+
+	if (data.kf_magic != KEY_FILE_MAGIC)
+		return false;
+
+	keyrec *krecs[2] = { &m_cur, &m_old };
+	for (uint32_t i = 0; i < 2; ++i) {
+		memcpy(krecs[i]->key_name, data.kf_keys[i].key_name, KEY_SIZE);
+		memcpy(krecs[i]->aes_key, data.kf_keys[i].aes_key, AES_SIZE);
+		memcpy(krecs[i]->hmac_key, data.kf_keys[i].hmac_key, HMAC_SIZE);
+		krecs[i]->expire = static_cast<time_t>(data.kf_keys[i].expire);
+	}
+
+	m_has_cur = true;
+	m_has_old = (data.kf_nkeys == 2);
+	m_checked = now;
+	return true;
+}
+
+/*
+ * Gets the current key record. The key file is consulted if
+ * the cached key does not exist or has expired; the key is
+ * rotated if the key in the file has expired too.
+ *
+ * @return key record or nullptr if the key file could not be
+ *         read or written.
+ *
+ * @throws snf::net::ssl::exception if the key could not
+ *         be created.
+ */
+const keyrec *
+shared_keymgr::get()
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	if (m_has_cur && (m_cur.expire >= time(0)))
+		return &m_cur;
+
+	if (!sync(true))
+		return nullptr;
+
+	return &m_cur;
+}
+
+/*
+ * Finds the key record using the given key name. If the key
+ * name is not known, the keys are read again from the key file
+ * as another process may have rotated them.
+ *
+ * @param [in] name - key name.
+ * @param [in] len  - key name length.
+ *
+ * @return key record.
+ */
+const keyrec *
+shared_keymgr::find(const uint8_t *name, size_t len)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	if (len != KEY_SIZE)
+		return nullptr;
+
+	for (int pass = 0; pass < 2; ++pass) {
+		if (m_has_cur && (memcmp(m_cur.key_name, name, len) == 0))
+			return &m_cur;
+
+		if (m_has_old && (memcmp(m_old.key_name, name, len) == 0))
+			return &m_old;
+
+		if ((pass != 0) || (m_checked >= time(0)) || !sync(false))
+			break;
+	}
+
+	return nullptr;
+}
+
 } // namespace ssl
 } // namespace net
 } // namespace snf
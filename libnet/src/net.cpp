@@ -91,7 +91,8 @@ map_system_error(int error, int default_retval)
 /*
  * Poll sockets for events. Look at poll(2) for more details.
  *
- * @param [inout] fds   - vector of pollfd elements.
+ * @param [inout] fds   - array of pollfd elements.
+ * @param [in]    nfds  - number of elements.
  * @param [in]    to    - timeout in milliseconds.
  *                        POLL_WAIT_FOREVER for inifinite wait.
  *                        POLL_WAIT_NONE for no wait.
@@ -102,7 +103,7 @@ map_system_error(int error, int default_retval)
  *         <0 in case of error.
  */
 int
-poll(std::vector<pollfd> &fds, int to, int *oserr)
+poll(pollfd *fds, size_t nfds, int to, int *oserr)
 {
 	int retval;
 
@@ -111,9 +112,9 @@ poll(std::vector<pollfd> &fds, int to, int *oserr)
 
 	do {
 #if defined(_WIN32)
-		retval = WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), to);
+		retval = WSAPoll(fds, static_cast<ULONG>(nfds), to);
 #else
-		retval = poll(fds.data(), fds.size(), to);
+		retval = ::poll(fds, static_cast<nfds_t>(nfds), to);
 #endif
 		if (retval == SOCKET_ERROR) {
 			int error = snf::net::error();
@@ -129,5 +130,24 @@ poll(std::vector<pollfd> &fds, int to, int *oserr)
 	return retval;
 }
 
+/*
+ * Poll sockets for events. Look at poll(2) for more details.
+ *
+ * @param [inout] fds   - vector of pollfd elements.
+ * @param [in]    to    - timeout in milliseconds.
+ *                        POLL_WAIT_FOREVER for inifinite wait.
+ *                        POLL_WAIT_NONE for no wait.
+ * @param [out]   oserr - system error in case of failure, if not null.
+ *
+ * @return >0 indicating the number of sockets that are ready.
+ *         =0 if the call times out before any socket is ready.
+ *         <0 in case of error.
+ */
+int
+poll(std::vector<pollfd> &fds, int to, int *oserr)
+{
+	return poll(fds.data(), fds.size(), to, oserr);
+}
+
 } // namespace net
 } // namespace snf
@@ -2,36 +2,123 @@
 #include "dbg.h"
 #include <memory>
 #include <algorithm>
+#include <cstring>
 
 namespace snf {
 namespace net {
 
 /*
- * Enable and sets the read buffer size. Call it once. The subsequent calls are noops.
+ * Sets the read buffer size. The reads are buffered by default
+ * with a buffer of DEFAULT_BUFSIZE bytes. The size can not be
+ * changed while there is unread data in the buffer.
  *
- * @param [in] bufsize - buffer size. 64 <= bufsize << 65536.
+ * @param [in] bufsize - buffer size. 0 disables buffering,
+ *                       otherwise 64 <= bufsize <= 65536.
+ *
+ * @return true if the buffer size is set, false if there is
+ *         unread data in the buffer.
  */
-void
+bool
 nio::setbuf(int bufsize)
 {
-	if (m_buffered)
-		return;
+	if (m_idx < m_len)
+		return false;
 
-	m_buffered = true;
+	m_buf.reset();
+	m_len = 0;
+	m_idx = 0;
+
+	if (bufsize <= 0) {
+		m_buffered = false;
+		m_max = 0;
+		return true;
+	}
 
-	if (bufsize <  64)
+	if (bufsize < 64)
 		bufsize = 64;
 	else if (bufsize > 65536)
 		bufsize = 65536;
 
-	m_buf = DBG_NEW char[bufsize];
+	m_buffered = true;
 	m_max = bufsize;
-	m_len = 0;
-	m_idx = 0;
+	return true;
+}
+
+/*
+ * Reads the data that is available, at least one byte, waiting
+ * for it if there is none. The default implementation reads
+ * the requested number of bytes. The derived classes override
+ * it to read only what is available.
+ *
+ * @param [out] buf     - buffer to read the data into.
+ * @param [in]  to_read - maximum number of bytes to read.
+ * @param [out] bread   - number of bytes read. 0 on end of file.
+ * @param [in]  to      - timeout in milliseconds.
+ *                        POLL_WAIT_FOREVER for inifinite wait.
+ *                        POLL_WAIT_NONE for no wait.
+ * @param [out] oserr   - system error in case of failure, if not null.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+nio::readsome(void *buf, int to_read, int *bread, int to, int *oserr)
+{
+	return readn(buf, to_read, bread, to, oserr);
+}
+
+/*
+ * Replaces the buffer with the data available, at least one
+ * byte, waiting for it if there is none. The default
+ * implementation reads into the buffer, or into a new one
+ * from the pool if a view of it has been handed out. The
+ * derived classes override it to hand over a buffer the
+ * data has been received in already.
+ *
+ * @param [inout] buf   - buffer to read the data into.
+ * @param [in]    size  - buffer size.
+ * @param [in]    to    - timeout in milliseconds.
+ *                        POLL_WAIT_FOREVER for inifinite wait.
+ *                        POLL_WAIT_NONE for no wait.
+ * @param [out]   oserr - system error in case of failure, if not null.
+ *
+ * @return E_ok on success, -ve error code on failure. The
+ *         buffer is empty on end of file.
+ */
+int
+nio::receive(iobuf &buf, int size, int to, int *oserr)
+{
+	if (!buf.unique())
+		buf = iobuf(size);
+	else
+		buf.truncate(0);
+
+	int n = 0;
+	int retval = readsome(buf.tail(), size, &n, to, oserr);
+	if (retval == E_ok)
+		buf.commit(n);
+	return retval;
+}
+
+/*
+ * Refills the empty read buffer with the data available.
+ * m_len is 0 on end of file.
+ */
+int
+nio::fill(int to, int *oserr)
+{
+	m_idx = m_len = 0;
+
+	int retval = receive(m_buf, m_max, to, oserr);
+	if (retval == E_ok)
+		m_len = m_buf.size();
+	return retval;
 }
 
 /*
- * Reads buffered data.
+ * Reads buffered data. The data that is already in the buffer
+ * is copied first. The rest is read directly into the caller's
+ * buffer if it would not fit in the read buffer, otherwise
+ * the read buffer is refilled.
  */
 int
 nio::read_buffered(void *buf, int to_read, int *bread, int to, int *oserr)
@@ -53,23 +140,25 @@ nio::read_buffered(void *buf, int to_read, int *bread, int to, int *oserr)
 		if (m_idx < m_len) {
 			// there is data available in buffer
 			n = std::min((m_len - m_idx), to_read);
-			memcpy(cbuf, m_buf + m_idx, n);
+			memcpy(cbuf, m_buf.data() + m_idx, n);
 			m_idx += n;
+			cbuf += n;
 			to_read -= n;
 			nbytes += n;
+			if (to_read == 0)
+				break;
 		}
 
-		if (to_read) {
-			if (m_idx >= m_len) {
-				retval = E_invalid_state;
-			} else {
-				m_idx = m_len = 0;
-				retval = readn(m_buf, m_max, &m_len, to, oserr);
-			}
-
-			if ((retval != E_ok) || (m_len == 0))
-				break;
+		if (to_read >= m_max) {
+			n = 0;
+			retval = readn(cbuf, to_read, &n, to, oserr);
+			nbytes += n;
+			break;
 		}
+
+		retval = fill(to, oserr);
+		if ((retval != E_ok) || (m_len == 0))
+			break;
 	}
 
 	*bread = nbytes;
@@ -85,6 +174,264 @@ nio::read(void *buf, int to_read, int *bread, int to, int *oserr)
 	return read_buffered(buf, to_read, bread, to, oserr);
 }
 
+/*
+ * Gets the total length of the scatter/gather elements.
+ *
+ * @return the total length, -1 if the elements are
+ *         invalid or the total does not fit in an int.
+ */
+int
+nio::iov_length(const iovec *iov, int iovcnt)
+{
+	if ((iov == nullptr) || (iovcnt <= 0))
+		return -1;
+
+	int64_t total = 0;
+	for (int i = 0; i < iovcnt; ++i) {
+		if ((iov[i].iov_base == nullptr) && (iov[i].iov_len != 0))
+			return -1;
+		total += static_cast<int64_t>(iov[i].iov_len);
+		if (total > INT32_MAX)
+			return -1;
+	}
+
+	return static_cast<int>(total);
+}
+
+/*
+ * Writes the data from the scatter/gather elements. The default
+ * implementation coalesces the small elements in a buffer of
+ * DEFAULT_BUFSIZE bytes (about the size of a TLS record, taken
+ * from the iobuf pool), so that each write carries as much data
+ * as possible; the elements that do not fit in the buffer are
+ * written as they are.
+ *
+ * @param [in]  iov      - scatter/gather elements.
+ * @param [in]  iovcnt   - number of elements.
+ * @param [out] bwritten - number of bytes written.
+ * @param [in]  to       - timeout in milliseconds.
+ *                         POLL_WAIT_FOREVER for inifinite wait.
+ *                         POLL_WAIT_NONE for no wait.
+ * @param [out] oserr    - system error in case of failure, if not null.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+nio::writen(const iovec *iov, int iovcnt, int *bwritten, int to, int *oserr)
+{
+	int total = iov_length(iov, iovcnt);
+	if (total <= 0)
+		return E_invalid_arg;
+
+	if (bwritten == nullptr)
+		return E_invalid_arg;
+
+	int retval = E_ok;
+	int nbytes = 0;
+	int len = 0;
+	int n = 0;
+	iobuf buf;
+
+	*bwritten = 0;
+
+	for (int i = 0; (retval == E_ok) && (i < iovcnt); ++i) {
+		const char *data = static_cast<const char *>(iov[i].iov_base);
+		int datalen = static_cast<int>(iov[i].iov_len);
+
+		if (datalen == 0)
+			continue;
+
+		if ((len + datalen) <= DEFAULT_BUFSIZE) {
+			if (!buf)
+				buf = iobuf(DEFAULT_BUFSIZE);
+			memcpy(buf.data() + len, data, datalen);
+			len += datalen;
+			continue;
+		}
+
+		if (len > 0) {
+			n = 0;
+			retval = writen(buf.data(), len, &n, to, oserr);
+			nbytes += n;
+			len = 0;
+			if (retval != E_ok)
+				break;
+		}
+
+		if (datalen < DEFAULT_BUFSIZE) {
+			if (!buf)
+				buf = iobuf(DEFAULT_BUFSIZE);
+			memcpy(buf.data(), data, datalen);
+			len = datalen;
+		} else {
+			n = 0;
+			retval = writen(data, datalen, &n, to, oserr);
+			nbytes += n;
+		}
+	}
+
+	if ((retval == E_ok) && (len > 0)) {
+		n = 0;
+		retval = writen(buf.data(), len, &n, to, oserr);
+		nbytes += n;
+	}
+
+	*bwritten = nbytes;
+
+	return retval;
+}
+
+/*
+ * Reads the data into the scatter/gather elements, filling
+ * them in order. With buffered reads, the small elements are
+ * filled from the read buffer.
+ *
+ * @param [in]  iov     - scatter/gather elements.
+ * @param [in]  iovcnt  - number of elements.
+ * @param [out] bread   - number of bytes read.
+ * @param [in]  to      - timeout in milliseconds.
+ *                        POLL_WAIT_FOREVER for inifinite wait.
+ *                        POLL_WAIT_NONE for no wait.
+ * @param [out] oserr   - system error in case of failure, if not null.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+nio::read(const iovec *iov, int iovcnt, int *bread, int to, int *oserr)
+{
+	int total = iov_length(iov, iovcnt);
+	if (total <= 0)
+		return E_invalid_arg;
+
+	if (bread == nullptr)
+		return E_invalid_arg;
+
+	int retval = E_ok;
+	int nbytes = 0;
+
+	for (int i = 0; i < iovcnt; ++i) {
+		int to_read = static_cast<int>(iov[i].iov_len);
+		if (to_read == 0)
+			continue;
+
+		int n = 0;
+		retval = read(iov[i].iov_base, to_read, &n, to, oserr);
+		nbytes += n;
+		if ((retval != E_ok) || (n != to_read))
+			break;
+	}
+
+	*bread = nbytes;
+
+	return retval;
+}
+
+int
+nio::write(const iovec *iov, int iovcnt, int *bwritten, int to, int *oserr)
+{
+	return writen(iov, iovcnt, bwritten, to, oserr);
+}
+
+/*
+ * Sends the file content. The default implementation reads
+ * the file in chunks and writes them.
+ *
+ * @param [in]  f      - open file.
+ * @param [in]  offset - file offset to start from.
+ * @param [in]  count  - number of bytes to send.
+ * @param [out] bsent  - number of bytes sent. It is less than
+ *                       count if the end of file is reached.
+ * @param [in]  to     - timeout in milliseconds.
+ *                       POLL_WAIT_FOREVER for inifinite wait.
+ *                       POLL_WAIT_NONE for no wait.
+ * @param [out] oserr  - system error in case of failure, if not null.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+nio::sendfile(snf::file &f, int64_t offset, int64_t count, int64_t *bsent, int to, int *oserr)
+{
+	if ((offset < 0) || (count <= 0) || (bsent == nullptr))
+		return E_invalid_arg;
+
+	const int chunk = iobuf_pool::LARGE_SIZE;
+	iobuf buf(chunk);
+	int retval = E_ok;
+
+	*bsent = 0;
+
+	while (count > 0) {
+		int to_read = static_cast<int>(std::min(count, static_cast<int64_t>(chunk)));
+		int bread = 0;
+
+		retval = f.read(offset, buf.data(), to_read, &bread, oserr);
+		if ((retval != E_ok) || (bread == 0))
+			break;
+
+		int bwritten = 0;
+		retval = writen(buf.data(), bread, &bwritten, to, oserr);
+		*bsent += bwritten;
+		if ((retval != E_ok) || (bwritten != bread))
+			break;
+
+		offset += bread;
+		count -= bread;
+	}
+
+	return retval;
+}
+
+/*
+ * Peeks at the buffered data without consuming it. If the
+ * buffer is empty, it is refilled with the data available.
+ * The data remains valid until the next read operation.
+ *
+ * @param [out] data  - pointer to the buffered data.
+ * @param [out] len   - length of the buffered data. 0 on
+ *                      end of file.
+ * @param [in]  to    - timeout in milliseconds.
+ *                      POLL_WAIT_FOREVER for inifinite wait.
+ *                      POLL_WAIT_NONE for no wait.
+ * @param [out] oserr - system error in case of failure, if not null.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ *         E_invalid_state if the reads are not buffered.
+ */
+int
+nio::peek(const char **data, int *len, int to, int *oserr)
+{
+	if ((data == nullptr) || (len == nullptr))
+		return E_invalid_arg;
+
+	if (!m_buffered)
+		return E_invalid_state;
+
+	int retval = E_ok;
+
+	if (m_idx >= m_len)
+		retval = fill(to, oserr);
+
+	if (retval == E_ok) {
+		*data = m_buf.data() + m_idx;
+		*len = m_len - m_idx;
+	}
+
+	return retval;
+}
+
+/*
+ * Consumes the buffered data returned by peek().
+ *
+ * @param [in] n - number of bytes to consume. It is
+ *                 capped to the data in the buffer.
+ */
+void
+nio::consume(int n)
+{
+	if (n > 0)
+		m_idx += std::min(n, m_len - m_idx);
+}
+
 int
 nio::write(const void *buf, int to_write, int *bwritten, int to, int *oserr)
 {
@@ -108,6 +455,11 @@ nio::write(const void *buf, int to_write, int *bwritten, int to, int *oserr)
 int
 nio::get_char(char &c, int to, int *oserr)
 {
+	if (m_idx < m_len) {
+		c = m_buf.data()[m_idx++];
+		return E_ok;
+	}
+
 	int bread = 0;
 	char buf[1];
 
@@ -222,39 +574,164 @@ nio::write_string(const std::string &str, int to, int *oserr)
 
 /*
  * Reads a line terminated by newline ('\n'). This will continue
- * readline until a new line is encountered.
+ * reading until a new line is encountered. With buffered reads,
+ * the buffer is scanned for the newline and the line is copied
+ * a chunk at a time.
  *
- * @param [out] line  - line read.
+ * @param [out] line  - line read, including the newline.
  * @param [in]  to    - timeout in milliseconds.
  *                      POLL_WAIT_FOREVER for inifinite wait.
  *                      POLL_WAIT_NONE for no wait.
  * @param [out] oserr - system error in case of failure, if not null.
  *
  * @return E_ok on success, -ve error code on failure.
+ *         E_read_failed if the end of file is reached
+ *         before the newline.
  *
  * The call can possibly throw one or more exceptions if the derived
- * class of implementation of write throws one.
+ * class of implementation of read throws one.
  */
 int
 nio::readline(std::string &line, int to, int *oserr)
 {
 	int     retval = E_ok;
 	int     n;
-	char    buf[1];
 
-	do {
-		n = 0;
-		retval = read(buf, 1, &n, to, oserr);
-		if (retval != E_ok) {
-			break;
-		} else if (n == 0) {
-			retval = E_read_failed;
+	if (!m_buffered) {
+		char buf[1];
+
+		do {
+			n = 0;
+			retval = readn(buf, 1, &n, to, oserr);
+			if (retval != E_ok) {
+				break;
+			} else if (n == 0) {
+				retval = E_read_failed;
+				break;
+			}
+
+			line.push_back(buf[0]);
+		} while (buf[0] != '\n');
+
+		return retval;
+	}
+
+	while (true) {
+		if (m_idx >= m_len) {
+			retval = fill(to, oserr);
+			if (retval != E_ok) {
+				break;
+			} else if (m_len == 0) {
+				retval = E_read_failed;
+				break;
+			}
+		}
+
+		const char *start = m_buf.data() + m_idx;
+		n = m_len - m_idx;
+
+		const char *nl = static_cast<const char *>(memchr(start, '\n', n));
+		if (nl)
+			n = static_cast<int>(nl - start) + 1;
+
+		line.append(start, n);
+		m_idx += n;
+
+		if (nl)
 			break;
+	}
+
+	return retval;
+}
+
+
+/*
+ * Reads the data available, up to the specified number of bytes,
+ * as an iobuf. With buffered reads, the iobuf is a view of the
+ * read buffer, so the data is not copied.
+ *
+ * @param [out] buf     - data read; empty on end of file.
+ * @param [in]  to_read - maximum number of bytes to read.
+ * @param [in]  to      - timeout in milliseconds.
+ *                        POLL_WAIT_FOREVER for inifinite wait.
+ *                        POLL_WAIT_NONE for no wait.
+ * @param [out] oserr   - system error in case of failure, if not null.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+nio::read(iobuf &buf, int to_read, int to, int *oserr)
+{
+	if (to_read <= 0)
+		return E_invalid_arg;
+
+	int retval = E_ok;
+
+	if (!m_buffered) {
+		iobuf b(to_read);
+		int n = 0;
+		retval = readsome(b.tail(), to_read, &n, to, oserr);
+		if (retval == E_ok) {
+			b.commit(n);
+			buf = std::move(b);
 		}
+		return retval;
+	}
 
-		if (n == 1)
-			line.push_back(buf[0]);
-	} while (buf[0] != '\n');
+	if (m_idx >= m_len)
+		retval = fill(to, oserr);
+
+	if (retval == E_ok) {
+		int n = std::min(m_len - m_idx, to_read);
+		buf = m_buf.slice(m_idx, n);
+		m_idx += n;
+	}
+
+	return retval;
+}
+
+/*
+ * Writes the data in the iobuf chain, with as few writes as
+ * the scatter/gather elements allow.
+ *
+ * @param [in]  chain    - data to write.
+ * @param [out] bwritten - number of bytes written.
+ * @param [in]  to       - timeout in milliseconds.
+ *                         POLL_WAIT_FOREVER for inifinite wait.
+ *                         POLL_WAIT_NONE for no wait.
+ * @param [out] oserr    - system error in case of failure, if not null.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+nio::write(const iobuf_chain &chain, int *bwritten, int to, int *oserr)
+{
+	if (bwritten == nullptr)
+		return E_invalid_arg;
+
+	*bwritten = 0;
+
+	iovec iov[64];
+	size_t idx = 0;
+	int retval = E_ok;
+
+	while ((retval == E_ok) && (idx < chain.count())) {
+		int iovcnt = 0;
+		int len = 0;
+
+		for (; (idx < chain.count()) && (iovcnt < 64); ++idx) {
+			const iobuf &b = chain.at(idx);
+			iov[iovcnt].iov_base = const_cast<char *>(b.data());
+			iov[iovcnt++].iov_len = static_cast<size_t>(b.size());
+			len += b.size();
+		}
+
+		int n = 0;
+		retval = write(iov, iovcnt, &n, to, oserr);
+		*bwritten += n;
+		if ((retval == E_ok) && (n != len))
+			retval = E_write_failed;
+	}
 
 	return retval;
 }
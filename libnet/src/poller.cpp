@@ -0,0 +1,1000 @@
+#include "poller.h"
+#include "logger.h"
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+#if defined(SNF_HAVE_IO_URING)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <csignal>
+#include <cstring>
+#endif
+
+namespace snf {
+namespace net {
+namespace internal {
+
+/*
+ * Creates the poller of the given type. If the type is
+ * not supported on the platform, poll() based poller
+ * is created.
+ *
+ * @param [in] type - poller type.
+ *
+ * @throws std::system_error if the poller could not
+ *         be created.
+ */
+poller *
+poller::create(poller_type type)
+{
+#if defined(SNF_HAVE_IO_URING)
+	if (type == poller_type::uring) {
+		try {
+			return new uring_poller();
+		} catch (const std::system_error &ex) {
+			WARNING_STRM("poller")
+				<< "io_uring is not available (" << ex.what() << "), using epoll"
+				<< snf::log::record::endl;
+		}
+		return new epoll_poller();
+	}
+#endif
+
+#if defined(__linux__)
+	if ((type == poller_type::dflt) || (type == poller_type::epoll) || (type == poller_type::uring))
+		return new epoll_poller();
+#else
+	if ((type == poller_type::epoll) || (type == poller_type::uring)) {
+		WARNING_STRM("poller")
+			<< "epoll/io_uring is not supported on this platform, using poll"
+			<< snf::log::record::endl;
+	}
+#endif
+	return new poll_poller();
+}
+
+/*
+ * Sets the events of interest for the socket.
+ * Removing a socket moves the last pollfd element
+ * in its place.
+ */
+void
+poll_poller::set(sock_t s, short events, bool)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	std::unordered_map<sock_t, size_t>::iterator I = m_index.find(s);
+	if (I == m_index.end()) {
+		if (events == 0)
+			return;
+
+		pollfd fdelem = { s, events, 0 };
+		m_index[s] = m_fds.size();
+		m_fds.push_back(fdelem);
+	} else if (events != 0) {
+		if (m_fds[I->second].events == events)
+			return;
+
+		m_fds[I->second].events = events;
+	} else {
+		size_t idx = I->second;
+		m_index.erase(I);
+		if (idx != (m_fds.size() - 1)) {
+			m_fds[idx] = m_fds.back();
+			m_index[m_fds[idx].fd] = idx;
+		}
+		m_fds.pop_back();
+	}
+
+	m_changed = true;
+}
+
+/*
+ * Calls poll() and collects the sockets that are ready.
+ */
+int
+poll_poller::wait(std::vector<pollfd> &ready, int to, int *oserr)
+{
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		if (m_changed) {
+			m_pollfds = m_fds;
+			m_changed = false;
+		}
+	}
+
+	int nready = snf::net::poll(m_pollfds, to, oserr);
+	if (nready > 0) {
+		int n = 0;
+		for (auto &fdelem : m_pollfds) {
+			if (fdelem.revents != 0) {
+				ready.push_back(fdelem);
+				fdelem.revents = 0;
+				if (++n == nready)
+					break;
+			}
+		}
+	}
+
+	return nready;
+}
+
+#if defined(__linux__)
+
+/*
+ * Converts poll() events to epoll() events and back.
+ */
+static uint32_t
+to_epoll_events(short events)
+{
+	uint32_t ev = 0;
+	if (events & POLLRD) ev |= EPOLLIN;
+	if (events & POLLWR) ev |= EPOLLOUT;
+	return ev;
+}
+
+static short
+from_epoll_events(uint32_t ev)
+{
+	short events = 0;
+	if (ev & EPOLLIN) events |= POLLIN;
+	if (ev & EPOLLPRI) events |= POLLPRI;
+	if (ev & EPOLLOUT) events |= POLLOUT;
+	if (ev & EPOLLERR) events |= POLLERR;
+	if (ev & (EPOLLHUP | EPOLLRDHUP)) events |= POLLHUP;
+	return events;
+}
+
+/*
+ * Creates the epoll instance.
+ *
+ * @throws std::system_error if epoll_create1() fails.
+ */
+epoll_poller::epoll_poller()
+	: m_evvec(256)
+{
+	m_epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (m_epfd < 0) {
+		throw std::system_error(
+			snf::net::error(),
+			std::system_category(),
+			"epoll_create1 failed");
+	}
+}
+
+epoll_poller::~epoll_poller()
+{
+	::close(m_epfd);
+}
+
+/*
+ * Sets the events of interest for the socket. The
+ * kernel drops a socket from the epoll set when it is
+ * closed. So a stale registration is not an error: a
+ * socket being removed may already be gone, and a
+ * socket being modified may have to be added again.
+ * Unless refresh is set, an unchanged interest set is
+ * not passed on to the kernel.
+ */
+void
+epoll_poller::set(sock_t s, short events, bool refresh)
+{
+	std::unordered_map<sock_t, short>::iterator I = m_events.find(s);
+	if ((I != m_events.end()) && (I->second == events) && !refresh)
+		return;
+
+	int retval;
+
+	if (events == 0) {
+		if (I == m_events.end())
+			return;
+
+		m_events.erase(I);
+		retval = epoll_ctl(m_epfd, EPOLL_CTL_DEL, s, nullptr);
+		if ((retval < 0) && ((errno == EBADF) || (errno == ENOENT)))
+			retval = 0;
+	} else {
+		epoll_event ev;
+		ev.events = to_epoll_events(events);
+		ev.data.fd = s;
+
+		if ((I == m_events.end()) || refresh) {
+			retval = epoll_ctl(m_epfd, EPOLL_CTL_ADD, s, &ev);
+			if ((retval < 0) && (errno == EEXIST))
+				retval = epoll_ctl(m_epfd, EPOLL_CTL_MOD, s, &ev);
+		} else {
+			retval = epoll_ctl(m_epfd, EPOLL_CTL_MOD, s, &ev);
+			if ((retval < 0) && (errno == ENOENT))
+				retval = epoll_ctl(m_epfd, EPOLL_CTL_ADD, s, &ev);
+		}
+
+		if (retval == 0)
+			m_events[s] = events;
+	}
+
+	if (retval < 0) {
+		std::ostringstream oss;
+		oss << "epoll_ctl failed for socket " << s;
+		throw std::system_error(
+			snf::net::error(),
+			std::system_category(),
+			oss.str());
+	}
+}
+
+/*
+ * Calls epoll_wait() and collects the sockets that are
+ * ready. The event vector grows when it is filled up.
+ */
+int
+epoll_poller::wait(std::vector<pollfd> &ready, int to, int *oserr)
+{
+	int nready;
+
+	if (oserr)
+		*oserr = 0;
+
+	do {
+		nready = epoll_wait(m_epfd, m_evvec.data(), static_cast<int>(m_evvec.size()), to);
+		if (nready < 0) {
+			int error = snf::net::error();
+			if (EINTR == error)
+				continue;
+			if (oserr) *oserr = error;
+			return SOCKET_ERROR;
+		}
+		break;
+	} while (true);
+
+	for (int i = 0; i < nready; ++i) {
+		pollfd fdelem = {
+			m_evvec[i].data.fd,
+			0,
+			from_epoll_events(m_evvec[i].events)
+		};
+		ready.push_back(fdelem);
+	}
+
+	if (nready == static_cast<int>(m_evvec.size()))
+		m_evvec.resize(m_evvec.size() * 2);
+
+	return nready;
+}
+
+#endif // __linux__
+
+#if defined(SNF_HAVE_IO_URING)
+
+constexpr unsigned URING_SQ_ENTRIES = 256;
+constexpr unsigned URING_CQ_ENTRIES = 4096;
+constexpr uint64_t URING_REMOVE = ~0ULL;   // user data of the requests with completions ignored
+constexpr unsigned URING_BUF_ENTRIES = 32;  // provided buffers, a power of 2
+constexpr uint16_t URING_BUF_GROUP = 0;     // provided buffer group ID
+constexpr int URING_BUF_SIZE = iobuf_pool::MEDIUM_SIZE;
+
+/*
+ * Makes the user data of the poll request from
+ * the socket and the generation.
+ */
+static inline uint64_t
+uring_data(sock_t s, uint32_t gen)
+{
+	return (static_cast<uint64_t>(gen) << 32) | static_cast<uint32_t>(s);
+}
+
+/*
+ * Sets up the ring and maps the submission and completion
+ * queues. IORING_FEAT_EXT_ARG (Linux 5.11) is required to
+ * wait with a timeout.
+ *
+ * @throws std::system_error if io_uring is not available.
+ */
+uring_poller::uring_poller()
+{
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	params.flags = IORING_SETUP_CQSIZE;
+	params.cq_entries = URING_CQ_ENTRIES;
+
+	m_fd = static_cast<int>(syscall(__NR_io_uring_setup, URING_SQ_ENTRIES, &params));
+	if (m_fd < 0) {
+		throw std::system_error(
+			snf::net::error(),
+			std::system_category(),
+			"io_uring_setup failed");
+	}
+
+	if (!(params.features & IORING_FEAT_EXT_ARG)) {
+		::close(m_fd);
+		throw std::system_error(
+			ENOTSUP,
+			std::system_category(),
+			"io_uring does not support waiting with timeout");
+	}
+
+	m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		m_sq_ring_size = m_cq_ring_size = std::max(m_sq_ring_size, m_cq_ring_size);
+	m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+	m_sq_ring = mmap(nullptr, m_sq_ring_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+	if (m_sq_ring == MAP_FAILED)
+		m_sq_ring = nullptr;
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		m_cq_ring = m_sq_ring;
+	} else {
+		m_cq_ring = mmap(nullptr, m_cq_ring_size, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+		if (m_cq_ring == MAP_FAILED)
+			m_cq_ring = nullptr;
+	}
+
+	void *sqes = mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+	if (sqes != MAP_FAILED)
+		m_sqes = static_cast<io_uring_sqe *>(sqes);
+
+	if ((m_sq_ring == nullptr) || (m_cq_ring == nullptr) || (m_sqes == nullptr)) {
+		int error = snf::net::error();
+		unmap();
+		::close(m_fd);
+		throw std::system_error(
+			error,
+			std::system_category(),
+			"failed to map io_uring");
+	}
+
+	char *sq = static_cast<char *>(m_sq_ring);
+	m_sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+	m_sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+	m_sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+	m_sq_mask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+	m_sq_entries = params.sq_entries;
+
+	char *cq = static_cast<char *>(m_cq_ring);
+	m_cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+	m_cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+	m_cq_mask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+	m_cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+	setup_buffers();
+}
+
+/*
+ * Detaches the feeds, which may outlive the poller, and
+ * takes the provided buffers back from the kernel before
+ * they are freed.
+ */
+uring_poller::~uring_poller()
+{
+	std::vector<std::shared_ptr<feed>> feeds;
+
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		for (auto &S : m_streams)
+			feeds.push_back(S.second.f);
+		m_streams.clear();
+		m_candidates.clear();
+	}
+
+	for (auto &f : feeds)
+		f->detach();
+
+	if (m_br) {
+		io_uring_buf_reg reg;
+		memset(&reg, 0, sizeof(reg));
+		reg.bgid = URING_BUF_GROUP;
+		syscall(__NR_io_uring_register, m_fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+		munmap(m_br, m_br_size);
+		m_br = nullptr;
+	}
+
+	unmap();
+	::close(m_fd);
+}
+
+/*
+ * Sets up the ring of buffers provided for the multishot
+ * receives, if the kernel has the multishot operations:
+ * Linux 6.0, which is told by IORING_OP_SEND_ZC that came
+ * with it. Otherwise the poller is readiness based only.
+ */
+void
+uring_poller::setup_buffers()
+{
+	std::vector<char> pbuf(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+	io_uring_probe *probe = reinterpret_cast<io_uring_probe *>(pbuf.data());
+
+	if ((syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PROBE, probe, 256) < 0) ||
+		(probe->ops_len <= IORING_OP_SEND_ZC) ||
+		!(probe->ops[IORING_OP_SEND_ZC].flags & IO_URING_OP_SUPPORTED)) {
+		DEBUG_STRM("poller")
+			<< "io_uring multishot operations are not supported"
+			<< snf::log::record::endl;
+		return;
+	}
+
+	size_t size = URING_BUF_ENTRIES * sizeof(io_uring_buf);
+	void *br = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (br == MAP_FAILED)
+		return;
+
+	io_uring_buf_reg reg;
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = reinterpret_cast<uint64_t>(br);
+	reg.ring_entries = URING_BUF_ENTRIES;
+	reg.bgid = URING_BUF_GROUP;
+
+	if (syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+		WARNING_STRM("poller", snf::net::error())
+			<< "failed to register the io_uring buffer ring"
+			<< snf::log::record::endl;
+		munmap(br, size);
+		return;
+	}
+
+	m_br = static_cast<io_uring_buf_ring *>(br);
+	m_br_size = size;
+	m_br_bufs.resize(URING_BUF_ENTRIES);
+	for (unsigned bid = 0; bid < URING_BUF_ENTRIES; ++bid)
+		provide(static_cast<uint16_t>(bid));
+}
+
+/*
+ * Provides a new buffer from the pool to the kernel, with
+ * the buffer ID of the one taken out of the ring. Called
+ * from the constructor or with the poller lock held.
+ */
+void
+uring_poller::provide(uint16_t bid)
+{
+	m_br_bufs[bid] = iobuf(URING_BUF_SIZE);
+
+	// The ring is an array of io_uring_buf, with the tail in the
+	// first entry. Not through m_br->bufs, which the empty struct
+	// of __DECLARE_FLEX_ARRAY shifts in C++.
+	io_uring_buf *buf = reinterpret_cast<io_uring_buf *>(m_br) +
+		(m_br_tail & (URING_BUF_ENTRIES - 1));
+	buf->addr = reinterpret_cast<uint64_t>(m_br_bufs[bid].tail());
+	buf->len = static_cast<uint32_t>(m_br_bufs[bid].tailroom());
+	buf->bid = bid;
+
+	__atomic_store_n(&m_br->tail, ++m_br_tail, __ATOMIC_RELEASE);
+}
+
+/*
+ * Unmaps the rings.
+ */
+void
+uring_poller::unmap()
+{
+	if (m_sqes)
+		munmap(m_sqes, m_sqes_size);
+	if (m_cq_ring && (m_cq_ring != m_sq_ring))
+		munmap(m_cq_ring, m_cq_ring_size);
+	if (m_sq_ring)
+		munmap(m_sq_ring, m_sq_ring_size);
+	m_sqes = nullptr;
+	m_cq_ring = m_sq_ring = nullptr;
+}
+
+/*
+ * Calls io_uring_enter(), retrying if interrupted.
+ *
+ * @return 0 on success, the system error on failure.
+ */
+int
+uring_poller::enter(unsigned to_submit, unsigned min_complete, unsigned flags,
+	const void *arg, size_t argsz)
+{
+	while (syscall(__NR_io_uring_enter, m_fd, to_submit, min_complete, flags, arg, argsz) < 0) {
+		int error = snf::net::error();
+		if (error != EINTR)
+			return error;
+	}
+	return 0;
+}
+
+/*
+ * Gets the next free submission queue entry. The queued
+ * entries are submitted if the queue is full. The caller
+ * must hold the poller lock.
+ *
+ * @throws std::system_error if the entries could not be
+ *         submitted.
+ */
+io_uring_sqe *
+uring_poller::get_sqe()
+{
+	unsigned tail = *m_sq_tail;
+	if ((tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE)) >= m_sq_entries)
+		flush();
+
+	unsigned idx = tail & m_sq_mask;
+	io_uring_sqe *sqe = &m_sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	m_sq_array[idx] = idx;
+	return sqe;
+}
+
+/*
+ * Queues the entry filled in, for the next submission.
+ * The caller must hold the poller lock.
+ */
+void
+uring_poller::queue()
+{
+	__atomic_store_n(m_sq_tail, *m_sq_tail + 1, __ATOMIC_RELEASE);
+	m_queued++;
+}
+
+/*
+ * Submits the queued entries. The caller must hold the
+ * poller lock.
+ *
+ * @throws std::system_error if the entries could not be
+ *         submitted.
+ */
+void
+uring_poller::flush()
+{
+	if (m_queued == 0)
+		return;
+
+	int error = enter(m_queued, 0, 0, nullptr, 0);
+	if (error != 0) {
+		throw std::system_error(
+			error,
+			std::system_category(),
+			"io_uring_enter failed");
+	}
+	m_queued = 0;
+}
+
+/*
+ * Queues a one-shot poll request for the socket with a new
+ * generation. The read events of a socket attached come from
+ * its feed, so there may be nothing to poll for. The caller
+ * must hold the poller lock.
+ */
+void
+uring_poller::arm(sock_t s, registration &reg)
+{
+	short events = reg.events;
+	if (m_streams.find(s) != m_streams.end())
+		events &= ~POLLRD;
+	if (events == 0)
+		return;
+
+	io_uring_sqe *sqe = get_sqe();
+	reg.gen = ++m_gen;
+	reg.armed = true;
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = s;
+	sqe->poll32_events = static_cast<uint16_t>(events);
+	sqe->user_data = uring_data(s, reg.gen);
+
+	queue();
+}
+
+/*
+ * Queues the removal of the poll request in flight. Its
+ * completion, if any, is ignored as it carries an old
+ * generation. The caller must hold the poller lock.
+ */
+void
+uring_poller::disarm(const registration &reg, sock_t s)
+{
+	if (!reg.armed)
+		return;
+
+	io_uring_sqe *sqe = get_sqe();
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->fd = -1;
+	sqe->addr = uring_data(s, reg.gen);
+	sqe->user_data = URING_REMOVE;
+
+	queue();
+}
+
+/*
+ * Queues the multishot accept, or the multishot receive into
+ * the provided buffers, of the stream. The caller must hold
+ * the poller lock.
+ */
+void
+uring_poller::arm(sock_t s, stream &st)
+{
+	io_uring_sqe *sqe = get_sqe();
+	st.armed = true;
+
+	sqe->fd = s;
+	sqe->user_data = uring_data(s, st.gen);
+	if (st.listening) {
+		sqe->opcode = IORING_OP_ACCEPT;
+		sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+		sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+	} else {
+		sqe->opcode = IORING_OP_RECV;
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = URING_BUF_GROUP;
+	}
+
+	queue();
+}
+
+/*
+ * Queues the cancellation of the operation in flight. The
+ * caller must hold the poller lock.
+ */
+void
+uring_poller::cancel(sock_t s, const stream &st)
+{
+	if (!st.armed)
+		return;
+
+	io_uring_sqe *sqe = get_sqe();
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = uring_data(s, st.gen);
+	sqe->user_data = URING_REMOVE;
+
+	queue();
+}
+
+/*
+ * Is the socket attached, registered for read and with
+ * completions in its feed? The caller must hold the
+ * poller lock.
+ */
+bool
+uring_poller::is_ready(sock_t s)
+{
+	std::unordered_map<sock_t, registration>::iterator R = m_regs.find(s);
+	if ((R == m_regs.end()) || !(R->second.events & POLLRD))
+		return false;
+
+	std::unordered_map<sock_t, stream>::iterator S = m_streams.find(s);
+	return (S != m_streams.end()) && S->second.f->ready();
+}
+
+/*
+ * Sets the events of interest for the socket. A change
+ * replaces the poll request in flight. The requests are
+ * submitted with the next wait() if called from the
+ * reactor thread, right away otherwise.
+ */
+void
+uring_poller::set(sock_t s, short events, bool refresh)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	std::unordered_map<sock_t, registration>::iterator I = m_regs.find(s);
+	if ((I != m_regs.end()) && (I->second.events == events) && !refresh)
+		return;
+
+	if (events == 0) {
+		if (I == m_regs.end())
+			return;
+		disarm(I->second, s);
+		m_regs.erase(I);
+	} else if (I == m_regs.end()) {
+		registration reg = { events, 0, false };
+		arm(s, reg);
+		m_regs[s] = reg;
+	} else {
+		disarm(I->second, s);
+		I->second.events = events;
+		arm(s, I->second);
+	}
+
+	bool other_thread = (std::this_thread::get_id() != m_thread.load());
+
+	if ((events & POLLRD) && (m_streams.find(s) != m_streams.end())) {
+		m_candidates.insert(s);
+
+		// Wake the reactor thread up if there are completions already.
+		if (other_thread && is_ready(s)) {
+			io_uring_sqe *sqe = get_sqe();
+			sqe->opcode = IORING_OP_NOP;
+			sqe->user_data = URING_REMOVE;
+			queue();
+		}
+	}
+
+	if (other_thread)
+		flush();
+}
+
+/*
+ * Starts the multishot accept or receive on the socket,
+ * if the kernel has the multishot operations.
+ */
+std::shared_ptr<feed>
+uring_poller::attach(sock_t s, bool listening)
+{
+	if (m_br == nullptr)
+		return nullptr;
+
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	std::shared_ptr<feed> f(DBG_NEW feed(this, s));
+	stream st = { f, listening, ++m_gen, false, false };
+	arm(s, st);
+	m_streams[s] = st;
+
+	if (std::this_thread::get_id() != m_thread.load())
+		flush();
+
+	return f;
+}
+
+/*
+ * Cancels the operation of the socket being closed. The
+ * completions still to come are ignored, but for the
+ * buffers they carry, which go back to the ring.
+ */
+void
+uring_poller::detach(sock_t s, feed *f)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	std::unordered_map<sock_t, stream>::iterator I = m_streams.find(s);
+	if ((I == m_streams.end()) || (I->second.f.get() != f))
+		return;
+
+	cancel(s, I->second);
+	if (I->second.listening && I->second.armed)
+		m_orphans.insert(uring_data(s, I->second.gen));
+	m_streams.erase(I);
+	m_candidates.erase(s);
+
+	if (std::this_thread::get_id() != m_thread.load())
+		flush();
+}
+
+/*
+ * Restarts the receive, stopped when the feed was over its
+ * limit, once the feed is within it. If the receive is still
+ * being cancelled, it is restarted on its last completion.
+ */
+void
+uring_poller::resume(sock_t s, feed *f)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	std::unordered_map<sock_t, stream>::iterator I = m_streams.find(s);
+	if ((I == m_streams.end()) || (I->second.f.get() != f))
+		return;
+
+	stream &st = I->second;
+	if (!st.paused || (f->bytes() > feed::LIMIT))
+		return;
+
+	st.paused = false;
+	f->paused = false;
+	if (!st.armed)
+		arm(s, st);
+
+	if (std::this_thread::get_id() != m_thread.load())
+		flush();
+}
+
+/*
+ * Re-arms the sockets that fired, submits the queued requests
+ * and waits for the completions in one io_uring_enter(), then
+ * collects the sockets that are ready. The completions of the
+ * multishot operations are queued in the feeds, and the sockets
+ * attached are ready for read as long as their feeds are not
+ * empty (level triggered).
+ */
+int
+uring_poller::wait(std::vector<pollfd> &ready, int to, int *oserr)
+{
+	struct completion
+	{
+		sock_t                  s;
+		std::shared_ptr<feed>   f;
+		bool                    listening;
+		int                     res;
+		iobuf                   buf;
+	};
+
+	if (oserr)
+		*oserr = 0;
+
+	m_thread = std::this_thread::get_id();
+
+	unsigned to_submit;
+
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+
+		for (auto s : m_fired) {
+			std::unordered_map<sock_t, registration>::iterator I = m_regs.find(s);
+			if ((I != m_regs.end()) && !I->second.armed)
+				arm(s, I->second);
+		}
+		m_fired.clear();
+
+		// Do not wait if a socket attached is ready already.
+		for (sock_t s : m_candidates) {
+			if (is_ready(s)) {
+				to = 0;
+				break;
+			}
+		}
+
+		to_submit = m_queued;
+		m_queued = 0;
+	}
+
+	__kernel_timespec ts;
+	io_uring_getevents_arg arg;
+	memset(&arg, 0, sizeof(arg));
+	arg.sigmask_sz = _NSIG / 8;
+	if (to >= 0) {
+		ts.tv_sec = to / 1000;
+		ts.tv_nsec = (to % 1000) * 1000000LL;
+		arg.ts = reinterpret_cast<uint64_t>(&ts);
+	}
+
+	int error = enter(to_submit, (to == 0) ? 0 : 1,
+			IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+	if ((error != 0) && (error != ETIME) && (error != EBUSY)) {
+		if (oserr) *oserr = error;
+		return SOCKET_ERROR;
+	}
+
+	int nready = 0;
+	std::vector<completion> done;
+
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+
+		unsigned head = *m_cq_head;
+		unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+
+		for (; head != tail; ++head) {
+			const io_uring_cqe *cqe = &m_cqes[head & m_cq_mask];
+			if (cqe->user_data == URING_REMOVE)
+				continue;
+
+			sock_t s = static_cast<sock_t>(cqe->user_data & 0xffffffffULL);
+			uint32_t gen = static_cast<uint32_t>(cqe->user_data >> 32);
+
+			std::unordered_map<sock_t, registration>::iterator I = m_regs.find(s);
+			if ((I != m_regs.end()) && (I->second.gen == gen)) {
+				I->second.armed = false;
+				m_fired.push_back(s);
+
+				short revents;
+				if (cqe->res >= 0)
+					revents = static_cast<short>(cqe->res);
+				else if (cqe->res == -EBADF)
+					revents = POLLNVAL;
+				else
+					revents = POLLERR;
+
+				pollfd fdelem = { s, 0, revents };
+				ready.push_back(fdelem);
+				nready++;
+				continue;
+			}
+
+			// The buffer filled is taken out of the ring, even if
+			// the socket is gone, and a new one is provided.
+			iobuf buf;
+			if (cqe->flags & IORING_CQE_F_BUFFER) {
+				uint16_t bid = static_cast<uint16_t>(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+				buf = std::move(m_br_bufs[bid]);
+				if (cqe->res > 0)
+					buf.commit(cqe->res);
+				provide(bid);
+			}
+
+			// A connection accepted after the listening socket
+			// was closed is closed too.
+			std::unordered_set<uint64_t>::iterator O = m_orphans.find(cqe->user_data);
+			if (O != m_orphans.end()) {
+				if (cqe->res >= 0)
+					::close(static_cast<sock_t>(cqe->res));
+				if (!(cqe->flags & IORING_CQE_F_MORE))
+					m_orphans.erase(O);
+				continue;
+			}
+
+			std::unordered_map<sock_t, stream>::iterator S = m_streams.find(s);
+			if ((S == m_streams.end()) || (S->second.gen != gen))
+				continue;
+
+			stream &st = S->second;
+			int res = cqe->res;
+
+			// Out of buffers for the moment, or stopped.
+			if ((res != -ENOBUFS) && (res != -ECANCELED)) {
+				completion c = { s, st.f, st.listening, res, std::move(buf) };
+				done.push_back(std::move(c));
+			}
+
+			if (!(cqe->flags & IORING_CQE_F_MORE)) {
+				st.armed = false;
+
+				// Re-armed, unless paused or at the end of the data.
+				bool ended = !st.listening && (res <= 0) &&
+					(res != -ENOBUFS) && (res != -ECANCELED);
+				if (!ended && !st.paused)
+					arm(s, st);
+			}
+		}
+
+		__atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+	}
+
+	for (completion &c : done) {
+		if (c.listening) {
+			if (c.res >= 0)
+				c.f->push(static_cast<sock_t>(c.res));
+			else
+				c.f->push_error(-c.res);
+		} else if (c.res > 0) {
+			c.f->push(std::move(c.buf));
+		} else if (c.res == 0) {
+			c.f->push_eof();
+		} else {
+			c.f->push_error(-c.res);
+		}
+	}
+
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	for (completion &c : done) {
+		std::unordered_map<sock_t, stream>::iterator S = m_streams.find(c.s);
+		if ((S == m_streams.end()) || (S->second.f != c.f))
+			continue;
+
+		m_candidates.insert(c.s);
+
+		/*
+		 * Stop receiving while the feed is over its limit. The
+		 * socket sees the flag before it takes the data queued,
+		 * or the feed is seen within the limit here.
+		 */
+		stream &st = S->second;
+		if (!st.listening && !st.paused && (st.f->bytes() > feed::LIMIT)) {
+			st.f->paused = true;
+			if (st.f->bytes() > feed::LIMIT) {
+				st.paused = true;
+				cancel(c.s, st);
+			} else {
+				st.f->paused = false;
+			}
+		}
+	}
+
+	for (std::unordered_set<sock_t>::iterator C = m_candidates.begin(); C != m_candidates.end(); ) {
+		if (is_ready(*C)) {
+			pollfd fdelem = { *C, 0, POLLRD };
+			ready.push_back(fdelem);
+			nready++;
+			++C;
+		} else {
+			C = m_candidates.erase(C);
+		}
+	}
+
+	return nready;
+}
+
+#endif // SNF_HAVE_IO_URING
+
+} // namespace internal
+} // namespace net
+} // namespace snf
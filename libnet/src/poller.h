@@ -0,0 +1,268 @@
+#ifndef _SNF_POLLER_H_
+#define _SNF_POLLER_H_
+
+#include "net.h"
+#include "reactor.h"
+#include "feed.h"
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <mutex>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <atomic>
+#include <thread>
+// Multishot receive, and so the rest used here, came with Linux 6.0.
+#if defined(IORING_RECV_MULTISHOT)
+#define SNF_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+#endif
+
+namespace snf {
+namespace net {
+namespace internal {
+
+/*
+ * Event notification mechanism used by the reactor. The
+ * registrations are persistent: the interest set of a
+ * socket changes only when the reactor changes it, and
+ * wait() returns only the sockets that are ready.
+ *
+ * set() is called with the reactor lock held, possibly
+ * from a thread other than the reactor thread. wait()
+ * is only called from the reactor thread.
+ */
+class poller
+{
+public:
+	virtual ~poller() {}
+
+	/*
+	 * Returns a readable poller name.
+	 */
+	virtual const char *name() const = 0;
+
+	/*
+	 * Does the reactor thread have to be woken up to
+	 * pick up a change in the interest set?
+	 */
+	virtual bool needs_wakeup() const = 0;
+
+	/*
+	 * Sets the events (POLLRD/POLLWR) of interest for the
+	 * socket. An empty set removes the socket.
+	 *
+	 * @param [in] s       - socket ID.
+	 * @param [in] events  - events of interest.
+	 * @param [in] refresh - the socket may have been closed and
+	 *                       a new one opened with the same ID
+	 *                       since it was last set.
+	 *
+	 * @throws std::system_error in case of failure.
+	 */
+	virtual void set(sock_t s, short events, bool refresh) = 0;
+
+	/*
+	 * Waits for the sockets to be ready.
+	 *
+	 * @param [out] ready - ready sockets, with revents set.
+	 * @param [in]  to    - timeout in milliseconds.
+	 *                      POLL_WAIT_FOREVER for inifinite wait.
+	 *                      POLL_WAIT_NONE for no wait.
+	 * @param [out] oserr - system error in case of failure.
+	 *
+	 * @return >= 0 indicating the number of sockets that are ready,
+	 *         SOCKET_ERROR in case of failure.
+	 */
+	virtual int wait(std::vector<pollfd> &ready, int to, int *oserr) = 0;
+
+	/*
+	 * Starts the multishot operation on the socket: accepting the
+	 * connections on a listening socket, or receiving the data on
+	 * a connected socket. The completions are queued in the feed
+	 * returned, and the socket is ready for read (if registered
+	 * for it) while the feed is not empty. Called before the
+	 * socket is registered.
+	 *
+	 * @param [in] s         - socket ID.
+	 * @param [in] listening - is it a listening socket?
+	 *
+	 * @return the feed, nullptr if the poller is readiness based.
+	 *
+	 * @throws std::system_error in case of failure.
+	 */
+	virtual std::shared_ptr<feed> attach(sock_t s, bool listening) { return nullptr; }
+
+	/*
+	 * Cancels the operation of the socket being closed. Called
+	 * with the feed lock held.
+	 */
+	virtual void detach(sock_t, feed *) {}
+
+	/*
+	 * Restarts receiving, stopped when the feed was over its
+	 * limit. Called with the feed lock held.
+	 */
+	virtual void resume(sock_t, feed *) {}
+
+	static poller *create(poller_type);
+};
+
+/*
+ * poll() based poller. The pollfd vector is maintained
+ * incrementally and is copied for the reactor thread only
+ * when the interest set changes.
+ */
+class poll_poller : public poller
+{
+private:
+	std::mutex                          m_lock;
+	std::vector<pollfd>                 m_fds;
+	std::unordered_map<sock_t, size_t>  m_index;
+	bool                                m_changed = false;
+	std::vector<pollfd>                 m_pollfds;
+
+public:
+	poll_poller() {}
+	virtual ~poll_poller() {}
+
+	virtual const char *name() const override { return "poll"; }
+	virtual bool needs_wakeup() const override { return true; }
+	virtual void set(sock_t, short, bool) override;
+	virtual int wait(std::vector<pollfd> &, int, int *) override;
+};
+
+#if defined(__linux__)
+
+/*
+ * epoll() based poller. The sockets are registered level
+ * triggered, so a handler need not drain the socket.
+ */
+class epoll_poller : public poller
+{
+private:
+	int                                 m_epfd;
+	std::unordered_map<sock_t, short>   m_events;
+	std::vector<epoll_event>            m_evvec;
+
+public:
+	epoll_poller();
+	virtual ~epoll_poller();
+
+	virtual const char *name() const override { return "epoll"; }
+	virtual bool needs_wakeup() const override { return false; }
+	virtual void set(sock_t, short, bool) override;
+	virtual int wait(std::vector<pollfd> &, int, int *) override;
+};
+
+#endif // __linux__
+
+#if defined(SNF_HAVE_IO_URING)
+
+/*
+ * io_uring based poller. The interest set is kept as one-shot
+ * poll requests in the submission ring. A request that fires is
+ * re-armed on the next wait(), so the sockets are level triggered
+ * as with epoll. The requests queued by the reactor thread (the
+ * handlers changing their interest, and the re-arms) are submitted
+ * with the wait itself: a loop iteration is one io_uring_enter()
+ * however many sockets fired or changed. The changes from other
+ * threads are submitted right away.
+ *
+ * The sockets attached run a multishot accept, or a multishot
+ * receive into the ring of buffers provided to the kernel, in
+ * place of the poll request for read: they are ready for read
+ * while their feed is not empty. A buffer filled is handed to
+ * the feed as it is, and a new one is provided in its place.
+ */
+class uring_poller : public poller
+{
+private:
+	struct registration
+	{
+		short       events;     // events of interest
+		uint32_t    gen;        // generation of the poll request
+		bool        armed;      // poll request in flight
+	};
+
+	struct stream
+	{
+		std::shared_ptr<feed>   f;          // completions
+		bool                    listening;  // accept or receive?
+		uint32_t                gen;        // generation of the operation
+		bool                    armed;      // operation in flight
+		bool                    paused;     // receive stopped, feed over its limit
+	};
+
+	int                                         m_fd;
+	void                                        *m_sq_ring = nullptr;
+	size_t                                      m_sq_ring_size = 0;
+	void                                        *m_cq_ring = nullptr;
+	size_t                                      m_cq_ring_size = 0;
+	io_uring_sqe                                *m_sqes = nullptr;
+	size_t                                      m_sqes_size = 0;
+	unsigned                                    *m_sq_head;
+	unsigned                                    *m_sq_tail;
+	unsigned                                    *m_sq_array;
+	unsigned                                    m_sq_mask;
+	unsigned                                    m_sq_entries;
+	unsigned                                    *m_cq_head;
+	unsigned                                    *m_cq_tail;
+	unsigned                                    m_cq_mask;
+	io_uring_cqe                                *m_cqes;
+
+	std::mutex                                  m_lock;
+	std::unordered_map<sock_t, registration>    m_regs;
+	std::vector<sock_t>                         m_fired;
+	uint32_t                                    m_gen = 0;
+	unsigned                                    m_queued = 0;
+	std::atomic<std::thread::id>                m_thread;
+
+	io_uring_buf_ring                           *m_br = nullptr;
+	size_t                                      m_br_size = 0;
+	uint16_t                                    m_br_tail = 0;
+	std::vector<iobuf>                          m_br_bufs;  // provided buffers by ID
+	std::unordered_map<sock_t, stream>          m_streams;
+	std::unordered_set<sock_t>                  m_candidates;   // streams that may be ready
+	std::unordered_set<uint64_t>                m_orphans;      // accepts cancelled, in flight
+
+	void unmap();
+	int enter(unsigned, unsigned, unsigned, const void *, size_t);
+	io_uring_sqe *get_sqe();
+	void queue();
+	void flush();
+	void arm(sock_t, registration &);
+	void disarm(const registration &, sock_t);
+	void setup_buffers();
+	void provide(uint16_t);
+	void arm(sock_t, stream &);
+	void cancel(sock_t, const stream &);
+	bool is_ready(sock_t);
+
+public:
+	uring_poller();
+	virtual ~uring_poller();
+
+	virtual const char *name() const override { return "io_uring"; }
+	virtual bool needs_wakeup() const override { return false; }
+	virtual void set(sock_t, short, bool) override;
+	virtual int wait(std::vector<pollfd> &, int, int *) override;
+	virtual std::shared_ptr<feed> attach(sock_t, bool) override;
+	virtual void detach(sock_t, feed *) override;
+	virtual void resume(sock_t, feed *) override;
+};
+
+#endif // SNF_HAVE_IO_URING
+
+} // namespace internal
+} // namespace net
+} // namespace snf
+
+#endif // _SNF_POLLER_H_
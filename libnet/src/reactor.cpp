@@ -1,6 +1,8 @@
 #include "net.h"
 #include "reactor.h"
+#include "poller.h"
 #include "logger.h"
+#include <thread>
 
 namespace snf {
 namespace net {
@@ -41,140 +43,358 @@ public:
 };
 
 /*
- * Prepares the poll vector to be used with poll()
- * system call by iterating over the registered
- * handlers.
+ * Sets the events of interest for the socket with
+ * the poller. The handlers removed while running do
+ * not count.
+ *
+ * @param [in] s       - socket ID.
+ * @param [in] eivec   - handlers registered for the socket.
+ * @param [in] refresh - force the registration with the
+ *                       poller.
+ */
+void
+reactor::set_interest(sock_t s, const ev_info_type &eivec, bool refresh)
+{
+	short events = 0;
+
+	for (auto &ei : eivec)
+		if (!ei->removed)
+			events |= static_cast<short>(ei->e);
+
+	m_poller->set(s, events, refresh);
+}
+
+/*
+ * Schedules the timeout timer of the handler for its
+ * expiration, replacing the current one if any. Must
+ * be called with the lock held.
+ *
+ * @param [in] s  - socket ID.
+ * @param [in] ei - handler.
  */
-std::vector<pollfd>
-reactor::set_poll_vector()
+void
+reactor::set_timeout(sock_t s, ev_info *ei)
 {
-	std::vector<pollfd> poll_vec;
+	cancel_timeout(ei);
+
+	if (ei->to != std::chrono::milliseconds::zero()) {
+		uint64_t id = ei->id;
+		ei->timer = m_timers.schedule(ei->exp, [this, s, id] () { handler_timeout(s, id); });
+	}
+}
+
+/*
+ * Cancels the timeout timer of the handler. Must be
+ * called with the lock held.
+ *
+ * @param [in] ei - handler.
+ */
+void
+reactor::cancel_timeout(ev_info *ei)
+{
+	if (ei->timer != INVALID_TIMER) {
+		m_timers.cancel(ei->timer);
+		ei->timer = INVALID_TIMER;
+	}
+}
+
+/*
+ * Calls the handlers, that are marked busy, without
+ * holding the lock. Depending on the return value of
+ * the handler, the handler is re-registered or removed.
+ * A handler removed or replaced while it was running
+ * is removed or replaced now.
+ *
+ * @param [in] s     - socket ID.
+ * @param [in] fired - handlers to call and the event
+ *                     to pass to them.
+ */
+void
+reactor::dispatch(sock_t s, ev_fired_type &fired)
+{
+	std::vector<bool> result(fired.size(), false);
+
+	for (size_t i = 0; i < fired.size(); ++i) {
+		try {
+			result[i] = (*fired[i].first->h)(s, fired[i].second);
+		} catch (std::exception &ex) {
+			ERROR_STRM("reactor")
+				<< "handler " << fired[i].first->h->name()
+				<< " for socket " << s
+				<< " failed: " << ex.what()
+				<< snf::log::record::endl;
+		}
+	}
+
+	clock_type::time_point now = clock_type::now();
 
 	std::lock_guard<std::mutex> guard(m_lock);
 
-	for (auto &h : m_handlers) {
-		pollfd fdelem = { h.first, 0, 0 };
-		for (auto &ei : h.second) {
-			switch (ei->e) {
-				case event::read:
-				case event::write:
-					fdelem.events |= static_cast<short>(ei->e);
-					break;
-
-				default:
-					break;
+	ev_handler_type::iterator H = m_handlers.find(s);
+	if (H == m_handlers.end())
+		return;
+
+	for (size_t i = 0; i < fired.size(); ++i) {
+		ev_info *ei = fired[i].first;
+		bool ok = result[i];
+
+		ei->busy = false;
+
+		if (ei->removed) {
+			ok = false;
+		} else if (ei->next) {
+			ei->h = std::move(ei->next);
+			ok = true;
+		}
+
+		if (ok) {
+			/*
+			 * The expiration is pushed out; a pending timer
+			 * finds it out when it expires, and is scheduled
+			 * again for the new expiration.
+			 */
+			if (ei->to != std::chrono::milliseconds::zero()) {
+				ei->exp = now + ei->to;
+				if (ei->timer == INVALID_TIMER)
+					set_timeout(s, ei);
 			}
+		} else {
+			ei->removed = true;
 		}
+	}
+
+	ev_info_type::iterator E = H->second.begin();
+	while (E != H->second.end()) {
+		if ((*E)->removed && !(*E)->busy) {
+			DEBUG_STRM("reactor")
+				<< "removed " << eventstr((*E)->e)
+				<< " handler " << (*E)->h->name()
+				<< " for socket " << s
+				<< snf::log::record::endl;
 
-		if (fdelem.events != 0)
-			poll_vec.push_back(fdelem);
+			cancel_timeout(E->get());
+			E = H->second.erase(E);
+		} else {
+			++E;
+		}
 	}
 
-	return poll_vec;
+	set_interest(s, H->second);
+
+	if (H->second.empty()) {
+		m_handlers.erase(H);
+
+		DEBUG_STRM("reactor")
+			<< "all handlers for socket " << s
+			<< " are removed"
+			<< snf::log::record::endl;
+	}
 }
 
 /*
- * Process the poll vector after call to poll() system call.
- * Calls the registered handlers when the socket is ready.
- * Depending on the return value of the handler, the handler
- * is re-registered or removed.
+ * Processes a ready socket. Picks the handlers
+ * interested in the events received and calls them.
+ *
+ * @param [in] fdelem - ready socket and the events.
  */
 void
-reactor::process_poll_vector(std::vector<pollfd> &poll_vec)
+reactor::process_ready(const pollfd &fdelem)
 {
-	std::chrono::system_clock::time_point now = 
-		std::chrono::system_clock::now();
+	ev_fired_type fired;
 
-	for (auto &fdelem : poll_vec) {
+	{
 		std::lock_guard<std::mutex> guard(m_lock);
 
-		ev_handler_type::iterator H;
-		H = m_handlers.find(fdelem.fd);
-		if (H != m_handlers.end()) {
-			ev_info_type::iterator E = H->second.begin();
-			while (E != H->second.end()) {
-				std::unique_ptr<ev_info> &uptr = *E;
-				bool ok = true;
-
-				if (fdelem.revents != 0) {
-					short e = static_cast<short>(uptr->e);
-
-					if (fdelem.revents & POLLERR) {
-						ok = (*uptr->h)(fdelem.fd, event::error);
-					} else if (fdelem.revents & POLLHUP) {
-						ok = (*uptr->h)(fdelem.fd, event::hup);
-					} else if (fdelem.revents & POLLNVAL) {
-						ok = (*uptr->h)(fdelem.fd, event::invalid);
-					} else if (fdelem.revents & e) {
-						ok = (*uptr->h)(fdelem.fd, uptr->e);
-						if (ok && (uptr->to != std::chrono::milliseconds::zero()))
-							uptr->exp = now + uptr->to;
-					}
-				} else {
-					if (now > uptr->exp)
-						ok = (*uptr->h)(fdelem.fd, event::timeout);
-				}
-
-				if (!ok) {
-					E = H->second.erase(E);
-
-					DEBUG_STRM("reactor")
-						<< "removed " << eventstr(uptr->e)
-						<< " handler " << uptr->h->name()
-						<< " for socket " << fdelem.fd
-						<< snf::log::record::endl;
-				} else {
-					++E;
-				}
-			}
+		ev_handler_type::iterator H = m_handlers.find(fdelem.fd);
+		if (H == m_handlers.end())
+			return;
 
-			if (H->second.empty()) {
-				m_handlers.erase(fdelem.fd);
+		for (auto &ei : H->second) {
+			if (ei->removed || ei->busy)
+				continue;
+
+			short e = static_cast<short>(ei->e);
+
+			if (fdelem.revents & POLLERR)
+				fired.emplace_back(ei.get(), event::error);
+			else if (fdelem.revents & POLLHUP)
+				fired.emplace_back(ei.get(), event::hup);
+			else if (fdelem.revents & POLLNVAL)
+				fired.emplace_back(ei.get(), event::invalid);
+			else if (fdelem.revents & e)
+				fired.emplace_back(ei.get(), ei->e);
+			else
+				continue;
+
+			ei->busy = true;
+		}
+	}
 
-				DEBUG_STRM("reactor")
-					<< "all handlers for socket " << fdelem.fd
-					<< " are removed"
-					<< snf::log::record::endl;
+	if (!fired.empty())
+		dispatch(fdelem.fd, fired);
+}
+
+/*
+ * Called when the timeout timer of a handler expires. If
+ * the handler has been active since the timer was set, the
+ * timer is set again for the new expiration. Otherwise the
+ * handler is called with the timeout event.
+ *
+ * @param [in] s  - socket ID.
+ * @param [in] id - handler registration ID.
+ */
+void
+reactor::handler_timeout(sock_t s, uint64_t id)
+{
+	ev_fired_type fired;
+
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+
+		ev_handler_type::iterator H = m_handlers.find(s);
+		if (H == m_handlers.end())
+			return;
+
+		ev_info *ei = nullptr;
+		for (auto &uptr : H->second) {
+			if (uptr->id == id) {
+				ei = uptr.get();
+				break;
 			}
 		}
+
+		if (ei == nullptr)
+			return;
+
+		ei->timer = INVALID_TIMER;
+
+		if (ei->removed || ei->busy || (ei->to == std::chrono::milliseconds::zero()))
+			return;
+
+		if (ei->exp > clock_type::now()) {
+			set_timeout(s, ei);
+			return;
+		}
+
+		ei->busy = true;
+		fired.emplace_back(ei, event::timeout);
+	}
+
+	dispatch(s, fired);
+}
+
+/*
+ * Expires the timers and calls their callbacks, and the
+ * posted callbacks, without holding the lock.
+ */
+void
+reactor::process_timers()
+{
+	std::vector<timer_wheel::callback> due;
+
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		due.swap(m_posted);
+		if (!m_timers.empty())
+			m_timers.expire(clock_type::now(), due);
+	}
+
+	for (auto &cb : due) {
+		try {
+			cb();
+		} catch (std::exception &ex) {
+			ERROR_STRM("reactor")
+				<< "timer callback failed: " << ex.what()
+				<< snf::log::record::endl;
+		}
 	}
 }
 
+/*
+ * Gets the poll timeout: the reactor timeout or the
+ * time to the nearest timer expiration, whichever is
+ * earlier; no wait if there are callbacks posted.
+ */
+int
+reactor::next_timeout()
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	if (!m_posted.empty())
+		return POLL_WAIT_NONE;
+
+	int to = m_timers.next_timeout(clock_type::now());
+	if (to == POLL_WAIT_FOREVER)
+		return m_timeout;
+
+	if ((m_timeout == POLL_WAIT_FOREVER) || (to < m_timeout))
+		return to;
+	return m_timeout;
+}
+
+/*
+ * Wakes up the reactor thread.
+ */
+void
+reactor::wakeup()
+{
+	m_sockpair[1].write_integral(1);
+}
+
 /*
  * Starts the reactor.
  *
- * @throws std::system_error in case of poll() system call failure.
+ * @throws std::system_error in case of poll()/epoll_wait()
+ *         system call failure.
  */
 void
 reactor::start()
 {
+	std::vector<pollfd> ready;
+
+	m_thread = std::this_thread::get_id();
+
 	while (!m_stopped) {
-		std::vector<pollfd> poll_vec = std::move(set_poll_vector());
 		int syserr = 0;
 
-		int nready = snf::net::poll(poll_vec, m_timeout, &syserr);
+		ready.clear();
+
+		int nready = m_poller->wait(ready, next_timeout(), &syserr);
 		if (SOCKET_ERROR == nready) {
+			std::ostringstream oss;
+			oss << m_poller->name() << " failed";
 			throw std::system_error(
 				syserr,
 				std::system_category(),
-				"poll failed");
-		} else if (nready > 0) {
-			process_poll_vector(poll_vec);
+				oss.str());
 		}
+
+		for (auto &fdelem : ready)
+			process_ready(fdelem);
+
+		process_timers();
 	}
 }
 
 /*
  * Constructs the reactor and starts it in a separate thread.
  *
- * @param [in]    to    - timeout in milliseconds.
- *                        POLL_WAIT_FOREVER for inifinite wait.
- *                        POLL_WAIT_NONE for no wait.
+ * @param [in] to   - timeout in milliseconds.
+ *                    POLL_WAIT_FOREVER for inifinite wait.
+ *                    POLL_WAIT_NONE for no wait.
+ * @param [in] type - poller type.
+ *
+ * @throws std::system_error if the poller could not be created.
  */
-reactor::reactor(int to)
+reactor::reactor(int to, poller_type type)
 	: m_timeout(to)
 	, m_sockpair(std::move(snf::net::socket::socketpair()))
+	, m_poller(internal::poller::create(type))
 {
+	DEBUG_STRM("reactor")
+		<< "using " << m_poller->name() << " poller"
+		<< snf::log::record::endl;
+
 	m_sockpair[0].blocking(false);
 	sock_t s = m_sockpair[0];
 
@@ -183,18 +403,96 @@ reactor::reactor(int to)
 	m_future = std::async(std::launch::async, &reactor::start, this);
 }
 
+reactor::~reactor()
+{
+	stop();
+	if (m_future.valid())
+		m_future.wait();
+}
+
+/*
+ * Gets the name of the poller in use.
+ */
+const char *
+reactor::poller_name() const
+{
+	return m_poller->name();
+}
+
 void
 reactor::stop()
 {
 	if (!m_stopped) {
 		m_stopped = true;
-		m_sockpair[1].write_integral(1);
+		wakeup();
 		m_future.wait();
 	}
 }
 
 /*
- * Adds/registers the event handler.
+ * Attaches the socket to the poller for the multishot
+ * operation, if the poller has it.
+ */
+bool
+reactor::attach(socket &s, bool listening)
+{
+	std::shared_ptr<internal::feed> f = m_poller->attach(s, listening);
+	if (!f)
+		return false;
+
+	s.m_feed = std::move(f);
+	return true;
+}
+
+/*
+ * Switches the listening socket to multishot accept, if the
+ * poller supports it (the io_uring poller, on Linux 6.0 or
+ * later): the kernel accepts the connections as they come,
+ * and socket::accept() takes them without a system call.
+ * The socket is ready for read while there are connections
+ * accepted. Call it before registering the accept handler.
+ *
+ * @param [in] s - listening socket.
+ *
+ * @return true if switched, false if the poller is
+ *         readiness based.
+ *
+ * @throws std::system_error in case of failure.
+ */
+bool
+reactor::accept_multishot(socket &s)
+{
+	return attach(s, true);
+}
+
+/*
+ * Switches the connected socket to multishot receive, if the
+ * poller supports it (the io_uring poller, on Linux 6.0 or
+ * later): the kernel receives the data as it comes into the
+ * buffers provided by the poller, and the socket reads take
+ * it from them without a system call; the buffered reads take
+ * the buffers as they are. The socket is ready for read while
+ * there is data (or end of file) received. Call it before
+ * registering the read handler. Not for the sockets read by
+ * other means, e.g. by OpenSSL.
+ *
+ * @param [in] s - connected socket.
+ *
+ * @return true if switched, false if the poller is
+ *         readiness based.
+ *
+ * @throws std::system_error in case of failure.
+ */
+bool
+reactor::recv_multishot(socket &s)
+{
+	return attach(s, false);
+}
+
+/*
+ * Adds/registers the event handler. If a handler is
+ * already registered for the socket and the event, it
+ * is replaced.
  *
  * @param [in] s  - socket ID.
  * @param [in] e  - event to wait for.
@@ -222,42 +520,46 @@ reactor::add_handler(sock_t s, event e, handler *h, int to)
 
 	std::lock_guard<std::mutex> guard(m_lock);
 
-	ev_handler_type::iterator H;
-	H = m_handlers.find(s);
-	if (H != m_handlers.end()) {
-		bool found = false;
-		for (auto &ei : H->second) {
-			if (ei->e == e) {
-				std::string old_handler = ei->h->name();
-				ei->h.reset(h);
-				found = true;
-
-				DEBUG_STRM("reactor")
-					<< "replaced " << eventstr(e)
-					<< " handler " << old_handler
-					<< " with handler " << ei->h->name()
-					<< " for socket " << s
-					<< snf::log::record::endl;
+	ev_info_type &eivec = m_handlers[s];
+	ev_info *ei = nullptr;
 
-				break;
-			}
+	for (auto &uptr : eivec) {
+		if ((uptr->e == e) && !uptr->removed) {
+			ei = uptr.get();
+			break;
 		}
+	}
 
-		if (!found) {
-			std::unique_ptr<ev_info> ei(new ev_info(e, to, h));
-			H->second.push_back(std::move(ei));
+	if (ei) {
+		std::string old_handler = ei->h->name();
 
-			DEBUG_STRM("reactor")
-				<< "added " << eventstr(e)
-				<< " handler " << h->name()
-				<< " for socket " << s
-				<< snf::log::record::endl;
+		if (ei->busy)
+			ei->next.reset(h);
+		else
+			ei->h.reset(h);
+
+		if (to <= 0) {
+			ei->to = std::chrono::milliseconds::zero();
+			ei->exp = clock_type::time_point::max();
+		} else {
+			ei->to = std::chrono::milliseconds{to};
+			ei->exp = clock_type::now() + ei->to;
 		}
+
+		set_timeout(s, ei);
+
+		DEBUG_STRM("reactor")
+			<< "replaced " << eventstr(e)
+			<< " handler " << old_handler
+			<< " with handler " << h->name()
+			<< " for socket " << s
+			<< snf::log::record::endl;
 	} else {
-		ev_info_type eivec;
-		std::unique_ptr<ev_info> ei(new ev_info(e, to, h));
-		eivec.push_back(std::move(ei));
-		m_handlers[s] = std::move(eivec);
+		std::unique_ptr<ev_info> uptr(new ev_info(e, to, h, ++m_next_id));
+		ei = uptr.get();
+		eivec.push_back(std::move(uptr));
+
+		set_timeout(s, ei);
 
 		DEBUG_STRM("reactor")
 			<< "added " << eventstr(e)
@@ -266,7 +568,11 @@ reactor::add_handler(sock_t s, event e, handler *h, int to)
 			<< snf::log::record::endl;
 	}
 
-	m_sockpair[1].write_integral(1);
+	set_interest(s, eivec, true);
+
+	if (m_poller->needs_wakeup() ||
+		((to > 0) && (std::this_thread::get_id() != m_thread)))
+		wakeup();
 }
 
 /*
@@ -279,14 +585,33 @@ reactor::remove_handler(sock_t s)
 {
 	std::lock_guard<std::mutex> guard(m_lock);
 
-	m_handlers.erase(s);
+	ev_handler_type::iterator H = m_handlers.find(s);
+	if (H == m_handlers.end())
+		return;
+
+	ev_info_type::iterator E = H->second.begin();
+	while (E != H->second.end()) {
+		cancel_timeout(E->get());
+		if ((*E)->busy) {
+			(*E)->removed = true;
+			++E;
+		} else {
+			E = H->second.erase(E);
+		}
+	}
+
+	set_interest(s, H->second);
+
+	if (H->second.empty())
+		m_handlers.erase(H);
 
 	DEBUG_STRM("reactor")
 		<< "all handlers for socket " << s
 		<< " are removed"
 		<< snf::log::record::endl;
 
-	m_sockpair[1].write_integral(1);
+	if (m_poller->needs_wakeup())
+		wakeup();
 }
 
 /*
@@ -300,37 +625,162 @@ reactor::remove_handler(sock_t s, event e)
 {
 	std::lock_guard<std::mutex> guard(m_lock);
 
-	ev_handler_type::iterator H;
-	H = m_handlers.find(s);
-	if (H != m_handlers.end()) {
-		ev_info_type::iterator E = H->second.begin();
-		while (E != H->second.end()) {
-			if ((*E)->e == e) {
-				DEBUG_STRM("reactor")
-					<< "removing " << eventstr(e)
-					<< " handler " << (*E)->h->name()
-					<< " for socket " << s
-					<< snf::log::record::endl;
+	ev_handler_type::iterator H = m_handlers.find(s);
+	if (H == m_handlers.end())
+		return;
+
+	ev_info_type::iterator E = H->second.begin();
+	while (E != H->second.end()) {
+		if (((*E)->e == e) && !(*E)->removed) {
+			DEBUG_STRM("reactor")
+				<< "removing " << eventstr(e)
+				<< " handler " << (*E)->h->name()
+				<< " for socket " << s
+				<< snf::log::record::endl;
 
+			cancel_timeout(E->get());
+			if ((*E)->busy)
+				(*E)->removed = true;
+			else
 				H->second.erase(E);
-				break;
-			}
-			++E;
+			break;
 		}
+		++E;
+	}
 
-		if (H->second.empty()) {
-			m_handlers.erase(s);
+	set_interest(s, H->second);
 
-			DEBUG_STRM("reactor")
-				<< "all handlers for socket " << s
-				<< " are removed"
-				<< snf::log::record::endl;
-		}
+	if (H->second.empty()) {
+		m_handlers.erase(H);
+
+		DEBUG_STRM("reactor")
+			<< "all handlers for socket " << s
+			<< " are removed"
+			<< snf::log::record::endl;
 	}
 
-	m_sockpair[1].write_integral(1);
+	if (m_poller->needs_wakeup())
+		wakeup();
 }
 
+/*
+ * Adds a general purpose timer. The callback is called once
+ * in the reactor thread, without holding the reactor lock,
+ * when the timer expires.
+ *
+ * @param [in] to - timeout in milliseconds.
+ * @param [in] cb - callback.
+ *
+ * @return the timer ID, that can be used to cancel the timer.
+ *
+ * @throws std::invalid_argument if the callback is not set.
+ */
+timer_id
+reactor::add_timer(int to, const timer_wheel::callback &cb)
+{
+	if (!cb)
+		throw std::invalid_argument("invalid timer callback");
+
+	timer_id id;
+
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		id = m_timers.schedule(
+			clock_type::now() + std::chrono::milliseconds((to > 0) ? to : 0),
+			cb);
+	}
+
+	if (std::this_thread::get_id() != m_thread)
+		wakeup();
+
+	return id;
+}
+
+/*
+ * Calls the callback once in the reactor thread, without
+ * holding the reactor lock, on the next turn of the event
+ * loop. Unlike a timer with no timeout, it does not wait for
+ * the next tick of the timer wheel.
+ *
+ * @param [in] cb - callback.
+ *
+ * @throws std::invalid_argument if the callback is not set.
+ */
+void
+reactor::post(const timer_wheel::callback &cb)
+{
+	if (!cb)
+		throw std::invalid_argument("invalid callback");
+
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_posted.push_back(cb);
+	}
+
+	if (std::this_thread::get_id() != m_thread)
+		wakeup();
+}
+
+/*
+ * Cancels the timer.
+ *
+ * @param [in] id - timer ID.
+ *
+ * @return true if the timer is cancelled, false if it has
+ *         expired or has been cancelled already.
+ */
+bool
+reactor::cancel_timer(timer_id id)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	return m_timers.cancel(id);
+}
+
+/*
+ * Constructs the reactor group and starts all the reactors.
+ *
+ * @param [in] n    - number of reactors. A value of <= 0 indicates
+ *                    one reactor per hardware thread.
+ * @param [in] to   - timeout in milliseconds for each reactor.
+ * @param [in] type - poller type for each reactor.
+ *
+ * @throws std::system_error if a poller could not be created.
+ */
+reactor_group::reactor_group(int n, int to, poller_type type)
+{
+	if (n <= 0) {
+		n = static_cast<int>(std::thread::hardware_concurrency());
+		if (n <= 0)
+			n = 1;
+	}
+
+	for (int i = 0; i < n; ++i)
+		m_reactors.emplace_back(new reactor(to, type));
+
+	DEBUG_STRM("reactor_group")
+		<< "started " << n << " reactors"
+		<< snf::log::record::endl;
+}
+
+/*
+ * Gets the next reactor in round robin order.
+ */
+reactor &
+reactor_group::next()
+{
+	size_t i = m_next.fetch_add(1, std::memory_order_relaxed);
+	return *m_reactors[i % m_reactors.size()];
+}
+
+/*
+ * Stops all the reactors.
+ */
+void
+reactor_group::stop()
+{
+	for (auto &r : m_reactors)
+		r->stop();
+}
 
 } // namespace net
 } // namespace snf
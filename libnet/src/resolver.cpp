@@ -0,0 +1,299 @@
+#include "resolver.h"
+#include <future>
+#include <stdexcept>
+
+namespace snf {
+namespace net {
+
+/*
+ * Makes the cache key for the lookup.
+ */
+std::string
+resolver::make_key(int family, socket_type type, const std::string &host, const std::string &svc)
+{
+	std::string key;
+	key.reserve(host.size() + svc.size() + 8);
+	key.append(std::to_string(family));
+	key.push_back((type == socket_type::tcp) ? 't' : 'u');
+	key.append(host);
+	key.push_back('\0');
+	key.append(svc);
+	return key;
+}
+
+/*
+ * Calls the completion callback in the waiter's reactor thread,
+ * or in the current thread if there is no reactor.
+ */
+void
+resolver::complete(const waiter &w, const std::error_code &ec, const addresses &addrs)
+{
+	if (w.r) {
+		callback cb = w.cb;
+		w.r->post([cb, ec, addrs] () { cb(ec, addrs); });
+	} else {
+		w.cb(ec, addrs);
+	}
+}
+
+/*
+ * Stores the lookup result in the cache. If the cache is full,
+ * the expired entries are dropped first and then, if needed,
+ * an arbitrary entry. The caller must hold the lock.
+ */
+void
+resolver::store(const std::string &key, const std::error_code &ec, const addresses &addrs)
+{
+	int ttl = ec ? m_negttl : m_ttl;
+	if ((ttl <= 0) || (m_max == 0))
+		return;
+
+	clock_type::time_point now = clock_type::now();
+
+	if ((m_cache.size() >= m_max) && (m_cache.find(key) == m_cache.end())) {
+		for (auto it = m_cache.begin(); it != m_cache.end(); ) {
+			if (it->second.exp <= now)
+				it = m_cache.erase(it);
+			else
+				++it;
+		}
+
+		if (m_cache.size() >= m_max)
+			m_cache.erase(m_cache.begin());
+	}
+
+	entry &e = m_cache[key];
+	e.ec = ec;
+	e.addrs = addrs;
+	e.exp = now + std::chrono::milliseconds(ttl);
+}
+
+/*
+ * Runs the lookup in the resolver thread, caches the result and
+ * completes all the waiters of the lookup.
+ */
+void
+resolver::lookup(const std::string &key, int family, socket_type type,
+	const std::string &host, const std::string &svc)
+{
+	lookup_function fcn;
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		fcn = m_lookup;
+	}
+
+	std::error_code ec;
+	addresses addrs;
+
+	try {
+		addrs = std::move(fcn(family, type, host, svc));
+	} catch (const std::system_error &ex) {
+		ec = ex.code();
+	} catch (const std::exception &) {
+		ec = std::make_error_code(std::errc::invalid_argument);
+	}
+
+	std::vector<waiter> waiters;
+
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		store(key, ec, addrs);
+
+		auto it = m_pending.find(key);
+		if (it != m_pending.end()) {
+			waiters = std::move(it->second);
+			m_pending.erase(it);
+		}
+	}
+
+	for (auto &w : waiters)
+		complete(w, ec, addrs);
+}
+
+/*
+ * Constructs the resolver.
+ *
+ * @param [in] nthreads   - number of resolver threads.
+ * @param [in] ttl        - time in milliseconds to cache the
+ *                          successful lookups. 0 disables it.
+ * @param [in] negttl     - time in milliseconds to cache the
+ *                          failed lookups. 0 disables it.
+ * @param [in] maxentries - maximum number of cached lookups.
+ *
+ * @throws std::invalid_argument if the number of threads is 0.
+ */
+resolver::resolver(size_t nthreads, int ttl, int negttl, size_t maxentries)
+	: m_lookup(static_cast<addresses (*)(int, socket_type, const std::string &,
+		const std::string &)>(&socket_address::get_client))
+	, m_ttl(ttl)
+	, m_negttl(negttl)
+	, m_max(maxentries)
+	, m_pool(nthreads ? nthreads : 1)
+{
+	if (nthreads == 0)
+		throw std::invalid_argument("invalid number of resolver threads");
+}
+
+/*
+ * Stops the resolver threads. The lookup in progress, if any,
+ * is waited for; the queued lookups are dropped.
+ */
+resolver::~resolver()
+{
+	m_pool.stop();
+}
+
+/*
+ * Sets the lookup function. The lookups already sent to the
+ * resolver threads may still use the previous function.
+ *
+ * @param [in] fcn - the lookup function.
+ *
+ * @throws std::invalid_argument if the function is not set.
+ */
+void
+resolver::set_lookup_function(const lookup_function &fcn)
+{
+	if (!fcn)
+		throw std::invalid_argument("invalid lookup function");
+
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_lookup = fcn;
+}
+
+/*
+ * Resolves the host and service asynchronously.
+ *
+ * @param [in] family - address family: AF_INET, AF_INET6
+ *                      or AF_UNSPEC.
+ * @param [in] type   - socket type.
+ * @param [in] host   - host name or address.
+ * @param [in] svc    - service name or port.
+ * @param [in] cb     - completion callback. It gets the lookup
+ *                      status and, on success, the addresses.
+ * @param [in] r      - reactor to call the callback in, or
+ *                      nullptr.
+ *
+ * @throws std::invalid_argument if the service or the callback
+ *         is not set.
+ */
+void
+resolver::resolve(int family, socket_type type, const std::string &host,
+	const std::string &svc, const callback &cb, reactor *r)
+{
+	if (svc.empty())
+		throw std::invalid_argument("service/port must be specified");
+
+	if (!cb)
+		throw std::invalid_argument("invalid resolver callback");
+
+	std::string key = std::move(make_key(family, type, host, svc));
+	std::error_code ec;
+	addresses addrs;
+
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+
+		auto cit = m_cache.find(key);
+		if (cit != m_cache.end()) {
+			if (cit->second.exp > clock_type::now()) {
+				ec = cit->second.ec;
+				addrs = cit->second.addrs;
+			} else {
+				m_cache.erase(cit);
+				cit = m_cache.end();
+			}
+		}
+
+		if (cit == m_cache.end()) {
+			auto pit = m_pending.find(key);
+			if (pit != m_pending.end()) {
+				pit->second.push_back(waiter { cb, r });
+			} else {
+				m_pending[key].push_back(waiter { cb, r });
+				m_pool.submit([this, key, family, type, host, svc] () {
+					lookup(key, family, type, host, svc);
+				});
+			}
+			return;
+		}
+	}
+
+	cb(ec, addrs);
+}
+
+/*
+ * Resolves the host and port asynchronously.
+ *
+ * @param [in] family - address family.
+ * @param [in] type   - socket type.
+ * @param [in] host   - host name or address.
+ * @param [in] port   - port.
+ * @param [in] cb     - completion callback.
+ * @param [in] r      - reactor to call the callback in, or
+ *                      nullptr.
+ *
+ * @throws std::invalid_argument if the callback is not set.
+ */
+void
+resolver::resolve(int family, socket_type type, const std::string &host,
+	in_port_t port, const callback &cb, reactor *r)
+{
+	resolve(family, type, host, std::to_string(port), cb, r);
+}
+
+/*
+ * Resolves the host and service, waiting for the result. It
+ * uses the cache and joins the lookup in progress, if any.
+ *
+ * @param [in] family - address family.
+ * @param [in] type   - socket type.
+ * @param [in] host   - host name or address.
+ * @param [in] svc    - service name or port.
+ *
+ * @return the addresses.
+ *
+ * @throws std::invalid_argument if the service is not set.
+ *         std::system_error if the lookup failed.
+ */
+resolver::addresses
+resolver::resolve(int family, socket_type type, const std::string &host, const std::string &svc)
+{
+	std::shared_ptr<std::promise<addresses>> p = std::make_shared<std::promise<addresses>>();
+	std::future<addresses> f = p->get_future();
+
+	resolve(family, type, host, svc,
+		[p, host] (const std::error_code &ec, const addresses &addrs) {
+			if (ec)
+				p->set_exception(std::make_exception_ptr(
+					std::system_error(ec, "failed to get address for " + host)));
+			else
+				p->set_value(addrs);
+		});
+
+	return f.get();
+}
+
+/*
+ * Gets the number of cached lookups, including the
+ * expired ones not yet dropped.
+ */
+size_t
+resolver::size()
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	return m_cache.size();
+}
+
+/*
+ * Drops all the cached lookups.
+ */
+void
+resolver::flush()
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_cache.clear();
+}
+
+} // namespace net
+} // namespace snf
@@ -319,11 +319,11 @@ socket_address::get_server(int family, socket_type type, const std::string &svc)
 
 	for (ptr = res; ptr != nullptr; ptr = ptr->ai_next) {
 		if (ptr->ai_family == AF_INET) {
-			sockaddr_in *sin = reinterpret_cast<sockaddr_in *>(res->ai_addr);
+			sockaddr_in *sin = reinterpret_cast<sockaddr_in *>(ptr->ai_addr);
 			socket_address sa { *sin };
 			sa_vec.push_back(sa);
-		} else if (res->ai_family == AF_INET6) {
-			sockaddr_in6 *sin6 = reinterpret_cast<sockaddr_in6 *>(res->ai_addr);
+		} else if (ptr->ai_family == AF_INET6) {
+			sockaddr_in6 *sin6 = reinterpret_cast<sockaddr_in6 *>(ptr->ai_addr);
 			socket_address sa { *sin6 };
 			sa_vec.push_back(sa);
 		}
@@ -398,11 +398,11 @@ socket_address::get_client(int family, socket_type type,
 
 	for (ptr = res; ptr != nullptr; ptr = ptr->ai_next) {
 		if (ptr->ai_family == AF_INET) {
-			sockaddr_in *sin = reinterpret_cast<sockaddr_in *>(res->ai_addr);
+			sockaddr_in *sin = reinterpret_cast<sockaddr_in *>(ptr->ai_addr);
 			socket_address sa { *sin };
 			sa_vec.push_back(sa);
-		} else if (res->ai_family == AF_INET6) {
-			sockaddr_in6 *sin6 = reinterpret_cast<sockaddr_in6 *>(res->ai_addr);
+		} else if (ptr->ai_family == AF_INET6) {
+			sockaddr_in6 *sin6 = reinterpret_cast<sockaddr_in6 *>(ptr->ai_addr);
 			socket_address sa { *sin6 };
 			sa_vec.push_back(sa);
 		}
@@ -0,0 +1,328 @@
+#include "sesscache.h"
+#include "error.h"
+#include <cstring>
+#include <sstream>
+#include <system_error>
+#include <stdexcept>
+
+namespace snf {
+namespace net {
+namespace ssl {
+
+static constexpr uint32_t CACHE_MAGIC = 0x53534e43;     // "SSNC"
+static constexpr uint32_t SLOT_MAGIC = 0x53455353;      // "SESS"
+
+/*
+ * Session cache file header.
+ */
+struct cache_header
+{
+	uint32_t    ch_magic;       // CACHE_MAGIC once initialized
+	int32_t     ch_buckets;     // number of buckets
+	int32_t     ch_slotsize;    // slot size
+	int32_t     ch_unused;
+};
+
+/*
+ * Slot header. The session ID follows the header
+ * and the session follows the session ID.
+ */
+struct slot_header
+{
+	uint32_t    sh_magic;       // SLOT_MAGIC if the slot is in use
+	uint32_t    sh_idlen;       // session ID length
+	uint32_t    sh_len;         // session length
+	uint32_t    sh_unused;
+	int64_t     sh_expire;      // epoch time when the session expires
+};
+
+/*
+ * Throws std::system_error for the failed file operation.
+ */
+static void
+throw_file_error(const char *what, const snf::file &f, int oserr)
+{
+	std::ostringstream oss;
+	oss << "failed to " << what << " session cache " << f.name();
+	if (oserr)
+		throw std::system_error(oserr, std::system_category(), oss.str());
+	throw std::runtime_error(oss.str());
+}
+
+/*
+ * Initializes the session cache file if it is not initialized
+ * with the same geometry. The header is locked while it is
+ * being checked so that one process does the initialization.
+ *
+ * @throws std::system_error or std::runtime_error on failure.
+ */
+void
+file_session_cache::init()
+{
+	int oserr = 0;
+	int bread = 0;
+	int bwritten = 0;
+	cache_header hdr;
+
+	if (m_file.lock(snf::file::lock_type::exclusive, 0, HEADER_SIZE, &oserr) != E_ok)
+		throw_file_error("lock", m_file, oserr);
+
+	memset(&hdr, 0, sizeof(hdr));
+	if ((m_file.read(0, &hdr, sizeof(hdr), &bread, &oserr) == E_ok) &&
+		(bread == sizeof(hdr)) &&
+		(hdr.ch_magic == CACHE_MAGIC) &&
+		(hdr.ch_buckets == m_buckets) &&
+		(hdr.ch_slotsize == m_slotsize)) {
+		m_file.unlock(0, HEADER_SIZE);
+		return;
+	}
+
+	// The slots of the new file are zero filled i.e. free.
+	int64_t fsize = HEADER_SIZE + static_cast<int64_t>(m_buckets) * bucket_size();
+	if ((m_file.truncate(0, &oserr) != E_ok) || (m_file.truncate(fsize, &oserr) != E_ok)) {
+		m_file.unlock(0, HEADER_SIZE);
+		throw_file_error("size", m_file, oserr);
+	}
+
+	hdr.ch_magic = CACHE_MAGIC;
+	hdr.ch_buckets = m_buckets;
+	hdr.ch_slotsize = m_slotsize;
+	hdr.ch_unused = 0;
+	if (m_file.write(0, &hdr, sizeof(hdr), &bwritten, &oserr) != E_ok) {
+		m_file.unlock(0, HEADER_SIZE);
+		throw_file_error("initialize", m_file, oserr);
+	}
+
+	m_file.unlock(0, HEADER_SIZE);
+}
+
+/*
+ * Gets the offset of the bucket for the session ID
+ * using the FNV-1a hash of the session ID. The low bits
+ * of FNV-1a only depend on the low bits of the input;
+ * so the high bits are folded in.
+ */
+int64_t
+file_session_cache::bucket_offset(const uint8_t *id, size_t idlen) const
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < idlen; ++i) {
+		h ^= id[i];
+		h *= 0x100000001b3ULL;
+	}
+	h ^= (h >> 32);
+	h ^= (h >> 16);
+
+	return HEADER_SIZE + static_cast<int64_t>(h % m_buckets) * bucket_size();
+}
+
+/*
+ * Reads the bucket. The caller must hold the bucket lock.
+ */
+bool
+file_session_cache::read_bucket(int64_t offset, std::vector<uint8_t> &bucket)
+{
+	int bread = 0;
+
+	bucket.resize(bucket_size());
+	if (m_file.read(offset, bucket.data(), bucket_size(), &bread) != E_ok)
+		return false;
+	return (bread == bucket_size());
+}
+
+/*
+ * Opens the session cache. The file is created if it does not
+ * exist. It is (re)initialized if it is not initialized with
+ * the same number of sessions and slot size; so all the
+ * processes must use the same values.
+ *
+ * @param [in] path      - session cache file path.
+ * @param [in] nsessions - number of sessions to hold.
+ * @param [in] slotsize  - slot size. It limits the session size.
+ *
+ * @throws std::invalid_argument if the number of sessions or the
+ *         slot size is not valid.
+ *         std::system_error or std::runtime_error if the file
+ *         could not be opened or initialized.
+ */
+file_session_cache::file_session_cache(const std::string &path, int nsessions, int slotsize)
+	: m_file(path, 0077)
+	, m_buckets((nsessions + SLOTS_PER_BUCKET - 1) / SLOTS_PER_BUCKET)
+	, m_slotsize(slotsize)
+{
+	static_assert(sizeof(cache_header) <= HEADER_SIZE, "session cache header is too large");
+	static_assert((sizeof(slot_header) + MAX_ID_SIZE) == SLOT_HEADER_SIZE, "unexpected slot header size");
+
+	if (nsessions <= 0)
+		throw std::invalid_argument("invalid number of sessions");
+
+	if ((slotsize <= SLOT_HEADER_SIZE) || (slotsize > (1 << 20)))
+		throw std::invalid_argument("invalid session cache slot size");
+
+	int oserr = 0;
+	snf::file::open_flags flags;
+	flags.o_read = true;
+	flags.o_write = true;
+	flags.o_create = true;
+
+	if (m_file.open(flags, 0600, &oserr) != E_ok)
+		throw_file_error("open", m_file, oserr);
+
+	init();
+}
+
+file_session_cache::~file_session_cache()
+{
+	m_file.close();
+}
+
+/*
+ * Adds the session to the cache. The slot is chosen in the order:
+ * the slot with the same session ID, a free or expired slot, and
+ * the slot expiring first.
+ *
+ * @return false if the session ID or the session is too large,
+ *         or if the file operation failed.
+ */
+bool
+file_session_cache::add(const uint8_t *id, size_t idlen, const uint8_t *data, size_t len, time_t expire)
+{
+	if ((id == nullptr) || (idlen == 0) || (idlen > MAX_ID_SIZE))
+		return false;
+
+	if ((data == nullptr) || (len == 0) || (len > static_cast<size_t>(m_slotsize - SLOT_HEADER_SIZE)))
+		return false;
+
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	int64_t offset = bucket_offset(id, idlen);
+	if (m_file.lock(snf::file::lock_type::exclusive, offset, bucket_size()) != E_ok)
+		return false;
+
+	std::vector<uint8_t> bucket;
+	if (!read_bucket(offset, bucket)) {
+		m_file.unlock(offset, bucket_size());
+		return false;
+	}
+
+	time_t now = time(0);
+	int victim = -1;
+	int64_t earliest = INT64_MAX;
+
+	for (int i = 0; i < SLOTS_PER_BUCKET; ++i) {
+		const slot_header *sh = reinterpret_cast<const slot_header *>(bucket.data() + i * m_slotsize);
+		const uint8_t *sid = reinterpret_cast<const uint8_t *>(sh + 1);
+
+		if ((sh->sh_magic == SLOT_MAGIC) && (sh->sh_idlen == idlen) && (memcmp(sid, id, idlen) == 0)) {
+			victim = i;
+			break;
+		}
+
+		int64_t exp = (sh->sh_magic == SLOT_MAGIC) ? sh->sh_expire : INT64_MIN;
+		if (exp < now)
+			exp = INT64_MIN;
+		if ((victim < 0) || (exp < earliest)) {
+			victim = i;
+			earliest = exp;
+		}
+	}
+
+	std::vector<uint8_t> slot(SLOT_HEADER_SIZE + len, 0);
+	slot_header *sh = reinterpret_cast<slot_header *>(slot.data());
+	sh->sh_magic = SLOT_MAGIC;
+	sh->sh_idlen = static_cast<uint32_t>(idlen);
+	sh->sh_len = static_cast<uint32_t>(len);
+	sh->sh_expire = static_cast<int64_t>(expire);
+	memcpy(slot.data() + sizeof(slot_header), id, idlen);
+	memcpy(slot.data() + SLOT_HEADER_SIZE, data, len);
+
+	int bwritten = 0;
+	int retval = m_file.write(offset + static_cast<int64_t>(victim) * m_slotsize,
+			slot.data(), static_cast<int>(slot.size()), &bwritten);
+
+	m_file.unlock(offset, bucket_size());
+	return (retval == E_ok);
+}
+
+/*
+ * Finds the session in the cache.
+ */
+bool
+file_session_cache::find(const uint8_t *id, size_t idlen, std::vector<uint8_t> &data)
+{
+	if ((id == nullptr) || (idlen == 0) || (idlen > MAX_ID_SIZE))
+		return false;
+
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	int64_t offset = bucket_offset(id, idlen);
+	if (m_file.lock(snf::file::lock_type::shared, offset, bucket_size()) != E_ok)
+		return false;
+
+	std::vector<uint8_t> bucket;
+	bool found = false;
+
+	if (read_bucket(offset, bucket)) {
+		time_t now = time(0);
+
+		for (int i = 0; i < SLOTS_PER_BUCKET; ++i) {
+			const uint8_t *ptr = bucket.data() + i * m_slotsize;
+			const slot_header *sh = reinterpret_cast<const slot_header *>(ptr);
+
+			if ((sh->sh_magic != SLOT_MAGIC) ||
+				(sh->sh_idlen != idlen) ||
+				(memcmp(ptr + sizeof(slot_header), id, idlen) != 0))
+				continue;
+
+			if ((sh->sh_expire >= now) &&
+				(sh->sh_len <= static_cast<uint32_t>(m_slotsize - SLOT_HEADER_SIZE))) {
+				data.assign(ptr + SLOT_HEADER_SIZE, ptr + SLOT_HEADER_SIZE + sh->sh_len);
+				found = true;
+			}
+			break;
+		}
+	}
+
+	m_file.unlock(offset, bucket_size());
+	return found;
+}
+
+/*
+ * Removes the session from the cache.
+ */
+void
+file_session_cache::remove(const uint8_t *id, size_t idlen)
+{
+	if ((id == nullptr) || (idlen == 0) || (idlen > MAX_ID_SIZE))
+		return;
+
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	int64_t offset = bucket_offset(id, idlen);
+	if (m_file.lock(snf::file::lock_type::exclusive, offset, bucket_size()) != E_ok)
+		return;
+
+	std::vector<uint8_t> bucket;
+	if (read_bucket(offset, bucket)) {
+		for (int i = 0; i < SLOTS_PER_BUCKET; ++i) {
+			const uint8_t *ptr = bucket.data() + i * m_slotsize;
+			const slot_header *sh = reinterpret_cast<const slot_header *>(ptr);
+
+			if ((sh->sh_magic == SLOT_MAGIC) &&
+				(sh->sh_idlen == idlen) &&
+				(memcmp(ptr + sizeof(slot_header), id, idlen) == 0)) {
+				uint32_t magic = 0;
+				int bwritten = 0;
+				m_file.write(offset + static_cast<int64_t>(i) * m_slotsize,
+					&magic, sizeof(magic), &bwritten);
+				break;
+			}
+		}
+	}
+
+	m_file.unlock(offset, bucket_size());
+}
+
+} // namespace ssl
+} // namespace net
+} // namespace snf
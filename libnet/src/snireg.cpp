@@ -0,0 +1,293 @@
+#include "snireg.h"
+#include "dbg.h"
+#include <algorithm>
+#include <cctype>
+
+/*
+ * Server name callback for the SNI context registry. It is set
+ * on the default SSL context by sni_registry::attach(). Switches
+ * the connection to the context registered for the server name.
+ *
+ * @param [in] ssl - raw SSL object.
+ * @param [in] arg - the SNI context registry.
+ *
+ * @return SSL_TLSEXT_ERR_OK if the context is switched or the
+ *         client did not present a server name,
+ *         SSL_TLSEXT_ERR_NOACK if no context is found for the
+ *         server name; the default context is used.
+ */
+extern "C" int
+sni_registry_cb(SSL *ssl, int *, void *arg)
+{
+	const snf::net::ssl::sni_registry *reg =
+		reinterpret_cast<const snf::net::ssl::sni_registry *>(arg);
+	if (reg == nullptr)
+		return SSL_TLSEXT_ERR_OK;
+
+	const char *name = snf::net::ssl::ssl_library::instance().ssl_get_servername()
+				(ssl, TLSEXT_NAMETYPE_host_name);
+	if ((name == nullptr) || (*name == '\0'))
+		return SSL_TLSEXT_ERR_OK;
+
+	snf::net::ssl::context *ctx = reg->find(name);
+	if (ctx == nullptr)
+		return SSL_TLSEXT_ERR_NOACK;
+
+	snf::net::ssl::ssl_library::instance().ssl_set_ssl_ctx()(ssl, *ctx);
+	return SSL_TLSEXT_ERR_OK;
+}
+
+namespace snf {
+namespace net {
+namespace ssl {
+
+/*
+ * Converts the server name to lower case and strips the
+ * trailing dot, if any.
+ */
+std::string
+sni_registry::normalize(const std::string &name)
+{
+	std::string n(name);
+	if (!n.empty() && (n.back() == '.'))
+		n.pop_back();
+	std::transform(n.begin(), n.end(), n.begin(),
+		[](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return n;
+}
+
+/*
+ * Inserts the name in the table, replacing the existing entry.
+ *
+ * @throws std::invalid_argument if the name is empty or is an
+ *         invalid wildcard name.
+ */
+void
+sni_registry::insert(table *t, const std::string &name, const context_ptr &ctx)
+{
+	std::string n = std::move(normalize(name));
+	if (n.empty())
+		throw std::invalid_argument("empty server name");
+
+	if (n[0] == '*') {
+		if ((n.size() < 3) || (n[1] != '.') || (n.find('*', 1) != std::string::npos))
+			throw std::invalid_argument("invalid wildcard server name " + name);
+		t->wildcard[n.substr(2)] = ctx;
+	} else {
+		t->exact[n] = ctx;
+	}
+}
+
+/*
+ * Gets the DNS names, common name and alternate names,
+ * from the certificate of the context.
+ *
+ * @throws snf::net::ssl::exception if the certificate could not
+ *         be retrieved.
+ */
+std::vector<std::string>
+sni_registry::names(context &ctx)
+{
+	std::vector<std::string> v;
+	x509_certificate cert = std::move(ctx.get_certificate());
+
+	if (!cert.common_name().empty())
+		v.push_back(cert.common_name());
+
+	for (auto &altname : cert.alternate_names())
+		if ((altname.type == "DNS") && !altname.name.empty())
+			v.push_back(altname.name);
+
+	return v;
+}
+
+/*
+ * Publishes the new table. The replaced table is retired. The
+ * caller must hold the update lock.
+ */
+void
+sni_registry::publish(table *t)
+{
+	const table *old = m_table.exchange(t, std::memory_order_acq_rel);
+	if (old)
+		m_retired.push_back(old);
+}
+
+sni_registry::sni_registry()
+	: m_table(DBG_NEW table)
+{
+}
+
+sni_registry::~sni_registry()
+{
+	delete m_table.load(std::memory_order_acquire);
+	for (auto t : m_retired)
+		delete t;
+}
+
+/*
+ * Adds the context for all the names in its certificate.
+ *
+ * @param [in] ctx - SSL context with the certificate set.
+ *
+ * @throws snf::net::ssl::exception if the certificate could not
+ *         be retrieved.
+ *         std::invalid_argument if the certificate has no name
+ *         or has an invalid name.
+ */
+void
+sni_registry::add(context &ctx)
+{
+	std::vector<context> v { ctx };
+	add(v);
+}
+
+/*
+ * Adds the contexts for all the names in their certificates. The
+ * table is copied once for all the contexts; so it is preferred
+ * to adding the contexts one by one.
+ *
+ * @param [in] ctxs - SSL contexts with the certificates set.
+ *
+ * @throws snf::net::ssl::exception if a certificate could not
+ *         be retrieved.
+ *         std::invalid_argument if a certificate has no name
+ *         or has an invalid name.
+ */
+void
+sni_registry::add(std::vector<context> &ctxs)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	std::unique_ptr<table> t(DBG_NEW table(*m_table.load(std::memory_order_acquire)));
+
+	for (auto &ctx : ctxs) {
+		std::vector<std::string> v = std::move(names(ctx));
+		if (v.empty())
+			throw std::invalid_argument("no server name in the certificate");
+
+		context_ptr cp = std::make_shared<context>(ctx);
+		for (auto &n : v)
+			insert(t.get(), n, cp);
+	}
+
+	publish(t.release());
+}
+
+/*
+ * Adds the context for the given name.
+ *
+ * @param [in] name - server name. It can be a wildcard name
+ *                    such as *.example.com.
+ * @param [in] ctx  - SSL context.
+ *
+ * @throws std::invalid_argument if the name is invalid.
+ */
+void
+sni_registry::add(const std::string &name, context &ctx)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	std::unique_ptr<table> t(DBG_NEW table(*m_table.load(std::memory_order_acquire)));
+	insert(t.get(), name, std::make_shared<context>(ctx));
+	publish(t.release());
+}
+
+/*
+ * Removes the name.
+ *
+ * @param [in] name - server name as added.
+ *
+ * @return true if the name is removed, false if not found.
+ */
+bool
+sni_registry::remove(const std::string &name)
+{
+	std::string n = std::move(normalize(name));
+
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	const table *cur = m_table.load(std::memory_order_acquire);
+	bool wild = ((n.size() > 2) && (n[0] == '*') && (n[1] == '.'));
+	const name_map &m = wild ? cur->wildcard : cur->exact;
+	const std::string key = wild ? n.substr(2) : n;
+
+	if (m.find(key) == m.end())
+		return false;
+
+	std::unique_ptr<table> t(DBG_NEW table(*cur));
+	if (wild)
+		t->wildcard.erase(key);
+	else
+		t->exact.erase(key);
+	publish(t.release());
+	return true;
+}
+
+/*
+ * Gets the number of names registered.
+ */
+size_t
+sni_registry::size() const
+{
+	const table *t = m_table.load(std::memory_order_acquire);
+	return t->exact.size() + t->wildcard.size();
+}
+
+/*
+ * Finds the context for the server name. Lock-free.
+ *
+ * @param [in] servername - server name presented by the TLS client.
+ *
+ * @return the context or nullptr if not found.
+ */
+context *
+sni_registry::find(const std::string &servername) const
+{
+	std::string n = std::move(normalize(servername));
+	const table *t = m_table.load(std::memory_order_acquire);
+
+	name_map::const_iterator it = t->exact.find(n);
+	if (it != t->exact.end())
+		return it->second.get();
+
+	std::string::size_type dot = n.find('.');
+	if ((dot == std::string::npos) || (dot == 0))
+		return nullptr;
+
+	it = t->wildcard.find(n.substr(dot + 1));
+	if (it != t->wildcard.end())
+		return it->second.get();
+
+	return nullptr;
+}
+
+/*
+ * Attaches the registry to the default SSL context i.e. sets the
+ * SNI callback on the context. The connections created with the
+ * context switch to the registered contexts during the handshake.
+ * Must be called before the connections are created. It replaces
+ * the SNI handling set using connection::enable_sni().
+ *
+ * @param [in] dflt - default SSL context.
+ *
+ * @throws snf::net::ssl::exception if the callback or argument
+ *         could not be set.
+ */
+void
+sni_registry::attach(context &dflt)
+{
+	if (ssl_library::instance().ssl_ctx_cb_ctrl()
+		(dflt, SSL_CTRL_SET_TLSEXT_SERVERNAME_CB,
+		reinterpret_cast<void (*)(void)>(sni_registry_cb)) != 1)
+		throw exception("failed to set SNI callback function");
+
+	if (ssl_library::instance().ssl_ctx_ctrl()
+		(dflt, SSL_CTRL_SET_TLSEXT_SERVERNAME_ARG, 0,
+		reinterpret_cast<void *>(this)) != 1)
+		throw exception("failed to set SNI callback argument");
+}
+
+} // namespace ssl
+} // namespace net
+} // namespace snf
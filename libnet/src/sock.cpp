@@ -1,10 +1,40 @@
 #include "sock.h"
 #include "ia.h"
 #include "error.h"
+#include "feed.h"
+
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#include <netinet/udp.h>
+#endif
 
 namespace snf {
 namespace net {
 
+/*
+ * Constructs the datagram to send to the address.
+ */
+datagram::datagram(const void *b, int l, const socket_address &sa)
+	: buf(const_cast<void *>(b))
+	, len(l)
+{
+	address(sa);
+}
+
+/*
+ * Sets the datagram address.
+ */
+void
+datagram::address(const socket_address &sa)
+{
+	memset(&addr, 0, sizeof(addr));
+	const sockaddr *p = sa.get_sa(&addrlen);
+	if (p)
+		memcpy(&addr, p, addrlen);
+	else
+		addrlen = 0;
+}
+
 const char *
 socket::optstr(int level, int optname)
 {
@@ -14,6 +44,9 @@ socket::optstr(int level, int optname)
 				case SO_TYPE: return "SO_TYPE";
 				case SO_KEEPALIVE: return "SO_KEEPALIVE";
 				case SO_REUSEADDR: return "SO_REUSEADDR";
+#if defined(SO_REUSEPORT)
+				case SO_REUSEPORT: return "SO_REUSEPORT";
+#endif
 				case SO_LINGER: return "SO_LINGER";
 				case SO_RCVBUF: return "SO_RCVBUF";
 				case SO_SNDBUF: return "SO_SNDBUF";
@@ -27,6 +60,11 @@ socket::optstr(int level, int optname)
 		case IPPROTO_TCP:
 			switch (optname) {
 				case TCP_NODELAY: return "TCP_NODELAY";
+#if defined(TCP_CORK)
+				case TCP_CORK: return "TCP_CORK";
+#elif defined(TCP_NOPUSH)
+				case TCP_NOPUSH: return "TCP_NOPUSH";
+#endif
 				default: break;
 			}
 			break;
@@ -152,6 +190,8 @@ socket::socket(sock_t s, bool skip_close)
 	} else {
 		throw std::invalid_argument("invalid socket type");
 	}
+
+	m_blocking = query_blocking();
 }
 
 /*
@@ -183,6 +223,26 @@ socket::socket(sock_t s, const sockaddr_storage &ss, socklen_t len)
 	}
 
 	m_peer = DBG_NEW socket_address(ss, len);
+
+#if !defined(__linux__)
+	// The accepted socket inherits the mode of the listening socket.
+	m_blocking = query_blocking();
+#endif
+}
+
+/*
+ * Constructs the accepted socket object, when the socket type
+ * and mode are already known, without querying them. If the
+ * peer address is not known (len is 0), it is queried when
+ * asked for.
+ */
+socket::socket(sock_t s, socket_type type, bool blk, const sockaddr_storage &ss, socklen_t len)
+	: m_sock(s)
+	, m_type(type)
+	, m_blocking(blk)
+{
+	if (len > 0)
+		m_peer = DBG_NEW socket_address(ss, len);
 }
 
 /*
@@ -250,9 +310,11 @@ socket::socket(socket &&s)
 	}
 
 	m_skip_close = s.m_skip_close;
+	m_blocking = s.m_blocking;
+	m_batched = s.m_batched;
+	m_feed = std::move(s.m_feed);
 
 #if defined(_WIN32)
-	m_blocking = s.m_blocking;
 	m_rcvtimeo = s.m_rcvtimeo;
 	m_sndtimeo = s.m_sndtimeo;
 #endif
@@ -309,9 +371,11 @@ socket::operator=(socket &&s)
 		}
 
 		m_skip_close = s.m_skip_close;
+		m_blocking = s.m_blocking;
+		m_batched = s.m_batched;
+		m_feed = std::move(s.m_feed);
 
 #if defined(_WIN32)
-		m_blocking = s.m_blocking;
 		m_rcvtimeo = s.m_rcvtimeo;
 		m_sndtimeo = s.m_sndtimeo;
 #endif
@@ -377,6 +441,49 @@ socket::reuseaddr(bool set)
 	setopt(SOL_SOCKET, SO_REUSEADDR, &value, vlen);
 }
 
+/*
+ * Determines if the socket option reuse port (SO_REUSEPORT) is set.
+ * The option is not available on all platforms.
+ *
+ * @return true if the option is set, false otherwise.
+ *
+ * @throws std::system_error if the socket option could not be fetched.
+ */
+bool
+socket::reuseport()
+{
+#if defined(SO_REUSEPORT)
+	int value = 0;
+	int vlen = static_cast<int>(sizeof(value));
+	getopt(SOL_SOCKET, SO_REUSEPORT, &value, &vlen);
+	return (value != 0);
+#else
+	return false;
+#endif
+}
+
+/*
+ * Enables/disables the socket option reuse port (SO_REUSEPORT).
+ * Multiple sockets, each with this option set, can be bound
+ * to the same port. On Linux, the incoming connections are
+ * distributed among the listening sockets.
+ *
+ * @throws std::system_error if the socket option could not be set.
+ *         std::runtime_error if the option is not available.
+ */
+void
+socket::reuseport(bool set)
+{
+#if defined(SO_REUSEPORT)
+	int value = set ? 1 : 0;
+	int vlen = static_cast<int>(sizeof(value));
+	setopt(SOL_SOCKET, SO_REUSEPORT, &value, vlen);
+#else
+	if (set)
+		throw std::runtime_error("SO_REUSEPORT is not available");
+#endif
+}
+
 /*
  * Gets the linger type. There are 3 possible return values:
  * - socket::linger_type::dflt  - When the socket is closed, close() returns immediately.
@@ -666,38 +773,271 @@ socket::tcpnodelay(bool nodelay)
 }
 
 /*
- * Determines if the socket is in blocking mode. Windows does
- * not support this option. So this function relies on a local variable
- * that holds the last mode.
+ * Determines if the tcp output is corked (TCP_CORK, or
+ * TCP_NOPUSH on BSD).
  *
- * @return true if socket is in blocking mode.
+ * @return true if the partial segments are held back.
  *
- * @throws std::system_error if the socket option could not be fetched.
+ * @throws std::system_error if the socket option could not be
+ *         retrieved or is not supported on the platform.
  */
 bool
-socket::blocking()
+socket::cork()
 {
-#if defined(_WIN32)
-	return m_blocking;
+#if defined(TCP_CORK) || defined(TCP_NOPUSH)
+	int value = 0;
+	int vlen = static_cast<int>(sizeof(value));
+#if defined(TCP_CORK)
+	getopt(IPPROTO_TCP, TCP_CORK, &value, &vlen);
 #else
-	int flags = fcntl(m_sock, F_GETFL, 0);
-	if (SOCKET_ERROR == flags) {
-		throw std::system_error(
-			snf::net::error(),
-			std::system_category(),
-			"failed to get socket flags");
-	}
+	getopt(IPPROTO_TCP, TCP_NOPUSH, &value, &vlen);
+#endif
+	return (value != 0);
+#else
+	throw std::system_error(
+		std::make_error_code(std::errc::operation_not_supported),
+		"TCP cork is not supported");
+#endif
+}
 
-	if ((flags & O_NONBLOCK) == O_NONBLOCK)
-		return false;
-	return true;
+/*
+ * Corks/uncorks the tcp output (TCP_CORK, or TCP_NOPUSH on
+ * BSD). While corked, only the full segments are sent, even
+ * with TCP_NODELAY set; uncorking sends the partial segment
+ * held back. So the small writes that make one message go out
+ * in as few packets as possible.
+ *
+ * @param [in] on - true to cork, false to uncork.
+ *
+ * @throws std::system_error if the socket option could not be
+ *         set or is not supported on the platform.
+ */
+void
+socket::cork(bool on)
+{
+#if defined(TCP_CORK) || defined(TCP_NOPUSH)
+	int value = on ? 1 : 0;
+	int vlen = static_cast<int>(sizeof(value));
+#if defined(TCP_CORK)
+	setopt(IPPROTO_TCP, TCP_CORK, &value, vlen);
+#else
+	setopt(IPPROTO_TCP, TCP_NOPUSH, &value, vlen);
+#endif
+#else
+	throw std::system_error(
+		std::make_error_code(std::errc::operation_not_supported),
+		"TCP cork is not supported");
 #endif
 }
 
 /*
- * Enables/disables the socket blocking mode. On Windows,
- * the changed value is saved in a local varible that can be
- * used by the read version of blocking().
+ * Gets the UDP generic segmentation offload segment size
+ * (UDP_SEGMENT).
+ *
+ * @return the segment size, 0 if segmentation is disabled.
+ *
+ * @throws std::system_error if the socket option could not be
+ *         retrieved or is not supported on the platform.
+ */
+int
+socket::udpsegment()
+{
+#if defined(UDP_SEGMENT)
+	int value = 0;
+	int vlen = static_cast<int>(sizeof(value));
+	getopt(IPPROTO_UDP, UDP_SEGMENT, &value, &vlen);
+	return value;
+#else
+	throw std::system_error(
+		std::make_error_code(std::errc::operation_not_supported),
+		"UDP segmentation offload is not supported");
+#endif
+}
+
+/*
+ * Sets the UDP generic segmentation offload segment size
+ * (UDP_SEGMENT). A datagram larger than the segment size
+ * is sent as a train of segment size datagrams (the last one
+ * may be shorter), with a single pass through the stack.
+ *
+ * @param [in] segsize - segment size, 0 to disable.
+ *
+ * @throws std::system_error if the socket option could not be
+ *         set or is not supported on the platform.
+ */
+void
+socket::udpsegment(int segsize)
+{
+#if defined(UDP_SEGMENT)
+	int value = segsize;
+	int vlen = static_cast<int>(sizeof(value));
+	setopt(IPPROTO_UDP, UDP_SEGMENT, &value, vlen);
+#else
+	throw std::system_error(
+		std::make_error_code(std::errc::operation_not_supported),
+		"UDP segmentation offload is not supported");
+#endif
+}
+
+/*
+ * Determines if UDP generic receive offload (UDP_GRO) is enabled.
+ *
+ * @return true if UDP GRO is enabled.
+ *
+ * @throws std::system_error if the socket option could not be
+ *         retrieved or is not supported on the platform.
+ */
+bool
+socket::udpgro()
+{
+#if defined(UDP_GRO)
+	int value = 0;
+	int vlen = static_cast<int>(sizeof(value));
+	getopt(IPPROTO_UDP, UDP_GRO, &value, &vlen);
+	return (value != 0);
+#else
+	throw std::system_error(
+		std::make_error_code(std::errc::operation_not_supported),
+		"UDP receive offload is not supported");
+#endif
+}
+
+/*
+ * Enables/disables UDP generic receive offload (UDP_GRO). With
+ * GRO, the datagrams of a flow may be received coalesced in one
+ * buffer; recvmmsg() reports the segment size in the datagram.
+ *
+ * @throws std::system_error if the socket option could not be
+ *         set or is not supported on the platform.
+ */
+void
+socket::udpgro(bool gro)
+{
+#if defined(UDP_GRO)
+	int value = gro ? 1 : 0;
+	int vlen = static_cast<int>(sizeof(value));
+	setopt(IPPROTO_UDP, UDP_GRO, &value, vlen);
+#else
+	throw std::system_error(
+		std::make_error_code(std::errc::operation_not_supported),
+		"UDP receive offload is not supported");
+#endif
+}
+
+/*
+ * Gets the time, in seconds, the accepted connections wait for
+ * the client data (TCP_DEFER_ACCEPT).
+ *
+ * @return the time in seconds, 0 if disabled.
+ *
+ * @throws std::system_error if the socket option could not be
+ *         retrieved or is not supported on the platform.
+ */
+int
+socket::deferaccept()
+{
+#if defined(TCP_DEFER_ACCEPT)
+	int value = 0;
+	int vlen = static_cast<int>(sizeof(value));
+	getopt(IPPROTO_TCP, TCP_DEFER_ACCEPT, &value, &vlen);
+	return value;
+#else
+	throw std::system_error(
+		std::make_error_code(std::errc::operation_not_supported),
+		"deferred accept is not supported");
+#endif
+}
+
+/*
+ * Defers the accept of the connections until the client sends
+ * data (TCP_DEFER_ACCEPT), so that the listener is woken up only
+ * for the connections that have a request to read.
+ *
+ * @param [in] secs - time in seconds to wait for the data; 0 to
+ *                    disable.
+ *
+ * @throws std::system_error if the socket option could not be
+ *         set or is not supported on the platform.
+ */
+void
+socket::deferaccept(int secs)
+{
+#if defined(TCP_DEFER_ACCEPT)
+	int value = secs;
+	int vlen = static_cast<int>(sizeof(value));
+	setopt(IPPROTO_TCP, TCP_DEFER_ACCEPT, &value, vlen);
+#else
+	throw std::system_error(
+		std::make_error_code(std::errc::operation_not_supported),
+		"deferred accept is not supported");
+#endif
+}
+
+/*
+ * Gets the TCP fast open queue length (TCP_FASTOPEN).
+ *
+ * @return the queue length, 0 if disabled.
+ *
+ * @throws std::system_error if the socket option could not be
+ *         retrieved or is not supported on the platform.
+ */
+int
+socket::fastopen()
+{
+#if defined(TCP_FASTOPEN)
+	int value = 0;
+	int vlen = static_cast<int>(sizeof(value));
+	getopt(IPPROTO_TCP, TCP_FASTOPEN, &value, &vlen);
+	return value;
+#else
+	throw std::system_error(
+		std::make_error_code(std::errc::operation_not_supported),
+		"TCP fast open is not supported");
+#endif
+}
+
+/*
+ * Enables TCP fast open on the listening socket (TCP_FASTOPEN):
+ * the data in the SYN of a returning client is accepted without
+ * waiting for the handshake to complete. Must be set before
+ * listen().
+ *
+ * @param [in] qlen - maximum number of pending fast open
+ *                    requests; 0 to disable.
+ *
+ * @throws std::system_error if the socket option could not be
+ *         set or is not supported on the platform.
+ */
+void
+socket::fastopen(int qlen)
+{
+#if defined(TCP_FASTOPEN)
+	int value = qlen;
+	int vlen = static_cast<int>(sizeof(value));
+	setopt(IPPROTO_TCP, TCP_FASTOPEN, &value, vlen);
+#else
+	throw std::system_error(
+		std::make_error_code(std::errc::operation_not_supported),
+		"TCP fast open is not supported");
+#endif
+}
+
+/*
+ * Determines if the socket is in blocking mode. The mode is
+ * cached in the object, so no system call is made; the mode
+ * must be changed using blocking(bool) only.
+ *
+ * @return true if socket is in blocking mode.
+ */
+bool
+socket::blocking()
+{
+	return m_blocking;
+}
+
+/*
+ * Enables/disables the socket blocking mode. The changed
+ * value is cached in the object and is used by blocking().
  *
  * @param [in] blk - true makes the socket blocking,
  *                   false makes the socket non-blocking.
@@ -710,10 +1050,12 @@ socket::blocking(bool blk)
 	int retval;
 	const char *mode = blk ? "blocking" : "non-blocking";
 
+	if (blk == m_blocking)
+		return;
+
 #if defined(_WIN32)
 	u_long nb = blk ? 0 : 1;
 	retval = ioctlsocket(m_sock, FIONBIO, &nb);
-	m_blocking = !nb;
 #else
 	int flags = fcntl(m_sock, F_GETFL, 0);
 	if (SOCKET_ERROR == flags) {
@@ -728,11 +1070,13 @@ socket::blocking(bool blk)
 			flags &= ~O_NONBLOCK;
 		} else {
 			// already blocking; nothing to do
+			m_blocking = blk;
 			return;
 		}
 	} else {
 		if ((flags & O_NONBLOCK) == O_NONBLOCK) {
 			// already non-blocking; nothing to do
+			m_blocking = blk;
 			return;
 		} else {
 			flags |= O_NONBLOCK;
@@ -750,6 +1094,83 @@ socket::blocking(bool blk)
 			std::system_category(),
 			oss.str());
 	}
+
+	m_blocking = blk;
+}
+
+/*
+ * Gets the socket mode from the system. Windows cannot
+ * query it; a new socket is in blocking mode there.
+ *
+ * @return true if socket is in blocking mode.
+ *
+ * @throws std::system_error if the socket flags could not be fetched.
+ */
+bool
+socket::query_blocking()
+{
+#if defined(_WIN32)
+	return true;
+#else
+	int flags = fcntl(m_sock, F_GETFL, 0);
+	if (SOCKET_ERROR == flags) {
+		throw std::system_error(
+			snf::net::error(),
+			std::system_category(),
+			"failed to get socket flags");
+	}
+
+	return ((flags & O_NONBLOCK) == 0);
+#endif
+}
+
+/*
+ * Gets the flags for recv()/send() with the given timeout. The
+ * read/write is always tried first; the socket is polled only
+ * if the call would block. If the call must not block (the
+ * socket is non-blocking or there is a timeout), MSG_DONTWAIT
+ * makes it non-blocking without changing the socket mode. Windows
+ * does not have the flag; the socket is switched to non-blocking
+ * mode, and reset is set so that the caller switches it back.
+ *
+ * @param [in]  to    - timeout in milliseconds.
+ * @param [out] reset - set to true if the socket mode is changed.
+ *
+ * @return the flags.
+ */
+int
+socket::io_flags(int to, bool *reset)
+{
+	*reset = false;
+
+	if (m_blocking && (POLL_WAIT_FOREVER == to))
+		return 0;
+
+#if defined(_WIN32)
+	if (m_blocking) {
+		blocking(false);
+		*reset = true;
+	}
+	return 0;
+#else
+	return MSG_DONTWAIT;
+#endif
+}
+
+/*
+ * Waits for the events on the socket, without allocating.
+ *
+ * @param [in]  events - POLLIN and/or POLLOUT.
+ * @param [in]  to     - timeout in milliseconds.
+ * @param [out] oserr  - system error in case of failure.
+ *
+ * @return true if the socket is ready, false on timeout or failure.
+ */
+bool
+socket::wait(short events, int to, int *oserr)
+{
+	pollfd fdelem = { m_sock, events, 0 };
+	return (snf::net::poll(&fdelem, 1, to, oserr) > 0);
 }
 
 /*
@@ -767,6 +1188,7 @@ socket::dump_options()
 	oss << std::boolalpha
 		<< ", keepalive=" << keepalive()
 		<< ", reuseaddr=" << reuseaddr()
+		<< ", reuseport=" << reuseport()
 		<< ", tcpnodelay=" << tcpnodelay()
 		<< ", blocking=" << blocking()
 		<< std::noboolalpha;
@@ -926,16 +1348,15 @@ socket::connect(const socket_address &sa, int to)
 		} else {
 			if (connect_in_progress(retval)) {
 				pollfd fdelem = { m_sock, POLLOUT | POLLERR, 0 };
-				std::vector<pollfd> fdvec { 1, fdelem };
 
 				int syserr;
-				retval = snf::net::poll(fdvec, to, &syserr);
+				retval = snf::net::poll(&fdelem, 1, to, &syserr);
 				if (SOCKET_ERROR == retval) {
 					retval = syserr;
 				} else if (retval == 0) {
 					retval = ETIMEDOUT;
 				} else {
-					if (fdvec[0].revents & POLLERR)
+					if (fdelem.revents & POLLERR)
 						retval = error();
 					else
 						retval = 0;
@@ -1048,7 +1469,8 @@ socket::listen(int backlog)
 
 /*
  * Accepts a request and returns a new accepted socket. The new
- * socket has the peer address set.
+ * socket has the peer address set (it is queried when asked for
+ * if the connection has been accepted by multishot accept).
  *
  * @returns new accepted socket.
  *
@@ -1059,16 +1481,32 @@ socket::accept()
 {
 	sockaddr_storage saddr = { 0 };
 	socklen_t slen = static_cast<socklen_t>(sizeof(saddr));
+	sock_t s;
+	int error = 0;
+
+	if (m_feed) {
+		m_feed->wait(m_blocking ? POLL_WAIT_FOREVER : POLL_WAIT_NONE);
+		if (m_feed->accept(&s, &error) == E_ok) {
+			// Accepted non-blocking.
+			socket nsock {s, m_type, false, saddr, 0};
+			nsock.blocking(true);
+			return nsock;
+		}
+		s = INVALID_SOCKET;
+	} else {
+		s = ::accept(
+				m_sock,
+				reinterpret_cast<sockaddr *>(&saddr),
+				&slen);
+		if (INVALID_SOCKET == s)
+			error = snf::net::error();
+	}
 
-	sock_t s = ::accept(
-			m_sock,
-			reinterpret_cast<sockaddr *>(&saddr),
-			&slen);
 	if (INVALID_SOCKET == s) {
 		std::ostringstream oss;
 		oss << "failed to accept socket " << static_cast<int64_t>(m_sock);
 		throw std::system_error(
-			snf::net::error(),
+			error,
 			std::system_category(),
 			oss.str());
 	}
@@ -1077,24 +1515,102 @@ socket::accept()
 }
 
 /*
- * Determines if the socket is readable in the specified time.
- *
- * @param [in]  to    - timeout in milliseconds.
- *                      POLL_WAIT_FOREVER for inifinite wait.
- *                      POLL_WAIT_NONE for no wait.
- * @param [out] oserr - system error in case of failure.
- *
- * @return true if the socket is readable, false otherwise.
+ * Accepts a pending connection, without throwing when there is
+ * none. On Linux, the connection is accepted with accept4(2),
+ * so the mode and close-on-exec flag are set by the same call.
+ * The connections aborted by the client before they are accepted
+ * are skipped. The caller drains the pending connections by
+ * accepting until E_try_again. On a socket attached for multishot
+ * accept, the connection is taken from the ones the reactor has
+ * accepted, without a system call.
+ *
+ * @param [out] nsock       - accepted socket.
+ * @param [in]  nonblocking - make the accepted socket non-blocking.
+ * @param [out] oserr       - system error code.
+ *
+ * @return E_ok on success, E_try_again if there is no pending
+ *         connection, -ve error code on failure.
  */
-bool
-socket::is_readable(int to, int *oserr)
+int
+socket::accept(std::unique_ptr<socket> &nsock, bool nonblocking, int *oserr)
 {
-	pollfd fdelem = { m_sock, POLLIN, 0 };
-	std::vector<pollfd> fdvec { 1, fdelem };
-	return (snf::net::poll(fdvec, to, oserr) > 0);
-}
+	sockaddr_storage saddr = { 0 };
+	socklen_t slen;
+	sock_t s;
+
+	if (m_feed) {
+		int retval = m_feed->accept(&s, oserr);
+		if (retval != E_ok)
+			return (retval == E_connection_reset) ? E_accept_failed : retval;
+
+		// Accepted non-blocking; the peer address is queried if asked for.
+		nsock.reset(DBG_NEW socket(s, m_type, false, saddr, 0));
+		if (!nonblocking)
+			nsock->blocking(true);
+		return E_ok;
+	}
 
-/*
+	for (;;) {
+		slen = static_cast<socklen_t>(sizeof(saddr));
+#if defined(__linux__)
+		s = ::accept4(
+				m_sock,
+				reinterpret_cast<sockaddr *>(&saddr),
+				&slen,
+				SOCK_CLOEXEC | (nonblocking ? SOCK_NONBLOCK : 0));
+#else
+		s = ::accept(
+				m_sock,
+				reinterpret_cast<sockaddr *>(&saddr),
+				&slen);
+#endif
+		if (INVALID_SOCKET != s)
+			break;
+
+		int error = snf::net::error();
+#if defined(_WIN32)
+		if (WSAECONNRESET == error)
+			continue;
+#else
+		if ((EINTR == error) || (ECONNABORTED == error))
+			continue;
+#endif
+
+		if (oserr) *oserr = error;
+		int retval = map_system_error(error, E_accept_failed);
+		return (retval == E_connection_reset) ? E_accept_failed : retval;
+	}
+
+#if defined(__linux__)
+	nsock.reset(DBG_NEW socket(s, m_type, !nonblocking, saddr, slen));
+#else
+	// The accepted socket may inherit the mode of the listening socket.
+	nsock.reset(DBG_NEW socket(s, saddr, slen));
+	nsock->blocking(!nonblocking);
+#endif
+
+	return E_ok;
+}
+
+/*
+ * Determines if the socket is readable in the specified time.
+ *
+ * @param [in]  to    - timeout in milliseconds.
+ *                      POLL_WAIT_FOREVER for inifinite wait.
+ *                      POLL_WAIT_NONE for no wait.
+ * @param [out] oserr - system error in case of failure.
+ *
+ * @return true if the socket is readable, false otherwise.
+ */
+bool
+socket::is_readable(int to, int *oserr)
+{
+	if (m_feed)
+		return m_feed->wait(to);
+	return wait(POLLIN, to, oserr);
+}
+
+/*
  * Determines if the socket is writable in the specified time.
  *
  * @param [in]  to    - timeout in milliseconds.
@@ -1107,9 +1623,7 @@ socket::is_readable(int to, int *oserr)
 bool
 socket::is_writable(int to, int *oserr)
 {
-	pollfd fdelem = { m_sock, POLLOUT, 0 };
-	std::vector<pollfd> fdvec { 1, fdelem };
-	return (snf::net::poll(fdvec, to, oserr) > 0);
+	return wait(POLLOUT, to, oserr);
 }
 
 /**
@@ -1131,6 +1645,7 @@ socket::readn(void *buf, int to_read, int *bread, int to, int *oserr)
 {
 	int     retval = E_ok;
 	int     n = 0, nbytes = 0;
+	int     error = 0;
 	char    *cbuf = static_cast<char *>(buf);
 
 	if (buf == nullptr)
@@ -1142,32 +1657,36 @@ socket::readn(void *buf, int to_read, int *bread, int to, int *oserr)
 	if (bread == nullptr)
 		return E_invalid_arg;
 
-	bool reset = false;
-	if (POLL_WAIT_FOREVER != to) {
-		if (blocking()) {
-			blocking(false);
-			reset = true;
+	if (m_feed) {
+		while (to_read > 0) {
+			n = 0;
+			retval = m_feed->recv(cbuf, to_read, &n, to, oserr);
+			if ((retval != E_ok) || (n == 0))
+				break;
+			cbuf += n;
+			to_read -= n;
+			nbytes += n;
 		}
+
+		*bread = nbytes;
+		return retval;
 	}
 
-	do {
-		if (blocking()) {
-			n = ::recv(m_sock, cbuf, to_read, 0);
-		} else {
-			if (is_readable(to, oserr)) {
-				n = ::recv(m_sock, cbuf, to_read, 0);
-			} else {
-				retval = map_system_error(*oserr, E_read_failed);
-				break;
-			}
-		}
+	bool nowait = !m_blocking || (POLL_WAIT_FOREVER != to);
+	bool reset = false;
+	int flags = io_flags(to, &reset);
 
+	do {
+		n = ::recv(m_sock, cbuf, to_read, flags);
 		if (SOCKET_ERROR == n) {
-			int error = snf::net::error();
+			error = snf::net::error();
 #if !defined(_WIN32)
 			if (EINTR == error)
 				continue;
 #endif
+			if (nowait && would_block(error) && wait(POLLIN, to, &error))
+				continue;
+
 			if (oserr) *oserr = error;
 			retval = map_system_error(error, E_read_failed);
 			break;
@@ -1188,6 +1707,93 @@ socket::readn(void *buf, int to_read, int *bread, int to, int *oserr)
 	return retval;
 }
 
+/*
+ * Reads the data available on the socket, waiting for some if
+ * there is none. Used to fill the read buffer.
+ *
+ * @param [out] buf     - buffer to read the data into.
+ * @param [in]  to_read - maximum number of bytes to read.
+ * @param [out] bread   - number of bytes read. 0 on end of file.
+ * @param [in]  to      - timeout in milliseconds.
+ *                        POLL_WAIT_FOREVER for inifinite wait.
+ *                        POLL_WAIT_NONE for no wait.
+ * @param [out] oserr   - system error code.
+ *
+ * @return E_ok on success, -ve error code on success.
+ */
+int
+socket::readsome(void *buf, int to_read, int *bread, int to, int *oserr)
+{
+	int     retval = E_ok;
+	int     n = 0;
+	int     error = 0;
+
+	if (buf == nullptr)
+		return E_invalid_arg;
+
+	if (to_read <= 0)
+		return E_invalid_arg;
+
+	if (bread == nullptr)
+		return E_invalid_arg;
+
+	*bread = 0;
+
+	if (m_feed)
+		return m_feed->recv(buf, to_read, bread, to, oserr);
+
+	bool nowait = !m_blocking || (POLL_WAIT_FOREVER != to);
+	bool reset = false;
+	int flags = io_flags(to, &reset);
+
+	do {
+		n = ::recv(m_sock, static_cast<char *>(buf), to_read, flags);
+		if (SOCKET_ERROR == n) {
+			error = snf::net::error();
+#if !defined(_WIN32)
+			if (EINTR == error)
+				continue;
+#endif
+			if (nowait && would_block(error) && wait(POLLIN, to, &error))
+				continue;
+
+			if (oserr) *oserr = error;
+			retval = map_system_error(error, E_read_failed);
+		} else {
+			*bread = n;
+		}
+		break;
+	} while (true);
+
+	if (reset)
+		blocking(true);
+
+	return retval;
+}
+
+/*
+ * Hands over the next buffer of the data received on a socket
+ * attached for multishot receive, without copying it. Reads
+ * into the buffer otherwise.
+ *
+ * @param [inout] buf   - buffer to read the data into.
+ * @param [in]    size  - buffer size.
+ * @param [in]    to    - timeout in milliseconds.
+ *                        POLL_WAIT_FOREVER for inifinite wait.
+ *                        POLL_WAIT_NONE for no wait.
+ * @param [out]   oserr - system error code.
+ *
+ * @return E_ok on success, -ve error code on failure. The
+ *         buffer is empty on end of file.
+ */
+int
+socket::receive(iobuf &buf, int size, int to, int *oserr)
+{
+	if (m_feed)
+		return m_feed->recv(buf, to, oserr);
+	return nio::receive(buf, size, to, oserr);
+}
+
 /**
  * Writes to the socket. There is no need to handle SIGPIPE
  * explicitly while using this.
@@ -1206,8 +1812,8 @@ int
 socket::writen(const void *buf, int to_write, int *bwritten, int to, int *oserr)
 {
 	int         retval = E_ok;
-	int         flags = 0;
 	int         n = 0, nbytes = 0;
+	int         error = 0;
 	const char  *cbuf = static_cast<const char *>(buf);
 
 	if (buf == nullptr)
@@ -1219,36 +1825,25 @@ socket::writen(const void *buf, int to_write, int *bwritten, int to, int *oserr)
 	if (bwritten == nullptr)
 		return E_invalid_arg;
 
+	bool nowait = !m_blocking || (POLL_WAIT_FOREVER != to);
+	bool reset = false;
+	int flags = io_flags(to, &reset);
+
 #if !defined(_WIN32)
-	flags = MSG_NOSIGNAL;
+	flags |= MSG_NOSIGNAL;
 #endif
 
-	bool reset = false;
-	if (POLL_WAIT_FOREVER != to) {
-		if (blocking()) {
-			blocking(false);
-			reset = true;
-		}
-	}
-
 	do {
-		if (blocking()) {
-			n = ::send(m_sock, cbuf, to_write, flags);
-		} else {
-			if (is_writable(to, oserr)) {
-				n = ::send(m_sock, cbuf, to_write, flags);
-			} else {
-				retval = map_system_error(*oserr, E_write_failed);
-				break;
-			}
-		}
-
+		n = ::send(m_sock, cbuf, to_write, flags);
 		if (SOCKET_ERROR == n) {
-			int error = snf::net::error();
+			error = snf::net::error();
 #if !defined(_WIN32)
 			if (EINTR == error)
 				continue;
 #endif
+			if (nowait && would_block(error) && wait(POLLOUT, to, &error))
+				continue;
+
 			if (oserr) *oserr = error;
 			retval = map_system_error(error, E_write_failed);
 			break;
@@ -1269,14 +1864,643 @@ socket::writen(const void *buf, int to_write, int *bwritten, int to, int *oserr)
 	return retval;
 }
 
+/**
+ * Writes the data from the scatter/gather elements to the
+ * socket in as few system calls as possible. There is no
+ * need to handle SIGPIPE explicitly while using this.
+ *
+ * @param [in]  iov      - scatter/gather elements.
+ * @param [in]  iovcnt   - number of elements.
+ * @param [out] bwritten - number of bytes written.
+ * @param [in]  to       - timeout in milliseconds.
+ *                         POLL_WAIT_FOREVER for inifinite wait.
+ *                         POLL_WAIT_NONE for no wait.
+ * @param [out] oserr    - system error code.
+ *
+ * @return E_ok on success, -ve error code on success.
+ */
+int
+socket::writen(const iovec *iov, int iovcnt, int *bwritten, int to, int *oserr)
+{
+	int     retval = E_ok;
+	int     n = 0, nbytes = 0;
+	int     error = 0;
+
+	int to_write = iov_length(iov, iovcnt);
+	if (to_write <= 0)
+		return E_invalid_arg;
+
+	if (bwritten == nullptr)
+		return E_invalid_arg;
+
+	/*
+	 * The elements are copied only when a write ends in
+	 * the middle of an element and it has to be adjusted.
+	 */
+	const iovec         *cur = iov;
+	int                 cnt = iovcnt;
+	std::vector<iovec>  rest;
+	bool                copied = false;
+
+	bool nowait = !m_blocking || (POLL_WAIT_FOREVER != to);
+	bool reset = false;
+	int flags = io_flags(to, &reset);
+
+	do {
+#if defined(_WIN32)
+		WSABUF wsabuf[64];
+		DWORD nbufs = static_cast<DWORD>(std::min(cnt, 64));
+		DWORD sent = 0;
+		for (DWORD i = 0; i < nbufs; ++i) {
+			wsabuf[i].buf = static_cast<CHAR *>(cur[i].iov_base);
+			wsabuf[i].len = static_cast<ULONG>(cur[i].iov_len);
+		}
+		if (::WSASend(m_sock, wsabuf, nbufs, &sent, 0, nullptr, nullptr) == 0)
+			n = static_cast<int>(sent);
+		else
+			n = SOCKET_ERROR;
+#else
+		msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = const_cast<iovec *>(cur);
+		msg.msg_iovlen = std::min(cnt, MAX_IOVEC);
+		int more = 0;
+#if defined(MSG_MORE)
+		// More elements follow; let the kernel fill the segments.
+		if (cnt > MAX_IOVEC)
+			more = MSG_MORE;
+#endif
+		n = static_cast<int>(::sendmsg(m_sock, &msg, flags | more | MSG_NOSIGNAL));
+#endif
+
+		if (SOCKET_ERROR == n) {
+			error = snf::net::error();
+#if !defined(_WIN32)
+			if (EINTR == error)
+				continue;
+#endif
+			if (nowait && would_block(error) && wait(POLLOUT, to, &error))
+				continue;
+
+			if (oserr) *oserr = error;
+			retval = map_system_error(error, E_write_failed);
+			break;
+		} else if (0 == n) {
+			break;
+		}
+
+		nbytes += n;
+		to_write -= n;
+
+		size_t left = static_cast<size_t>(n);
+		while ((cnt > 0) && (left >= cur->iov_len)) {
+			left -= cur->iov_len;
+			cur++;
+			cnt--;
+		}
+
+		if (left > 0) {
+			if (!copied) {
+				rest.assign(cur, cur + cnt);
+				cur = rest.data();
+				copied = true;
+			}
+			iovec *first = const_cast<iovec *>(cur);
+			first->iov_base = static_cast<char *>(first->iov_base) + left;
+			first->iov_len -= left;
+		}
+	} while (to_write > 0);
+
+	*bwritten = nbytes;
+
+	if (reset)
+		blocking(true);
+
+	return retval;
+}
+
+/**
+ * Sends the file content. On Linux, the data is sent with
+ * sendfile(2), without being copied to the user space. If
+ * the file does not support it, or on other platforms, the
+ * file is read and written in chunks. sendfile(2) takes no
+ * MSG_DONTWAIT, so a timed send on a blocking socket is also
+ * done in chunks rather than by switching the blocking mode.
+ *
+ * @param [in]  f      - open file.
+ * @param [in]  offset - file offset to start from.
+ * @param [in]  count  - number of bytes to send.
+ * @param [out] bsent  - number of bytes sent. It is less than
+ *                       count if the end of file is reached.
+ * @param [in]  to     - timeout in milliseconds.
+ *                       POLL_WAIT_FOREVER for inifinite wait.
+ *                       POLL_WAIT_NONE for no wait.
+ * @param [out] oserr  - system error code.
+ *
+ * @return E_ok on success, -ve error code on success.
+ */
+int
+socket::sendfile(snf::file &f, int64_t offset, int64_t count, int64_t *bsent, int to, int *oserr)
+{
+#if defined(__linux__)
+	int     retval = E_ok;
+	int     error = 0;
+	ssize_t n = 0;
+	off_t   off = static_cast<off_t>(offset);
+
+	if ((offset < 0) || (count <= 0) || (bsent == nullptr))
+		return E_invalid_arg;
+
+	if (m_blocking && (POLL_WAIT_FOREVER != to))
+		return nio::sendfile(f, offset, count, bsent, to, oserr);
+
+	*bsent = 0;
+
+	do {
+		size_t to_send = static_cast<size_t>(std::min(count, static_cast<int64_t>(0x40000000)));
+		n = ::sendfile(m_sock, static_cast<fhandle_t>(f), &off, to_send);
+		if (n < 0) {
+			error = snf::net::error();
+			if (EINTR == error)
+				continue;
+
+			if ((*bsent == 0) && ((EINVAL == error) || (ENOSYS == error))) {
+				// sendfile() is not supported for the file
+				return nio::sendfile(f, offset, count, bsent, to, oserr);
+			}
+
+			if (!m_blocking && would_block(error) && wait(POLLOUT, to, &error))
+				continue;
+
+			if (oserr) *oserr = error;
+			retval = map_system_error(error, E_write_failed);
+			break;
+		} else if (0 == n) {
+			// end of file
+			break;
+		} else {
+			*bsent += n;
+			count -= n;
+		}
+	} while (count > 0);
+
+	return retval;
+#else
+	return nio::sendfile(f, offset, count, bsent, to, oserr);
+#endif
+}
+
+/*
+ * Starts a batch of writes that make one message: the tcp
+ * output is corked so that the writes are sent in full
+ * segments. Best effort; if the socket can not be corked
+ * the writes go out as usual.
+ */
+void
+socket::begin_batch()
+{
+	if ((m_type != socket_type::tcp) || m_batched)
+		return;
+
+	try {
+		cork(true);
+		m_batched = true;
+	} catch (const std::system_error &) {
+		// writes are not batched
+	}
+}
+
+/*
+ * Ends the batch of writes: uncorks the tcp output, sending
+ * the partial segment held back.
+ *
+ * @param [in]  to    - timeout in milliseconds (not used).
+ * @param [out] oserr - system error in case of failure, if not null.
+ *
+ * @return E_ok on success, E_write_failed on failure.
+ */
+int
+socket::end_batch(int, int *oserr)
+{
+	if (!m_batched)
+		return E_ok;
+
+	m_batched = false;
+
+	try {
+		cork(false);
+	} catch (const std::system_error &ex) {
+		if (oserr) *oserr = ex.code().value();
+		return E_write_failed;
+	}
+
+	return E_ok;
+}
+
+/**
+ * Sends a datagram to the address.
+ *
+ * @param [in]  buf   - datagram to send.
+ * @param [in]  len   - datagram length.
+ * @param [in]  sa    - destination address.
+ * @param [out] bsent - number of bytes sent.
+ * @param [in]  to    - timeout in milliseconds.
+ *                      POLL_WAIT_FOREVER for inifinite wait.
+ *                      POLL_WAIT_NONE for no wait.
+ * @param [out] oserr - system error code.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+socket::sendto(const void *buf, int len, const socket_address &sa, int *bsent, int to, int *oserr)
+{
+	int     retval = E_ok;
+	int     n = 0;
+	int     error = 0;
+
+	if ((buf == nullptr) || (len < 0) || (bsent == nullptr))
+		return E_invalid_arg;
+
+	*bsent = 0;
+
+	socklen_t salen = 0;
+	const sockaddr *to_sa = sa.get_sa(&salen);
+
+	bool nowait = !m_blocking || (POLL_WAIT_FOREVER != to);
+	bool reset = false;
+	int flags = io_flags(to, &reset);
+
+#if !defined(_WIN32)
+	flags |= MSG_NOSIGNAL;
+#endif
+
+	for (;;) {
+		n = static_cast<int>(::sendto(m_sock, static_cast<const char *>(buf), len,
+				flags, to_sa, salen));
+		if (SOCKET_ERROR == n) {
+			error = snf::net::error();
+#if !defined(_WIN32)
+			if (EINTR == error)
+				continue;
+#endif
+			if (nowait && would_block(error) && wait(POLLOUT, to, &error))
+				continue;
+
+			if (oserr) *oserr = error;
+			retval = map_system_error(error, E_write_failed);
+		} else {
+			*bsent = n;
+		}
+		break;
+	}
+
+	if (reset)
+		blocking(true);
+
+	return retval;
+}
+
+/**
+ * Receives a datagram.
+ *
+ * @param [out] buf   - buffer to receive the datagram into.
+ * @param [in]  len   - buffer length. The part of the datagram
+ *                      that does not fit is discarded.
+ * @param [out] bread - number of bytes received.
+ * @param [out] from  - source address, if not null.
+ * @param [in]  to    - timeout in milliseconds.
+ *                      POLL_WAIT_FOREVER for inifinite wait.
+ *                      POLL_WAIT_NONE for no wait.
+ * @param [out] oserr - system error code.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+socket::recvfrom(void *buf, int len, int *bread, socket_address *from, int to, int *oserr)
+{
+	int     retval = E_ok;
+	int     n = 0;
+	int     error = 0;
+
+	if ((buf == nullptr) || (len <= 0) || (bread == nullptr))
+		return E_invalid_arg;
+
+	*bread = 0;
+
+	sockaddr_storage ss;
+	socklen_t sslen;
+
+	bool nowait = !m_blocking || (POLL_WAIT_FOREVER != to);
+	bool reset = false;
+	int flags = io_flags(to, &reset);
+
+	for (;;) {
+		sslen = static_cast<socklen_t>(sizeof(ss));
+		n = static_cast<int>(::recvfrom(m_sock, static_cast<char *>(buf), len,
+				flags, reinterpret_cast<sockaddr *>(&ss), &sslen));
+		if (SOCKET_ERROR == n) {
+			error = snf::net::error();
+#if !defined(_WIN32)
+			if (EINTR == error)
+				continue;
+#endif
+			if (nowait && would_block(error) && wait(POLLIN, to, &error))
+				continue;
+
+			if (oserr) *oserr = error;
+			retval = map_system_error(error, E_read_failed);
+		} else {
+			*bread = n;
+			if (from && (sslen > 0))
+				*from = socket_address(ss, sslen);
+		}
+		break;
+	}
+
+	if (reset)
+		blocking(true);
+
+	return retval;
+}
+
+/**
+ * Sends the datagrams. On Linux, the datagrams are sent in
+ * batches with sendmmsg(2), one system call per batch; on other
+ * platforms, one at a time. On Linux, a datagram with the segment
+ * size set is sent with UDP generic segmentation offload, as a
+ * train of segment size datagrams.
+ *
+ * @param [in]  dgrams - datagrams to send.
+ * @param [in]  count  - number of datagrams.
+ * @param [out] nsent  - number of datagrams sent. It is less
+ *                       than count on failure.
+ * @param [in]  to     - timeout in milliseconds.
+ *                       POLL_WAIT_FOREVER for inifinite wait.
+ *                       POLL_WAIT_NONE for no wait.
+ * @param [out] oserr  - system error code.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+socket::sendmmsg(datagram *dgrams, int count, int *nsent, int to, int *oserr)
+{
+	int     retval = E_ok;
+	int     error = 0;
+
+	if ((dgrams == nullptr) || (count <= 0) || (nsent == nullptr))
+		return E_invalid_arg;
+
+	*nsent = 0;
+
+	bool nowait = !m_blocking || (POLL_WAIT_FOREVER != to);
+	bool reset = false;
+	int flags = io_flags(to, &reset);
+
+#if defined(__linux__)
+	constexpr int max_batch = 64;
+	mmsghdr msgs[max_batch];
+	iovec iovs[max_batch];
+#if defined(UDP_SEGMENT)
+	char ctrl[max_batch][CMSG_SPACE(sizeof(uint16_t))];
+#endif
+
+	while (*nsent < count) {
+		datagram *dg = dgrams + *nsent;
+		int batch = std::min(count - *nsent, max_batch);
+
+		memset(msgs, 0, sizeof(mmsghdr) * batch);
+		for (int i = 0; i < batch; ++i) {
+			iovs[i].iov_base = dg[i].buf;
+			iovs[i].iov_len = static_cast<size_t>(dg[i].len);
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			if (dg[i].addrlen > 0) {
+				msgs[i].msg_hdr.msg_name = &dg[i].addr;
+				msgs[i].msg_hdr.msg_namelen = dg[i].addrlen;
+			}
+#if defined(UDP_SEGMENT)
+			if (dg[i].segsize > 0) {
+				msgs[i].msg_hdr.msg_control = ctrl[i];
+				msgs[i].msg_hdr.msg_controllen = sizeof(ctrl[i]);
+				cmsghdr *cm = CMSG_FIRSTHDR(&msgs[i].msg_hdr);
+				cm->cmsg_level = IPPROTO_UDP;
+				cm->cmsg_type = UDP_SEGMENT;
+				cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+				uint16_t segsize = static_cast<uint16_t>(dg[i].segsize);
+				memcpy(CMSG_DATA(cm), &segsize, sizeof(segsize));
+			}
+#endif
+		}
+
+		int n = ::sendmmsg(m_sock, msgs, static_cast<unsigned int>(batch), flags | MSG_NOSIGNAL);
+		if (SOCKET_ERROR == n) {
+			error = snf::net::error();
+			if (EINTR == error)
+				continue;
+			if (nowait && would_block(error) && wait(POLLOUT, to, &error))
+				continue;
+
+			if (oserr) *oserr = error;
+			retval = map_system_error(error, E_write_failed);
+			break;
+		}
+
+		*nsent += n;
+	}
+#else
+	while (*nsent < count) {
+		datagram *dg = dgrams + *nsent;
+		int n = ::sendto(m_sock, static_cast<const char *>(dg->buf), dg->len, flags,
+				(dg->addrlen > 0) ? reinterpret_cast<const sockaddr *>(&dg->addr) : nullptr,
+				dg->addrlen);
+		if (SOCKET_ERROR == n) {
+			error = snf::net::error();
+#if !defined(_WIN32)
+			if (EINTR == error)
+				continue;
+#endif
+			if (nowait && would_block(error) && wait(POLLOUT, to, &error))
+				continue;
+
+			if (oserr) *oserr = error;
+			retval = map_system_error(error, E_write_failed);
+			break;
+		}
+
+		(*nsent)++;
+	}
+#endif
+
+	if (reset)
+		blocking(true);
+
+	return retval;
+}
+
+/**
+ * Receives the datagrams. Waits for the first datagram and
+ * then receives the ones that are already queued, up to count,
+ * without waiting. On Linux, the datagrams are received in one
+ * system call with recvmmsg(2); on other platforms, one at a
+ * time. With UDP_GRO enabled, a datagram may hold a train of
+ * coalesced datagrams; its segment size is set then.
+ *
+ * @param [in,out] dgrams - datagrams with the buffers to receive
+ *                          into. The bytes received, the source
+ *                          address and the flags are set.
+ * @param [in]     count  - number of datagrams.
+ * @param [out]    nrecvd - number of datagrams received.
+ * @param [in]     to     - timeout in milliseconds for the first
+ *                          datagram.
+ *                          POLL_WAIT_FOREVER for inifinite wait.
+ *                          POLL_WAIT_NONE for no wait.
+ * @param [out]    oserr  - system error code.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+socket::recvmmsg(datagram *dgrams, int count, int *nrecvd, int to, int *oserr)
+{
+	int     retval = E_ok;
+	int     error = 0;
+
+	if ((dgrams == nullptr) || (count <= 0) || (nrecvd == nullptr))
+		return E_invalid_arg;
+
+	*nrecvd = 0;
+
+	bool nowait = !m_blocking || (POLL_WAIT_FOREVER != to);
+	bool reset = false;
+	int flags = io_flags(to, &reset);
+
+#if defined(__linux__)
+	constexpr int max_batch = 64;
+	mmsghdr msgs[max_batch];
+	iovec iovs[max_batch];
+#if defined(UDP_GRO)
+	char ctrl[max_batch][CMSG_SPACE(sizeof(int))];
+#endif
+
+	int batch = std::min(count, max_batch);
+
+	for (;;) {
+		memset(msgs, 0, sizeof(mmsghdr) * batch);
+		for (int i = 0; i < batch; ++i) {
+			iovs[i].iov_base = dgrams[i].buf;
+			iovs[i].iov_len = static_cast<size_t>(dgrams[i].len);
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_name = &dgrams[i].addr;
+			msgs[i].msg_hdr.msg_namelen = static_cast<socklen_t>(sizeof(sockaddr_storage));
+#if defined(UDP_GRO)
+			msgs[i].msg_hdr.msg_control = ctrl[i];
+			msgs[i].msg_hdr.msg_controllen = sizeof(ctrl[i]);
+#endif
+		}
+
+		int n = ::recvmmsg(m_sock, msgs, static_cast<unsigned int>(batch),
+				flags | MSG_WAITFORONE, nullptr);
+		if (SOCKET_ERROR == n) {
+			error = snf::net::error();
+			if (EINTR == error)
+				continue;
+			if (nowait && would_block(error) && wait(POLLIN, to, &error))
+				continue;
+
+			if (oserr) *oserr = error;
+			retval = map_system_error(error, E_read_failed);
+			break;
+		}
+
+		for (int i = 0; i < n; ++i) {
+			datagram &dg = dgrams[i];
+			dg.bytes = static_cast<int>(msgs[i].msg_len);
+			dg.addrlen = msgs[i].msg_hdr.msg_namelen;
+			dg.truncated = ((msgs[i].msg_hdr.msg_flags & MSG_TRUNC) != 0);
+			dg.segsize = 0;
+#if defined(UDP_GRO)
+			for (cmsghdr *cm = CMSG_FIRSTHDR(&msgs[i].msg_hdr);
+				cm != nullptr;
+				cm = CMSG_NXTHDR(&msgs[i].msg_hdr, cm)) {
+				if ((cm->cmsg_level == IPPROTO_UDP) && (cm->cmsg_type == UDP_GRO))
+					memcpy(&dg.segsize, CMSG_DATA(cm), sizeof(int));
+			}
+#endif
+		}
+
+		*nrecvd = n;
+		break;
+	}
+#else
+	while (*nrecvd < count) {
+		datagram &dg = dgrams[*nrecvd];
+		dg.addrlen = static_cast<socklen_t>(sizeof(sockaddr_storage));
+		int n = ::recvfrom(m_sock, static_cast<char *>(dg.buf), dg.len, flags,
+				reinterpret_cast<sockaddr *>(&dg.addr), &dg.addrlen);
+		if (SOCKET_ERROR == n) {
+			error = snf::net::error();
+#if defined(_WIN32)
+			if (WSAEMSGSIZE == error) {
+				dg.bytes = dg.len;
+				dg.truncated = true;
+				dg.segsize = 0;
+				(*nrecvd)++;
+				continue;
+			}
+#else
+			if (EINTR == error)
+				continue;
+#endif
+
+			// Only the first datagram is waited for.
+			if (would_block(error) && (*nrecvd > 0))
+				break;
+			if (nowait && would_block(error) && wait(POLLIN, to, &error))
+				continue;
+
+			if (oserr) *oserr = error;
+			retval = map_system_error(error, E_read_failed);
+			break;
+		}
+
+		dg.bytes = n;
+		dg.truncated = false;
+		dg.segsize = 0;
+		(*nrecvd)++;
+
+		if (!nowait) {
+			// Do not block for the rest.
+#if defined(_WIN32)
+			blocking(false);
+			reset = true;
+#else
+			flags |= MSG_DONTWAIT;
+#endif
+			nowait = true;
+		}
+	}
+#endif
+
+	if (reset)
+		blocking(true);
+
+	return retval;
+}
+
 /*
- * Closes the socket.
+ * Closes the socket. The multishot operation of a socket
+ * attached is cancelled first.
  *
  * @throws std::system_error if the socket could not be closed.
  */
 void
 socket::close()
 {
+	if (m_feed) {
+		m_feed->close();
+		m_feed.reset();
+	}
+
 	if (m_sock != INVALID_SOCKET) {
 #if defined(_WIN32)
 		int retval = ::closesocket(m_sock);
@@ -154,6 +154,15 @@ ssl_library::bio_free()
 	return m_bio_free;
 }
 
+p_bio_ctrl
+ssl_library::bio_ctrl()
+{
+	if (!m_bio_ctrl)
+		m_bio_ctrl = reinterpret_cast<p_bio_ctrl>
+			(m_crypto->symbol("BIO_ctrl"));
+	return m_bio_ctrl;
+}
+
 p_d2i_private_key_fp
 ssl_library::d2i_private_key_fp()
 {
@@ -902,6 +911,33 @@ ssl_library::ssl_ctx_set_timeout()
 	return m_ssl_ctx_set_timeout;
 }
 
+p_ssl_ctx_sess_set_new_cb
+ssl_library::ssl_ctx_sess_set_new_cb()
+{
+	if (!m_ssl_ctx_sess_set_new_cb)
+		m_ssl_ctx_sess_set_new_cb = reinterpret_cast<p_ssl_ctx_sess_set_new_cb>
+			(m_ssl->symbol("SSL_CTX_sess_set_new_cb"));
+	return m_ssl_ctx_sess_set_new_cb;
+}
+
+p_ssl_ctx_sess_set_get_cb
+ssl_library::ssl_ctx_sess_set_get_cb()
+{
+	if (!m_ssl_ctx_sess_set_get_cb)
+		m_ssl_ctx_sess_set_get_cb = reinterpret_cast<p_ssl_ctx_sess_set_get_cb>
+			(m_ssl->symbol("SSL_CTX_sess_set_get_cb"));
+	return m_ssl_ctx_sess_set_get_cb;
+}
+
+p_ssl_ctx_sess_set_remove_cb
+ssl_library::ssl_ctx_sess_set_remove_cb()
+{
+	if (!m_ssl_ctx_sess_set_remove_cb)
+		m_ssl_ctx_sess_set_remove_cb = reinterpret_cast<p_ssl_ctx_sess_set_remove_cb>
+			(m_ssl->symbol("SSL_CTX_sess_set_remove_cb"));
+	return m_ssl_ctx_sess_set_remove_cb;
+}
+
 p_ssl_new
 ssl_library::ssl_new()
 {
@@ -1154,6 +1190,33 @@ ssl_library::ssl_get0_param()
 	return m_ssl_get0_param;
 }
 
+p_ssl_get_rbio
+ssl_library::ssl_get_rbio()
+{
+	if (!m_ssl_get_rbio)
+		m_ssl_get_rbio = reinterpret_cast<p_ssl_get_rbio>
+			(m_ssl->symbol("SSL_get_rbio"));
+	return m_ssl_get_rbio;
+}
+
+p_ssl_get_wbio
+ssl_library::ssl_get_wbio()
+{
+	if (!m_ssl_get_wbio)
+		m_ssl_get_wbio = reinterpret_cast<p_ssl_get_wbio>
+			(m_ssl->symbol("SSL_get_wbio"));
+	return m_ssl_get_wbio;
+}
+
+p_ssl_sendfile
+ssl_library::ssl_sendfile()
+{
+	if (!m_ssl_sendfile)
+		m_ssl_sendfile = reinterpret_cast<p_ssl_sendfile>
+			(m_ssl->symbol("SSL_sendfile", false));
+	return m_ssl_sendfile;
+}
+
 p_ssl_session_d2i
 ssl_library::ssl_session_d2i()
 {
@@ -0,0 +1,352 @@
+#include "net.h"
+#include "timerwheel.h"
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace snf {
+namespace net {
+
+/*
+ * Gets the index of the least significant bit set.
+ * The value must not be 0.
+ */
+static inline int
+lsb(uint64_t v)
+{
+#if defined(_MSC_VER)
+	unsigned long idx;
+	_BitScanForward64(&idx, v);
+	return static_cast<int>(idx);
+#else
+	return __builtin_ctzll(v);
+#endif
+}
+
+/*
+ * Constructs the timer wheel.
+ *
+ * @param [in] res - tick resolution.
+ *
+ * @throws std::invalid_argument if the resolution is not positive.
+ */
+timer_wheel::timer_wheel(std::chrono::milliseconds res)
+	: m_resolution(res)
+	, m_start(clock_type::now())
+{
+	if (m_resolution.count() <= 0)
+		throw std::invalid_argument("invalid timer wheel resolution");
+
+	memset(m_slots, 0, sizeof(m_slots));
+	memset(m_bitmap, 0, sizeof(m_bitmap));
+}
+
+timer_wheel::~timer_wheel()
+{
+	for (auto &t : m_timers)
+		delete t.second;
+}
+
+/*
+ * Converts the time point to tick, rounding up so that
+ * a timer never expires early.
+ */
+uint64_t
+timer_wheel::to_tick(clock_type::time_point tp) const
+{
+	if (tp <= m_start)
+		return 0;
+
+	int64_t res = std::chrono::duration_cast<clock_type::duration>(m_resolution).count();
+	int64_t elapsed = (tp - m_start).count();
+	return static_cast<uint64_t>((elapsed + res - 1) / res);
+}
+
+/*
+ * Links the node at the head of its slot.
+ */
+void
+timer_wheel::link(node *n)
+{
+	node *&head = m_slots[n->level][n->slot];
+
+	n->prev = nullptr;
+	n->next = head;
+	if (head)
+		head->prev = n;
+	head = n;
+
+	m_bitmap[n->level][n->slot / 64] |= (uint64_t(1) << (n->slot % 64));
+}
+
+/*
+ * Unlinks the node from its slot.
+ */
+void
+timer_wheel::unlink(node *n)
+{
+	node *&head = m_slots[n->level][n->slot];
+
+	if (n->prev)
+		n->prev->next = n->next;
+	else
+		head = n->next;
+
+	if (n->next)
+		n->next->prev = n->prev;
+
+	if (head == nullptr)
+		m_bitmap[n->level][n->slot / 64] &= ~(uint64_t(1) << (n->slot % 64));
+
+	n->prev = n->next = nullptr;
+}
+
+/*
+ * Places the node in the lowest level whose span covers the
+ * expiration tick. The expiration tick must not be earlier
+ * than the current tick.
+ */
+void
+timer_wheel::place(node *n)
+{
+	uint64_t delta = n->tick - m_current;
+	uint64_t tick = n->tick;
+	int level = 0;
+
+	while ((level < (LEVELS - 1)) && (delta >= (uint64_t(1) << (SLOT_BITS * (level + 1)))))
+		level++;
+
+	if (delta >= (uint64_t(1) << (SLOT_BITS * LEVELS)))
+		tick = m_current + (uint64_t(1) << (SLOT_BITS * LEVELS)) - 1;
+
+	n->level = level;
+	n->slot = static_cast<int>((tick >> (SLOT_BITS * level)) & SLOT_MASK);
+	link(n);
+}
+
+/*
+ * Moves the timers of the higher level slots, that come
+ * in range with the current tick, to the lower levels.
+ * Called when the level 0 index wraps around.
+ */
+void
+timer_wheel::cascade()
+{
+	for (int level = 1; level < LEVELS; ++level) {
+		int slot = static_cast<int>((m_current >> (SLOT_BITS * level)) & SLOT_MASK);
+
+		node *n = m_slots[level][slot];
+		m_slots[level][slot] = nullptr;
+		m_bitmap[level][slot / 64] &= ~(uint64_t(1) << (slot % 64));
+
+		while (n) {
+			node *next = n->next;
+			place(n);
+			n = next;
+		}
+
+		if (slot != 0)
+			break;
+	}
+}
+
+/*
+ * Finds the next non-empty slot at the level after the
+ * given slot, wrapping around.
+ *
+ * @return the distance (1 to 256) to the next non-empty
+ *         slot, 0 if all the slots are empty.
+ */
+int
+timer_wheel::next_slot(int level, int slot) const
+{
+	int i = 1;
+
+	while (i <= SLOTS) {
+		int s = (slot + i) & static_cast<int>(SLOT_MASK);
+		uint64_t word = m_bitmap[level][s / 64] >> (s % 64);
+		if (word) {
+			int d = i + lsb(word);
+			return (d <= SLOTS) ? d : 0;
+		}
+		i += 64 - (s % 64);
+	}
+
+	return 0;
+}
+
+/*
+ * Schedules a timer.
+ *
+ * @param [in] exp - expiration time. If the time has passed,
+ *                   the timer expires on the next tick.
+ * @param [in] cb  - callback.
+ *
+ * @return the timer ID.
+ */
+timer_id
+timer_wheel::schedule(clock_type::time_point exp, const callback &cb)
+{
+	node *n = new node;
+	n->tick = to_tick(exp);
+	if (n->tick <= m_current)
+		n->tick = m_current + 1;
+	n->id = ++m_next_id;
+	n->cb = cb;
+
+	place(n);
+	m_timers[n->id] = n;
+
+	return n->id;
+}
+
+/*
+ * Schedules a timer.
+ *
+ * @param [in] to - time from now.
+ * @param [in] cb - callback.
+ *
+ * @return the timer ID.
+ */
+timer_id
+timer_wheel::schedule(std::chrono::milliseconds to, const callback &cb)
+{
+	return schedule(clock_type::now() + to, cb);
+}
+
+/*
+ * Cancels the timer.
+ *
+ * @param [in] id - timer ID.
+ *
+ * @return true if the timer is cancelled, false if the
+ *         timer is not found i.e. it has expired or has
+ *         been cancelled already.
+ */
+bool
+timer_wheel::cancel(timer_id id)
+{
+	std::unordered_map<timer_id, node *>::iterator I = m_timers.find(id);
+	if (I == m_timers.end())
+		return false;
+
+	unlink(I->second);
+	delete I->second;
+	m_timers.erase(I);
+	return true;
+}
+
+/*
+ * Gets the time to the next expiration. For the timers at
+ * the higher levels, it is the time to the start of their
+ * slot, when they are cascaded. So the caller may wake up
+ * before the timer actually expires; expire() then moves it
+ * closer.
+ *
+ * @param [in] now - current time.
+ *
+ * @return the time in milliseconds to the next expiration,
+ *         POLL_WAIT_FOREVER if there is no timer.
+ */
+int
+timer_wheel::next_timeout(clock_type::time_point now)
+{
+	if (m_timers.empty())
+		return POLL_WAIT_FOREVER;
+
+	uint64_t next = UINT64_MAX;
+
+	for (int level = 0; level < LEVELS; ++level) {
+		int slot = static_cast<int>((m_current >> (SLOT_BITS * level)) & SLOT_MASK);
+		int d = next_slot(level, slot);
+		if (d == 0)
+			continue;
+
+		// The timers at a level expire before the ones at the higher levels.
+		next = ((m_current >> (SLOT_BITS * level)) + d) << (SLOT_BITS * level);
+		break;
+	}
+
+	if (next == UINT64_MAX)
+		return POLL_WAIT_FOREVER;
+
+	clock_type::time_point exp = m_start + m_resolution * static_cast<int64_t>(next);
+	if (exp <= now)
+		return POLL_WAIT_NONE;
+
+	std::chrono::milliseconds ms =
+		std::chrono::duration_cast<std::chrono::milliseconds>(exp - now);
+	if ((exp - now) > ms)
+		ms += std::chrono::milliseconds(1);
+
+	if (ms.count() > INT32_MAX)
+		return INT32_MAX;
+	return static_cast<int>(ms.count());
+}
+
+/*
+ * Expires the timers up to the given time. The callbacks
+ * of the expired timers are appended to the vector in the
+ * order of their expiration.
+ *
+ * @param [in]  now - current time.
+ * @param [out] due - callbacks of the expired timers.
+ *
+ * @return the number of timers expired.
+ */
+size_t
+timer_wheel::expire(clock_type::time_point now, std::vector<callback> &due)
+{
+	uint64_t target = 0;
+	if (now > m_start)
+		target = static_cast<uint64_t>((now - m_start) / m_resolution);
+
+	size_t count = 0;
+
+	while (m_current < target) {
+		if (m_timers.empty()) {
+			m_current = target;
+			break;
+		}
+
+		int word = 0;
+		while ((word < WORDS) && (m_bitmap[0][word] == 0))
+			word++;
+
+		if (word == WORDS) {
+			// Nothing at level 0: skip to the last tick before the wrap around.
+			uint64_t last = m_current | SLOT_MASK;
+			if (last >= target) {
+				m_current = target;
+				break;
+			}
+			m_current = last;
+		}
+
+		m_current++;
+
+		int slot = static_cast<int>(m_current & SLOT_MASK);
+		if (slot == 0)
+			cascade();
+
+		node *n = m_slots[0][slot];
+		m_slots[0][slot] = nullptr;
+		m_bitmap[0][slot / 64] &= ~(uint64_t(1) << (slot % 64));
+
+		while (n) {
+			node *next = n->next;
+			due.push_back(std::move(n->cb));
+			m_timers.erase(n->id);
+			delete n;
+			count++;
+			n = next;
+		}
+	}
+
+	return count;
+}
+
+} // namespace net
+} // namespace snf
@@ -0,0 +1,146 @@
+#include "asyncio.h"
+#include <thread>
+
+class aio : public snf::tf::test
+{
+private:
+	static constexpr const char *class_name = "aio";
+
+	/*
+	 * Echoes the fixed size messages back, one at a time,
+	 * chaining the operations from the completion callbacks.
+	 */
+	struct echo_session
+	{
+		snf::net::async_io      &io;
+		char                    buf[8];
+		int                     rounds = 0;
+		std::promise<int>       done;
+
+		echo_session(snf::net::async_io &_io) : io(_io) {}
+
+		void read()
+		{
+			io.async_readn(buf, sizeof(buf), [this] (const snf::net::io_result &r) {
+				if ((r.status != E_ok) || (r.bytes == 0))
+					done.set_value(rounds);
+				else
+					write();
+			});
+		}
+
+		void write()
+		{
+			io.async_write(buf, sizeof(buf), [this] (const snf::net::io_result &r) {
+				if (r.status != E_ok) {
+					done.set_value(rounds);
+				} else {
+					rounds++;
+					read();
+				}
+			});
+		}
+	};
+
+public:
+	aio() : snf::tf::test() {}
+	~aio() {}
+
+	virtual const char *name() const
+	{
+		return "AsyncIO";
+	}
+
+	virtual const char *description() const
+	{
+		return "Tests reactor driven asynchronous reads and writes";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		snf::net::initialize(false);
+
+		try {
+			snf::net::reactor r { 100 };
+			std::array<snf::net::socket, 2> sp = std::move(snf::net::socket::socketpair());
+			int bwritten = 0;
+			int bread = 0;
+
+			{
+				snf::net::async_io io(r, sp[0]);
+				char buf[64];
+
+				// Read waits for the data.
+				std::future<snf::net::io_result> f = io.async_read(buf, sizeof(buf), 2000);
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+				sp[1].writen("hello", 5, &bwritten);
+				snf::net::io_result res = f.get();
+				ASSERT_EQ(int, res.status, E_ok, "read completed");
+				ASSERT_EQ(int, res.bytes, 5, "available data read");
+				ASSERT_EQ(int, memcmp(buf, "hello", 5), 0, "data matches");
+
+				// Exact read of the data written in pieces.
+				f = io.async_readn(buf, 12, 2000);
+				for (const char *p : { "abcd", "efgh", "ijkl" }) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(10));
+					sp[1].writen(p, 4, &bwritten);
+				}
+				res = f.get();
+				ASSERT_EQ(int, res.bytes, 12, "all data read");
+				ASSERT_EQ(int, memcmp(buf, "abcdefghijkl", 12), 0, "data matches");
+
+				// Timeout.
+				res = io.async_read(buf, sizeof(buf), 100).get();
+				ASSERT_EQ(int, res.status, E_timed_out, "read timed out");
+
+				// Write more than the socket buffer holds.
+				std::string large(4 * 1024 * 1024, 'w');
+				std::future<snf::net::io_result> wf = io.async_write(large.data(),
+					static_cast<int>(large.size()), 5000);
+				std::string got(large.size(), '\0');
+				ASSERT_EQ(int, sp[1].readn(&got[0], static_cast<int>(got.size()), &bread, 5000),
+					E_ok, "large data read");
+				res = wf.get();
+				ASSERT_EQ(int, res.status, E_ok, "write completed");
+				ASSERT_EQ(int, res.bytes, static_cast<int>(large.size()), "all data written");
+				ASSERT_EQ(bool, got == large, true, "data matches");
+
+				bool busy = false;
+				io.async_read(buf, sizeof(buf), 1000);
+				try {
+					io.async_read(buf, sizeof(buf), 1000);
+				} catch (const std::logic_error &) {
+					busy = true;
+				}
+				ASSERT_EQ(bool, busy, true, "one read at a time");
+			}
+
+			// Sequential protocol code on the reactor thread.
+			{
+				snf::net::async_io io(r, sp[0]);
+				echo_session es(io);
+				std::future<int> done = es.done.get_future();
+				es.read();
+
+				char msg[8], echo[8];
+				for (int i = 0; i < 100; ++i) {
+					snprintf(msg, sizeof(msg), "m%06d", i);
+					sp[1].writen(msg, sizeof(msg), &bwritten);
+					ASSERT_EQ(int, sp[1].readn(echo, sizeof(echo), &bread, 2000), E_ok, "echo read");
+					ASSERT_EQ(int, memcmp(msg, echo, sizeof(msg)), 0, "echo matches");
+				}
+
+				sp[1].shutdown(SHUT_WR);
+				ASSERT_EQ(int, done.get(), 100, "session ended at end of file");
+			}
+
+			r.stop();
+		} catch (const std::system_error &ex) {
+			std::cerr << "system error: " << ex.code() << std::endl;
+			std::cerr << ex.what() << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+};
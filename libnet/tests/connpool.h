@@ -0,0 +1,152 @@
+#include "cnxnpool.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+class connpool : public snf::tf::test
+{
+private:
+	static constexpr const char *class_name = "connpool";
+
+	std::mutex                      m_lock;
+	std::vector<snf::net::socket>   m_accepted;
+	std::atomic<bool>               m_done { false };
+
+	void acceptor(snf::net::socket &lsock)
+	{
+		while (!m_done.load()) {
+			if (lsock.is_readable(50)) {
+				snf::net::socket s = std::move(lsock.accept());
+				std::lock_guard<std::mutex> guard(m_lock);
+				m_accepted.push_back(std::move(s));
+			}
+		}
+	}
+
+	size_t accepted()
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		return m_accepted.size();
+	}
+
+public:
+	connpool() : snf::tf::test() {}
+	~connpool() {}
+
+	virtual const char *name() const
+	{
+		return "ConnectionPool";
+	}
+
+	virtual const char *description() const
+	{
+		return "Tests outbound connection pool";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		snf::net::initialize(false);
+
+		try {
+			snf::net::socket lsock { AF_INET, snf::net::socket_type::tcp };
+			lsock.reuseaddr(true);
+			lsock.bind(snf::net::internet_address { "127.0.0.1" }, 0);
+			lsock.listen(16);
+			in_port_t port = lsock.local_address().port();
+
+			m_done = false;
+			std::thread t([this, &lsock] () { acceptor(lsock); });
+
+			bool passed = false;
+			try {
+				passed = run(port);
+			} catch (...) {
+				m_done = true;
+				t.join();
+				m_accepted.clear();
+				throw;
+			}
+
+			m_done = true;
+			t.join();
+			m_accepted.clear();
+			return passed;
+		} catch (const std::system_error &ex) {
+			std::cerr << "system error: " << ex.code() << std::endl;
+			std::cerr << ex.what() << std::endl;
+			return false;
+		}
+	}
+
+	bool run(in_port_t port)
+	{
+		{
+			snf::net::connection_pool pool(2, 10000);
+
+			snf::net::connection_pool::lease l1 = pool.checkout("127.0.0.1", port, nullptr, 1000);
+			ASSERT_EQ(bool, l1.is_reused(), false, "new connection");
+			l1.release();
+			ASSERT_EQ(bool, l1.valid(), false, "lease released");
+			ASSERT_EQ(size_t, pool.idle_count(), 1, "connection is idle");
+
+			snf::net::connection_pool::lease l2 = pool.checkout("127.0.0.1", port, nullptr, 1000);
+			ASSERT_EQ(bool, l2.is_reused(), true, "idle connection reused");
+
+			snf::net::connection_pool::lease l3 = pool.checkout("127.0.0.1", port, nullptr, 1000);
+			ASSERT_EQ(bool, l3.is_reused(), false, "new connection");
+			ASSERT_EQ(size_t, pool.open_count(), 2, "two connections open");
+
+			bool timedout = false;
+			try {
+				pool.checkout("127.0.0.1", port, nullptr, 100);
+			} catch (const std::system_error &ex) {
+				timedout = (ex.code().value() == ETIMEDOUT);
+			}
+			ASSERT_EQ(bool, timedout, true, "limit per host enforced");
+
+			// A waiting checkout gets the released connection.
+			std::thread releaser([&l2] () {
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				l2.release();
+			});
+			snf::net::connection_pool::lease l4 = pool.checkout("127.0.0.1", port, nullptr, 2000);
+			releaser.join();
+			ASSERT_EQ(bool, l4.is_reused(), true, "released connection handed over");
+
+			l3.discard();
+			ASSERT_EQ(size_t, pool.open_count(), 1, "discarded connection closed");
+			l4.release();
+
+			// The connection closed by the peer is not reused.
+			{
+				std::lock_guard<std::mutex> guard(m_lock);
+				m_accepted.clear();
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			snf::net::connection_pool::lease l5 = pool.checkout("127.0.0.1", port, nullptr, 1000);
+			ASSERT_EQ(bool, l5.is_reused(), false, "closed connection not reused");
+			ASSERT_EQ(size_t, pool.open_count(), 1, "closed connection dropped");
+			for (int i = 0; (i < 100) && (accepted() == 0); ++i)
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			ASSERT_EQ(size_t, accepted(), 1, "new connection accepted");
+		}
+
+		{
+			// Idle eviction on the reactor.
+			snf::net::reactor r { 100 };
+			snf::net::connection_pool pool(2, 100, &r);
+
+			snf::net::connection_pool::lease l1 = pool.checkout("127.0.0.1", port, nullptr, 1000);
+			l1.release();
+			ASSERT_EQ(size_t, pool.idle_count(), 1, "connection is idle");
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(400));
+			ASSERT_EQ(size_t, pool.idle_count(), 0, "idle connection evicted");
+			ASSERT_EQ(size_t, pool.open_count(), 0, "no connection open");
+
+			r.stop();
+		}
+
+		return true;
+	}
+};
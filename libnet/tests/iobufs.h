@@ -0,0 +1,112 @@
+#include "iobuf.h"
+#include "sock.h"
+
+class iobufs : public snf::tf::test
+{
+private:
+	static constexpr const char *class_name = "iobufs";
+
+public:
+	iobufs() : snf::tf::test() {}
+	~iobufs() {}
+
+	virtual const char *name() const
+	{
+		return "IOBuf";
+	}
+
+	virtual const char *description() const
+	{
+		return "Tests pooled reference counted buffers";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		snf::net::initialize(false);
+
+		try {
+			snf::net::iobuf_pool &pool = snf::net::iobuf_pool::instance();
+
+			// Blocks are recycled.
+			const char *blk = nullptr;
+			{
+				snf::net::iobuf b(1000);
+				ASSERT_EQ(int, b.capacity(), snf::net::iobuf_pool::SMALL_SIZE, "small size class");
+				ASSERT_EQ(bool, b.unique(), true, "single reference");
+				blk = b.data();
+			}
+			uint64_t hits = pool.hits();
+			{
+				snf::net::iobuf b(100);
+				ASSERT_EQ(bool, b.data() == blk, true, "block reused");
+				ASSERT_EQ(uint64_t, pool.hits(), hits + 1, "pool hit");
+			}
+
+			// Views share the block.
+			snf::net::iobuf b("hello world", 11);
+			snf::net::iobuf s = b.slice(6, 5);
+			ASSERT_EQ(bool, b.unique(), false, "block shared");
+			ASSERT_EQ(int, b.tailroom(), 0, "shared block is read only");
+			ASSERT_EQ(int, memcmp(s.data(), "world", 5), 0, "slice matches");
+			s.advance(2);
+			ASSERT_EQ(int, memcmp(s.data(), "rld", 3), 0, "advanced");
+			s.reset();
+			ASSERT_EQ(bool, b.unique(), true, "block no longer shared");
+
+			// Chain.
+			snf::net::iobuf_chain chain;
+			std::string big(150, 'x');
+			chain.append("head:", 5);
+			chain.append(big.data(), big.size());
+			chain.append(b);
+			ASSERT_EQ(size_t, chain.length(), 166, "chain length");
+			ASSERT_EQ(size_t, chain.count(), 2, "room used before adding a buffer");
+
+			iovec iov[8];
+			int n = chain.to_iovec(iov, 8);
+			ASSERT_EQ(int, n, 2, "one element per buffer");
+			ASSERT_EQ(bool, iov[1].iov_base == b.data(), true, "appended buffer not copied");
+
+			chain.consume(100);
+			ASSERT_EQ(size_t, chain.length(), 66, "consumed");
+			ASSERT_EQ(char, chain.at(0).data()[0], 'x', "data after consume");
+			chain.consume(60);
+			ASSERT_EQ(size_t, chain.count(), 1, "used up buffer released");
+			ASSERT_EQ(int, memcmp(chain.at(0).data(), " world", 6), 0, "data after consume");
+
+			// Reads handed out without copying.
+			std::array<snf::net::socket, 2> sp = std::move(snf::net::socket::socketpair());
+			int bwritten = 0;
+			sp[1].writen("abcdefghij", 10, &bwritten);
+
+			snf::net::iobuf r1, r2;
+			ASSERT_EQ(int, sp[0].read(r1, 4, 1000), E_ok, "first read");
+			ASSERT_EQ(int, sp[0].read(r2, 100, 1000), E_ok, "second read");
+			ASSERT_EQ(int, r1.size(), 4, "first read size");
+			ASSERT_EQ(int, r2.size(), 6, "second read size");
+			ASSERT_EQ(bool, (r1.data() + 4) == r2.data(), true, "views of the read buffer");
+
+			sp[1].writen("klmno", 5, &bwritten);
+			snf::net::iobuf r3;
+			ASSERT_EQ(int, sp[0].read(r3, 100, 1000), E_ok, "third read");
+			ASSERT_EQ(bool, r3.data() != r1.data(), true, "shared read buffer not overwritten");
+			ASSERT_EQ(int, memcmp(r1.data(), "abcd", 4), 0, "first data intact");
+			ASSERT_EQ(int, memcmp(r3.data(), "klmno", 5), 0, "third data matches");
+
+			snf::net::iobuf_chain out;
+			out.append(r1);
+			out.append(r3);
+			ASSERT_EQ(int, sp[0].write(out, &bwritten, 1000), E_ok, "chain written");
+			char buf[16];
+			int bread = 0;
+			sp[1].readn(buf, 9, &bread, 1000);
+			ASSERT_EQ(int, memcmp(buf, "abcdklmno", 9), 0, "chain data matches");
+		} catch (const std::system_error &ex) {
+			std::cerr << "system error: " << ex.code() << std::endl;
+			std::cerr << ex.what() << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+};
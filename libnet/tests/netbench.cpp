@@ -0,0 +1,871 @@
+#include "net.h"
+#include "cnxn.h"
+#include "asyncio.h"
+#include "iobuf.h"
+#include "json.h"
+#include "logmgr.h"
+#include "flogger.h"
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+#include <csignal>
+
+/*
+ * Throughput and latency benchmark for libnet.
+ *
+ * An echo server and the clients run in the same process, over
+ * the loopback interface. The server accepts the connections on
+ * a reactor and echoes the data back with async_io. The clients
+ * are driven by their own reactors: every connection keeps up to
+ * <depth> messages of <size> bytes in flight (pipelining) and
+ * records the round trip time of every message. The throughput
+ * (msgs/s, Gbps of payload one way) and the latency percentiles
+ * are reported.
+ *
+ * With -handshakes, <conns> threads also open and close that
+ * many connections (TLS handshakes with -ssl) and the setup rate
+ * and latency are reported.
+ *
+ * -poller takes a comma separated list of reactor backends; the
+ * benchmark is run once with each, so the backends can be compared
+ * with the same settings. -bufsize (nio read buffer), -sockbuf
+ * (kernel socket buffers), -poollimit (iobuf pool) and -nodelay
+ * change the buffering.
+ *
+ * TLS requires the server key and certificate, e.g.
+ *
+ *   openssl req -x509 -newkey rsa:2048 -nodes -days 30 \
+ *       -subj /CN=localhost -keyout key.pem -out cert.pem
+ */
+
+struct bench_config
+{
+	int                                     size = 64;
+	int                                     conns = 1;
+	int                                     depth = 1;
+	int64_t                                 messages = 100000;  // per connection
+	int                                     seconds = 0;
+	int                                     reactors = 1;
+	int                                     bufsize = snf::net::nio::DEFAULT_BUFSIZE;
+	int                                     sockbuf = 0;
+	bool                                    nodelay = true;
+	int64_t                                 handshakes = 0;
+	bool                                    use_ssl = false;
+	std::string                             keyfile;
+	std::string                             certfile;
+	std::string                             keypass;
+	std::vector<snf::net::poller_type>      pollers;
+	std::ostream                            *rpt = &std::cout;  // human-readable report
+};
+
+typedef std::chrono::steady_clock bench_clock;
+
+static inline int64_t
+ElapsedNs(const bench_clock::time_point &start)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			bench_clock::now() - start).count();
+}
+
+/*
+ * Latencies (in nanoseconds) and the error count.
+ */
+class LatencyStats
+{
+public:
+	std::vector<int64_t>    latencies;
+	int64_t                 errors;
+
+	LatencyStats() : errors(0) {}
+
+	void merge(const LatencyStats &s)
+	{
+		latencies.insert(latencies.end(), s.latencies.begin(), s.latencies.end());
+		errors += s.errors;
+	}
+
+	snf::json::object report(std::ostream &os, const char *name)
+	{
+		snf::json::object o;
+		int64_t count = int64_t(latencies.size());
+
+		o.add(KVPAIR("count", count));
+		o.add(KVPAIR("errors", errors));
+
+		if (count == 0)
+			return o;
+
+		std::sort(latencies.begin(), latencies.end());
+
+		double sum = 0.0;
+		for (int64_t l : latencies)
+			sum += double(l);
+
+		double avg = sum / double(count) / 1000.0;
+		double p50 = double(percentile(50.0)) / 1000.0;
+		double p99 = double(percentile(99.0)) / 1000.0;
+		double p999 = double(percentile(99.9)) / 1000.0;
+		double max = double(latencies.back()) / 1000.0;
+
+		o.add(KVPAIR("avg_us", avg));
+		o.add(KVPAIR("p50_us", p50));
+		o.add(KVPAIR("p99_us", p99));
+		o.add(KVPAIR("p999_us", p999));
+		o.add(KVPAIR("max_us", max));
+
+		char line[256];
+		snprintf(line, sizeof(line),
+			"  %-10s count=%" PRId64 " errors=%" PRId64
+			" avg=%.2fus p50=%.2fus p99=%.2fus p999=%.2fus max=%.2fus",
+			name, count, errors, avg, p50, p99, p999, max);
+		os << line << std::endl;
+
+		return o;
+	}
+
+private:
+	int64_t percentile(double p) const
+	{
+		size_t idx = size_t(std::ceil(p / 100.0 * double(latencies.size())));
+		if (idx > 0)
+			idx--;
+		if (idx >= latencies.size())
+			idx = latencies.size() - 1;
+		return latencies[idx];
+	}
+};
+
+static void
+SetupSocket(const bench_config &cfg, snf::net::socket &s)
+{
+	s.tcpnodelay(cfg.nodelay);
+	if (cfg.sockbuf > 0) {
+		s.rcvbuf(cfg.sockbuf);
+		s.sndbuf(cfg.sockbuf);
+	}
+}
+
+class EchoServer;
+
+/*
+ * Server side of a connection: does the TLS handshake, if any,
+ * and echoes the data read back. Deletes itself when the peer
+ * closes the connection.
+ */
+class EchoSession
+{
+private:
+	friend class HandshakeHandler;
+
+	EchoServer                                      &m_srv;
+	snf::net::reactor                               &m_reactor;
+	std::unique_ptr<snf::net::socket>               m_sock;
+	std::unique_ptr<snf::net::ssl::connection>      m_cnxn;
+	std::unique_ptr<snf::net::async_io>             m_aio;
+	std::vector<char>                               m_buf;
+
+	void read();
+	void write(int);
+
+public:
+	EchoSession(EchoServer &, snf::net::reactor &, std::unique_ptr<snf::net::socket> &);
+	~EchoSession();
+
+	void start();
+	void echo();
+	void close();
+};
+
+/*
+ * Drives the server side TLS handshake on the reactor.
+ */
+class HandshakeHandler : public snf::net::handler
+{
+private:
+	EchoSession         *m_sess;
+	snf::net::event     m_event;
+
+public:
+	HandshakeHandler(EchoSession *sess, snf::net::event e) : m_sess(sess), m_event(e) {}
+	virtual ~HandshakeHandler() {}
+
+	virtual const char *name() const
+	{
+		return "netbench-handshake-handler";
+	}
+
+	virtual bool operator()(sock_t s, snf::net::event e) override
+	{
+		if (e != m_event) {
+			m_sess->close();
+			return false;
+		}
+
+		bool want_write = false;
+		int retval;
+
+		try {
+			retval = m_sess->m_cnxn->try_handshake(*m_sess->m_sock, &want_write);
+		} catch (const std::system_error &) {
+			retval = E_ssl_error;
+		}
+
+		if (retval == E_try_again) {
+			snf::net::event next = want_write ? snf::net::event::write : snf::net::event::read;
+			if (next == m_event)
+				return true;
+			m_sess->m_reactor.add_handler(s, next, DBG_NEW HandshakeHandler(m_sess, next), 5000);
+			return false;
+		} else if (retval != E_ok) {
+			m_sess->close();
+			return false;
+		}
+
+		m_sess->echo();
+		return false;
+	}
+};
+
+/*
+ * Loopback echo server on a reactor group. The listening socket
+ * is on the first reactor; the connections are spread over all
+ * of them.
+ */
+class EchoServer
+{
+private:
+	friend class EchoSession;
+
+	class AcceptHandler : public snf::net::handler
+	{
+	private:
+		EchoServer  &m_srv;
+
+	public:
+		AcceptHandler(EchoServer &srv) : m_srv(srv) {}
+		virtual ~AcceptHandler() {}
+
+		virtual const char *name() const
+		{
+			return "netbench-accept-handler";
+		}
+
+		virtual bool operator()(sock_t, snf::net::event e) override
+		{
+			if (e != snf::net::event::read)
+				return true;
+
+			for (int i = 0; i < 64; ++i) {
+				std::unique_ptr<snf::net::socket> s;
+				if (m_srv.m_lsock.accept(s) != E_ok)
+					break;
+				SetupSocket(m_srv.m_cfg, *s);
+				EchoSession *sess = DBG_NEW EchoSession(m_srv, m_srv.m_reactors.next(), s);
+				sess->start();
+			}
+
+			return true;
+		}
+	};
+
+	const bench_config                          &m_cfg;
+	snf::net::reactor_group                     m_reactors;
+	snf::net::socket                            m_lsock;
+	std::unique_ptr<snf::net::ssl::context>     m_ctx;
+	std::atomic<int>                            m_sessions { 0 };
+
+public:
+	EchoServer(const bench_config &cfg, snf::net::poller_type type)
+		: m_cfg(cfg)
+		, m_reactors(cfg.reactors, 100, type)
+		, m_lsock(AF_INET, snf::net::socket_type::tcp)
+	{
+		if (cfg.use_ssl) {
+			m_ctx.reset(DBG_NEW snf::net::ssl::context);
+			const char *passwd = cfg.keypass.empty() ? nullptr : cfg.keypass.c_str();
+			snf::net::ssl::pkey key { snf::net::ssl::data_fmt::pem, cfg.keyfile, passwd };
+			snf::net::ssl::x509_certificate cert { snf::net::ssl::data_fmt::pem, cfg.certfile };
+			m_ctx->use_private_key(key);
+			m_ctx->use_certificate(cert);
+			m_ctx->check_private_key();
+			m_ctx->set_ciphers();
+		}
+
+		m_lsock.reuseaddr(true);
+		m_lsock.bind(snf::net::internet_address { "127.0.0.1" }, 0);
+		m_lsock.listen(SOMAXCONN);
+		m_lsock.blocking(false);
+		m_reactors[0].add_handler(m_lsock, snf::net::event::read, DBG_NEW AcceptHandler(*this));
+	}
+
+	~EchoServer()
+	{
+		// Give the sessions time to see the clients go away.
+		for (int i = 0; (i < 500) && (m_sessions.load() > 0); ++i)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		m_reactors[0].remove_handler(m_lsock);
+		m_reactors.stop();
+		m_lsock.close();
+	}
+
+	in_port_t port() { return m_lsock.local_address().port(); }
+	const char *poller_name() { return m_reactors[0].poller_name(); }
+};
+
+EchoSession::EchoSession(EchoServer &srv, snf::net::reactor &r, std::unique_ptr<snf::net::socket> &s)
+	: m_srv(srv)
+	, m_reactor(r)
+	, m_sock(std::move(s))
+	, m_buf(snf::net::iobuf_pool::LARGE_SIZE)
+{
+	m_srv.m_sessions++;
+}
+
+EchoSession::~EchoSession()
+{
+	m_aio.reset();
+	m_cnxn.reset();
+	m_sock->close();
+	m_srv.m_sessions--;
+}
+
+void
+EchoSession::start()
+{
+	if (m_srv.m_ctx) {
+		m_cnxn.reset(DBG_NEW snf::net::ssl::connection { snf::net::connection_mode::server, *m_srv.m_ctx });
+		m_reactor.add_handler(*m_sock, snf::net::event::read,
+			DBG_NEW HandshakeHandler(this, snf::net::event::read), 5000);
+	} else {
+		echo();
+	}
+}
+
+void
+EchoSession::echo()
+{
+	snf::net::nio *io = m_cnxn ? static_cast<snf::net::nio *>(m_cnxn.get()) : m_sock.get();
+	io->setbuf(m_srv.m_cfg.bufsize);
+	m_aio.reset(DBG_NEW snf::net::async_io(m_reactor, *m_sock, io));
+	read();
+}
+
+void
+EchoSession::read()
+{
+	m_aio->async_read(m_buf.data(), static_cast<int>(m_buf.size()), [this] (const snf::net::io_result &r) {
+		if ((r.status != E_ok) || (r.bytes == 0))
+			close();
+		else
+			write(r.bytes);
+	});
+}
+
+void
+EchoSession::write(int len)
+{
+	m_aio->async_write(m_buf.data(), len, [this] (const snf::net::io_result &r) {
+		if (r.status != E_ok)
+			close();
+		else
+			read();
+	});
+}
+
+/*
+ * Deletes the session once the current callback returns.
+ */
+void
+EchoSession::close()
+{
+	m_reactor.post([this] () { delete this; });
+}
+
+/*
+ * Client side of a connection. Keeps up to <depth> messages in
+ * flight until all the messages are echoed back (or the time is
+ * up), on the reactor thread.
+ */
+class EchoClient
+{
+private:
+	const bench_config                          &m_cfg;
+	snf::net::socket                            m_sock;
+	std::unique_ptr<snf::net::ssl::connection>  m_cnxn;
+	std::unique_ptr<snf::net::async_io>         m_aio;
+	std::vector<char>                           m_out;
+	std::vector<char>                           m_in;
+	std::vector<bench_clock::time_point>        m_sent;
+	int64_t                                     m_limit;
+	int64_t                                     m_nsent = 0;
+	int64_t                                     m_nrecvd = 0;
+	int                                         m_partial = 0;
+	bool                                        m_writing = false;
+	bench_clock::time_point                     m_deadline;
+	std::promise<void>                          m_done;
+
+	void send();
+	void recv();
+	void finish(bool);
+
+public:
+	LatencyStats                                stats;
+
+	EchoClient(const bench_config &, snf::net::ssl::context *, in_port_t);
+	~EchoClient();
+
+	std::future<void> start(snf::net::reactor &);
+	int64_t messages() const { return m_nrecvd; }
+};
+
+EchoClient::EchoClient(const bench_config &cfg, snf::net::ssl::context *ctx, in_port_t port)
+	: m_cfg(cfg)
+	, m_sock(AF_INET, snf::net::socket_type::tcp)
+	, m_out(size_t(cfg.size) * size_t(cfg.depth), 'm')
+	, m_in(snf::net::iobuf_pool::LARGE_SIZE)
+	, m_sent(cfg.depth)
+	, m_limit(cfg.seconds > 0 ? INT64_MAX : cfg.messages)
+{
+	SetupSocket(cfg, m_sock);
+	m_sock.connect(AF_INET, "127.0.0.1", port, 5000);
+
+	snf::net::nio *io = &m_sock;
+	if (ctx) {
+		m_cnxn.reset(DBG_NEW snf::net::ssl::connection { snf::net::connection_mode::client, *ctx });
+		m_cnxn->handshake(m_sock, 5000);
+		io = m_cnxn.get();
+	}
+
+	m_sock.blocking(false);
+	io->setbuf(cfg.bufsize);
+
+	if (m_cfg.seconds <= 0)
+		stats.latencies.reserve(size_t(m_limit));
+}
+
+EchoClient::~EchoClient()
+{
+	m_aio.reset();
+	m_cnxn.reset();
+	m_sock.close();
+}
+
+std::future<void>
+EchoClient::start(snf::net::reactor &r)
+{
+	snf::net::nio *io = m_cnxn ? static_cast<snf::net::nio *>(m_cnxn.get()) : &m_sock;
+	m_aio.reset(DBG_NEW snf::net::async_io(r, m_sock, io));
+	m_deadline = bench_clock::now() + std::chrono::seconds(m_cfg.seconds);
+
+	std::future<void> f = m_done.get_future();
+	if (m_limit == 0) {
+		m_done.set_value();
+	} else {
+		r.post([this] () { send(); recv(); });
+	}
+	return f;
+}
+
+/*
+ * Writes the messages that fit in the pipeline with one write.
+ */
+void
+EchoClient::send()
+{
+	if (m_writing)
+		return;
+
+	if ((m_cfg.seconds > 0) && (m_limit == INT64_MAX) && (bench_clock::now() >= m_deadline))
+		m_limit = m_nsent;
+
+	int64_t n = std::min(int64_t(m_cfg.depth) - (m_nsent - m_nrecvd), m_limit - m_nsent);
+	if (n <= 0)
+		return;
+
+	bench_clock::time_point now = bench_clock::now();
+	for (int64_t i = 0; i < n; ++i)
+		m_sent[size_t((m_nsent + i) % m_cfg.depth)] = now;
+	m_nsent += n;
+
+	m_writing = true;
+	m_aio->async_write(m_out.data(), int(n) * m_cfg.size, [this] (const snf::net::io_result &r) {
+		m_writing = false;
+		if (r.status != E_ok)
+			finish(false);
+		else
+			send();
+	});
+}
+
+void
+EchoClient::recv()
+{
+	m_aio->async_read(m_in.data(), static_cast<int>(m_in.size()), [this] (const snf::net::io_result &r) {
+		if ((r.status != E_ok) || (r.bytes == 0)) {
+			finish(false);
+			return;
+		}
+
+		bench_clock::time_point now = bench_clock::now();
+		m_partial += r.bytes;
+		while (m_partial >= m_cfg.size) {
+			const bench_clock::time_point &sent = m_sent[size_t(m_nrecvd % m_cfg.depth)];
+			stats.latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				now - sent).count());
+			m_nrecvd++;
+			m_partial -= m_cfg.size;
+		}
+
+		send();
+
+		if ((m_nrecvd == m_nsent) && (m_nsent == m_limit))
+			finish(true);
+		else
+			recv();
+	}, 10000);
+}
+
+void
+EchoClient::finish(bool ok)
+{
+	if (!ok)
+		stats.errors++;
+	m_done.set_value();
+}
+
+/*
+ * Opens and closes connections, doing the TLS handshake if the
+ * context is given, and records the time to set them up.
+ */
+static void
+HandshakeWorker(in_port_t port, snf::net::ssl::context *ctx, int64_t count, LatencyStats *stats)
+{
+	for (int64_t i = 0; i < count; ++i) {
+		try {
+			bench_clock::time_point start = bench_clock::now();
+			snf::net::socket s { AF_INET, snf::net::socket_type::tcp };
+			s.connect(AF_INET, "127.0.0.1", port, 5000);
+			if (ctx) {
+				snf::net::ssl::connection cnxn { snf::net::connection_mode::client, *ctx };
+				cnxn.handshake(s, 5000);
+				stats->latencies.push_back(ElapsedNs(start));
+				cnxn.shutdown();
+			} else {
+				stats->latencies.push_back(ElapsedNs(start));
+			}
+			s.close();
+		} catch (const std::system_error &) {
+			stats->errors++;
+		}
+	}
+}
+
+static snf::json::object
+RunEcho(const bench_config &cfg, EchoServer &srv, snf::net::ssl::context *ctx, snf::net::poller_type type)
+{
+	snf::json::object o;
+	std::vector<std::unique_ptr<EchoClient>> clients;
+	std::vector<std::future<void>> done;
+
+	for (int c = 0; c < cfg.conns; ++c)
+		clients.emplace_back(DBG_NEW EchoClient(cfg, ctx, srv.port()));
+
+	bench_clock::time_point start = bench_clock::now();
+
+	{
+		snf::net::reactor_group reactors(cfg.reactors, 100, type);
+		for (int c = 0; c < cfg.conns; ++c)
+			done.push_back(clients[c]->start(reactors.next()));
+		for (std::future<void> &f : done)
+			f.wait();
+
+		double secs = double(ElapsedNs(start)) / 1e9;
+
+		LatencyStats total;
+		for (std::unique_ptr<EchoClient> &c : clients)
+			total.merge(c->stats);
+
+		int64_t msgs = int64_t(total.latencies.size());
+		double mps = double(msgs) / secs;
+		double gbps = double(msgs) * double(cfg.size) * 8.0 / secs / 1e9;
+
+		char line[256];
+		snprintf(line, sizeof(line), "  echo: %.3f seconds, %.0f msgs/s, %.3f Gbps", secs, mps, gbps);
+		*cfg.rpt << line << std::endl;
+
+		o.add(KVPAIR("seconds", secs));
+		o.add(KVPAIR("msgs_per_sec", mps));
+		o.add(KVPAIR("gbps", gbps));
+		o.add(KVPAIR("latency", total.report(*cfg.rpt, "rtt")));
+
+		clients.clear();
+	}
+
+	return o;
+}
+
+static snf::json::object
+RunHandshakes(const bench_config &cfg, EchoServer &srv, snf::net::ssl::context *ctx)
+{
+	snf::json::object o;
+	std::vector<LatencyStats> stats(cfg.conns);
+	std::vector<std::thread> workers;
+
+	bench_clock::time_point start = bench_clock::now();
+
+	for (int t = 0; t < cfg.conns; ++t) {
+		int64_t count = cfg.handshakes / cfg.conns;
+		if (t < (cfg.handshakes % cfg.conns))
+			count++;
+		workers.push_back(std::thread(HandshakeWorker, srv.port(), ctx, count, &stats[t]));
+	}
+
+	LatencyStats total;
+	for (int t = 0; t < cfg.conns; ++t) {
+		workers[t].join();
+		total.merge(stats[t]);
+	}
+
+	double secs = double(ElapsedNs(start)) / 1e9;
+	double hps = double(total.latencies.size()) / secs;
+
+	char line[256];
+	snprintf(line, sizeof(line), "  %s: %.3f seconds, %.0f/s",
+		ctx ? "handshakes" : "connects", secs, hps);
+	*cfg.rpt << line << std::endl;
+
+	o.add(KVPAIR("seconds", secs));
+	o.add(KVPAIR("per_sec", hps));
+	o.add(KVPAIR("latency", total.report(*cfg.rpt, "setup")));
+	return o;
+}
+
+static bool
+ParsePollers(const std::string &list, std::vector<snf::net::poller_type> &pollers)
+{
+	size_t pos = 0;
+
+	while (pos <= list.size()) {
+		size_t end = list.find(',', pos);
+		if (end == std::string::npos)
+			end = list.size();
+
+		std::string name = list.substr(pos, end - pos);
+		if (name == "dflt")
+			pollers.push_back(snf::net::poller_type::dflt);
+		else if (name == "poll")
+			pollers.push_back(snf::net::poller_type::poll);
+		else if (name == "epoll")
+			pollers.push_back(snf::net::poller_type::epoll);
+		else if (name == "uring")
+			pollers.push_back(snf::net::poller_type::uring);
+		else
+			return false;
+
+		pos = end + 1;
+	}
+
+	return true;
+}
+
+static int
+usage(const char *prog)
+{
+	std::cerr
+		<< prog
+		<< " [-size <msg_size>] [-conns <num>] [-depth <pipeline_depth>]" << std::endl
+		<< "        [-messages <num_per_conn>] [-seconds <num>] [-handshakes <num>]" << std::endl
+		<< "        [-poller <dflt|poll|epoll|uring>[,...]] [-reactors <num>]" << std::endl
+		<< "        [-bufsize <nio_bufsize>] [-sockbuf <bytes>] [-poollimit <bytes>]" << std::endl
+		<< "        [-nodelay <0|1>] [-ssl -key <key_file> -cert <cert_file> [-keypass <password>]]" << std::endl
+		<< "        [-json <file|->] [-logpath <log_path>]" << std::endl;
+	return 1;
+}
+
+static bool
+IntArg(int argc, const char **argv, int &i, int64_t lo, int64_t hi, int64_t &val)
+{
+	const char *opt = argv[i];
+
+	if (++i >= argc) {
+		std::cerr << "missing argument to " << opt << std::endl;
+		return false;
+	}
+
+	val = strtoll(argv[i], 0, 10);
+	if ((val < lo) || (val > hi)) {
+		std::cerr << "invalid argument to " << opt << " (" << argv[i] << ")" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+int
+main(int argc, const char **argv)
+{
+	const char      *prog = argv[0];
+	bench_config    cfg;
+	std::string     jsonFile;
+	std::string     logPath;
+	int64_t         val;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp("-size", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 1, 16 * 1024 * 1024, val)) return usage(prog);
+			cfg.size = int(val);
+		} else if (strcmp("-conns", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 1, 10000, val)) return usage(prog);
+			cfg.conns = int(val);
+		} else if (strcmp("-depth", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 1, 1024, val)) return usage(prog);
+			cfg.depth = int(val);
+		} else if (strcmp("-messages", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 0, INT64_C(1) << 40, cfg.messages)) return usage(prog);
+		} else if (strcmp("-seconds", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 0, 3600, val)) return usage(prog);
+			cfg.seconds = int(val);
+		} else if (strcmp("-handshakes", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 0, INT64_C(1) << 40, cfg.handshakes)) return usage(prog);
+		} else if (strcmp("-poller", argv[i]) == 0) {
+			if (++i >= argc) return usage(prog);
+			if (!ParsePollers(argv[i], cfg.pollers)) {
+				std::cerr << "invalid poller (" << argv[i] << ")" << std::endl;
+				return usage(prog);
+			}
+		} else if (strcmp("-reactors", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 1, 64, val)) return usage(prog);
+			cfg.reactors = int(val);
+		} else if (strcmp("-bufsize", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 0, 65536, val)) return usage(prog);
+			cfg.bufsize = int(val);
+		} else if (strcmp("-sockbuf", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 0, INT32_MAX, val)) return usage(prog);
+			cfg.sockbuf = int(val);
+		} else if (strcmp("-poollimit", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 0, INT64_C(1) << 40, val)) return usage(prog);
+			snf::net::iobuf_pool::instance().limit(size_t(val));
+		} else if (strcmp("-nodelay", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 0, 1, val)) return usage(prog);
+			cfg.nodelay = (val != 0);
+		} else if (strcmp("-ssl", argv[i]) == 0) {
+			cfg.use_ssl = true;
+		} else if (strcmp("-key", argv[i]) == 0) {
+			if (++i >= argc) return usage(prog);
+			cfg.keyfile = argv[i];
+		} else if (strcmp("-cert", argv[i]) == 0) {
+			if (++i >= argc) return usage(prog);
+			cfg.certfile = argv[i];
+		} else if (strcmp("-keypass", argv[i]) == 0) {
+			if (++i >= argc) return usage(prog);
+			cfg.keypass = argv[i];
+		} else if (strcmp("-json", argv[i]) == 0) {
+			if (++i >= argc) return usage(prog);
+			jsonFile = argv[i];
+		} else if (strcmp("-logpath", argv[i]) == 0) {
+			if (++i >= argc) return usage(prog);
+			logPath = argv[i];
+		} else {
+			return usage(prog);
+		}
+	}
+
+	if (cfg.use_ssl && (cfg.keyfile.empty() || cfg.certfile.empty())) {
+		std::cerr << "-key and -cert are required with -ssl" << std::endl;
+		return usage(prog);
+	}
+
+	// Keep the debug messages of the library off the console.
+	if (logPath.empty()) {
+		snf::log::console_logger *clog = DBG_NEW snf::log::console_logger {
+						snf::log::severity::warning };
+		clog->set_destination(snf::log::console_logger::destination::err);
+		snf::log::manager::instance().add_logger(clog);
+	} else {
+		snf::log::file_logger *flog = DBG_NEW snf::log::file_logger {
+						logPath,
+						snf::log::severity::info };
+		flog->make_path(true);
+		snf::log::manager::instance().add_logger(flog);
+	}
+
+	// With -json -, the standard output carries the JSON only.
+	if (jsonFile == "-")
+		cfg.rpt = &std::cerr;
+
+	if (cfg.pollers.empty())
+		cfg.pollers.push_back(snf::net::poller_type::dflt);
+
+#if !defined(_WIN32)
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	snf::json::object result;
+	snf::json::array runs;
+
+	try {
+		snf::net::initialize(cfg.use_ssl);
+
+		std::unique_ptr<snf::net::ssl::context> ctx;
+		if (cfg.use_ssl) {
+			ctx.reset(DBG_NEW snf::net::ssl::context);
+			ctx->set_ciphers();
+		}
+
+		result.add(KVPAIR("transport", cfg.use_ssl ? "tls" : "tcp"));
+		result.add(KVPAIR("size", cfg.size));
+		result.add(KVPAIR("conns", cfg.conns));
+		result.add(KVPAIR("depth", cfg.depth));
+		result.add(KVPAIR("messages", cfg.messages));
+		result.add(KVPAIR("seconds", cfg.seconds));
+		result.add(KVPAIR("reactors", cfg.reactors));
+		result.add(KVPAIR("bufsize", cfg.bufsize));
+		result.add(KVPAIR("sockbuf", cfg.sockbuf));
+		result.add(KVPAIR("nodelay", cfg.nodelay));
+
+		for (snf::net::poller_type type : cfg.pollers) {
+			snf::json::object run;
+			EchoServer srv(cfg, type);
+
+			*cfg.rpt << srv.poller_name() << ": "
+				<< (cfg.use_ssl ? "tls" : "tcp") << ", "
+				<< cfg.conns << " connection(s), "
+				<< cfg.size << " byte messages, depth "
+				<< cfg.depth << std::endl;
+
+			run.add(KVPAIR("poller", srv.poller_name()));
+			if ((cfg.messages > 0) || (cfg.seconds > 0))
+				run.add(KVPAIR("echo", RunEcho(cfg, srv, ctx.get(), type)));
+			if (cfg.handshakes > 0)
+				run.add(KVPAIR("handshakes", RunHandshakes(cfg, srv, ctx.get())));
+			runs.add(run);
+		}
+	} catch (const std::system_error &ex) {
+		std::cerr << "system error: " << ex.code() << std::endl;
+		std::cerr << ex.what() << std::endl;
+		return 1;
+	} catch (const std::exception &ex) {
+		std::cerr << ex.what() << std::endl;
+		return 1;
+	}
+
+	result.add(KVPAIR("runs", runs));
+
+	if (jsonFile == "-") {
+		std::cout << result.str(true) << std::endl;
+	} else if (!jsonFile.empty()) {
+		std::ofstream out(jsonFile);
+		if (!out) {
+			std::cerr << "failed to open " << jsonFile << std::endl;
+			return 1;
+		}
+		out << result.str(true) << std::endl;
+	}
+
+	return 0;
+}
@@ -4,6 +4,16 @@
 #include "key.h"
 #include "certificate.h"
 #include "sctx.h"
+#include "tmwheel.h"
+#include "rctr.h"
+#include "rdline.h"
+#include "shcache.h"
+#include "snilookup.h"
+#include "rslvr.h"
+#include "connpool.h"
+#include "aio.h"
+#include "udp.h"
+#include "iobufs.h"
 
 namespace snf {
 namespace tf {
@@ -13,6 +23,16 @@ test *test_list[] = {
 	DBG_NEW priv_key(),
 	DBG_NEW certificate(),
 	DBG_NEW sctx(),
+	DBG_NEW tmwheel(),
+	DBG_NEW rctr(),
+	DBG_NEW rdline(),
+	DBG_NEW shcache(),
+	DBG_NEW snilookup(),
+	DBG_NEW rslvr(),
+	DBG_NEW connpool(),
+	DBG_NEW aio(),
+	DBG_NEW udp(),
+	DBG_NEW iobufs(),
 	0
 };
 
@@ -0,0 +1,357 @@
+#include "sock.h"
+#include "reactor.h"
+#include <condition_variable>
+#include <thread>
+
+class rctr : public snf::tf::test
+{
+private:
+	static constexpr const char *class_name = "rctr";
+
+	/*
+	 * Counts the events received. Reads the data on
+	 * the read event so that the socket is not ready
+	 * again.
+	 */
+	class counting_handler : public snf::net::handler
+	{
+	private:
+		snf::net::socket        &m_sock;
+		std::mutex              &m_lock;
+		std::condition_variable &m_cv;
+		int                     &m_reads;
+		int                     &m_timeouts;
+		bool                    m_again;
+
+	public:
+		counting_handler(snf::net::socket &s, std::mutex &lock, std::condition_variable &cv,
+			int &reads, int &timeouts, bool again)
+			: m_sock(s), m_lock(lock), m_cv(cv)
+			, m_reads(reads), m_timeouts(timeouts), m_again(again)
+		{
+		}
+
+		virtual const char *name() const { return "counting-handler"; }
+
+		virtual bool operator()(sock_t s, snf::net::event e) override
+		{
+			if (e == snf::net::event::read) {
+				int dummy = 0;
+				m_sock.read_integral(&dummy, snf::net::POLL_WAIT_NONE);
+			}
+
+			std::lock_guard<std::mutex> guard(m_lock);
+			if (e == snf::net::event::read)
+				m_reads++;
+			else if (e == snf::net::event::timeout)
+				m_timeouts++;
+			m_cv.notify_all();
+			return m_again;
+		}
+	};
+
+	/*
+	 * Accepts a connection and counts it.
+	 */
+	class accepting_handler : public snf::net::handler
+	{
+	private:
+		snf::net::socket        &m_sock;
+		std::mutex              &m_lock;
+		std::condition_variable &m_cv;
+		int                     &m_accepts;
+
+	public:
+		accepting_handler(snf::net::socket &s, std::mutex &lock, std::condition_variable &cv,
+			int &accepts)
+			: m_sock(s), m_lock(lock), m_cv(cv), m_accepts(accepts)
+		{
+		}
+
+		virtual const char *name() const { return "accepting-handler"; }
+
+		virtual bool operator()(sock_t s, snf::net::event e) override
+		{
+			if (e != snf::net::event::read)
+				return false;
+
+			snf::net::socket nsock = std::move(m_sock.accept());
+
+			std::lock_guard<std::mutex> guard(m_lock);
+			m_accepts++;
+			m_cv.notify_all();
+			return true;
+		}
+	};
+
+	/*
+	 * Accepts the connections the reactor has accepted, and
+	 * switches them to multishot receive.
+	 */
+	class multishot_handler : public snf::net::handler
+	{
+	private:
+		snf::net::reactor                               &m_reactor;
+		snf::net::socket                                &m_sock;
+		std::mutex                                      &m_lock;
+		std::condition_variable                         &m_cv;
+		std::vector<std::unique_ptr<snf::net::socket>>  &m_accepted;
+
+	public:
+		multishot_handler(snf::net::reactor &r, snf::net::socket &s, std::mutex &lock,
+			std::condition_variable &cv, std::vector<std::unique_ptr<snf::net::socket>> &accepted)
+			: m_reactor(r), m_sock(s), m_lock(lock), m_cv(cv), m_accepted(accepted)
+		{
+		}
+
+		virtual const char *name() const { return "multishot-handler"; }
+
+		virtual bool operator()(sock_t s, snf::net::event e) override
+		{
+			if (e != snf::net::event::read)
+				return false;
+
+			std::unique_ptr<snf::net::socket> nsock;
+			while (m_sock.accept(nsock) == E_ok) {
+				if (!m_reactor.recv_multishot(*nsock))
+					return false;
+
+				std::lock_guard<std::mutex> guard(m_lock);
+				m_accepted.push_back(std::move(nsock));
+				m_cv.notify_all();
+			}
+
+			return true;
+		}
+	};
+
+	std::mutex              m_lock;
+	std::condition_variable m_cv;
+	int                     m_reads = 0;
+	int                     m_timeouts = 0;
+	int                     m_accepts = 0;
+
+	bool wait_for(int *counter, int count, int ms = 2000)
+	{
+		std::unique_lock<std::mutex> guard(m_lock);
+		return m_cv.wait_for(guard, std::chrono::milliseconds(ms),
+			[counter, count] () { return *counter >= count; });
+	}
+
+	void reset()
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_reads = 0;
+		m_timeouts = 0;
+	}
+
+	bool run_reactor(snf::net::poller_type type)
+	{
+		snf::net::reactor r(snf::net::POLL_WAIT_FOREVER, type);
+		std::cout << "using " << r.poller_name() << " poller" << std::endl;
+
+		std::array<snf::net::socket, 2> sp = std::move(snf::net::socket::socketpair());
+		sp[0].blocking(false);
+
+		reset();
+
+		// Persistent registration: every write is dispatched once.
+		r.add_handler(sp[0], snf::net::event::read,
+			DBG_NEW counting_handler(sp[0], m_lock, m_cv, m_reads, m_timeouts, true));
+		for (int i = 1; i <= 5; ++i) {
+			sp[1].write_integral(i);
+			ASSERT_EQ(bool, wait_for(&m_reads, i), true, "read event received");
+		}
+
+		// Timeout: no data for 50ms.
+		r.add_handler(sp[0], snf::net::event::read,
+			DBG_NEW counting_handler(sp[0], m_lock, m_cv, m_reads, m_timeouts, true), 50);
+		ASSERT_EQ(bool, wait_for(&m_timeouts, 2), true, "timeout events received");
+
+		// One-shot: the handler is removed after the first event.
+		reset();
+		r.add_handler(sp[0], snf::net::event::read,
+			DBG_NEW counting_handler(sp[0], m_lock, m_cv, m_reads, m_timeouts, false));
+		sp[1].write_integral(1);
+		ASSERT_EQ(bool, wait_for(&m_reads, 1), true, "read event received");
+		sp[1].write_integral(2);
+		ASSERT_EQ(bool, wait_for(&m_reads, 2, 200), false, "handler is not called again");
+
+		// General purpose timers.
+		int fired = 0;
+		snf::net::timer_id tid = r.add_timer(100, [this, &fired] () {
+			std::lock_guard<std::mutex> guard(m_lock);
+			fired += 1;
+			m_cv.notify_all();
+		});
+		r.add_timer(20, [this, &fired] () {
+			std::lock_guard<std::mutex> guard(m_lock);
+			fired += 10;
+			m_cv.notify_all();
+		});
+		ASSERT_EQ(bool, wait_for(&fired, 10), true, "timer expired");
+		ASSERT_EQ(bool, r.cancel_timer(tid), true, "timer cancelled");
+		ASSERT_EQ(bool, wait_for(&fired, 11, 200), false, "cancelled timer did not expire");
+
+		// Removed handler.
+		r.add_handler(sp[0], snf::net::event::read,
+			DBG_NEW counting_handler(sp[0], m_lock, m_cv, m_reads, m_timeouts, true));
+		ASSERT_EQ(bool, wait_for(&m_reads, 2), true, "pending data is read");
+		r.remove_handler(sp[0]);
+		sp[1].write_integral(3);
+		ASSERT_EQ(bool, wait_for(&m_reads, 3, 200), false, "removed handler is not called");
+
+		r.stop();
+		return true;
+	}
+
+	bool run_reactor_group()
+	{
+		const int nclients = 16;
+
+		snf::net::reactor_group rg(2, snf::net::POLL_WAIT_FOREVER);
+		ASSERT_EQ(size_t, rg.size(), 2, "reactor group size");
+
+		std::vector<std::unique_ptr<snf::net::socket>> listeners;
+		in_port_t port = 0;
+
+		for (size_t i = 0; i < rg.size(); ++i) {
+			std::unique_ptr<snf::net::socket> l(DBG_NEW snf::net::socket(AF_INET, snf::net::socket_type::tcp));
+			l->reuseaddr(true);
+			l->reuseport(true);
+			ASSERT_EQ(bool, l->reuseport(), true, "reuse port is enabled");
+			l->bind(AF_INET, port);
+			l->listen(nclients);
+			port = l->local_address().port();
+			rg[i].add_handler(*l, snf::net::event::read,
+				DBG_NEW accepting_handler(*l, m_lock, m_cv, m_accepts));
+			listeners.push_back(std::move(l));
+		}
+
+		std::vector<std::unique_ptr<snf::net::socket>> clients;
+		for (int i = 0; i < nclients; ++i) {
+			std::unique_ptr<snf::net::socket> c(DBG_NEW snf::net::socket(AF_INET, snf::net::socket_type::tcp));
+			c->connect(AF_INET, "localhost", port);
+			clients.push_back(std::move(c));
+		}
+
+		ASSERT_EQ(bool, wait_for(&m_accepts, nclients), true, "all connections accepted");
+
+		rg.stop();
+		return true;
+	}
+
+	bool run_multishot()
+	{
+		const int nbytes = 1048576;
+
+		snf::net::reactor r(snf::net::POLL_WAIT_FOREVER, snf::net::poller_type::uring);
+
+		snf::net::socket l(AF_INET, snf::net::socket_type::tcp);
+		l.reuseaddr(true);
+		l.bind(AF_INET, 0);
+		l.listen(4);
+		l.blocking(false);
+
+		if (!r.accept_multishot(l)) {
+			std::cout << "skipped multishot, " << r.poller_name() << " poller" << std::endl;
+			r.stop();
+			return true;
+		}
+
+		std::vector<std::unique_ptr<snf::net::socket>> accepted;
+		r.add_handler(l, snf::net::event::read,
+			DBG_NEW multishot_handler(r, l, m_lock, m_cv, accepted));
+
+		snf::net::socket c(AF_INET, snf::net::socket_type::tcp);
+		c.connect(AF_INET, "localhost", l.local_address().port());
+
+		{
+			std::unique_lock<std::mutex> guard(m_lock);
+			ASSERT_EQ(bool, m_cv.wait_for(guard, std::chrono::milliseconds(2000),
+				[&accepted] () { return !accepted.empty(); }), true, "connection accepted");
+		}
+
+		snf::net::socket &a = *accepted[0];
+		a.blocking(false);
+
+		// The data received is dispatched as read events.
+		reset();
+		r.add_handler(a, snf::net::event::read,
+			DBG_NEW counting_handler(a, m_lock, m_cv, m_reads, m_timeouts, true));
+		for (int i = 1; i <= 5; ++i) {
+			c.write_integral(i);
+			ASSERT_EQ(bool, wait_for(&m_reads, i), true, "read event received");
+		}
+		r.remove_handler(a);
+
+		// More than the feed holds: the receive stops and starts again.
+		std::vector<char> out(nbytes);
+		for (int i = 0; i < nbytes; ++i)
+			out[i] = static_cast<char>(i % 251);
+
+		int bwritten = 0;
+		std::thread writer([&c, &out, &bwritten] () {
+			c.writen(out.data(), static_cast<int>(out.size()), &bwritten);
+		});
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+		std::vector<char> in(nbytes);
+		int bread = 0;
+		int retval = a.readn(in.data(), nbytes, &bread, 5000);
+		writer.join();
+
+		ASSERT_EQ(int, retval, E_ok, "data read");
+		ASSERT_EQ(int, bwritten, nbytes, "all data written");
+		ASSERT_EQ(int, bread, nbytes, "all data read");
+		ASSERT_EQ(bool, in == out, true, "data read as written");
+
+		// End of file.
+		c.close();
+		char ch;
+		ASSERT_EQ(int, a.readn(&ch, 1, &bread, 2000), E_ok, "end of file read");
+		ASSERT_EQ(int, bread, 0, "no data at end of file");
+
+		r.stop();
+		return true;
+	}
+
+public:
+	rctr() : snf::tf::test() {}
+	~rctr() {}
+
+	virtual const char *name() const
+	{
+		return "Reactor";
+	}
+
+	virtual const char *description() const
+	{
+		return "Tests reactor with all the pollers, and reactor group";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		snf::net::initialize(false);
+
+		try {
+			ASSERT_EQ(bool, run_reactor(snf::net::poller_type::poll), true, "poll reactor test passed");
+			ASSERT_EQ(bool, run_reactor(snf::net::poller_type::dflt), true, "default reactor test passed");
+			ASSERT_EQ(bool, run_reactor(snf::net::poller_type::uring), true, "io_uring reactor test passed");
+			ASSERT_EQ(bool, run_multishot(), true, "multishot test passed");
+#if !defined(_WIN32)
+			ASSERT_EQ(bool, run_reactor_group(), true, "reactor group test passed");
+#endif
+		} catch (const std::invalid_argument &ex) {
+			std::cerr << "invalid argument: " << ex.what() << std::endl;
+			return false;
+		} catch (const std::system_error &ex) {
+			std::cerr << "system error: " << ex.code() << std::endl;
+			std::cerr << ex.what() << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+};
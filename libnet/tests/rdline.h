@@ -0,0 +1,197 @@
+#include "sock.h"
+#include <thread>
+
+class rdline : public snf::tf::test
+{
+private:
+	static constexpr const char *class_name = "rdline";
+
+	static void write_all(snf::net::socket &s, const std::string &data, size_t chunk)
+	{
+		for (size_t i = 0; i < data.size(); i += chunk) {
+			int n = static_cast<int>(std::min(chunk, data.size() - i));
+			int bwritten = 0;
+			s.write(data.data() + i, n, &bwritten);
+		}
+	}
+
+public:
+	rdline() : snf::tf::test() {}
+	~rdline() {}
+
+	virtual const char *name() const
+	{
+		return "BufferedReader";
+	}
+
+	virtual const char *description() const
+	{
+		return "Tests buffered line reader, peek, vectored I/O, and sendfile";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		snf::net::initialize(false);
+
+		try {
+			std::array<snf::net::socket, 2> sp = std::move(snf::net::socket::socketpair());
+
+			// Lines written in small chunks, and one larger than the buffer.
+			std::string longline(3 * snf::net::nio::DEFAULT_BUFSIZE, 'x');
+			longline.push_back('\n');
+
+			std::string data = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n" + longline + "tail";
+			std::thread writer([&sp, &data] () {
+				write_all(sp[1], data, 7);
+				sp[1].shutdown(SHUT_WR);
+			});
+
+			std::string line;
+			ASSERT_EQ(int, sp[0].readline(line, 1000), E_ok, "first line read");
+			ASSERT_EQ(const std::string &, line, std::string("GET / HTTP/1.1\r\n"), "first line matches");
+
+			line.clear();
+			ASSERT_EQ(int, sp[0].readline(line, 1000), E_ok, "second line read");
+			ASSERT_EQ(const std::string &, line, std::string("Host: localhost\r\n"), "second line matches");
+
+			char c = 0;
+			ASSERT_EQ(int, sp[0].get_char(c, 1000), E_ok, "character read");
+			ASSERT_EQ(char, c, '\r', "character matches");
+
+			const char *p = nullptr;
+			int len = 0;
+			ASSERT_EQ(int, sp[0].peek(&p, &len, 1000), E_ok, "data peeked");
+			ASSERT_GE(int, len, 1, "peeked data is not empty");
+			ASSERT_EQ(char, p[0], '\n', "peeked data matches");
+			sp[0].consume(1);
+
+			line.clear();
+			ASSERT_EQ(int, sp[0].readline(line, 1000), E_ok, "long line read");
+			ASSERT_EQ(bool, line == longline, true, "long line matches");
+
+			line.clear();
+			ASSERT_EQ(int, sp[0].readline(line, 1000), E_read_failed, "end of file before newline");
+			ASSERT_EQ(const std::string &, line, std::string("tail"), "partial line matches");
+
+			writer.join();
+
+			// Timed reads on a blocking socket do not change its mode.
+			int bread = 0;
+			char rbuf[16];
+			ASSERT_EQ(int, sp[1].readn(rbuf, sizeof(rbuf), &bread, 50), E_read_failed, "read timed out");
+			ASSERT_EQ(int, bread, 0, "nothing read");
+			ASSERT_EQ(bool, sp[1].blocking(), true, "socket is still blocking");
+			sp[0].write_integral(7);
+			ASSERT_EQ(int, sp[1].readn(rbuf, sizeof(int), &bread, 1000), E_ok, "timed read");
+			ASSERT_EQ(int, bread, static_cast<int>(sizeof(int)), "data read");
+
+			// Large reads bypass the buffer.
+			std::string str(1000, 'y');
+			ASSERT_EQ(bool, sp[1].setbuf(128), true, "buffer size set");
+			ASSERT_EQ(int, sp[0].write_string(str), E_ok, "string written");
+			str.clear();
+			ASSERT_EQ(int, sp[1].read_string(str, 1000), E_ok, "string read");
+			ASSERT_EQ(bool, str == std::string(1000, 'y'), true, "string matches");
+			ASSERT_EQ(int, sp[1].pending(), 0, "nothing pending");
+
+			// Unbuffered reads.
+			ASSERT_EQ(bool, sp[1].setbuf(0), true, "buffering disabled");
+			write_all(sp[0], "one\ntwo\n", 3);
+			line.clear();
+			ASSERT_EQ(int, sp[1].readline(line, 1000), E_ok, "unbuffered line read");
+			ASSERT_EQ(const std::string &, line, std::string("one\n"), "unbuffered line matches");
+			ASSERT_EQ(int, sp[1].peek(&p, &len, 1000), E_invalid_state, "no peek without buffer");
+			line.clear();
+			ASSERT_EQ(int, sp[1].readline(line, 1000), E_ok, "unbuffered line read");
+
+			// Gather writes, through sendmsg() and through coalescing.
+			for (int pass = 0; pass < 2; ++pass) {
+				std::string big(100000, 'z');
+				std::vector<std::string> parts;
+				for (int i = 0; i < 100; ++i)
+					parts.push_back(std::to_string(i) + ",");
+
+				std::vector<iovec> iov;
+				std::string expected;
+				for (size_t i = 0; i < parts.size(); ++i) {
+					iov.push_back({ const_cast<char *>(parts[i].data()), parts[i].size() });
+					expected += parts[i];
+					if (i == 50) {
+						iov.push_back({ const_cast<char *>(big.data()), big.size() });
+						expected += big;
+					}
+				}
+
+				std::string received(expected.size(), '\0');
+				int bread = 0;
+				std::thread reader([&sp, &received, &bread] () {
+					sp[1].read(&received[0], static_cast<int>(received.size()), &bread, 5000);
+				});
+
+				int bwritten = 0;
+				int retval = (pass == 0)
+					? sp[0].writen(iov.data(), static_cast<int>(iov.size()), &bwritten, 5000)
+					: sp[0].nio::writen(iov.data(), static_cast<int>(iov.size()), &bwritten, 5000);
+				reader.join();
+
+				ASSERT_EQ(int, retval, E_ok, "gather write");
+				ASSERT_EQ(int, bwritten, static_cast<int>(expected.size()), "all data written");
+				ASSERT_EQ(int, bread, static_cast<int>(expected.size()), "all data read");
+				ASSERT_EQ(bool, received == expected, true, "data matches");
+			}
+
+			ASSERT_EQ(int, sp[0].writen(static_cast<const iovec *>(nullptr), 1, &len), E_invalid_arg, "invalid elements");
+
+			// File content, through sendfile() and through read and write.
+			const char *fname = "rdline.dat";
+			std::string content;
+			for (int i = 0; content.size() < 200000; ++i)
+				content += std::to_string(i) + "\n";
+
+			{
+				snf::file f(fname, 0022);
+				snf::file::open_flags oflags;
+				oflags.o_write = true;
+				oflags.o_create = true;
+				oflags.o_truncate = true;
+				ASSERT_EQ(int, f.open(oflags), E_ok, "file created");
+				int bwritten = 0;
+				ASSERT_EQ(int, f.write(content.data(), static_cast<int>(content.size()), &bwritten), E_ok,
+					"file written");
+			}
+
+			for (int pass = 0; pass < 2; ++pass) {
+				snf::file f(fname, 0022);
+				snf::file::open_flags oflags;
+				oflags.o_read = true;
+				ASSERT_EQ(int, f.open(oflags), E_ok, "file opened");
+
+				const int64_t offset = 1000;
+				std::string expected = content.substr(offset);
+				std::string received(expected.size(), '\0');
+				int bread = 0;
+				std::thread reader([&sp, &received, &bread] () {
+					sp[1].read(&received[0], static_cast<int>(received.size()), &bread, 5000);
+				});
+
+				int64_t bsent = 0;
+				int retval = (pass == 0)
+					? sp[0].sendfile(f, offset, static_cast<int64_t>(content.size()), &bsent, 5000)
+					: sp[0].nio::sendfile(f, offset, static_cast<int64_t>(content.size()), &bsent, 5000);
+				reader.join();
+
+				ASSERT_EQ(int, retval, E_ok, "file sent");
+				ASSERT_EQ(int64_t, bsent, static_cast<int64_t>(expected.size()), "sent up to the end of file");
+				ASSERT_EQ(bool, received == expected, true, "file content matches");
+			}
+
+			remove(fname);
+		} catch (const std::system_error &ex) {
+			std::cerr << "system error: " << ex.code() << std::endl;
+			std::cerr << ex.what() << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+};
@@ -0,0 +1,134 @@
+#include "resolver.h"
+#include "ia.h"
+#include <atomic>
+#include <thread>
+
+class rslvr : public snf::tf::test
+{
+private:
+	static constexpr const char *class_name = "rslvr";
+
+	/*
+	 * Stub lookup: a.test resolves to 10.0.0.1 after a delay,
+	 * everything else fails with ENOENT.
+	 */
+	static snf::net::resolver::lookup_function stub(std::atomic<int> &calls)
+	{
+		return [&calls] (int, snf::net::socket_type, const std::string &host, const std::string &svc)
+			-> snf::net::resolver::addresses {
+			calls++;
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			if (host != "a.test")
+				throw std::system_error(ENOENT, std::generic_category(), "no such host");
+			snf::net::internet_address ia { "10.0.0.1" };
+			return snf::net::resolver::addresses { snf::net::socket_address { ia,
+				static_cast<in_port_t>(std::stoi(svc)) } };
+		};
+	}
+
+public:
+	rslvr() : snf::tf::test() {}
+	~rslvr() {}
+
+	virtual const char *name() const
+	{
+		return "Resolver";
+	}
+
+	virtual const char *description() const
+	{
+		return "Tests asynchronous resolver with TTL cache";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		try {
+			std::atomic<int> calls(0);
+			std::atomic<int> done(0);
+			std::atomic<int> failed(0);
+			snf::net::resolver res(2, 300, 200);
+			res.set_lookup_function(stub(calls));
+
+			// Concurrent lookups are coalesced.
+			for (int i = 0; i < 8; ++i) {
+				res.resolve(AF_INET, snf::net::socket_type::tcp, "a.test", 80,
+					[&done, &failed] (const std::error_code &ec,
+						const snf::net::resolver::addresses &addrs) {
+						if (ec || (addrs.size() != 1) || (addrs[0].port() != 80))
+							failed++;
+						done++;
+					});
+			}
+			while (done.load() < 8)
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			ASSERT_EQ(int, failed.load(), 0, "lookups succeeded");
+			ASSERT_EQ(int, calls.load(), 1, "lookups coalesced");
+
+			// Cache hit completes in the caller's thread.
+			bool inline_done = false;
+			res.resolve(AF_INET, snf::net::socket_type::tcp, "a.test", 80,
+				[&inline_done] (const std::error_code &ec, const snf::net::resolver::addresses &) {
+					inline_done = !ec;
+				});
+			ASSERT_EQ(bool, inline_done, true, "cached lookup completed");
+			ASSERT_EQ(int, calls.load(), 1, "lookup cached");
+
+			// Negative caching.
+			bool nohost = false;
+			try {
+				res.resolve(AF_INET, snf::net::socket_type::tcp, "b.test", "80");
+			} catch (const std::system_error &ex) {
+				nohost = (ex.code().value() == ENOENT);
+			}
+			ASSERT_EQ(bool, nohost, true, "lookup failed");
+			nohost = false;
+			try {
+				res.resolve(AF_INET, snf::net::socket_type::tcp, "b.test", "80");
+			} catch (const std::system_error &ex) {
+				nohost = (ex.code().value() == ENOENT);
+			}
+			ASSERT_EQ(bool, nohost, true, "failure cached");
+			ASSERT_EQ(int, calls.load(), 2, "failure cached");
+			ASSERT_EQ(size_t, res.size(), 2, "lookups cached");
+
+			// Expiration.
+			std::this_thread::sleep_for(std::chrono::milliseconds(350));
+			snf::net::resolver::addresses addrs =
+				res.resolve(AF_INET, snf::net::socket_type::tcp, "a.test", "443");
+			ASSERT_EQ(in_port_t, addrs.at(0).port(), 443, "different service resolved");
+			ASSERT_EQ(int, calls.load(), 3, "different service looked up");
+			res.resolve(AF_INET, snf::net::socket_type::tcp, "a.test", "80");
+			ASSERT_EQ(int, calls.load(), 4, "expired lookup repeated");
+
+			// Completion in the reactor thread.
+			snf::net::reactor r { 100 };
+			std::atomic<bool> rdone(false);
+			std::thread::id tid;
+			res.flush();
+			res.resolve(AF_INET, snf::net::socket_type::tcp, "a.test", 80,
+				[&rdone, &tid] (const std::error_code &, const snf::net::resolver::addresses &) {
+					tid = std::this_thread::get_id();
+					rdone = true;
+				}, &r);
+			while (!rdone.load())
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			ASSERT_NE(bool, tid == std::this_thread::get_id(), true, "completed in the reactor thread");
+			r.stop();
+
+			// System resolver.
+			snf::net::resolver sysres(1);
+			addrs = sysres.resolve(AF_INET, snf::net::socket_type::tcp, "127.0.0.1", "8080");
+			ASSERT_EQ(bool, addrs.empty(), false, "numeric host resolved");
+			ASSERT_EQ(in_port_t, addrs[0].port(), 8080, "port matches");
+		} catch (const std::system_error &ex) {
+			std::cerr << "system error: " << ex.code() << std::endl;
+			std::cerr << ex.what() << std::endl;
+			return false;
+		} catch (const std::exception &ex) {
+			std::cerr << ex.what() << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+};
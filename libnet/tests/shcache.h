@@ -0,0 +1,132 @@
+#include "sesscache.h"
+#include "keymgr.h"
+#include <thread>
+
+class shcache : public snf::tf::test
+{
+private:
+	static constexpr const char *class_name = "shcache";
+
+	static std::vector<uint8_t> make_id(int i)
+	{
+		std::vector<uint8_t> id(32, 0);
+		for (size_t j = 0; j < id.size(); ++j)
+			id[j] = static_cast<uint8_t>(i * 31 + j);
+		return id;
+	}
+
+	bool run_session_cache(const char *fname)
+	{
+		const int nsessions = 64;
+
+		// Two caches on the same file stand for two processes.
+		snf::net::ssl::file_session_cache sc1(fname, nsessions, 512);
+		snf::net::ssl::file_session_cache sc2(fname, nsessions, 512);
+
+		time_t expire = time(0) + 60;
+		std::vector<uint8_t> data;
+
+		for (int i = 0; i < nsessions; ++i) {
+			std::vector<uint8_t> id = make_id(i);
+			std::string sess = "session-" + std::to_string(i);
+			ASSERT_EQ(bool, sc1.add(id.data(), id.size(),
+				reinterpret_cast<const uint8_t *>(sess.data()), sess.size(), expire), true, "session added");
+		}
+
+		int found = 0;
+		for (int i = 0; i < nsessions; ++i) {
+			std::vector<uint8_t> id = make_id(i);
+			if (sc2.find(id.data(), id.size(), data)) {
+				std::string sess = "session-" + std::to_string(i);
+				ASSERT_EQ(bool, std::string(data.begin(), data.end()) == sess, true, "session matches");
+				found++;
+			}
+		}
+		ASSERT_GE(int, found, nsessions / 2, "sessions shared");
+
+		std::vector<uint8_t> id = make_id(nsessions);
+		std::string sess(100, 's');
+		ASSERT_EQ(bool, sc2.add(id.data(), id.size(),
+			reinterpret_cast<const uint8_t *>(sess.data()), sess.size(), expire), true, "session added");
+		ASSERT_EQ(bool, sc1.find(id.data(), id.size(), data), true, "session found");
+		sc1.remove(id.data(), id.size());
+		ASSERT_EQ(bool, sc2.find(id.data(), id.size(), data), false, "session removed");
+
+		ASSERT_EQ(bool, sc1.add(id.data(), id.size(),
+			reinterpret_cast<const uint8_t *>(sess.data()), sess.size(), time(0) - 1), true, "session added");
+		ASSERT_EQ(bool, sc2.find(id.data(), id.size(), data), false, "expired session not found");
+
+		std::string large(1024, 'l');
+		ASSERT_EQ(bool, sc1.add(id.data(), id.size(),
+			reinterpret_cast<const uint8_t *>(large.data()), large.size(), expire), false, "large session not added");
+
+		// A different geometry reinitializes the file.
+		snf::net::ssl::file_session_cache sc3(fname, nsessions * 2, 512);
+		id = make_id(0);
+		ASSERT_EQ(bool, sc3.find(id.data(), id.size(), data), false, "reinitialized cache is empty");
+
+		return true;
+	}
+
+	bool run_keymgr(const char *fname)
+	{
+		snf::net::ssl::shared_keymgr km1(fname, 1);
+		snf::net::ssl::shared_keymgr km2(fname, 1);
+
+		const snf::net::ssl::keyrec *k1 = km1.get();
+		ASSERT_NE(const snf::net::ssl::keyrec *, k1, nullptr, "key created");
+		const snf::net::ssl::keyrec *k2 = km2.get();
+		ASSERT_NE(const snf::net::ssl::keyrec *, k2, nullptr, "key read");
+		ASSERT_EQ(int, memcmp(k1, k2, sizeof(snf::net::ssl::keyrec)), 0, "keys are shared");
+
+		uint8_t name[snf::net::ssl::KEY_SIZE];
+		memcpy(name, k1->key_name, sizeof(name));
+
+		// Rotated by one, found by the other.
+		std::this_thread::sleep_for(std::chrono::milliseconds(2100));
+		k1 = km1.get();
+		ASSERT_NE(const snf::net::ssl::keyrec *, k1, nullptr, "key rotated");
+		ASSERT_NE(int, memcmp(k1->key_name, name, sizeof(name)), 0, "new key");
+
+		k2 = km2.find(k1->key_name, sizeof(name));
+		ASSERT_NE(const snf::net::ssl::keyrec *, k2, nullptr, "new key found");
+		ASSERT_EQ(int, memcmp(k1->aes_key, k2->aes_key, snf::net::ssl::AES_SIZE), 0, "new key matches");
+		ASSERT_NE(const snf::net::ssl::keyrec *, km2.find(name, sizeof(name)), nullptr, "old key found");
+
+		return true;
+	}
+
+public:
+	shcache() : snf::tf::test() {}
+	~shcache() {}
+
+	virtual const char *name() const
+	{
+		return "SharedSessionCache";
+	}
+
+	virtual const char *description() const
+	{
+		return "Tests file backed session cache and shared ticket key manager";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		const char *cfname = "shcache.dat";
+		const char *kfname = "shcache.key";
+
+		try {
+			bool passed = run_session_cache(cfname) && run_keymgr(kfname);
+			remove(cfname);
+			remove(kfname);
+			return passed;
+		} catch (const snf::net::ssl::exception &ex) {
+			std::cerr << ex.what() << std::endl;
+			return false;
+		} catch (const std::system_error &ex) {
+			std::cerr << "system error: " << ex.code() << std::endl;
+			std::cerr << ex.what() << std::endl;
+			return false;
+		}
+	}
+};
@@ -0,0 +1,107 @@
+#include "snireg.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+
+class snilookup : public snf::tf::test
+{
+private:
+	static constexpr const char *class_name = "snilookup";
+
+public:
+	snilookup() : snf::tf::test() {}
+	~snilookup() {}
+
+	virtual const char *name() const
+	{
+		return "SNIRegistry";
+	}
+
+	virtual const char *description() const
+	{
+		return "Tests SNI context registry lookups";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		std::unique_ptr<snf::net::ssl::context> c1, c2, c3;
+
+		// The contexts need OpenSSL 1.1 or later; skip the
+		// test if the library in use does not have it.
+		try {
+			c1.reset(DBG_NEW snf::net::ssl::context);
+			c2.reset(DBG_NEW snf::net::ssl::context);
+			c3.reset(DBG_NEW snf::net::ssl::context);
+		} catch (const std::runtime_error &ex) {
+			std::cerr << "skipped, no usable OpenSSL: " << ex.what() << std::endl;
+			return true;
+		}
+
+		try {
+			snf::net::ssl::context &ctx1 = *c1, &ctx2 = *c2, &ctx3 = *c3;
+			snf::net::ssl::sni_registry reg;
+
+			reg.add("www.example.com", ctx1);
+			reg.add("*.Example.COM", ctx2);
+			reg.add("*.example.org", ctx3);
+			ASSERT_EQ(size_t, reg.size(), 3, "names added");
+
+			ASSERT_EQ(SSL_CTX *, static_cast<SSL_CTX *>(*reg.find("www.example.com")),
+				static_cast<SSL_CTX *>(ctx1), "exact name matches");
+			ASSERT_EQ(SSL_CTX *, static_cast<SSL_CTX *>(*reg.find("WWW.Example.Com.")),
+				static_cast<SSL_CTX *>(ctx1), "name is case-insensitive");
+			ASSERT_EQ(SSL_CTX *, static_cast<SSL_CTX *>(*reg.find("mail.example.com")),
+				static_cast<SSL_CTX *>(ctx2), "wildcard name matches");
+			ASSERT_EQ(SSL_CTX *, static_cast<SSL_CTX *>(*reg.find("www.example.org")),
+				static_cast<SSL_CTX *>(ctx3), "wildcard name matches");
+			ASSERT_EQ(snf::net::ssl::context *, reg.find("example.com"), nullptr,
+				"wildcard does not match the parent domain");
+			ASSERT_EQ(snf::net::ssl::context *, reg.find("a.mail.example.com"), nullptr,
+				"wildcard matches one label only");
+			ASSERT_EQ(snf::net::ssl::context *, reg.find("www.example.net"), nullptr,
+				"unknown name does not match");
+
+			ASSERT_EQ(bool, reg.remove("*.example.com"), true, "wildcard name removed");
+			ASSERT_EQ(bool, reg.remove("*.example.com"), false, "wildcard name not removed twice");
+			ASSERT_EQ(snf::net::ssl::context *, reg.find("mail.example.com"), nullptr,
+				"removed name does not match");
+
+			bool invalid = false;
+			try {
+				reg.add("*example.com", ctx1);
+			} catch (const std::invalid_argument &) {
+				invalid = true;
+			}
+			ASSERT_EQ(bool, invalid, true, "invalid wildcard name rejected");
+
+			// Lookups while the names are being added.
+			std::atomic<bool> done(false);
+			std::atomic<int> misses(0);
+			std::vector<std::thread> readers;
+			for (int i = 0; i < 4; ++i) {
+				readers.emplace_back([&reg, &done, &misses] () {
+					while (!done.load())
+						if (reg.find("www.example.com") == nullptr)
+							misses++;
+				});
+			}
+
+			for (int i = 0; i < 1000; ++i)
+				reg.add("host" + std::to_string(i) + ".example.net", ctx3);
+
+			done = true;
+			for (auto &t : readers)
+				t.join();
+
+			ASSERT_EQ(int, misses.load(), 0, "existing name is always found");
+			ASSERT_EQ(size_t, reg.size(), 1002, "all names added");
+			ASSERT_EQ(SSL_CTX *, static_cast<SSL_CTX *>(*reg.find("host999.example.net")),
+				static_cast<SSL_CTX *>(ctx3), "added name matches");
+		} catch (const std::runtime_error &ex) {
+			std::cerr << ex.what() << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+};
@@ -1,4 +1,5 @@
 #include "sock.h"
+#include "ia.h"
 
 class sock_attr : public snf::tf::test
 {
@@ -123,6 +124,80 @@ public:
 		return true;
 	}
 
+	bool accept_drain()
+	{
+		snf::net::socket l(AF_INET, snf::net::socket_type::tcp);
+		l.reuseaddr(true);
+		l.bind(snf::net::internet_address { "127.0.0.1" }, 0);
+
+#if defined(__linux__)
+		l.fastopen(16);
+		ASSERT_EQ(int, l.fastopen(), 16, "fast open queue length matches");
+		l.deferaccept(5);
+		ASSERT_NE(int, l.deferaccept(), 0, "accept is deferred");
+		l.deferaccept(0);
+		ASSERT_EQ(int, l.deferaccept(), 0, "accept is not deferred");
+#endif
+
+		l.blocking(false);
+		l.listen(16);
+
+		std::unique_ptr<snf::net::socket> ns;
+		ASSERT_EQ(int, l.accept(ns), E_try_again, "no pending connection");
+
+		std::vector<snf::net::socket> clients;
+		for (int i = 0; i < 3; ++i) {
+			clients.emplace_back(AF_INET, snf::net::socket_type::tcp);
+			clients.back().connect(l.local_address(), 1000);
+		}
+
+		int naccepted = 0;
+		while (l.accept(ns) == E_ok) {
+			ASSERT_EQ(bool, ns->blocking(), false, "accepted socket is non-blocking");
+			naccepted++;
+		}
+		ASSERT_EQ(int, naccepted, 3, "pending connections drained");
+
+		return true;
+	}
+
+	bool batched_writes()
+	{
+		snf::net::socket l(AF_INET, snf::net::socket_type::tcp);
+		l.reuseaddr(true);
+		l.bind(snf::net::internet_address { "127.0.0.1" }, 0);
+		l.listen(4);
+
+		snf::net::socket c(AF_INET, snf::net::socket_type::tcp);
+		c.tcpnodelay(true);
+		c.connect(l.local_address(), 1000);
+		snf::net::socket ns = std::move(l.accept());
+
+		int bwritten = 0;
+		int bread = 0;
+
+		c.begin_batch();
+#if defined(__linux__)
+		ASSERT_EQ(bool, c.cork(), true, "output is corked in a batch");
+#endif
+		for (const char *p : { "HTTP/1.1 200 OK\r\n", "Content-Length: 5\r\n", "\r\n" })
+			c.writen(p, static_cast<int>(strlen(p)), &bwritten);
+		iovec iov[2] = { { const_cast<char *>("hel"), 3 }, { const_cast<char *>("lo"), 2 } };
+		c.writen(iov, 2, &bwritten);
+		ASSERT_EQ(int, c.end_batch(), E_ok, "batch ended");
+#if defined(__linux__)
+		ASSERT_EQ(bool, c.cork(), false, "output is uncorked");
+#endif
+
+		const char *expected = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello";
+		int len = static_cast<int>(strlen(expected));
+		std::string got(len, '\0');
+		ASSERT_EQ(int, ns.readn(&got[0], len, &bread, 1000), E_ok, "batched data read");
+		ASSERT_EQ(bool, got == expected, true, "batched data matches");
+
+		return true;
+	}
+
 	virtual bool execute(const snf::config *conf)
 	{
 		snf::net::initialize(false);
@@ -145,10 +220,17 @@ public:
 
 			// blocking
 			s.blocking(false);
+			ASSERT_EQ(bool, s.blocking(), false, "socket is non-blocking");
 			std::cout << "socket is non-blocking now" << std::endl;
 			s.blocking(true);
+			ASSERT_EQ(bool, s.blocking(), true, "socket is blocking");
 			std::cout << "socket is blocking now" << std::endl;
 
+			{
+				snf::net::socket raw(static_cast<sock_t>(s), true);
+				ASSERT_EQ(bool, raw.blocking(), true, "raw socket mode is queried");
+			}
+
 			std::array<snf::net::socket, 2> sp = std::move(snf::net::socket::socketpair());
 			std::array<int, 5> iarr { 101, 507, 93, 1023, 2398 };
 			for (int i : iarr) {
@@ -158,6 +240,9 @@ public:
 				ASSERT_EQ(int, i, j, "socketpair passed");
 			}
 
+			ASSERT_EQ(bool, accept_drain(), true, "accept drain test passed");
+			ASSERT_EQ(bool, batched_writes(), true, "batched writes test passed");
+
 		} catch (const std::invalid_argument &ex) {
 			std::cerr << "invalid argument: " << ex.what() << std::endl;
 			return false;
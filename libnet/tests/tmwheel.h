@@ -0,0 +1,109 @@
+#include "timerwheel.h"
+#include <random>
+
+class tmwheel : public snf::tf::test
+{
+private:
+	static constexpr const char *class_name = "tmwheel";
+
+	using clock_type = snf::net::timer_wheel::clock_type;
+
+public:
+	tmwheel() : snf::tf::test() {}
+	~tmwheel() {}
+
+	virtual const char *name() const
+	{
+		return "TimerWheel";
+	}
+
+	virtual const char *description() const
+	{
+		return "Tests hierarchical timer wheel";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		const int ntimers = 10000;
+
+		/*
+		 * The wheel is driven with synthetic time points, so
+		 * that hours go by in an instant. The start of the wheel
+		 * is a bit after t0; so a timer may expire up to 1ms
+		 * after its expiration relative to t0, never before.
+		 */
+		clock_type::time_point t0 = clock_type::now();
+		snf::net::timer_wheel tw;
+
+		std::mt19937_64 rng(12345);
+		std::vector<int64_t> expiry(ntimers);
+		std::vector<int64_t> fired(ntimers, -1);
+		std::vector<snf::net::timer_id> ids(ntimers);
+		int64_t now_ms = 0;
+
+		for (int i = 0; i < ntimers; ++i) {
+			// from 1ms up to about 2 days, so that every level is used
+			int shift = static_cast<int>(rng() % 28);
+			expiry[i] = 1 + static_cast<int64_t>(rng() % (int64_t(1) << shift));
+			ids[i] = tw.schedule(t0 + std::chrono::milliseconds(expiry[i]),
+				[&fired, &now_ms, i] () { fired[i] = now_ms; });
+		}
+
+		ASSERT_EQ(size_t, tw.size(), ntimers, "timers scheduled");
+
+		// Cancel every 10th timer.
+		int ncancelled = 0;
+		for (int i = 0; i < ntimers; i += 10)
+			if (tw.cancel(ids[i]))
+				ncancelled++;
+		ASSERT_EQ(int, ncancelled, ntimers / 10, "timers cancelled");
+		ASSERT_EQ(bool, tw.cancel(ids[0]), false, "timer is not cancelled twice");
+
+		std::vector<snf::net::timer_wheel::callback> due;
+		size_t expired = 0;
+		int late_wakeups = 0;
+
+		while (!tw.empty()) {
+			int to = tw.next_timeout(t0 + std::chrono::milliseconds(now_ms));
+			if (to < 0)
+				break;
+
+			int64_t earliest = INT64_MAX;
+			for (int i = 0; i < ntimers; ++i)
+				if (((i % 10) != 0) && (fired[i] < 0) && (expiry[i] < earliest))
+					earliest = expiry[i];
+
+			// never later than the earliest expiration
+			if ((now_ms + to) > (earliest + 1))
+				late_wakeups++;
+
+			now_ms += (to > 0) ? to : 1;
+			due.clear();
+			expired += tw.expire(t0 + std::chrono::milliseconds(now_ms), due);
+			for (auto &cb : due)
+				cb();
+		}
+
+		ASSERT_EQ(bool, tw.empty(), true, "next timeout is set while there are timers");
+		ASSERT_EQ(int, late_wakeups, 0, "next timeout is never late");
+		ASSERT_EQ(size_t, expired, ntimers - ntimers / 10, "all timers expired");
+
+		int early = 0, late = 0, cancelled = 0;
+		for (int i = 0; i < ntimers; ++i) {
+			if ((i % 10) == 0) {
+				if (fired[i] != -1)
+					cancelled++;
+			} else if (fired[i] < expiry[i]) {
+				early++;
+			} else if (fired[i] > (expiry[i] + 1)) {
+				late++;
+			}
+		}
+
+		ASSERT_EQ(int, cancelled, 0, "cancelled timers did not expire");
+		ASSERT_EQ(int, early, 0, "no timer expired early");
+		ASSERT_EQ(int, late, 0, "no timer expired late");
+
+		return true;
+	}
+};
@@ -0,0 +1,129 @@
+#include "sock.h"
+#include "ia.h"
+
+#if defined(__linux__)
+#include <netinet/udp.h>
+#endif
+
+class udp : public snf::tf::test
+{
+private:
+	static constexpr const char *class_name = "udp";
+
+	static snf::net::socket make_socket()
+	{
+		snf::net::socket s { AF_INET, snf::net::socket_type::udp };
+		s.bind(snf::net::internet_address { "127.0.0.1" }, 0);
+		return s;
+	}
+
+public:
+	udp() : snf::tf::test() {}
+	~udp() {}
+
+	virtual const char *name() const
+	{
+		return "UDP";
+	}
+
+	virtual const char *description() const
+	{
+		return "Tests datagram send/receive and batching";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		snf::net::initialize(false);
+
+		try {
+			snf::net::socket rs = std::move(make_socket());
+			snf::net::socket ss = std::move(make_socket());
+			snf::net::socket_address raddr = rs.local_address();
+			snf::net::socket_address saddr = ss.local_address();
+			char buf[2048];
+			int n = 0;
+
+			// Single datagram.
+			ASSERT_EQ(int, ss.sendto("ping", 4, raddr, &n), E_ok, "datagram sent");
+			ASSERT_EQ(int, n, 4, "all bytes sent");
+
+			snf::net::socket_address from = raddr;
+			ASSERT_EQ(int, rs.recvfrom(buf, sizeof(buf), &n, &from, 1000), E_ok, "datagram received");
+			ASSERT_EQ(int, n, 4, "datagram length");
+			ASSERT_EQ(int, memcmp(buf, "ping", 4), 0, "data matches");
+			ASSERT_EQ(bool, from == saddr, true, "source address");
+
+			ASSERT_NE(int, rs.recvfrom(buf, sizeof(buf), &n, nullptr, 100), E_ok, "nothing to receive");
+			ASSERT_EQ(int, n, 0, "nothing received");
+
+			// Batched send and receive.
+			const int count = 200;
+			std::vector<std::string> msgs;
+			std::vector<snf::net::datagram> out;
+			for (int i = 0; i < count; ++i)
+				msgs.push_back("metric." + std::to_string(i) + ":1|c");
+			for (int i = 0; i < count; ++i)
+				out.emplace_back(msgs[i].data(), static_cast<int>(msgs[i].size()), raddr);
+
+			ASSERT_EQ(int, ss.sendmmsg(out.data(), count, &n), E_ok, "datagrams sent");
+			ASSERT_EQ(int, n, count, "all datagrams sent");
+
+			std::vector<std::string> bufs(count, std::string(64, '\0'));
+			std::vector<snf::net::datagram> in;
+			for (int i = 0; i < count; ++i)
+				in.emplace_back(&bufs[i][0], 64);
+
+			int received = 0;
+			while (received < count) {
+				ASSERT_EQ(int, rs.recvmmsg(in.data() + received, count - received, &n, 1000),
+					E_ok, "datagrams received");
+				for (int i = received; i < received + n; ++i) {
+					ASSERT_EQ(int, in[i].bytes, static_cast<int>(msgs[i].size()), "datagram length");
+					ASSERT_EQ(int, memcmp(in[i].buf, msgs[i].data(), msgs[i].size()), 0, "data matches");
+					ASSERT_EQ(bool, in[i].address() == saddr, true, "source address");
+				}
+				received += n;
+			}
+
+			ASSERT_EQ(int, rs.recvmmsg(in.data(), count, &n, 100), E_read_failed, "nothing to receive");
+			ASSERT_EQ(int, n, 0, "nothing received");
+
+			// Truncation.
+			ss.sendto(buf, 100, raddr, &n);
+			snf::net::datagram small(buf, 10);
+			ASSERT_EQ(int, rs.recvmmsg(&small, 1, &n, 1000), E_ok, "datagram received");
+			ASSERT_EQ(bool, small.truncated, true, "datagram truncated");
+
+			// Connected socket, no address.
+			ss.connect(raddr);
+			snf::net::datagram dg((void *)"pong", 4);
+			ASSERT_EQ(int, ss.sendmmsg(&dg, 1, &n), E_ok, "datagram sent");
+			ASSERT_EQ(int, rs.recvfrom(buf, sizeof(buf), &n, &from, 1000), E_ok, "datagram received");
+			ASSERT_EQ(int, memcmp(buf, "pong", 4), 0, "data matches");
+
+#if defined(UDP_SEGMENT)
+			// Segmentation offload: one send, many datagrams.
+			std::string train(10 * 100, 's');
+			snf::net::datagram seg(&train[0], static_cast<int>(train.size()));
+			seg.segsize = 100;
+			if (ss.sendmmsg(&seg, 1, &n) == E_ok) {
+				std::vector<snf::net::datagram> segs(10, snf::net::datagram(buf, 128));
+				received = 0;
+				while (received < 10) {
+					ASSERT_EQ(int, rs.recvmmsg(segs.data(), 10, &n, 1000), E_ok, "segments received");
+					for (int i = 0; i < n; ++i)
+						ASSERT_EQ(int, segs[i].bytes, 100, "segment length");
+					received += n;
+				}
+				ASSERT_EQ(int, received, 10, "all segments received");
+			}
+#endif
+		} catch (const std::system_error &ex) {
+			std::cerr << "system error: " << ex.code() << std::endl;
+			std::cerr << ex.what() << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+};
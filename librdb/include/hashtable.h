@@ -2,8 +2,9 @@
 #define _SNF_RDB_HASHTABLE_H_
 
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include "dbstruct.h"
-#include "rwlock.h"
 
 #ifndef HASH_TABLE_SIZE
 #define HASH_TABLE_SIZE 500000
@@ -31,31 +32,98 @@ hash(const char *key, int klen, int table_size)
 }
 
 /*
- * Entry of the hash table (32-byte long). The size of
- * the entire hash table is:
- * <number_of_entries> * sizeof(hash_entry_t)
+ * Key fingerprint. Selects 1 of the 63 filter bits
+ * (bit 0 marks the filter as valid) using FNV-1a, so
+ * that it is independent of the hash table index.
+ *
+ * @param key - the key.
+ * @param klen - the key length.
+ *
+ * @return the filter bit for the key.
+ */
+inline uint64_t
+keyfp(const char *key, int klen)
+{
+	uint32_t h = 2166136261U;
+
+	for (int i = 0; i < klen; i++) {
+		h ^= (unsigned char)key[i];
+		h *= 16777619U;
+	}
+
+	return uint64_t(1) << (1 + (h % 63));
+}
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE     64
+#endif
+
+#define HT_FILTER_UNKNOWN   uint64_t(0)                 // not built yet
+#define HT_FILTER_VALID     uint64_t(1)
+#define HT_FILTER_FULL      (~uint64_t(0))              // too many keys
+#define HT_FILTER_MAX_BITS  40
+
+#define HT_LOCK_WRITER      0x80000000U                 // held exclusively
+#define HT_LOCK_PENDING     0x40000000U                 // writer is waiting
+#define HT_LOCK_PARKED      0x20000000U                 // waiter(s) are parked
+#define HT_LOCK_READERS     0x1FFFFFFFU                 // number of readers
+
+#ifndef HT_LOCK_SPINS
+#define HT_LOCK_SPINS       64
+#endif
+
+#ifndef HT_PARK_SLOTS
+#define HT_PARK_SLOTS       64
+#endif
+
+/*
+ * Entry of the hash table (40-byte long). Everything a
+ * lookup needs to start with is in the entry, including
+ * the read-write lock. When the hash table is cache
+ * aligned, every entry takes a cache line of its own.
+ * The size of the entire hash table is:
+ * <number_of_entries> * sizeof(hash_entry_t), or
+ * <number_of_entries> * CACHE_LINE_SIZE if aligned.
  */
-extern "C"
 typedef struct hash_entry
 {
-	int64_t         offset;   // 8, offset of the first page on disk
-	key_page_node_t *head;    // 8, pointer to the first page in memory
-	key_page_node_t *tail;    // 8, pointer to the last page in memory
-	RWLock          *rwlock;  // 8, read-write lock (set on-demand)
+	int64_t                 offset;   // 8, offset of the first page on disk
+	key_page_node_t         *head;    // 8, pointer to the first page in memory
+	key_page_node_t         *tail;    // 8, pointer to the last page in memory
+	std::atomic<uint64_t>   filter;   // 8, fingerprints of the keys
+	std::atomic<uint32_t>   lock;     // 4, read-write lock word
 } hash_entry_t;
 
+/*
+ * Threads that cannot get the lock after spinning
+ * for a while wait here. The slots are shared by
+ * the hash table entries.
+ */
+typedef struct ht_park
+{
+	std::mutex              mutex;
+	std::condition_variable cv;
+} ht_park_t;
+
 /**
  * The main hash table.
  */
 class HashTable
 {
 private:
-	hash_entry_t    *ht;
+	char            *ht;
 	int             htsize;
-	std::mutex      mutex;
-	RWLockPool      *rwlockPool;
+	size_t          stride;
+	ht_park_t       parkLot[HT_PARK_SLOTS];
+
+	hash_entry_t *entry(int index) const
+	{
+		return (hash_entry_t *)(ht + size_t(index) * stride);
+	}
 
 	void initHashEntry(hash_entry_t *);
+	void park(int, hash_entry_t *, uint32_t);
+	void unpark(int, hash_entry_t *);
 
 public:
 	/**
@@ -64,7 +132,7 @@ public:
 	HashTable()
 		: ht(0),
 		  htsize(0),
-		  rwlockPool(DBG_NEW RWLockPool())
+		  stride(sizeof(hash_entry_t))
 	{
 	}
 
@@ -77,12 +145,14 @@ public:
 			for (int i = 0; i < htsize; ++i) {
 				freeKeyPageNodeList(i);
 			}
+#if defined(_WIN32)
+			_aligned_free(ht);
+#else
 			::free(ht);
+#endif
 			ht = 0;
 			htsize = 0;
 		}
-
-		delete rwlockPool;
 	}
 
 	int size() const
@@ -90,7 +160,7 @@ public:
 		return htsize;
 	}
 
-	int allocate(int);
+	int allocate(int, bool aligned = false);
 	void rdlock(int);
 	void rdunlock(int);
 	void wrlock(int);
@@ -99,6 +169,11 @@ public:
 	int64_t getOffset(int);
 	void setOffset(int, int64_t);
 
+	uint64_t getFilter(int);
+	bool mayContain(int, const char *, int);
+	void addToFilter(int, const char *, int);
+	void setFilter(int, uint64_t);
+
 	int addKeyPageNode(int, key_page_node_t *);
 	void removeKeyPageNode(int, key_page_node_t *);
 	key_page_node_t *getKeyPageNodeList(int);
@@ -3,8 +3,10 @@
 
 #include "error.h"
 #include "cache.h"
+#include "vcache.h"
 #include "dbfiles.h"
 #include "hashtable.h"
+#include "shmindex.h"
 
 int NextPrime(int); // from librdb/prime.cpp
 
@@ -24,6 +26,10 @@ private:
 	int         o_memusage;     // memory usage for key pages in %
 	bool        o_syncdata;     // always sync db file
 	bool        o_syncidx;      // always sync index file
+	int         o_vcsize;       // number of cached value pages
+	bool        o_shared;       // shared read-only mode
+	bool        o_htalign;      // cache align hash table entries
+	int         o_bulkrun;      // key records bulkLoad sorts in memory
 
 public:
 	/**
@@ -34,6 +40,10 @@ public:
 		o_memusage = 75;
 		o_syncdata = true;
 		o_syncidx = false;
+		o_vcsize = 0;
+		o_shared = false;
+		o_htalign = false;
+		o_bulkrun = 1024 * 1024;
 	}
 
 	/**
@@ -44,6 +54,10 @@ public:
 		o_memusage = opt.o_memusage;
 		o_syncdata = opt.o_syncdata;
 		o_syncidx = opt.o_syncidx;
+		o_vcsize = opt.o_vcsize;
+		o_shared = opt.o_shared;
+		o_htalign = opt.o_htalign;
+		o_bulkrun = opt.o_bulkrun;
 	}
 
 	/**
@@ -108,6 +122,110 @@ public:
 		o_syncidx = syncidx;
 	}
 
+	/**
+	 * Gets the number of value pages to cache in memory.
+	 * 0 means that the value cache is disabled.
+	 */
+	int getValueCacheSize() const
+	{
+		return o_vcsize;
+	}
+
+	/**
+	 * Sets the number of value pages to cache in memory.
+	 * Each value page is 256 bytes long. The value cache
+	 * is disabled by default.
+	 *
+	 * @param [in] vcsize - number of value pages to cache,
+	 *                      0 to disable the value cache.
+	 *
+	 * @return E_ok on success, -ve error code on failure.
+	 */
+	int setValueCacheSize(int vcsize)
+	{
+		if (vcsize < 0) {
+			LOG_ERROR("RdbOptions",
+				"invalid value cache size (%d); should not be negative",
+				vcsize);
+			return E_invalid_arg;
+		}
+
+		o_vcsize = vcsize;
+		return E_ok;
+	}
+
+	/**
+	 * Is the database opened in shared mode?
+	 */
+	bool sharedMode() const
+	{
+		return o_shared;
+	}
+
+	/**
+	 * Sets the shared mode. In shared mode, the database
+	 * is opened read-only and any number of processes can
+	 * get values from it concurrently. They share one copy
+	 * of the hash table and the key pages. The database
+	 * cannot be opened for update while it is shared.
+	 */
+	void sharedMode(bool shared)
+	{
+		o_shared = shared;
+	}
+
+	/**
+	 * Are the hash table entries cache aligned?
+	 */
+	bool cacheAlignHashTable() const
+	{
+		return o_htalign;
+	}
+
+	/**
+	 * Aligns every hash table entry to the cache line, so
+	 * that the writers on the neighbouring entries do not
+	 * invalidate each other's cache line. It costs 64 bytes
+	 * instead of 40 bytes per entry.
+	 */
+	void cacheAlignHashTable(bool align)
+	{
+		o_htalign = align;
+	}
+
+	/**
+	 * Gets the number of key records bulkLoad sorts in
+	 * memory at a time.
+	 */
+	int getBulkLoadRunSize() const
+	{
+		return o_bulkrun;
+	}
+
+	/**
+	 * Sets the number of key records bulkLoad sorts in memory
+	 * at a time. Each key record takes 64 bytes. The records
+	 * beyond it are sorted in runs of this size, which are
+	 * spilled to temporary files and merged. The default is
+	 * 1M records (64MB).
+	 *
+	 * @param [in] nrecs - number of key records, at least 1024.
+	 *
+	 * @return E_ok on success, -ve error code on failure.
+	 */
+	int setBulkLoadRunSize(int nrecs)
+	{
+		if (nrecs < 1024) {
+			LOG_ERROR("RdbOptions",
+				"invalid bulk load run size (%d); should be at least 1024",
+				nrecs);
+			return E_invalid_arg;
+		}
+
+		o_bulkrun = nrecs;
+		return E_ok;
+	}
+
 	/**
 	 * Copy operator.
 	 */
@@ -117,6 +235,10 @@ public:
 			o_memusage = opt.o_memusage;
 			o_syncdata = opt.o_syncdata;
 			o_syncidx = opt.o_syncidx;
+			o_vcsize = opt.o_vcsize;
+			o_shared = opt.o_shared;
+			o_htalign = opt.o_htalign;
+			o_bulkrun = opt.o_bulkrun;
 		}
 
 		return *this;
@@ -159,6 +281,36 @@ public:
 	virtual int getUpdatedValue(char *nval, int *nlen) = 0;
 };
 
+/**
+ * Abstract record reader. Feeds the key/value pairs
+ * to Rdb::bulkLoad().
+ */
+class RecordReader
+{
+public:
+	/**
+	 * Virtual distructor.
+	 */
+	virtual ~RecordReader()
+	{
+	}
+
+	/**
+	 * Reads the next key/value pair.
+	 *
+	 * @param [out]   key  - key.
+	 * @param [inout] klen - max key length as input,
+	 *                       actual key length as output.
+	 * @param [out]   val  - value.
+	 * @param [inout] vlen - max value length as input,
+	 *                       actual value length as output.
+	 *
+	 * @return E_ok on success, E_eof_detected if there are
+	 * no more records, -ve error code on failure.
+	 */
+	virtual int read(char *key, int *klen, char *val, int *vlen) = 0;
+};
+
 /**
  * The main database class.
  */
@@ -174,6 +326,9 @@ private:
 	KeyFile     *keyFile;
 	ValueFile   *valueFile;
 	LRUCache    *cache;
+	ValueCache  *vcache;
+	SharedIndex *shmIndex;
+	snf::file   *lockFile;
 	bool        opened;
 	std::mutex  openMutex;
 	int         opCount;
@@ -204,14 +359,21 @@ private:
 		this->keyFile = 0;
 		this->valueFile = 0;
 		this->cache = 0;
+		this->vcache = 0;
+		this->shmIndex = 0;
+		this->lockFile = 0;
 		this->opened = false;
 		this->opCount = 0;
 	}
 
+	int lock(bool);
+	void unlock();
+	void cleanup();
 	int populateHashTable();
 	int populateFreePages(const char *);
 	int addNewPage(key_info_t *);
 	int processKeyPages(key_info_t *, op_t);
+	int getValue(key_info_t *, char *, int *);
 	int backupFile(const char *);
 	int restoreFile(const char *);
 	int removeBackupFile(const char *);
@@ -336,6 +498,7 @@ public:
 	int set(const char *, int, const char *, int, Updater *updater = 0);
 	int remove(const char *, int);
 	int rebuild();
+	int bulkLoad(RecordReader *);
 	int close();
 };
 
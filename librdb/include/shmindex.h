@@ -0,0 +1,89 @@
+#ifndef _SNF_RDB_SHMINDEX_H_
+#define _SNF_RDB_SHMINDEX_H_
+
+#include "file.h"
+#include "dbstruct.h"
+
+#define SHM_INDEX_MAGIC 0x52444253  // "RDBS"
+
+/*
+ * Shared index. It lives in a named shared memory
+ * object and holds the offset of the first key page
+ * for every hash table entry. The size of the shared
+ * index is:
+ * sizeof(shm_index_t) + (<hash_table_size> - 1) * sizeof(int64_t)
+ */
+extern "C"
+typedef struct shm_index
+{
+	int     si_magic;       // SHM_INDEX_MAGIC once fully built
+	int     si_htsize;      // hash table size
+	int     si_kpsize;      // key page size
+	int     si_unused;
+	int64_t si_kfsize;      // key file size when built
+	int64_t si_offsets[1];  // offset of the first key page
+} shm_index_t;
+
+/**
+ * Read-only index shared by all the processes that
+ * open the database in shared mode. The hash table
+ * is built once in a named shared memory object by
+ * the first process and attached by the others. The
+ * key pages are mapped straight from the key file,
+ * so all the processes share one copy of them in the
+ * system page cache.
+ *
+ * The database must not change while it is shared.
+ * It is the caller's responsibility to keep the
+ * writers away (see Rdb::open()) and to serialize
+ * open() across the processes.
+ */
+class SharedIndex
+{
+private:
+	int         kpSize;
+	int         htSize;
+	std::string shmName;
+	shm_index_t *index;
+	size_t      indexLen;
+	const char  *keyPages;
+	int64_t     keyPagesLen;
+
+	static int getName(const snf::file *, std::string &);
+	void build();
+
+public:
+	/**
+	 * Constructs the shared index object.
+	 *
+	 * @param [in] kpsize - Key page size.
+	 * @param [in] htsize - Hash table size.
+	 */
+	SharedIndex(int kpsize, int htsize)
+		: kpSize(kpsize),
+		  htSize(htsize),
+		  index(0),
+		  indexLen(0),
+		  keyPages(0),
+		  keyPagesLen(0)
+	{
+	}
+
+	/**
+	 * Destroys the shared index object. The
+	 * shared memory object is left in place
+	 * for the other processes.
+	 */
+	~SharedIndex()
+	{
+		close();
+	}
+
+	int open(const snf::file *);
+	int get(key_info_t *);
+	void close();
+
+	static int remove(const snf::file *);
+};
+
+#endif // _SNF_RDB_SHMINDEX_H_
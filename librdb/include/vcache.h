@@ -0,0 +1,112 @@
+#ifndef _SNF_RDB_VCACHE_H_
+#define _SNF_RDB_VCACHE_H_
+
+#include <mutex>
+#include <unordered_map>
+#include "dbstruct.h"
+
+/*
+ * Frequency sketch used for admission control. It is
+ * a count-min sketch with 4 rows of 8-bit counters
+ * (saturating at 15). Once the number of recorded
+ * accesses reaches the sample size, all the counters
+ * are halved so that the old popularity fades away.
+ */
+class FreqSketch
+{
+private:
+	uint8_t     *table;
+	uint32_t    mask;
+	int         additions;
+	int         sampleSize;
+
+	uint32_t index(int64_t, int) const;
+	void reset();
+
+public:
+	FreqSketch(int);
+
+	~FreqSketch()
+	{
+		if (table) {
+			::free(table);
+			table = 0;
+		}
+	}
+
+	int  frequency(int64_t) const;
+	void increment(int64_t);
+};
+
+/* Value cache slot */
+typedef struct vslot
+{
+	int64_t         vs_offset;  // value page offset
+	int             vs_prev;    // previous LRU slot
+	int             vs_next;    // next LRU slot
+} vslot_t;
+
+/**
+ * Value page cache. Caches value pages keyed by their
+ * offset in the value file, so that hot values are
+ * served without going to the disk. The cache is a
+ * fixed array of value pages arranged in LRU order.
+ * A new value page is admitted in a full cache only
+ * if it is accessed more frequently than the least
+ * recently used one (TinyLFU admission). This keeps
+ * one-hit wonders from flushing the hot values out.
+ */
+class ValueCache
+{
+private:
+	int                             max;
+	int                             num;
+	int                             head;
+	int                             tail;
+	int                             freeSlot;
+	vslot_t                         *slots;
+	value_page_t                    *pages;
+	FreqSketch                      *sketch;
+	std::unordered_map<int64_t, int> slotMap;
+	std::mutex                      mutex;
+
+	void unlink(int);
+	void pushFront(int);
+	void release(int);
+
+public:
+	/**
+	 * Constructs the value cache object.
+	 *
+	 * @param [in] size - Maximum number of value pages
+	 *                    in the cache.
+	 */
+	ValueCache(int size);
+
+	/**
+	 * Destroys the value cache object.
+	 */
+	~ValueCache()
+	{
+		if (slots) {
+			::free(slots);
+			slots = 0;
+		}
+
+		if (pages) {
+			::free(pages);
+			pages = 0;
+		}
+
+		if (sketch) {
+			delete sketch;
+			sketch = 0;
+		}
+	}
+
+	int  get(int64_t, value_page_t *);
+	void put(int64_t, const value_page_t *);
+	void invalidate(int64_t);
+};
+
+#endif // _SNF_RDB_VCACHE_H_
@@ -0,0 +1,929 @@
+#include <algorithm>
+#include <cstddef>
+#include <future>
+#include <thread>
+#include <vector>
+#include "filesystem.h"
+#include "rdb.h"
+
+#ifndef BULK_WRITE_SIZE
+#define BULK_WRITE_SIZE     (4 * 1024 * 1024)
+#endif
+
+/* Key record collected during the bulk load */
+typedef struct bulk_rec
+{
+	int     br_hash;                // key hash
+	int     br_klen;                // key length
+	char    br_key[MAX_KEY_LENGTH]; // key
+	int64_t br_voff;                // value offset in file
+} bulk_rec_t;
+
+/* Sorted run of key records spilled to a file */
+typedef struct bulk_seg
+{
+	int64_t bs_off;     // offset of the first record in the file
+	int64_t bs_cnt;     // number of records
+} bulk_seg_t;
+
+/* Key records of a range of hash table entries */
+typedef struct bulk_part
+{
+	std::vector<bulk_rec_t> bp_recs;    // key records in memory
+	std::vector<int64_t>    bp_dups;    // value offsets of overwritten keys
+	std::vector<bulk_seg_t> bp_segs;    // sorted runs spilled to bp_spill
+	snf::file               *bp_spill;  // spill file
+	int64_t                 bp_spilled; // size of the spill file
+	int64_t                 bp_nrecs;   // number of keys
+	int64_t                 bp_npages;  // number of key pages
+	int64_t                 bp_kpoff;   // offset of the first key page
+} bulk_part_t;
+
+/*
+ * Orders the key records by hash, and then the same way
+ * as the key records are ordered in the key page. The
+ * value offset breaks the tie so that the last value
+ * set for a key comes last.
+ */
+static bool
+BulkRecLess(const bulk_rec_t &r1, const bulk_rec_t &r2)
+{
+	if (r1.br_hash != r2.br_hash)
+		return r1.br_hash < r2.br_hash;
+
+	if (r1.br_klen != r2.br_klen)
+		return r1.br_klen < r2.br_klen;
+
+	int cmp = memcmp(r1.br_key, r2.br_key, r1.br_klen);
+	if (cmp != 0)
+		return cmp < 0;
+
+	return r1.br_voff < r2.br_voff;
+}
+
+/*
+ * Are the keys same?
+ */
+static bool
+BulkRecSameKey(const bulk_rec_t &r1, const bulk_rec_t &r2)
+{
+	return ((r1.br_hash == r2.br_hash) &&
+		(r1.br_klen == r2.br_klen) &&
+		(memcmp(r1.br_key, r2.br_key, r1.br_klen) == 0));
+}
+
+/*
+ * Opens a database file for bulk load. The file
+ * is not synced on every write.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+static int
+BulkOpen(snf::file *file)
+{
+	int                     retval = E_ok;
+	int                     oserr = 0;
+	snf::file::open_flags   oflags;
+
+	oflags.o_read = true;
+	oflags.o_write = true;
+	oflags.o_create = true;
+
+	retval = file->open(oflags, 0600, &oserr);
+	if (retval != E_ok) {
+		LOG_SYSERR("Rdb", oserr, "failed to open file %s", file->name());
+	}
+
+	return retval;
+}
+
+/*
+ * Writes a block of pages to the database file.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+static int
+BulkWrite(snf::file *file, int64_t offset, const void *buf, int toWrite)
+{
+	int retval = E_ok;
+	int oserr = 0;
+	int bWritten = 0;
+
+	retval = file->write(offset, buf, toWrite, &bWritten, &oserr);
+	if (retval != E_ok) {
+		LOG_SYSERR("Rdb", oserr,
+			"failed to write file %s at offset %" PRId64,
+			file->name(), offset);
+	} else if (bWritten != toWrite) {
+		LOG_ERROR("Rdb",
+			"expected to write %d bytes, wrote only %d bytes",
+			toWrite, bWritten);
+		retval = E_write_failed;
+	}
+
+	return retval;
+}
+
+/*
+ * Sorts the key records of the partition in memory and
+ * drops the overwritten keys.
+ *
+ * @param [inout] bp - the partition.
+ */
+static void
+BulkSortPartition(bulk_part_t *bp)
+{
+	std::vector<bulk_rec_t> &recs = bp->bp_recs;
+
+	std::sort(recs.begin(), recs.end(), BulkRecLess);
+
+	size_t n = 0;
+	for (size_t i = 0; i < recs.size(); ++i) {
+		if ((n > 0) && BulkRecSameKey(recs[n - 1], recs[i])) {
+			bp->bp_dups.push_back(recs[n - 1].br_voff);
+			recs[n - 1] = recs[i];
+		} else {
+			if (n != i)
+				recs[n] = recs[i];
+			n++;
+		}
+	}
+	recs.resize(n);
+}
+
+/*
+ * Sorts the key records of the partition in memory and
+ * appends them, as a sorted run, to the spill file.
+ *
+ * @param [inout] bp - the partition.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+static int
+BulkSpillPartition(bulk_part_t *bp)
+{
+	int     retval = E_ok;
+	int     perBlock = int(BULK_WRITE_SIZE / sizeof(bulk_rec_t));
+	size_t  n;
+
+	if (bp->bp_recs.empty()) {
+		return E_ok;
+	}
+
+	BulkSortPartition(bp);
+
+	bulk_seg_t seg;
+	seg.bs_off = bp->bp_spilled;
+	seg.bs_cnt = int64_t(bp->bp_recs.size());
+
+	for (size_t i = 0; (retval == E_ok) && (i < bp->bp_recs.size()); i += n) {
+		n = std::min(bp->bp_recs.size() - i, size_t(perBlock));
+		retval = BulkWrite(bp->bp_spill, bp->bp_spilled,
+				bp->bp_recs.data() + i, int(n * sizeof(bulk_rec_t)));
+		bp->bp_spilled += int64_t(n * sizeof(bulk_rec_t));
+	}
+
+	if (retval == E_ok) {
+		bp->bp_segs.push_back(seg);
+		bp->bp_recs.clear();
+	}
+
+	return retval;
+}
+
+/*
+ * Spills the key records in memory of all the partitions,
+ * in parallel.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+static int
+BulkSpill(std::vector<bulk_part_t> &parts)
+{
+	int retval = E_ok;
+
+	std::vector<std::future<int>> spillers;
+	for (size_t i = 0; i < parts.size(); ++i) {
+		spillers.push_back(std::async(std::launch::async,
+			BulkSpillPartition, &parts[i]));
+	}
+
+	for (size_t i = 0; i < parts.size(); ++i) {
+		int r = spillers[i].get();
+		if (retval == E_ok)
+			retval = r;
+	}
+
+	return retval;
+}
+
+/*
+ * Creates the spill files of the partitions.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+static int
+BulkOpenSpill(const char *spillpfx, std::vector<bulk_part_t> &parts)
+{
+	int     retval = E_ok;
+
+	for (size_t i = 0; (retval == E_ok) && (i < parts.size()); ++i) {
+		std::string spillPath(spillpfx);
+		spillPath += "." + std::to_string(i);
+		parts[i].bp_spill = DBG_NEW snf::file(spillPath, 0022);
+		retval = BulkOpen(parts[i].bp_spill);
+		if (retval == E_ok) {
+			retval = parts[i].bp_spill->truncate(0L);
+		}
+	}
+
+	return retval;
+}
+
+/*
+ * Closes and removes the spill files of the partitions.
+ */
+static void
+BulkRemoveSpill(std::vector<bulk_part_t> &parts)
+{
+	for (size_t i = 0; i < parts.size(); ++i) {
+		if (parts[i].bp_spill) {
+			std::string spillPath(parts[i].bp_spill->name());
+			delete parts[i].bp_spill;
+			parts[i].bp_spill = 0;
+			snf::fs::remove_file(spillPath.c_str());
+		}
+	}
+}
+
+/*
+ * Reads all the records, writes the value pages
+ * sequentially to the value file and distributes
+ * the key records to the partitions. Once there are
+ * <runsize> key records in memory, they are sorted
+ * and spilled to the partitions' spill files,
+ * named <spillpfx>.<partition>.
+ *
+ * @param [in]  reader   - record reader.
+ * @param [in]  file     - value file.
+ * @param [in]  htsize   - hash table size.
+ * @param [in]  runsize  - number of key records to hold in memory.
+ * @param [in]  spillpfx - spill file name prefix.
+ * @param [out] parts    - partitions.
+ * @param [out] vfsize   - value file size.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+static int
+BulkReadRecords(
+	RecordReader *reader,
+	snf::file *file,
+	int htsize,
+	int runsize,
+	const char *spillpfx,
+	std::vector<bulk_part_t> &parts,
+	int64_t *vfsize)
+{
+	int             retval = E_ok;
+	int             nparts = int(parts.size());
+	int             perBlock = int(BULK_WRITE_SIZE / sizeof(value_page_t));
+	int             nvp = 0;
+	int             inmem = 0;
+	int64_t         voff = 0;
+	char            key[MAX_KEY_LENGTH];
+	char            val[MAX_VALUE_LENGTH];
+	int             klen;
+	int             vlen;
+	bulk_rec_t      br;
+	value_page_t    *blk;
+
+	blk = (value_page_t *)malloc(perBlock * sizeof(value_page_t));
+	if (blk == 0) {
+		LOG_ERROR("Rdb", "failed to allocate memory for value pages");
+		return E_no_memory;
+	}
+
+	while (retval == E_ok) {
+		klen = MAX_KEY_LENGTH;
+		vlen = MAX_VALUE_LENGTH;
+
+		retval = reader->read(key, &klen, val, &vlen);
+		if (retval != E_ok) {
+			if (retval == E_eof_detected) {
+				retval = E_ok;
+			} else {
+				LOG_ERROR("Rdb", "failed to read record (%d)", retval);
+			}
+			break;
+		}
+
+		if ((klen <= 0) || (klen > MAX_KEY_LENGTH)) {
+			LOG_ERROR("Rdb", "invalid key length (%d)", klen);
+			retval = E_invalid_arg;
+			break;
+		}
+
+		if ((vlen <= 0) || (vlen > MAX_VALUE_LENGTH)) {
+			LOG_ERROR("Rdb", "invalid value length (%d)", vlen);
+			retval = E_invalid_arg;
+			break;
+		}
+
+		InitValuePage(blk + nvp, key, klen, val, vlen);
+
+		br.br_hash = hash(key, klen, htsize);
+		br.br_klen = klen;
+		memcpy(br.br_key, key, klen);
+		br.br_voff = voff + int64_t(nvp * sizeof(value_page_t));
+		parts[int((int64_t(br.br_hash) * nparts) / htsize)].bp_recs.push_back(br);
+
+		if (++nvp == perBlock) {
+			retval = BulkWrite(file, voff, blk, int(nvp * sizeof(value_page_t)));
+			voff += int64_t(nvp * sizeof(value_page_t));
+			nvp = 0;
+		}
+
+		if ((retval == E_ok) && (++inmem == runsize)) {
+			if (parts[0].bp_spill == 0) {
+				retval = BulkOpenSpill(spillpfx, parts);
+			}
+			if (retval == E_ok) {
+				retval = BulkSpill(parts);
+			}
+			inmem = 0;
+		}
+	}
+
+	// Once spilled, all the runs are in the spill files
+	if ((retval == E_ok) && (parts[0].bp_spill != 0)) {
+		retval = BulkSpill(parts);
+	}
+
+	if ((retval == E_ok) && (nvp > 0)) {
+		retval = BulkWrite(file, voff, blk, int(nvp * sizeof(value_page_t)));
+		voff += int64_t(nvp * sizeof(value_page_t));
+	}
+
+	::free(blk);
+
+	*vfsize = voff;
+	return retval;
+}
+
+/*
+ * Merges the sorted runs of a partition: either the key
+ * records in memory, or the runs spilled to the file. The
+ * records come out in BulkRecLess order, one per key; the
+ * overwritten keys are dropped.
+ */
+class BulkCursor
+{
+private:
+	static const int BUFFERED_RECORDS = 256;
+
+	struct run
+	{
+		std::vector<bulk_rec_t> buf;    // buffered records of a spilled run
+		const bulk_rec_t        *recs;  // records
+		size_t                  cnt;    // number of records
+		size_t                  idx;    // next record
+		int64_t                 off;    // file offset of the records not read
+		int64_t                 left;   // number of records not read
+	};
+
+	const bulk_part_t       *bp;
+	std::vector<int64_t>    *dups;
+	std::vector<run>        runs;
+	std::vector<size_t>     heap;
+
+	// Orders the runs by their next record, smallest on the top
+	bool greater(size_t r1, size_t r2) const
+	{
+		const run &a = runs[r1];
+		const run &b = runs[r2];
+		return BulkRecLess(b.recs[b.idx], a.recs[a.idx]);
+	}
+
+	int fill(run *r)
+	{
+		int bRead = 0;
+		int oserr = 0;
+		int n = int(std::min(r->left, int64_t(BUFFERED_RECORDS)));
+		int toRead = int(n * sizeof(bulk_rec_t));
+
+		int retval = bp->bp_spill->read(r->off, r->buf.data(), toRead, &bRead, &oserr);
+		if (retval != E_ok) {
+			LOG_SYSERR("Rdb", oserr,
+				"failed to read file %s at offset %" PRId64,
+				bp->bp_spill->name(), r->off);
+			return retval;
+		} else if (bRead != toRead) {
+			LOG_ERROR("Rdb",
+				"expected to read %d bytes, read only %d bytes",
+				toRead, bRead);
+			return E_read_failed;
+		}
+
+		r->recs = r->buf.data();
+		r->cnt = size_t(n);
+		r->idx = 0;
+		r->off += toRead;
+		r->left -= n;
+		return E_ok;
+	}
+
+	// Takes the smallest record out
+	int pop(bulk_rec_t *rec)
+	{
+		auto cmp = [this] (size_t r1, size_t r2) { return greater(r1, r2); };
+
+		std::pop_heap(heap.begin(), heap.end(), cmp);
+		run &r = runs[heap.back()];
+		*rec = r.recs[r.idx++];
+
+		if ((r.idx == r.cnt) && (r.left > 0)) {
+			int retval = fill(&r);
+			if (retval != E_ok)
+				return retval;
+		}
+
+		if (r.idx < r.cnt)
+			std::push_heap(heap.begin(), heap.end(), cmp);
+		else
+			heap.pop_back();
+
+		return E_ok;
+	}
+
+public:
+	/*
+	 * @param [in]  bp   - the partition.
+	 * @param [out] dups - value offsets of the overwritten
+	 *                     keys, if not null.
+	 */
+	BulkCursor(const bulk_part_t *bp, std::vector<int64_t> *dups)
+		: bp(bp)
+		, dups(dups)
+	{
+	}
+
+	int start()
+	{
+		runs.clear();
+		heap.clear();
+
+		if (bp->bp_segs.empty()) {
+			run r;
+			r.recs = bp->bp_recs.data();
+			r.cnt = bp->bp_recs.size();
+			r.idx = 0;
+			r.off = 0;
+			r.left = 0;
+			runs.push_back(r);
+		} else {
+			runs.resize(bp->bp_segs.size());
+			for (size_t i = 0; i < bp->bp_segs.size(); ++i) {
+				run &r = runs[i];
+				r.buf.resize(BUFFERED_RECORDS);
+				r.off = bp->bp_segs[i].bs_off;
+				r.left = bp->bp_segs[i].bs_cnt;
+				int retval = fill(&r);
+				if (retval != E_ok)
+					return retval;
+			}
+		}
+
+		for (size_t i = 0; i < runs.size(); ++i) {
+			if (runs[i].cnt > 0)
+				heap.push_back(i);
+		}
+
+		std::make_heap(heap.begin(), heap.end(),
+			[this] (size_t r1, size_t r2) { return greater(r1, r2); });
+		return E_ok;
+	}
+
+	/*
+	 * Gets the next key record.
+	 *
+	 * @return E_ok on success, E_eof_detected if there are no
+	 * more records, -ve error code on failure.
+	 */
+	int next(bulk_rec_t *rec)
+	{
+		if (heap.empty())
+			return E_eof_detected;
+
+		int retval = pop(rec);
+		while ((retval == E_ok) && !heap.empty()) {
+			const run &r = runs[heap.front()];
+			if (!BulkRecSameKey(r.recs[r.idx], *rec))
+				break;
+			if (dups)
+				dups->push_back(rec->br_voff);
+			retval = pop(rec);
+		}
+
+		return retval;
+	}
+};
+
+/*
+ * Counts the keys of the partition and the key pages needed.
+ * The keys of a hash table entry are evenly spread over the
+ * minimum number of key pages. The overwritten keys found
+ * while merging the spilled runs are added to the partition's
+ * duplicates.
+ *
+ * @param [inout] bp     - the partition.
+ * @param [in]    kpsize - key page size.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+static int
+BulkCountPartition(bulk_part_t *bp, int kpsize)
+{
+	int         keysPerPage = NUM_OF_KEYS_IN_PAGE(kpsize);
+	int64_t     nkeys = 0;
+	bulk_rec_t  rec;
+	BulkCursor  cur(bp, &bp->bp_dups);
+
+	bp->bp_nrecs = 0;
+	bp->bp_npages = 0;
+
+	int retval = cur.start();
+	if (retval == E_ok)
+		retval = cur.next(&rec);
+
+	while (retval == E_ok) {
+		int hash = rec.br_hash;
+		nkeys = 0;
+		do {
+			nkeys++;
+			retval = cur.next(&rec);
+		} while ((retval == E_ok) && (rec.br_hash == hash));
+
+		bp->bp_nrecs += nkeys;
+		bp->bp_npages += (nkeys + keysPerPage - 1) / keysPerPage;
+	}
+
+	return (retval == E_eof_detected) ? E_ok : retval;
+}
+
+/*
+ * Builds the balanced binary tree from the sorted key
+ * records in the range [lo, hi] of the key page.
+ *
+ * @return the root of the tree.
+ */
+static short
+BulkBuildTree(key_page_t *kp, short lo, short hi)
+{
+	if (lo > hi)
+		return -1;
+
+	short mid = lo + (hi - lo) / 2;
+	key_rec_t *krec = kp->kp_keys + mid;
+
+	krec->kr_left = BulkBuildTree(kp, lo, mid - 1);
+	krec->kr_right = BulkBuildTree(kp, mid + 1, hi);
+
+	int lh = (krec->kr_left != -1) ? kp->kp_keys[krec->kr_left].kr_height : 0;
+	int rh = (krec->kr_right != -1) ? kp->kp_keys[krec->kr_right].kr_height : 0;
+	krec->kr_height = char(1 + ((lh < rh) ? rh : lh));
+
+	return mid;
+}
+
+/*
+ * Builds the key pages of the partition and writes them
+ * to the key file starting at the partition's key page
+ * offset.
+ *
+ * @param [in] fname  - key file name.
+ * @param [in] bp     - the partition.
+ * @param [in] kpsize - key page size.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+static int
+BulkWritePartition(const char *fname, const bulk_part_t *bp, int kpsize)
+{
+	int                     retval = E_ok;
+	int                     keysPerPage = NUM_OF_KEYS_IN_PAGE(kpsize);
+	int                     perBlock = BULK_WRITE_SIZE / kpsize;
+	int                     npg = 0;
+	int64_t                 blkoff = bp->bp_kpoff;
+	int64_t                 pgoff = bp->bp_kpoff;
+	snf::file               file(fname, 0022);
+	char                    *blk;
+	bulk_rec_t              rec;
+	std::vector<bulk_rec_t> recs;   // keys of a hash table entry
+	BulkCursor              cur(bp, 0);
+
+	if (bp->bp_nrecs == 0) {
+		return E_ok;
+	}
+
+	if (perBlock <= 0) {
+		perBlock = 1;
+	}
+
+	retval = BulkOpen(&file);
+	if (retval != E_ok) {
+		return retval;
+	}
+
+	blk = (char *)malloc(size_t(perBlock) * kpsize);
+	if (blk == 0) {
+		LOG_ERROR("Rdb", "failed to allocate memory for key pages");
+		return E_no_memory;
+	}
+
+	int next = cur.start();
+	if (next == E_ok)
+		next = cur.next(&rec);
+
+	while ((retval == E_ok) && (next == E_ok)) {
+		recs.clear();
+		do {
+			recs.push_back(rec);
+			next = cur.next(&rec);
+		} while ((next == E_ok) && (rec.br_hash == recs[0].br_hash));
+
+		size_t i = 0;
+		int nkeys = int(recs.size());
+		int npages = (nkeys + keysPerPage - 1) / keysPerPage;
+
+		for (int p = 0; (retval == E_ok) && (p < npages); ++p) {
+			int cnt = (nkeys / npages) + ((p < (nkeys % npages)) ? 1 : 0);
+			key_page_t *kp = (key_page_t *)(blk + (size_t(npg) * kpsize));
+
+			InitKeyPage(kp, kpsize);
+			kp->kp_hash = recs[i].br_hash;
+			kp->kp_vcount = short(cnt);
+			if (p > 0)
+				kp->kp_poff = pgoff - kpsize;
+			if (p < (npages - 1))
+				kp->kp_noff = pgoff + kpsize;
+
+			for (int k = 0; k < cnt; ++k, ++i) {
+				key_rec_t *krec = kp->kp_keys + k;
+				InitKeyRecord(krec);
+				krec->kr_flags = KEY_INUSE;
+				krec->kr_klen = short(recs[i].br_klen);
+				memcpy(krec->kr_key, recs[i].br_key, recs[i].br_klen);
+				krec->kr_voff = recs[i].br_voff;
+			}
+
+			kp->kp_root = BulkBuildTree(kp, 0, short(cnt - 1));
+
+			pgoff += kpsize;
+			if (++npg == perBlock) {
+				retval = BulkWrite(&file, blkoff, blk, npg * kpsize);
+				blkoff = pgoff;
+				npg = 0;
+			}
+		}
+	}
+
+	if ((retval == E_ok) && (next != E_eof_detected)) {
+		retval = next;
+	}
+
+	if ((retval == E_ok) && (npg > 0)) {
+		retval = BulkWrite(&file, blkoff, blk, npg * kpsize);
+	}
+
+	::free(blk);
+
+	return retval;
+}
+
+/**
+ * Loads the records into an empty database. Unlike set(),
+ * the records are not added one at a time:
+ * 1. The value pages are written sequentially to the
+ *    value file and the keys are partitioned by the hash
+ *    table entry.
+ * 2. The partitions are sorted in parallel. If a key
+ *    appears more than once, the last value wins. If
+ *    there are more key records than the bulk load run
+ *    size, they are sorted in runs of that size, which
+ *    are spilled to temporary files and merged.
+ * 3. Full and balanced key pages are built in parallel
+ *    and written sequentially to the key file.
+ * The files are written in large blocks and synced once
+ * at the end.
+ *
+ * The database must not be open and must be empty. Open the
+ * database once the records are loaded.
+ *
+ * @param [in] reader - the record reader.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::bulkLoad(RecordReader *reader)
+{
+	int     retval = E_ok;
+	char    idxPath[MAXPATHLEN + 1];
+	char    dbPath[MAXPATHLEN + 1];
+	char    attrPath[MAXPATHLEN + 1];
+	char    fdpPath[MAXPATHLEN + 1];
+	char    spillPfx[MAXPATHLEN + 1];
+	bool    newAttr = false;
+	int64_t vfsize = 0;
+	int64_t kfsize = 0;
+	int64_t nrecs = 0;
+	int     oserr = 0;
+
+	if (reader == 0) {
+		LOG_ERROR("Rdb", "invalid record reader specified");
+		return E_invalid_arg;
+	}
+
+	std::lock_guard<std::mutex> guard(openMutex);
+	if (opened) {
+		LOG_ERROR("Rdb", "DB is open; close it before bulk loading");
+		return E_invalid_state;
+	}
+
+	// Keep the other processes away while loading
+	retval = lock(false);
+	if (retval != E_ok) {
+		return retval;
+	}
+
+	snprintf(idxPath, MAXPATHLEN, "%s%c%s", path.c_str(), snf::pathsep(), name.c_str());
+	strncpy(dbPath, idxPath, MAXPATHLEN);
+	strncpy(attrPath, idxPath, MAXPATHLEN);
+	strncpy(fdpPath, idxPath, MAXPATHLEN);
+	strncpy(spillPfx, idxPath, MAXPATHLEN);
+
+	strncat(idxPath, ".idx", MAXPATHLEN);
+	strncat(dbPath, ".db", MAXPATHLEN);
+	strncat(attrPath, ".attr", MAXPATHLEN);
+	strncat(fdpPath, ".fdp", MAXPATHLEN);
+	strncat(spillPfx, ".bulk", MAXPATHLEN);
+
+	AttrFile attrFile(attrPath, 0022);
+	retval = attrFile.open();
+	if (retval != E_ok) {
+		unlock();
+		return retval;
+	}
+
+	retval = attrFile.read();
+	if (retval == E_ok) {
+		kpSize = attrFile.getKeyPageSize();
+		htSize = attrFile.getHashTableSize();
+	} else if (retval == E_eof_detected) {
+		newAttr = true;
+		retval = E_ok;
+	} else {
+		unlock();
+		return retval;
+	}
+
+	snf::file idxFile(idxPath, 0022);
+	snf::file dbFile(dbPath, 0022);
+	snf::file fdpFile(fdpPath, 0022);
+
+	if (((retval = BulkOpen(&idxFile)) != E_ok) ||
+		((retval = BulkOpen(&dbFile)) != E_ok) ||
+		((retval = BulkOpen(&fdpFile)) != E_ok)) {
+		unlock();
+		return retval;
+	}
+
+	if ((idxFile.size() != 0) || (dbFile.size() != 0)) {
+		LOG_ERROR("Rdb", "DB is not empty; cannot bulk load");
+		unlock();
+		return E_invalid_state;
+	}
+
+	int nparts = int(std::thread::hardware_concurrency());
+	if (nparts <= 0)
+		nparts = 1;
+	if (nparts > htSize)
+		nparts = htSize;
+
+	std::vector<bulk_part_t> parts(nparts);
+	for (int i = 0; i < nparts; ++i) {
+		parts[i].bp_spill = 0;
+		parts[i].bp_spilled = 0;
+	}
+
+	LOG_INFO("Rdb", "bulk loading %s using %d partitions", name.c_str(), nparts);
+
+	retval = BulkReadRecords(reader, &dbFile, htSize,
+			options.getBulkLoadRunSize(), spillPfx, parts, &vfsize);
+	if (retval == E_ok) {
+		if (parts[0].bp_spill == 0) {
+			std::vector<std::future<void>> sorters;
+			for (int i = 0; i < nparts; ++i) {
+				sorters.push_back(std::async(std::launch::async,
+					BulkSortPartition, &parts[i]));
+			}
+
+			for (int i = 0; i < nparts; ++i) {
+				sorters[i].get();
+			}
+		} else {
+			LOG_INFO("Rdb", "merging %d sorted runs per partition",
+				int(parts[0].bp_segs.size()));
+		}
+
+		std::vector<std::future<int>> counters;
+		for (int i = 0; i < nparts; ++i) {
+			counters.push_back(std::async(std::launch::async,
+				BulkCountPartition, &parts[i], kpSize));
+		}
+
+		for (int i = 0; i < nparts; ++i) {
+			int r = counters[i].get();
+			if (retval == E_ok)
+				retval = r;
+			parts[i].bp_kpoff = kfsize;
+			kfsize += parts[i].bp_npages * kpSize;
+			nrecs += parts[i].bp_nrecs;
+		}
+	}
+
+	if (retval == E_ok) {
+		std::vector<std::future<int>> writers;
+		for (int i = 0; i < nparts; ++i) {
+			writers.push_back(std::async(std::launch::async,
+				BulkWritePartition, idxPath, &parts[i], kpSize));
+		}
+
+		for (int i = 0; i < nparts; ++i) {
+			int r = writers[i].get();
+			if (retval == E_ok)
+				retval = r;
+		}
+	}
+
+	if (retval == E_ok) {
+		// The free disk page stack: the end of the
+		// file at the bottom, the overwritten values
+		// on top.
+		std::vector<int64_t> fdp;
+		fdp.push_back(vfsize);
+
+		int flags = VPAGE_DELETED;
+		for (int i = 0; (retval == E_ok) && (i < nparts); ++i) {
+			for (size_t j = 0; (retval == E_ok) && (j < parts[i].bp_dups.size()); ++j) {
+				int64_t voff = parts[i].bp_dups[j];
+				retval = BulkWrite(&dbFile, voff + offsetof(value_page_t, vp_flags),
+						&flags, int(sizeof(flags)));
+				fdp.push_back(voff);
+			}
+		}
+
+		if (retval == E_ok) {
+			retval = fdpFile.truncate(0L, &oserr);
+			if (retval != E_ok) {
+				LOG_SYSERR("Rdb", oserr, "failed to truncate file %s", fdpPath);
+			}
+		}
+
+		if (retval == E_ok) {
+			retval = BulkWrite(&fdpFile, 0L, fdp.data(),
+					int(fdp.size() * sizeof(int64_t)));
+		}
+	}
+
+	if (retval == E_ok) {
+		if (((retval = idxFile.sync(&oserr)) != E_ok) ||
+			((retval = dbFile.sync(&oserr)) != E_ok) ||
+			((retval = fdpFile.sync(&oserr)) != E_ok)) {
+			LOG_SYSERR("Rdb", oserr, "failed to sync database files");
+		}
+	}
+
+	if ((retval == E_ok) && newAttr) {
+		attrFile.setKeyPageSize(kpSize);
+		attrFile.setHashTableSize(htSize);
+		retval = attrFile.write();
+	}
+
+	BulkRemoveSpill(parts);
+
+	if (retval != E_ok) {
+		// Leave behind an empty database
+		idxFile.truncate(0L);
+		dbFile.truncate(0L);
+		fdpFile.truncate(0L);
+	} else {
+		LOG_INFO("Rdb",
+			"bulk loaded %" PRId64 " records (%" PRId64 " bytes of key pages, %"
+			PRId64 " bytes of value pages)",
+			nrecs, kfsize, vfsize);
+	}
+
+	unlock();
+
+	return retval;
+}
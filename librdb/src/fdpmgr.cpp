@@ -121,7 +121,7 @@ FreeDiskPageMgr::init()
 				}
 			} while (retval == E_ok);
 
-			if (retval != E_eof_detected) {
+			if (retval == E_eof_detected) {
 				retval = E_ok;
 			}
 		}
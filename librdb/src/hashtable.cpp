@@ -2,6 +2,9 @@
 #include <sys/mman.h>
 #endif
 
+#include <new>
+#include <thread>
+
 #include "hashtable.h"
 #include "logmgr.h"
 #include "error.h"
@@ -17,25 +20,38 @@ HashTable::initHashEntry(hash_entry_t *hent)
 	ASSERT((hent != 0), "HashTable", 0,
 		"invalid hash entry");
 
+	::new (hent) hash_entry_t;
+
 	hent->offset = -1L;
 	hent->head = 0;
 	hent->tail = 0;
-	hent->rwlock = 0;
+	hent->filter.store(HT_FILTER_UNKNOWN, std::memory_order_relaxed);
+	hent->lock.store(0, std::memory_order_relaxed);
 }
 
 /**
  * Allocates and initializes the hash table.
  *
- * @param [in] size - Hash table size.
+ * @param [in] size    - Hash table size.
+ * @param [in] aligned - Align every entry to the
+ *                       cache line?
  *
  * @return E_ok on success, -ve error code on failure.
  */
 int
-HashTable::allocate(int size)
+HashTable::allocate(int size, bool aligned)
 {
-	size_t	len = size * sizeof(hash_entry_t);
+	stride = aligned ? CACHE_LINE_SIZE : sizeof(hash_entry_t);
+
+	size_t	len = size * stride;
+
+#if defined(_WIN32)
+	ht = (char *)_aligned_malloc(len, CACHE_LINE_SIZE);
+#else
+	if (posix_memalign((void **)&ht, CACHE_LINE_SIZE, len) != 0)
+		ht = 0;
+#endif
 
-	ht = (hash_entry_t *)malloc(len);
 	if (ht == 0) {
 		ERROR_STRM("HashTable", errno)
 			<< "failed to allocate memory for hash table"
@@ -46,16 +62,58 @@ HashTable::allocate(int size)
 		posix_madvise(ht, len, MADV_WILLNEED);
 #endif
 		for (int i = 0; i < size; ++i)
-			initHashEntry(ht + i);
+			initHashEntry(entry(i));
 
 		htsize = size;
 		return E_ok;
 	}
 }
 
+/*
+ * Waits for the lock word of the hash table entry to
+ * change. The waiter marks the entry as parked before
+ * it checks the lock word one last time, so that the
+ * thread releasing the lock knows it has to wake up
+ * the waiters.
+ *
+ * @param [in] index - Hash table entry index.
+ * @param [in] hent  - Hash table entry.
+ * @param [in] busy  - Lock word bits the waiter is
+ *                     waiting for to clear.
+ */
+void
+HashTable::park(int index, hash_entry_t *hent, uint32_t busy)
+{
+	ht_park_t *p = parkLot + (index % HT_PARK_SLOTS);
+
+	std::unique_lock<std::mutex> guard(p->mutex);
+
+	uint32_t v = hent->lock.fetch_or(HT_LOCK_PARKED, std::memory_order_acq_rel);
+	if (v & busy)
+		p->cv.wait(guard);
+}
+
+/*
+ * Wakes up the threads waiting for the hash table entry.
+ *
+ * @param [in] index - Hash table entry index.
+ * @param [in] hent  - Hash table entry.
+ */
+void
+HashTable::unpark(int index, hash_entry_t *hent)
+{
+	ht_park_t *p = parkLot + (index % HT_PARK_SLOTS);
+
+	std::lock_guard<std::mutex> guard(p->mutex);
+
+	hent->lock.fetch_and(~HT_LOCK_PARKED, std::memory_order_relaxed);
+	p->cv.notify_all();
+}
+
 /**
  * Acquires read lock on hash table entry at the
- * specified index.
+ * specified index. New readers wait if a writer
+ * is waiting, so that the writers do not starve.
  *
  * @param [in] index - Hash table entry index.
  */
@@ -66,21 +124,27 @@ HashTable::rdlock(int index)
 		"out-of-bound hash table index (%d), range [%d, %d)",
 		index, 0, htsize);
 
-	hash_entry_t *hent = ht + index;
-
-	std::lock_guard<std::mutex> guard(mutex);
+	hash_entry_t *hent = entry(index);
+	uint32_t busy = HT_LOCK_WRITER | HT_LOCK_PENDING;
+	uint32_t v = hent->lock.load(std::memory_order_relaxed);
 
-	if (hent->rwlock == 0) {
-		hent->rwlock = rwlockPool->get();
-	}
+	for (int spins = 0; ; ++spins) {
+		if ((v & busy) == 0) {
+			if (hent->lock.compare_exchange_weak(v, v + 1,
+					std::memory_order_acquire, std::memory_order_relaxed))
+				return;
+			continue;
+		}
 
-	ASSERT((hent->rwlock != 0), "HashTable", 0,
-		"failed to get read write lock");
+		if (spins < HT_LOCK_SPINS) {
+			std::this_thread::yield();
+		} else {
+			park(index, hent, busy);
+			spins = 0;
+		}
 
-	int error = 0;
-	int r = hent->rwlock->rdlock(&error);
-	ASSERT((r == E_ok), "HashTable", error,
-		"failed to get read lock on %d", index);
+		v = hent->lock.load(std::memory_order_relaxed);
+	}
 }
 
 /**
@@ -96,17 +160,15 @@ HashTable::rdunlock(int index)
 		"out-of-bound hash table index (%d), range [%d, %d)",
 		index, 0, htsize);
 
-	hash_entry_t *hent = ht + index;
+	hash_entry_t *hent = entry(index);
 
-	std::lock_guard<std::mutex> guard(mutex);
+	uint32_t v = hent->lock.fetch_sub(1, std::memory_order_release);
 
-	if (hent->rwlock) {
-		hent->rwlock->rdunlock();
-		if (hent->rwlock->getLockCount() == 0) {
-			rwlockPool->put(hent->rwlock);
-			hent->rwlock = 0;
-		}
-	}
+	ASSERT(((v & HT_LOCK_READERS) != 0), "HashTable", 0,
+		"hash table entry %d is not read locked", index);
+
+	if (((v & HT_LOCK_READERS) == 1) && (v & HT_LOCK_PARKED))
+		unpark(index, hent);
 }
 
 /**
@@ -122,21 +184,30 @@ HashTable::wrlock(int index)
 		"out-of-bound hash table index (%d), range [%d, %d)",
 		index, 0, htsize);
 
-	hash_entry_t *hent = ht + index;
+	hash_entry_t *hent = entry(index);
+	uint32_t busy = HT_LOCK_WRITER | HT_LOCK_READERS;
+	uint32_t v = hent->lock.load(std::memory_order_relaxed);
 
-	std::lock_guard<std::mutex> guard(mutex);
+	for (int spins = 0; ; ++spins) {
+		if ((v & busy) == 0) {
+			if (hent->lock.compare_exchange_weak(v, (v | HT_LOCK_WRITER) & ~HT_LOCK_PENDING,
+					std::memory_order_acquire, std::memory_order_relaxed))
+				return;
+			continue;
+		}
 
-	if (hent->rwlock == 0) {
-		hent->rwlock = rwlockPool->get();
-	}
+		if ((v & HT_LOCK_PENDING) == 0)
+			hent->lock.fetch_or(HT_LOCK_PENDING, std::memory_order_relaxed);
 
-	ASSERT((hent->rwlock != 0), "HashTable", 0,
-		"failed to get read write lock");
+		if (spins < HT_LOCK_SPINS) {
+			std::this_thread::yield();
+		} else {
+			park(index, hent, busy);
+			spins = 0;
+		}
 
-	int error = 0;
-	int r = hent->rwlock->wrlock(&error);
-	ASSERT((r == E_ok), "HashTable", error,
-		"failed to get write lock on %d", index);
+		v = hent->lock.load(std::memory_order_relaxed);
+	}
 }
 
 /**
@@ -152,15 +223,15 @@ HashTable::wrunlock(int index)
 		"out-of-bound hash table index (%d), range [%d, %d)",
 		index, 0, htsize);
 
-	hash_entry_t *hent = ht + index;
+	hash_entry_t *hent = entry(index);
 
-	std::lock_guard<std::mutex> guard(mutex);
+	uint32_t v = hent->lock.fetch_and(~HT_LOCK_WRITER, std::memory_order_release);
 
-	if (hent->rwlock) {
-		hent->rwlock->wrunlock();
-		rwlockPool->put(hent->rwlock);
-		hent->rwlock = 0;
-	}
+	ASSERT(((v & HT_LOCK_WRITER) != 0), "HashTable", 0,
+		"hash table entry %d is not write locked", index);
+
+	if (v & HT_LOCK_PARKED)
+		unpark(index, hent);
 }
 
 /**
@@ -178,7 +249,7 @@ HashTable::getOffset(int index)
 		"out-of-bound hash table index (%d), range [%d, %d)",
 		index, 0, htsize);
 
-	hash_entry_t *hent = ht + index;
+	hash_entry_t *hent = entry(index);
 
 	return hent->offset;
 }
@@ -195,11 +266,117 @@ HashTable::setOffset(int index, int64_t offset)
 		"out-of-bound hash table index (%d), range [%d, %d)",
 		index, 0, htsize);
 
-	hash_entry_t *hent = ht + index;
+	hash_entry_t *hent = entry(index);
 
 	hent->offset = offset;
 }
 
+/**
+ * Gets the key fingerprints of the hash table entry.
+ *
+ * @param [in] index - Hash table entry index.
+ *
+ * @return the key fingerprints, HT_FILTER_UNKNOWN if
+ * they are not built yet, HT_FILTER_FULL if there are
+ * too many keys.
+ */
+uint64_t
+HashTable::getFilter(int index)
+{
+	ASSERT(((index >= 0) && (index < htsize)), "HashTable", 0,
+		"out-of-bound hash table index (%d), range [%d, %d)",
+		index, 0, htsize);
+
+	hash_entry_t *hent = entry(index);
+
+	return hent->filter.load(std::memory_order_relaxed);
+}
+
+/**
+ * Checks the key fingerprints of the hash table entry.
+ * The caller must hold the lock on the entry.
+ *
+ * @param [in] index - Hash table entry index.
+ * @param [in] key   - Key.
+ * @param [in] klen  - Key length.
+ *
+ * @return false if the key is definitely not in any
+ * of the key pages of the entry, true otherwise.
+ */
+bool
+HashTable::mayContain(int index, const char *key, int klen)
+{
+	ASSERT(((index >= 0) && (index < htsize)), "HashTable", 0,
+		"out-of-bound hash table index (%d), range [%d, %d)",
+		index, 0, htsize);
+
+	hash_entry_t *hent = entry(index);
+
+	uint64_t filter = hent->filter.load(std::memory_order_relaxed);
+	if (filter == HT_FILTER_UNKNOWN)
+		return true;
+
+	return ((filter & keyfp(key, klen)) != 0);
+}
+
+/**
+ * Adds the key fingerprint to the hash table entry. The
+ * fingerprints are never removed; a removed key only
+ * costs a false positive. The caller must hold the
+ * write lock on the entry.
+ *
+ * @param [in] index - Hash table entry index.
+ * @param [in] key   - Key.
+ * @param [in] klen  - Key length.
+ */
+void
+HashTable::addToFilter(int index, const char *key, int klen)
+{
+	ASSERT(((index >= 0) && (index < htsize)), "HashTable", 0,
+		"out-of-bound hash table index (%d), range [%d, %d)",
+		index, 0, htsize);
+
+	hash_entry_t *hent = entry(index);
+
+	uint64_t filter = hent->filter.load(std::memory_order_relaxed);
+	if ((filter == HT_FILTER_UNKNOWN) || (filter == HT_FILTER_FULL))
+		return;
+
+	setFilter(index, filter | keyfp(key, klen));
+}
+
+/**
+ * Sets the key fingerprints of the hash table entry.
+ * The filter is given up once it has too many bits
+ * set to be useful. The caller must hold the lock on
+ * the entry. Readers may race to set the filter, but
+ * they all set the same value.
+ *
+ * @param [in] index  - Hash table entry index.
+ * @param [in] filter - Fingerprints of all the keys
+ *                      of the entry.
+ */
+void
+HashTable::setFilter(int index, uint64_t filter)
+{
+	ASSERT(((index >= 0) && (index < htsize)), "HashTable", 0,
+		"out-of-bound hash table index (%d), range [%d, %d)",
+		index, 0, htsize);
+
+	hash_entry_t *hent = entry(index);
+
+	filter |= HT_FILTER_VALID;
+
+	int nbits = 0;
+	for (uint64_t f = filter; f; f &= (f - 1))
+		nbits++;
+
+	if (nbits > HT_FILTER_MAX_BITS)
+		filter = HT_FILTER_FULL;
+
+	hent->filter.store(filter, std::memory_order_relaxed);
+}
+
 /**
  * Adds the key page node to the end of the list.
  *
@@ -217,7 +394,7 @@ HashTable::addKeyPageNode(int index, key_page_node_t *kpn)
 
 	kpn->kpn_prev = kpn->kpn_next = 0;
 
-	hash_entry_t *hent = ht + index;
+	hash_entry_t *hent = entry(index);
 
 	if (hent->head == 0) {
 		hent->head = kpn;
@@ -245,7 +422,7 @@ HashTable::removeKeyPageNode(int index, key_page_node_t *kpn)
 		"out-of-bound hash table index (%d), range [%d, %d)",
 		index, 0, htsize);
 
-	hash_entry_t *hent = ht + index;
+	hash_entry_t *hent = entry(index);
 
 	ASSERT(((hent->head != 0) && (hent->tail != 0)), "HashTable", 0,
 		"key page list is empty");
@@ -282,7 +459,7 @@ HashTable::getKeyPageNodeList(int index)
 		"out-of-bound hash table index (%d), range [%d, %d)",
 		index, 0, htsize);
 
-	hash_entry_t *hent = ht + index;
+	hash_entry_t *hent = entry(index);
 	return hent->head;
 }
 
@@ -298,7 +475,7 @@ HashTable::freeKeyPageNodeList(int index)
 		"out-of-bound hash table index (%d), range [%d, %d)",
 		index, 0, htsize);
 
-	hash_entry_t *hent = ht + index;
+	hash_entry_t *hent = entry(index);
 	if (hent->head) {
 		key_page_node_t *kpn;
 		while ((kpn = hent->head) != 0) {
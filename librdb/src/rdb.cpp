@@ -121,7 +121,7 @@ Rdb::populateFreePages(const char *fname)
 		if (fdpMgr->size() == 0) {
 			// Most likely we are opening the db for the first time
 			if (-1L == vfsize) {
-				valueFile->size();
+				vfsize = valueFile->size();
 			}
 			fdpMgr->free(vfsize);
 		}
@@ -131,9 +131,35 @@ Rdb::populateFreePages(const char *fname)
 	return retval;
 }
 
+/*
+ * Gets the fingerprints of all the keys in the key page.
+ *
+ * @param [in] kp     - key page.
+ * @param [in] kpsize - key page size.
+ *
+ * @return the key fingerprints.
+ */
+static uint64_t
+KeyPageFilter(const key_page_t *kp, int kpsize)
+{
+	uint64_t    filter = 0;
+	int         nkeys = NUM_OF_KEYS_IN_PAGE(kpsize);
+
+	for (int i = 0; i < nkeys; ++i) {
+		const key_rec_t *kr = kp->kp_keys + i;
+		if (kr->kr_flags == KEY_INUSE)
+			filter |= keyfp(kr->kr_key, kr->kr_klen);
+	}
+
+	return filter;
+}
+
 /*
  * Main function to process the key pages and find the
  * correct key page that holds (or can hold) the key.
+ * A GET that walks all the key pages without finding
+ * the key (re)builds the key fingerprints of the hash
+ * table entry on the way.
  *
  * @param [inout] key - key information.
  * @param [in]    op  - operation being performed.
@@ -147,6 +173,9 @@ Rdb::processKeyPages(key_info_t *ki, op_t op)
 	key_page_t      *kp = 0;
 	int64_t         nextOffset = hashTable->getOffset(ki->ki_hash);
 	key_page_node_t *kpn = hashTable->getKeyPageNodeList(ki->ki_hash);
+	uint64_t        filter = 0;
+	bool            buildFilter = (op == GET) &&
+				(hashTable->getFilter(ki->ki_hash) != HT_FILTER_FULL);
 
 	while ((retval == E_ok) &&
 			(nextOffset != -1L) &&
@@ -201,6 +230,9 @@ Rdb::processKeyPages(key_info_t *ki, op_t op)
 						return E_ok;
 					}
 				}
+
+				if (buildFilter)
+					filter |= KeyPageFilter(kp, kpSize);
 			} else if (op == SET) {
 				if (kp->kp_vcount < NUM_OF_KEYS_IN_PAGE(kpSize)) {
 					KeyRecords keyRec(kp, kpSize); 
@@ -273,6 +305,9 @@ Rdb::processKeyPages(key_info_t *ki, op_t op)
 						return E_ok;
 					}
 				}
+
+				if (buildFilter)
+					filter |= KeyPageFilter(kp, kpSize);
 			} else if (op == SET) {
 				if (kp->kp_vcount < NUM_OF_KEYS_IN_PAGE(kpSize)) {
 					KeyRecords keyRec(kp, kpSize); 
@@ -295,8 +330,62 @@ Rdb::processKeyPages(key_info_t *ki, op_t op)
 		}
 	}
 
-	if (retval == E_ok)
+	if (retval == E_ok) {
+		// All the key pages are seen; the key fingerprints are complete
+		if (buildFilter)
+			hashTable->setFilter(ki->ki_hash, filter);
 		retval = E_not_found;
+	}
+
+	return retval;
+}
+
+/*
+ * Reads the value of the key located in the key pages.
+ * The value cache, if enabled, is checked first.
+ *
+ * @param [in]    ki    - key information.
+ * @param [out]   value - value for the key.
+ * @param [inout] vlen  - maximum value size on input,
+ *                        actual value size on output.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::getValue(key_info_t *ki, char *value, int *vlen)
+{
+	int             retval = E_ok;
+	value_page_t    vp;
+
+	if (vcache && (vcache->get(ki->ki_voff, &vp) == E_ok)) {
+		retval = E_ok;
+	} else {
+		retval = valueFile->read(ki->ki_voff, &vp);
+		if ((retval == E_ok) && vcache) {
+			vcache->put(ki->ki_voff, &vp);
+		}
+	}
+
+	if (retval != E_ok) {
+		LOG_ERROR("Rdb", "failed to read value page at offset %" PRId64 " from %s",
+			ki->ki_voff, valueFile->name());
+	} else {
+		ASSERT(!IsValuePageDeleted(&vp), "Rdb", 0,
+			"value is already deleted");
+		ASSERT((ki->ki_klen == vp.vp_klen), "Rdb", 0,
+			"key length mismatch (expected %d, found %d)", ki->ki_klen, vp.vp_klen);
+		ASSERT((memcmp(ki->ki_key, vp.vp_key, ki->ki_klen) == 0), "Rdb", 0,
+			"key mismatch");
+
+		if (vp.vp_vlen > *vlen) {
+			retval = E_insufficient_buffer;
+		} else {
+			if (vp.vp_vlen < *vlen) {
+				*vlen = vp.vp_vlen;
+			}
+			memcpy(value, vp.vp_value, *vlen);
+		}
+	}
 
 	return retval;
 }
@@ -472,6 +561,106 @@ Rdb::setHashTableSize(int htsize)
 	}
 }
 
+/*
+ * Locks the database against the other processes. The
+ * first byte of <dbname>.lck is locked in shared mode
+ * by the processes that open the database in shared
+ * mode, and in exclusive mode by the process that opens
+ * the database for update.
+ *
+ * @param [in] shared - lock in shared mode?
+ *
+ * @return E_ok on success, E_try_again if the database is
+ * in use by other process(es), -ve error code on failure.
+ */
+int
+Rdb::lock(bool shared)
+{
+	int     retval = E_ok;
+	int     oserr = 0;
+	char    lckPath[MAXPATHLEN + 1];
+
+	snprintf(lckPath, MAXPATHLEN, "%s%c%s.lck", path.c_str(), snf::pathsep(), name.c_str());
+
+	std::unique_ptr<snf::file> pLockFile(DBG_NEW snf::file(lckPath, 0022));
+
+	snf::file::open_flags oflags;
+	oflags.o_read = true;
+	oflags.o_write = true;
+	oflags.o_create = true;
+
+	retval = pLockFile->open(oflags, 0600, &oserr);
+	if (retval != E_ok) {
+		LOG_SYSERR("Rdb", oserr, "failed to open lock file %s", lckPath);
+		return retval;
+	}
+
+	retval = pLockFile->trylock(
+			shared ? snf::file::lock_type::shared : snf::file::lock_type::exclusive,
+			0L, 1L, &oserr);
+	if (retval == E_try_again) {
+		LOG_ERROR("Rdb", "DB is in use by other process(es)");
+	} else if (retval != E_ok) {
+		LOG_SYSERR("Rdb", oserr, "failed to lock file %s", lckPath);
+	} else {
+		lockFile = pLockFile.release();
+	}
+
+	return retval;
+}
+
+/*
+ * Unlocks the database.
+ */
+void
+Rdb::unlock()
+{
+	if (lockFile) {
+		delete lockFile;
+		lockFile = 0;
+	}
+}
+
+/*
+ * Frees everything open() allocates and unlocks the
+ * database. Used by close(), and by open() on failure.
+ */
+void
+Rdb::cleanup()
+{
+	if (valueFile) {
+		delete valueFile;
+		valueFile = 0;
+	}
+
+	if (keyFile) {
+		delete keyFile;
+		keyFile = 0;
+	}
+
+	if (cache) {
+		delete cache;
+		cache = 0;
+	}
+
+	if (vcache) {
+		delete vcache;
+		vcache = 0;
+	}
+
+	if (hashTable) {
+		delete hashTable;
+		hashTable = 0;
+	}
+
+	if (shmIndex) {
+		delete shmIndex;
+		shmIndex = 0;
+	}
+
+	unlock();
+}
+
 /**
  * Opens the database. The key page size and hash table size
  * must be set before opening the database for the first time.
@@ -479,12 +668,20 @@ Rdb::setHashTableSize(int htsize)
  * size do not change. The only way to change them is to rebuild
  * the database.
  *
- * @return E_ok on success, -ve error code on failure.
+ * In shared mode, the database must already exist. It is opened
+ * read-only and the hash table is shared with the other processes
+ * that open the database in shared mode.
+ *
+ * @return E_ok on success, E_try_again if the database is in use
+ * by other process(es) in a conflicting mode, -ve error code on
+ * failure.
  */
 int
 Rdb::open()
 {
 	int     retval = E_ok;
+	int     oserr = 0;
+	bool    shared = options.sharedMode();
 	char    idxPath[MAXPATHLEN + 1];
 	char    dbPath[MAXPATHLEN + 1];
 	char    attrPath[MAXPATHLEN + 1];
@@ -505,24 +702,36 @@ Rdb::open()
 	strncat(attrPath, ".attr", MAXPATHLEN);
 	strncat(fdpPath, ".fdp", MAXPATHLEN);
 
+	retval = lock(shared);
+	if (retval != E_ok) {
+		return retval;
+	}
+
 	std::unique_ptr<AttrFile> attrFile(DBG_NEW AttrFile(attrPath, 0022));
 	retval = attrFile->open();
 	if (retval != E_ok) {
+		cleanup();
 		return retval;
 	}
 
 	retval = attrFile->read();
 	if (retval != E_ok) {
 		if (retval == E_eof_detected) {
-			attrFile->setKeyPageSize(kpSize);
-			attrFile->setHashTableSize(htSize);
-			retval = attrFile->write();
+			if (shared) {
+				LOG_ERROR("Rdb", "DB %s does not exist", name.c_str());
+				retval = E_not_found;
+			} else {
+				attrFile->setKeyPageSize(kpSize);
+				attrFile->setHashTableSize(htSize);
+				retval = attrFile->write();
+			}
 		}
 	}
 
 	attrFile->close();
 
 	if (retval != E_ok) {
+		cleanup();
 		return retval;
 	}
 
@@ -532,35 +741,68 @@ Rdb::open()
 	std::unique_ptr<KeyFile> pKeyFile(DBG_NEW KeyFile(idxPath, 0022));
 	retval = pKeyFile->open(options.syncIndexFile());
 	if (retval != E_ok) {
+		cleanup();
 		return retval;
 	}
 
 	std::unique_ptr<ValueFile> pValueFile(DBG_NEW ValueFile(dbPath, 0022));
 	retval = pValueFile->open(options.syncDataFile());
 	if (retval != E_ok) {
+		cleanup();
 		return retval;
 	}
 
-	hashTable = DBG_NEW HashTable();
-	retval = hashTable->allocate(htSize);
-	if (retval != E_ok) {
-		return retval;
-	}
+	if (shared) {
+		// Serialize building/attaching the shared index
+		retval = lockFile->lock(snf::file::lock_type::exclusive, 1L, 1L, &oserr);
+		if (retval != E_ok) {
+			LOG_SYSERR("Rdb", oserr, "failed to lock file %s", lockFile->name());
+			cleanup();
+			return retval;
+		}
 
-	keyFile = pKeyFile.release();
-	valueFile = pValueFile.release();
+		std::unique_ptr<SharedIndex> pShmIndex(DBG_NEW SharedIndex(kpSize, htSize));
+		retval = pShmIndex->open(pKeyFile.get());
 
-	cache = DBG_NEW LRUCache(keyFile, kpSize, options.getMemoryUsage());
+		lockFile->unlock(1L, 1L);
 
-	retval = populateHashTable();
-	if (retval == E_ok) {
-		retval = populateFreePages(fdpPath);
+		if (retval != E_ok) {
+			cleanup();
+			return retval;
+		}
+
+		keyFile = pKeyFile.release();
+		valueFile = pValueFile.release();
+		shmIndex = pShmIndex.release();
+	} else {
+		// The database is about to change; the shared
+		// index, if any, is stale now.
+		SharedIndex::remove(pKeyFile.get());
+
+		hashTable = DBG_NEW HashTable();
+		retval = hashTable->allocate(htSize, options.cacheAlignHashTable());
+		if (retval != E_ok) {
+			cleanup();
+			return retval;
+		}
+
+		keyFile = pKeyFile.release();
+		valueFile = pValueFile.release();
+
+		cache = DBG_NEW LRUCache(keyFile, kpSize, options.getMemoryUsage());
+
+		retval = populateHashTable();
+		if (retval == E_ok) {
+			retval = populateFreePages(fdpPath);
+		}
+	}
+
+	if ((retval == E_ok) && (options.getValueCacheSize() > 0)) {
+		vcache = DBG_NEW ValueCache(options.getValueCacheSize());
 	}
 
 	if (retval != E_ok) {
-		delete valueFile;
-		delete keyFile;
-		delete hashTable;
+		cleanup();
 	} else {
 		opened = true;
 	}
@@ -589,7 +831,6 @@ Rdb::get(
 {
 	int             retval;
 	int             hindex = -1;
-	value_page_t    vp;
 	key_info_t      ki;
 
 	if ((key == 0) || (*key == '\0')) {
@@ -621,43 +862,34 @@ Rdb::get(
 	ASSERT(((hindex >= 0) && (hindex < htSize)), "Rdb", 0,
 		"invalid hash value (%d)", hindex);
 
-	HTLockGuard guard(hashTable, hindex, false);
-
 	SetKeyInfo(&ki, key, klen, hindex);
 
-	retval = processKeyPages(&ki, GET);
-	if (retval == E_ok) {
-		ASSERT((ki.ki_kpn != 0), "Rdb", 0,
-			"found the key but key page node is not set");
-		ASSERT((ki.ki_kpn->kpn_kp != 0), "Rdb", 0,
-			"found the key but key page is not set");
-		ASSERT((ki.ki_kpn->kpn_kpoff != -1), "Rdb", 0,
-			"found the key but key page offset is not set");
-		ASSERT((ki.ki_kidx != -1), "Rdb", 0,
-			"found the key but key index in page is not set");
-		ASSERT((ki.ki_voff != -1), "Rdb", 0,
-			"found the key but value page offset is not set");
+	if (shmIndex) {
+		retval = shmIndex->get(&ki);
+		if (retval == E_ok) {
+			retval = getValue(&ki, value, vlen);
+		}
+	} else {
+		HTLockGuard guard(hashTable, hindex, false);
 
-		retval = valueFile->read(ki.ki_voff, &vp);
-		if (retval != E_ok) {
-			LOG_ERROR("Rdb", "failed to read value page at offset %" PRId64 " from %s",
-				ki.ki_voff, valueFile->name());
-		} else {
-			ASSERT(!IsValuePageDeleted(&vp), "Rdb", 0,
-				"value is already deleted");
-			ASSERT((klen == vp.vp_klen), "Rdb", 0,
-				"key length mismatch (expected %d, found %d)", klen, vp.vp_klen);
-			ASSERT((memcmp(key, vp.vp_key, klen) == 0), "Rdb", 0,
-				"key mismatch");
-
-			if (vp.vp_vlen > *vlen) {
-				retval = E_insufficient_buffer;
-			} else {
-				if (vp.vp_vlen < *vlen) {
-					*vlen = vp.vp_vlen;
-				}
-				memcpy(value, vp.vp_value, *vlen);
-			}
+		if (hashTable->mayContain(hindex, key, klen))
+			retval = processKeyPages(&ki, GET);
+		else
+			retval = E_not_found;
+
+		if (retval == E_ok) {
+			ASSERT((ki.ki_kpn != 0), "Rdb", 0,
+				"found the key but key page node is not set");
+			ASSERT((ki.ki_kpn->kpn_kp != 0), "Rdb", 0,
+				"found the key but key page is not set");
+			ASSERT((ki.ki_kpn->kpn_kpoff != -1), "Rdb", 0,
+				"found the key but key page offset is not set");
+			ASSERT((ki.ki_kidx != -1), "Rdb", 0,
+				"found the key but key index in page is not set");
+			ASSERT((ki.ki_voff != -1), "Rdb", 0,
+				"found the key but value page offset is not set");
+
+			retval = getValue(&ki, value, vlen);
 		}
 	}
 
@@ -728,6 +960,11 @@ Rdb::set(
 		return E_invalid_arg;
 	}
 
+	if (shmIndex) {
+		LOG_ERROR("Rdb", "DB is opened in shared mode");
+		return E_invalid_state;
+	}
+
 	{
 		std::lock_guard<std::mutex> guard(opMutex);
 		opCount++;
@@ -743,7 +980,11 @@ Rdb::set(
 
 	InitValuePage(&vp, key, klen, value, vlen);
 
-	retval = processKeyPages(&ki, GET);
+	if (hashTable->mayContain(hindex, key, klen))
+		retval = processKeyPages(&ki, GET);
+	else
+		retval = E_not_found;
+
 	if (retval == E_ok) {
 		ASSERT((ki.ki_kpn != 0), "Rdb", 0,
 			"found the key but key page node is not set");
@@ -781,6 +1022,10 @@ Rdb::set(
 		}
 
 		if (retval == E_ok) {
+			if (vcache) {
+				vcache->invalidate(ki.ki_voff);
+			}
+
 			retval = valueFile->write(ki.ki_voff, &vp);
 			if (retval != E_ok) {
 				LOG_ERROR("Rdb", "failed to write value to %s",
@@ -803,6 +1048,10 @@ Rdb::set(
 			if (retval == E_not_found) {
 				retval = addNewPage(&ki);
 			}
+
+			if (retval == E_ok) {
+				hashTable->addToFilter(hindex, key, klen);
+			}
 		}
 	}
 
@@ -845,6 +1094,11 @@ Rdb::remove(
 		return E_invalid_arg;
 	}
 
+	if (shmIndex) {
+		LOG_ERROR("Rdb", "DB is opened in shared mode");
+		return E_invalid_state;
+	}
+
 	{
 		std::lock_guard<std::mutex> guard(opMutex);
 		opCount++;
@@ -858,7 +1112,11 @@ Rdb::remove(
 
 	SetKeyInfo(&ki, key, klen, hindex);
 
-	retval = processKeyPages(&ki, GET);
+	if (hashTable->mayContain(hindex, key, klen))
+		retval = processKeyPages(&ki, GET);
+	else
+		retval = E_not_found;
+
 	if (retval == E_ok) {
 		ASSERT((ki.ki_kpn != 0), "Rdb", 0,
 			"found the key but key page node is not set");
@@ -871,6 +1129,10 @@ Rdb::remove(
 		ASSERT((ki.ki_voff != -1), "Rdb", 0,
 			"found the key but value page offset is not set");
 
+		if (vcache) {
+			vcache->invalidate(ki.ki_voff);
+		}
+
 		// Mark the value page as deleted
 		retval = valueFile->writeFlags(ki.ki_voff, 0, VPAGE_DELETED);
 		if (retval != E_ok) {
@@ -890,8 +1152,9 @@ Rdb::remove(
 				"found and deleted key page mismatch");
 			ASSERT((ki.ki_kpn->kpn_kpoff == dki.ki_kpn->kpn_kpoff), "Rdb", 0,
 				"found and deleted key page offset mismatch");
-			ASSERT((ki.ki_kidx == dki.ki_kidx), "Rdb", 0,
-				"found and deleted key index mismatch");
+			// The key indices may differ: when the key has both the
+			// subtrees, it is replaced by the maximum key in its left
+			// subtree, and the record of that key is freed instead.
 
 			// The key is deleted now
 
@@ -1034,6 +1297,11 @@ Rdb::rebuild()
 			return E_invalid_state;
 		}
 
+		if (options.sharedMode()) {
+			LOG_ERROR("Rdb", "DB cannot be rebuilt in shared mode");
+			return E_invalid_state;
+		}
+
 		snprintf(idxPath, MAXPATHLEN, "%s%c%s", path.c_str(), snf::pathsep(), name.c_str());
 		strncpy(dbPath, idxPath, MAXPATHLEN);
 		strncpy(attrPath, idxPath, MAXPATHLEN);
@@ -1136,25 +1404,7 @@ Rdb::close()
 		return E_try_again;
 	}
 
-	if (valueFile) {
-		delete valueFile;
-		valueFile = 0;
-	}
-
-	if (keyFile) {
-		delete keyFile;
-		keyFile = 0;
-	}
-
-	if (cache) {
-		delete cache;
-		cache = 0;
-	}
-
-	if (hashTable) {
-		delete hashTable;
-		hashTable = 0;
-	}
+	cleanup();
 
 	opened = false;
 
@@ -0,0 +1,772 @@
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "rdb.h"
+#include "json.h"
+#include "logmgr.h"
+#include "flogger.h"
+
+/*
+ * YCSB style benchmark for librdb.
+ *
+ * The database is loaded with <records> key/value pairs and
+ * then <operations> operations of the chosen workload mix are
+ * run using <threads> threads. The throughput and the latency
+ * percentiles of every operation type are reported.
+ *
+ * Workload | Mix
+ * ---------|-------------------------------------------
+ * a        | 50% read, 50% update
+ * b        | 95% read, 5% update
+ * c        | 100% read
+ * d        | 95% read (latest keys), 5% insert
+ * e        | 95% scan, 5% insert
+ * f        | 50% read, 50% read-modify-write
+ *
+ * librdb is a hash store and has no ordered scan. A scan of
+ * N keys is emulated by N gets of consecutive keys.
+ */
+
+enum op_type { OP_READ, OP_UPDATE, OP_INSERT, OP_SCAN, OP_RMW, OP_MAX };
+
+static const char *OpNames[OP_MAX] = { "read", "update", "insert", "scan", "rmw" };
+
+enum key_dist { DIST_UNIFORM, DIST_ZIPFIAN, DIST_LATEST };
+
+static const char *DistNames[] = { "uniform", "zipfian", "latest" };
+
+typedef struct bench_config
+{
+	std::string path;
+	std::string name;
+	char        workload;
+	int64_t     records;
+	int64_t     operations;
+	int         threads;
+	int         ksize;
+	int         vsize;
+	key_dist    dist;
+	bool        cold;
+	bool        load;
+	bool        bulk;
+	int         scanlen;
+	unsigned    seed;
+	double      rprop;      // read proportion
+	double      uprop;      // update proportion
+	double      iprop;      // insert proportion
+	double      sprop;      // scan proportion
+	double      mprop;      // read-modify-write proportion
+} bench_config_t;
+
+/*
+ * Zipfian generator (Gray et al., "Quickly Generating
+ * Billion-Record Synthetic Databases"), as used by YCSB.
+ * The zeta constant is computed once; every thread draws
+ * using its own random engine.
+ */
+class ZipfianGenerator
+{
+private:
+	int64_t items;
+	double  theta;
+	double  zetan;
+	double  alpha;
+	double  eta;
+
+	static double zeta(int64_t n, double theta)
+	{
+		double sum = 0.0;
+		for (int64_t i = 0; i < n; ++i)
+			sum += 1.0 / std::pow(double(i + 1), theta);
+		return sum;
+	}
+
+public:
+	ZipfianGenerator(int64_t n, double t = 0.99)
+		: items(n),
+		  theta(t)
+	{
+		double zeta2 = zeta(2, theta);
+		zetan = zeta(items, theta);
+		alpha = 1.0 / (1.0 - theta);
+		eta = (1.0 - std::pow(2.0 / double(items), 1.0 - theta)) / (1.0 - zeta2 / zetan);
+	}
+
+	int64_t next(std::mt19937_64 &rng) const
+	{
+		double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+		double uz = u * zetan;
+
+		if (uz < 1.0)
+			return 0;
+
+		if (uz < (1.0 + std::pow(0.5, theta)))
+			return (items > 1) ? 1 : 0;
+
+		int64_t n = int64_t(double(items) * std::pow(eta * u - eta + 1.0, alpha));
+		return (n >= items) ? (items - 1) : n;
+	}
+};
+
+/*
+ * Bijective 64-bit mixer. Scatters the popular key ids
+ * over the key space, and over the hash table.
+ */
+static inline uint64_t
+Mix64(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+static int
+MakeKey(int64_t id, int ksize, char *key)
+{
+	char buf[32];
+	int  n = snprintf(buf, sizeof(buf), "k%016" PRIx64, Mix64(uint64_t(id)));
+
+	memset(key, '0', ksize);
+	memcpy(key + ksize - n, buf, n);
+	return ksize;
+}
+
+static int
+MakeValue(int64_t id, int64_t ver, int vsize, char *val)
+{
+	uint64_t x = Mix64(uint64_t(id) ^ (uint64_t(ver) << 40));
+
+	for (int i = 0; i < vsize; ++i) {
+		val[i] = 'a' + char(x % 26);
+		x = (x >> 5) | (x << 59);
+	}
+
+	return vsize;
+}
+
+/*
+ * Latencies (in nanoseconds) and counters of one
+ * operation type.
+ */
+class OpStats
+{
+public:
+	std::vector<int64_t>    latencies;
+	int64_t                 errors;
+	int64_t                 notFound;
+
+	OpStats() : errors(0), notFound(0) {}
+
+	void merge(const OpStats &s)
+	{
+		latencies.insert(latencies.end(), s.latencies.begin(), s.latencies.end());
+		errors += s.errors;
+		notFound += s.notFound;
+	}
+
+	snf::json::object report(std::ostream &os, const char *name)
+	{
+		snf::json::object o;
+		int64_t count = int64_t(latencies.size());
+
+		o.add(KVPAIR("count", count));
+		o.add(KVPAIR("errors", errors));
+		o.add(KVPAIR("not_found", notFound));
+
+		if (count == 0)
+			return o;
+
+		std::sort(latencies.begin(), latencies.end());
+
+		double sum = 0.0;
+		for (int64_t l : latencies)
+			sum += double(l);
+
+		double avg = sum / double(count) / 1000.0;
+		double p50 = double(percentile(50.0)) / 1000.0;
+		double p99 = double(percentile(99.0)) / 1000.0;
+		double p999 = double(percentile(99.9)) / 1000.0;
+		double max = double(latencies.back()) / 1000.0;
+
+		o.add(KVPAIR("avg_us", avg));
+		o.add(KVPAIR("p50_us", p50));
+		o.add(KVPAIR("p99_us", p99));
+		o.add(KVPAIR("p999_us", p999));
+		o.add(KVPAIR("max_us", max));
+
+		char line[256];
+		snprintf(line, sizeof(line),
+			"%-8s count=%" PRId64 " errors=%" PRId64 " not_found=%" PRId64
+			" avg=%.2fus p50=%.2fus p99=%.2fus p999=%.2fus max=%.2fus",
+			name, count, errors, notFound, avg, p50, p99, p999, max);
+		os << line << std::endl;
+
+		return o;
+	}
+
+private:
+	int64_t percentile(double p) const
+	{
+		size_t idx = size_t(std::ceil(p / 100.0 * double(latencies.size())));
+		if (idx > 0)
+			idx--;
+		if (idx >= latencies.size())
+			idx = latencies.size() - 1;
+		return latencies[idx];
+	}
+};
+
+typedef std::chrono::steady_clock bench_clock;
+
+static inline int64_t
+ElapsedNs(const bench_clock::time_point &start)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			bench_clock::now() - start).count();
+}
+
+/*
+ * Returns the records to be loaded by
+ * Rdb::bulkLoad().
+ */
+class BenchRecordReader : public RecordReader
+{
+private:
+	const bench_config_t    &cfg;
+	int64_t                 next;
+
+public:
+	BenchRecordReader(const bench_config_t &c) : cfg(c), next(0) {}
+
+	int read(char *key, int *klen, char *val, int *vlen)
+	{
+		if (next >= cfg.records)
+			return E_eof_detected;
+
+		*klen = MakeKey(next, cfg.ksize, key);
+		*vlen = MakeValue(next, 0, cfg.vsize, val);
+		next++;
+		return E_ok;
+	}
+};
+
+static void
+LoadWorker(Rdb *rdb, const bench_config_t *cfg, int tid, OpStats *stats)
+{
+	char key[MAX_KEY_LENGTH];
+	char val[MAX_VALUE_LENGTH];
+
+	for (int64_t id = tid; id < cfg->records; id += cfg->threads) {
+		int klen = MakeKey(id, cfg->ksize, key);
+		int vlen = MakeValue(id, 0, cfg->vsize, val);
+
+		bench_clock::time_point start = bench_clock::now();
+		int retval = rdb->set(key, klen, val, vlen);
+		stats->latencies.push_back(ElapsedNs(start));
+
+		if (retval != E_ok)
+			stats->errors++;
+	}
+}
+
+static void
+RunWorker(
+	Rdb *rdb,
+	const bench_config_t *cfg,
+	const ZipfianGenerator *zipf,
+	std::atomic<int64_t> *nextId,
+	int tid,
+	int64_t nops,
+	OpStats *stats)
+{
+	std::mt19937_64 rng(cfg->seed + unsigned(tid) * 7919);
+	std::uniform_real_distribution<double> opDist(0.0, 1.0);
+	char key[MAX_KEY_LENGTH];
+	char val[MAX_VALUE_LENGTH];
+	char buf[MAX_VALUE_LENGTH + 1];
+	int  klen, vlen, buflen;
+	int  retval = E_ok;
+
+	for (int64_t n = 0; n < nops; ++n) {
+		double  r = opDist(rng);
+		op_type op;
+
+		if (r < cfg->rprop)
+			op = OP_READ;
+		else if (r < (cfg->rprop + cfg->uprop))
+			op = OP_UPDATE;
+		else if (r < (cfg->rprop + cfg->uprop + cfg->iprop))
+			op = OP_INSERT;
+		else if (r < (cfg->rprop + cfg->uprop + cfg->iprop + cfg->sprop))
+			op = OP_SCAN;
+		else
+			op = OP_RMW;
+
+		int64_t maxId = nextId->load(std::memory_order_relaxed);
+		int64_t id;
+
+		if (op == OP_INSERT) {
+			id = nextId->fetch_add(1);
+		} else if (cfg->dist == DIST_UNIFORM) {
+			id = std::uniform_int_distribution<int64_t>(0, maxId - 1)(rng);
+		} else if (cfg->dist == DIST_LATEST) {
+			id = maxId - 1 - zipf->next(rng);
+			if (id < 0)
+				id = 0;
+		} else {
+			id = int64_t(Mix64(uint64_t(zipf->next(rng))) % uint64_t(maxId));
+		}
+
+		klen = MakeKey(id, cfg->ksize, key);
+
+		bench_clock::time_point start = bench_clock::now();
+
+		switch (op) {
+			case OP_READ:
+				buflen = MAX_VALUE_LENGTH;
+				retval = rdb->get(key, klen, buf, &buflen);
+				break;
+
+			case OP_UPDATE:
+			case OP_INSERT:
+				vlen = MakeValue(id, n + 1, cfg->vsize, val);
+				retval = rdb->set(key, klen, val, vlen);
+				break;
+
+			case OP_SCAN: {
+				int len = std::uniform_int_distribution<int>(1, cfg->scanlen)(rng);
+				for (int i = 0; i < len; ++i) {
+					if ((id + i) >= maxId)
+						break;
+					if (i > 0)
+						klen = MakeKey(id + i, cfg->ksize, key);
+					buflen = MAX_VALUE_LENGTH;
+					retval = rdb->get(key, klen, buf, &buflen);
+					if (retval != E_ok)
+						break;
+				}
+				break;
+			}
+
+			case OP_RMW:
+				buflen = MAX_VALUE_LENGTH;
+				retval = rdb->get(key, klen, buf, &buflen);
+				if (retval == E_ok) {
+					vlen = MakeValue(id, n + 1, cfg->vsize, val);
+					retval = rdb->set(key, klen, val, vlen);
+				}
+				break;
+
+			default:
+				break;
+		}
+
+		stats[op].latencies.push_back(ElapsedNs(start));
+
+		if (retval == E_not_found)
+			stats[op].notFound++;
+		else if (retval != E_ok)
+			stats[op].errors++;
+	}
+}
+
+/*
+ * Flushes the database files and drops them from the
+ * system page cache (best effort), so that the run
+ * phase starts cold.
+ */
+static void
+DropFileCache(const bench_config_t &cfg)
+{
+#if !defined(_WIN32)
+	const char *exts[] = { ".idx", ".db" };
+
+	for (int i = 0; i < 2; ++i) {
+		std::string fname(cfg.path);
+		fname += snf::pathsep();
+		fname += cfg.name;
+		fname += exts[i];
+
+		int fd = ::open(fname.c_str(), O_RDONLY);
+		if (fd >= 0) {
+			fsync(fd);
+			posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+			::close(fd);
+		}
+	}
+#endif
+}
+
+/*
+ * Reads every record once so that the run
+ * phase starts warm.
+ */
+static void
+WarmUp(Rdb &rdb, const bench_config_t &cfg)
+{
+	char key[MAX_KEY_LENGTH];
+	char buf[MAX_VALUE_LENGTH + 1];
+	int  klen, buflen;
+
+	for (int64_t id = 0; id < cfg.records; ++id) {
+		klen = MakeKey(id, cfg.ksize, key);
+		buflen = MAX_VALUE_LENGTH;
+		rdb.get(key, klen, buf, &buflen);
+	}
+}
+
+static bool
+SetWorkload(bench_config_t &cfg, const char *w)
+{
+	cfg.rprop = cfg.uprop = cfg.iprop = cfg.sprop = cfg.mprop = 0.0;
+	cfg.workload = char(tolower(w[0]));
+	if (w[0] && w[1])
+		return false;
+
+	switch (cfg.workload) {
+		case 'a': cfg.rprop = 0.50; cfg.uprop = 0.50; break;
+		case 'b': cfg.rprop = 0.95; cfg.uprop = 0.05; break;
+		case 'c': cfg.rprop = 1.00; break;
+		case 'd': cfg.rprop = 0.95; cfg.iprop = 0.05; cfg.dist = DIST_LATEST; break;
+		case 'e': cfg.sprop = 0.95; cfg.iprop = 0.05; break;
+		case 'f': cfg.rprop = 0.50; cfg.mprop = 0.50; break;
+		default: return false;
+	}
+
+	return true;
+}
+
+static int
+usage(const char *prog)
+{
+	std::cerr
+		<< prog
+		<< " -path <db_path> -name <db_name> [-workload <a|b|c|d|e|f>]" << std::endl
+		<< "        [-records <num>] [-operations <num>] [-threads <num>]" << std::endl
+		<< "        [-ksize <key_size>] [-vsize <value_size>] [-scanlen <max_scan_length>]" << std::endl
+		<< "        [-dist <uniform|zipfian|latest>] [-cache <cold|warm>]" << std::endl
+		<< "        [-noload|-bulkload] [-seed <num>]" << std::endl
+		<< "        [-htsize <hash_table_size>] [-pgsize <page_size>]" << std::endl
+		<< "        [-memusage <%_of_memory>] [-syncdf <0|1>]" << std::endl
+		<< "        [-syncif <0|1>] [-vcsize <num_of_value_pages>] [-htalign]" << std::endl
+		<< "        [-json <file|->] [-logpath <log_path>]" << std::endl;
+	return 1;
+}
+
+static bool
+IntArg(int argc, const char **argv, int &i, int64_t lo, int64_t hi, int64_t &val)
+{
+	const char *opt = argv[i];
+
+	if (++i >= argc) {
+		std::cerr << "missing argument to " << opt << std::endl;
+		return false;
+	}
+
+	val = strtoll(argv[i], 0, 10);
+	if ((val < lo) || (val > hi)) {
+		std::cerr << "invalid argument to " << opt << " (" << argv[i] << ")" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+int
+main(int argc, const char **argv)
+{
+	const char      *prog = argv[0];
+	bench_config_t  cfg;
+	RdbOptions      dbOpt;
+	std::string     jsonFile;
+	std::string     logPath;
+	std::string     distName;
+	int             htSize = -1;
+	int             pgSize = -1;
+	int64_t         val;
+	int             retval;
+
+	cfg.records = 100000;
+	cfg.operations = 100000;
+	cfg.threads = 1;
+	cfg.ksize = 24;
+	cfg.vsize = 100;
+	cfg.dist = DIST_ZIPFIAN;
+	cfg.cold = false;
+	cfg.load = true;
+	cfg.bulk = false;
+	cfg.scanlen = 10;
+	cfg.seed = 1;
+	SetWorkload(cfg, "a");
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp("-path", argv[i]) == 0) {
+			if (++i >= argc) return usage(prog);
+			cfg.path = argv[i];
+		} else if (strcmp("-name", argv[i]) == 0) {
+			if (++i >= argc) return usage(prog);
+			cfg.name = argv[i];
+		} else if (strcmp("-workload", argv[i]) == 0) {
+			if (++i >= argc) return usage(prog);
+			if (!SetWorkload(cfg, argv[i])) {
+				std::cerr << "invalid workload (" << argv[i] << ")" << std::endl;
+				return usage(prog);
+			}
+		} else if (strcmp("-records", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 1, INT64_C(1) << 40, cfg.records)) return usage(prog);
+		} else if (strcmp("-operations", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 0, INT64_C(1) << 40, cfg.operations)) return usage(prog);
+		} else if (strcmp("-threads", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 1, 1024, val)) return usage(prog);
+			cfg.threads = int(val);
+		} else if (strcmp("-ksize", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 17, MAX_KEY_LENGTH, val)) return usage(prog);
+			cfg.ksize = int(val);
+		} else if (strcmp("-vsize", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 1, MAX_VALUE_LENGTH, val)) return usage(prog);
+			cfg.vsize = int(val);
+		} else if (strcmp("-scanlen", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 1, 1000, val)) return usage(prog);
+			cfg.scanlen = int(val);
+		} else if (strcmp("-dist", argv[i]) == 0) {
+			if (++i >= argc) return usage(prog);
+			distName = argv[i];
+		} else if (strcmp("-cache", argv[i]) == 0) {
+			if (++i >= argc) return usage(prog);
+			if (strcmp(argv[i], "cold") == 0) {
+				cfg.cold = true;
+			} else if (strcmp(argv[i], "warm") == 0) {
+				cfg.cold = false;
+			} else {
+				std::cerr << "invalid cache state (" << argv[i] << ")" << std::endl;
+				return usage(prog);
+			}
+		} else if (strcmp("-noload", argv[i]) == 0) {
+			cfg.load = false;
+		} else if (strcmp("-bulkload", argv[i]) == 0) {
+			cfg.bulk = true;
+		} else if (strcmp("-seed", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 0, INT32_MAX, val)) return usage(prog);
+			cfg.seed = unsigned(val);
+		} else if (strcmp("-htsize", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 1, INT32_MAX, val)) return usage(prog);
+			htSize = int(val);
+		} else if (strcmp("-pgsize", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 1, INT32_MAX, val)) return usage(prog);
+			pgSize = int(val);
+		} else if (strcmp("-memusage", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 1, 100, val)) return usage(prog);
+			dbOpt.setMemoryUsage(int(val));
+		} else if (strcmp("-syncdf", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 0, 1, val)) return usage(prog);
+			dbOpt.syncDataFile(val != 0);
+		} else if (strcmp("-syncif", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 0, 1, val)) return usage(prog);
+			dbOpt.syncIndexFile(val != 0);
+		} else if (strcmp("-vcsize", argv[i]) == 0) {
+			if (!IntArg(argc, argv, i, 0, INT32_MAX, val)) return usage(prog);
+			dbOpt.setValueCacheSize(int(val));
+		} else if (strcmp("-htalign", argv[i]) == 0) {
+			dbOpt.cacheAlignHashTable(true);
+		} else if (strcmp("-json", argv[i]) == 0) {
+			if (++i >= argc) return usage(prog);
+			jsonFile = argv[i];
+		} else if (strcmp("-logpath", argv[i]) == 0) {
+			if (++i >= argc) return usage(prog);
+			logPath = argv[i];
+		} else {
+			return usage(prog);
+		}
+	}
+
+	if (!distName.empty()) {
+		if (distName == "uniform") {
+			cfg.dist = DIST_UNIFORM;
+		} else if (distName == "zipfian") {
+			cfg.dist = DIST_ZIPFIAN;
+		} else if (distName == "latest") {
+			cfg.dist = DIST_LATEST;
+		} else {
+			std::cerr << "invalid distribution (" << distName << ")" << std::endl;
+			return usage(prog);
+		}
+	}
+
+	if (cfg.path.empty()) {
+		std::cerr << "database path not specified" << std::endl;
+		return usage(prog);
+	}
+
+	if (cfg.name.empty()) {
+		std::cerr << "database name not specified" << std::endl;
+		return usage(prog);
+	}
+
+	// Keep the debug messages of the library off the console, and
+	// the warnings off the standard output.
+	if (logPath.empty()) {
+		snf::log::console_logger *clog = DBG_NEW snf::log::console_logger {
+						snf::log::severity::warning };
+		clog->set_destination(snf::log::console_logger::destination::err);
+		snf::log::manager::instance().add_logger(clog);
+	} else {
+		snf::log::file_logger *flog = DBG_NEW snf::log::file_logger {
+						logPath,
+						snf::log::severity::info };
+		flog->make_path(true);
+		snf::log::manager::instance().add_logger(flog);
+	}
+
+	Rdb rdb(cfg.path, cfg.name, dbOpt);
+
+	if (pgSize != -1)
+		rdb.setKeyPageSize(pgSize);
+
+	if (htSize != -1)
+		rdb.setHashTableSize(htSize);
+
+	// With -json -, the standard output carries the JSON only.
+	std::ostream &rpt = (jsonFile == "-") ? std::cerr : std::cout;
+
+	snf::json::object result;
+	result.add(KVPAIR("workload", std::string(1, cfg.workload)));
+	result.add(KVPAIR("records", cfg.records));
+	result.add(KVPAIR("operations", cfg.operations));
+	result.add(KVPAIR("threads", cfg.threads));
+	result.add(KVPAIR("key_size", cfg.ksize));
+	result.add(KVPAIR("value_size", cfg.vsize));
+	result.add(KVPAIR("distribution", DistNames[cfg.dist]));
+	result.add(KVPAIR("cache", cfg.cold ? "cold" : "warm"));
+	result.add(KVPAIR("sync_data", dbOpt.syncDataFile()));
+	result.add(KVPAIR("sync_index", dbOpt.syncIndexFile()));
+	result.add(KVPAIR("value_cache", dbOpt.getValueCacheSize()));
+	result.add(KVPAIR("hash_table_aligned", dbOpt.cacheAlignHashTable()));
+
+	rpt << "workload " << cfg.workload << ": "
+		<< cfg.records << " records, "
+		<< cfg.operations << " operations, "
+		<< cfg.threads << " thread(s), "
+		<< DistNames[cfg.dist] << ", "
+		<< (cfg.cold ? "cold" : "warm") << " cache" << std::endl;
+
+	if (cfg.load) {
+		OpStats loadStats;
+		bench_clock::time_point start = bench_clock::now();
+
+		if (cfg.bulk) {
+			BenchRecordReader reader(cfg);
+			retval = rdb.bulkLoad(&reader);
+			if (retval != E_ok) {
+				std::cerr << "bulk load failed with status " << retval << std::endl;
+				return 1;
+			}
+		} else {
+			retval = rdb.open();
+			if (retval != E_ok) {
+				std::cerr << "open failed with status " << retval << std::endl;
+				return 1;
+			}
+
+			std::vector<OpStats> stats(cfg.threads);
+			std::vector<std::thread> workers;
+			for (int t = 0; t < cfg.threads; ++t)
+				workers.push_back(std::thread(LoadWorker, &rdb, &cfg, t, &stats[t]));
+			for (int t = 0; t < cfg.threads; ++t) {
+				workers[t].join();
+				loadStats.merge(stats[t]);
+			}
+
+			rdb.close();
+		}
+
+		double secs = double(ElapsedNs(start)) / 1e9;
+		double tput = double(cfg.records) / secs;
+
+		rpt << "load: " << secs << " seconds, " << tput << " ops/sec" << std::endl;
+
+		snf::json::object load;
+		load.add(KVPAIR("method", cfg.bulk ? "bulk" : "set"));
+		load.add(KVPAIR("seconds", secs));
+		load.add(KVPAIR("throughput", tput));
+		if (!cfg.bulk)
+			load.add(KVPAIR("insert", loadStats.report(rpt, "insert")));
+		result.add(KVPAIR("load", load));
+	}
+
+	if (cfg.cold)
+		DropFileCache(cfg);
+
+	retval = rdb.open();
+	if (retval != E_ok) {
+		std::cerr << "open failed with status " << retval << std::endl;
+		return 1;
+	}
+
+	if (!cfg.cold)
+		WarmUp(rdb, cfg);
+
+	ZipfianGenerator zipf(cfg.records);
+	std::atomic<int64_t> nextId(cfg.records);
+	std::vector<std::vector<OpStats>> stats(cfg.threads, std::vector<OpStats>(OP_MAX));
+	std::vector<std::thread> workers;
+
+	bench_clock::time_point start = bench_clock::now();
+
+	for (int t = 0; t < cfg.threads; ++t) {
+		int64_t nops = cfg.operations / cfg.threads;
+		if (t < (cfg.operations % cfg.threads))
+			nops++;
+		workers.push_back(std::thread(RunWorker,
+			&rdb, &cfg, &zipf, &nextId, t, nops, stats[t].data()));
+	}
+
+	for (int t = 0; t < cfg.threads; ++t)
+		workers[t].join();
+
+	double secs = double(ElapsedNs(start)) / 1e9;
+	double tput = double(cfg.operations) / secs;
+
+	rdb.close();
+
+	rpt << "run: " << secs << " seconds, " << tput << " ops/sec" << std::endl;
+
+	snf::json::object run;
+	snf::json::object ops;
+	run.add(KVPAIR("seconds", secs));
+	run.add(KVPAIR("throughput", tput));
+
+	for (int op = 0; op < OP_MAX; ++op) {
+		OpStats total;
+		for (int t = 0; t < cfg.threads; ++t)
+			total.merge(stats[t][op]);
+		if (!total.latencies.empty())
+			ops.add(KVPAIR(OpNames[op], total.report(rpt, OpNames[op])));
+	}
+
+	run.add(KVPAIR("operations", ops));
+	result.add(KVPAIR("run", run));
+
+	if (jsonFile == "-") {
+		std::cout << result.str(true) << std::endl;
+	} else if (!jsonFile.empty()) {
+		std::ofstream out(jsonFile);
+		if (!out) {
+			std::cerr << "failed to open " << jsonFile << std::endl;
+			return 1;
+		}
+		out << result.str(true) << std::endl;
+	}
+
+	return 0;
+}
@@ -1,19 +1,79 @@
+#include <fstream>
 #include "rdb.h"
 #include "logmgr.h"
 #include "flogger.h"
 
 static bool   Verbosity;
 
+/*
+ * Reads records from a text file. Each line has a
+ * key and a value separated by a space or tab.
+ */
+class FileRecordReader : public RecordReader
+{
+private:
+	std::ifstream   in;
+	int64_t         lineno;
+
+public:
+	FileRecordReader(const std::string &fname)
+		: in(fname),
+		  lineno(0)
+	{
+	}
+
+	bool isOpen() const
+	{
+		return in.is_open();
+	}
+
+	int read(char *key, int *klen, char *val, int *vlen)
+	{
+		std::string line;
+
+		while (std::getline(in, line)) {
+			lineno++;
+
+			if (!line.empty() && (line.back() == '\r'))
+				line.pop_back();
+
+			if (line.empty())
+				continue;
+
+			std::string::size_type pos = line.find_first_of(" \t");
+			if ((pos == 0) || (pos == std::string::npos) || (pos == (line.size() - 1))) {
+				std::cerr << "invalid record at line " << lineno << std::endl;
+				return E_invalid_arg;
+			}
+
+			if ((int(pos) > *klen) || (int(line.size() - pos - 1) > *vlen)) {
+				std::cerr << "key or value too long at line " << lineno << std::endl;
+				return E_invalid_arg;
+			}
+
+			*klen = int(pos);
+			memcpy(key, line.data(), *klen);
+			*vlen = int(line.size() - pos - 1);
+			memcpy(val, line.data() + pos + 1, *vlen);
+			return E_ok;
+		}
+
+		return E_eof_detected;
+	}
+};
+
 static int
 usage(const char *prog)
 {
 	std::cerr
 		<< prog
-		<< " [-get|-set|-del|-rebuild] -path <db_path> -name <db_name>" << std::endl
+		<< " [-get|-set|-del|-rebuild|-load <file>] -path <db_path> -name <db_name>" << std::endl
 		<< "        -key <key> [-value <value>]" << std::endl
 		<< "        [-htsize <hash_table_size>] [-pgsize <page_size>]" << std::endl
 		<< "        [-memusage <%_of_memory>] [-syncdf <0|1>]" << std::endl
-		<< "        [-syncif <0|1>] [-logpath <log_path>]" << std::endl;
+		<< "        [-syncif <0|1>] [-vcsize <num_of_value_pages>]" << std::endl
+		<< "        [-shared]" << std::endl
+		<< "        [-logpath <log_path>]" << std::endl;
 	return 1;
 }
 
@@ -34,6 +94,7 @@ main(int argc, const char **argv)
 	char val[MAX_VALUE_LENGTH + 1];
 	char prog[MAXPATHLEN + 1];
 	bool rebuild = false;
+	std::string loadFile;
 
 	snf::basename(prog, MAXPATHLEN + 1, argv[0], true);
 
@@ -46,6 +107,14 @@ main(int argc, const char **argv)
 			cmd = DEL;
 		} else if (strcmp("-rebuild", argv[i]) == 0) {
 			rebuild = true;
+		} else if (strcmp("-load", argv[i]) == 0) {
+			++i;
+			if (argv[i]) {
+				loadFile = argv[i];
+			} else {
+				std::cerr << "missing argument to -load" << std::endl;
+				return usage(prog);
+			}
 		} else if (strcmp("-path", argv[i]) == 0) {
 			++i;
 			if (argv[i]) {
@@ -115,6 +184,21 @@ main(int argc, const char **argv)
 				std::cerr << "missing argument to -syncif" << std::endl;
 				return usage(prog);
 			}
+		} else if (strcmp("-shared", argv[i]) == 0) {
+			dbOpt.sharedMode(true);
+		} else if (strcmp("-vcsize", argv[i]) == 0) {
+			++i;
+			if (argv[i]) {
+				if (dbOpt.setValueCacheSize(atoi(argv[i])) != E_ok) {
+					std::cerr
+						<< "invalid value cache size ("
+						<< argv[i] << ")" << std::endl;
+					return 1;
+				}
+			} else {
+				std::cerr << "missing argument to -vcsize" << std::endl;
+				return usage(prog);
+			}
 		} else if (strcmp("-pgsize", argv[i]) == 0) {
 			++i;
 			if (argv[i]) {
@@ -166,8 +250,8 @@ main(int argc, const char **argv)
 		snf::log::manager::instance().add_logger(flog);
 	}
 
-	if ((cmd == NIL) && !rebuild) {
-		std::cerr << "one of [-get|-set|-del|-rebuild] must be specified" << std::endl;
+	if ((cmd == NIL) && !rebuild && loadFile.empty()) {
+		std::cerr << "one of [-get|-set|-del|-rebuild|-load] must be specified" << std::endl;
 		return usage(prog);
 	}
 
@@ -199,6 +283,30 @@ main(int argc, const char **argv)
 		return 0;
 	}
 
+	if (!loadFile.empty()) {
+		FileRecordReader reader(loadFile);
+		if (!reader.isOpen()) {
+			std::cerr << "failed to open " << loadFile << std::endl;
+			return 1;
+		}
+
+		Rdb rdb(path, name, dbOpt);
+
+		if (pgSize != -1)
+			rdb.setKeyPageSize(pgSize);
+
+		if (htSize != -1)
+			rdb.setHashTableSize(htSize);
+
+		retval = rdb.bulkLoad(&reader);
+		if (retval != E_ok) {
+			std::cerr << "load failed with status " << retval << std::endl;
+			return 1;
+		}
+
+		return 0;
+	}
+
 	if (key.empty()) {
 		std::cerr << "key not specified" << std::endl;
 		return usage(prog);
@@ -0,0 +1,274 @@
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+
+#include "shmindex.h"
+#include "keyrec.h"
+#include "logmgr.h"
+#include "error.h"
+
+/*
+ * Gets the name of the shared memory object for the
+ * key file. The name is derived from the device and
+ * the inode of the key file, so a rebuilt database
+ * never picks up a stale index.
+ *
+ * @param [in]  keyFile - Key file.
+ * @param [out] name    - Shared memory object name.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+SharedIndex::getName(const snf::file *keyFile, std::string &name)
+{
+#if defined(_WIN32)
+	return E_invalid_state;
+#else
+	struct stat st;
+	char        buf[64];
+
+	if (fstat(fhandle_t(*keyFile), &st) < 0) {
+		LOG_SYSERR("SharedIndex", errno,
+			"failed to stat file %s", keyFile->name());
+		return E_stat_failed;
+	}
+
+	snprintf(buf, sizeof(buf), "/snf-rdb-%" PRIx64 "-%" PRIx64,
+		uint64_t(st.st_dev), uint64_t(st.st_ino));
+	name = buf;
+
+	return E_ok;
+#endif
+}
+
+/*
+ * Builds the shared hash table from the mapped key
+ * pages i.e. sets the offset of the first key page
+ * of every hash table entry. The magic is set last.
+ */
+void
+SharedIndex::build()
+{
+	index->si_magic = 0;
+	index->si_htsize = htSize;
+	index->si_kpsize = kpSize;
+	index->si_unused = 0;
+	index->si_kfsize = keyPagesLen;
+
+	for (int i = 0; i < htSize; ++i)
+		index->si_offsets[i] = -1L;
+
+	for (int64_t offset = 0; (offset + kpSize) <= keyPagesLen; offset += kpSize) {
+		const key_page_t *kp = (const key_page_t *)(keyPages + offset);
+
+		if (IsKeyPageDeleted(kp) || (kp->kp_vcount <= 0))
+			continue;
+
+		if ((kp->kp_poff == -1L) &&
+			(kp->kp_hash >= 0) && (kp->kp_hash < htSize) &&
+			(index->si_offsets[kp->kp_hash] == -1L)) {
+			index->si_offsets[kp->kp_hash] = offset;
+		}
+	}
+
+	index->si_magic = SHM_INDEX_MAGIC;
+
+	LOG_DEBUG("SharedIndex", "built shared index %s", shmName.c_str());
+}
+
+/**
+ * Opens the shared index. The key file is mapped
+ * in memory. If the shared memory object for the
+ * key file exists and is up-to-date, it is attached.
+ * Otherwise it is (re)built.
+ *
+ * @param [in] keyFile - Key file.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+SharedIndex::open(const snf::file *keyFile)
+{
+#if defined(_WIN32)
+	LOG_ERROR("SharedIndex", "shared mode is not supported on this platform");
+	return E_invalid_state;
+#else
+	int         retval = E_ok;
+	int         shmfd;
+	struct stat st;
+	void        *addr;
+
+	retval = getName(keyFile, shmName);
+	if (retval != E_ok) {
+		return retval;
+	}
+
+	if (fstat(fhandle_t(*keyFile), &st) < 0) {
+		LOG_SYSERR("SharedIndex", errno,
+			"failed to stat file %s", keyFile->name());
+		return E_stat_failed;
+	}
+
+	keyPagesLen = int64_t(st.st_size);
+	if (keyPagesLen > 0) {
+		addr = mmap(0, size_t(keyPagesLen), PROT_READ, MAP_SHARED,
+				fhandle_t(*keyFile), 0);
+		if (addr == MAP_FAILED) {
+			LOG_SYSERR("SharedIndex", errno,
+				"failed to map file %s", keyFile->name());
+			keyPagesLen = 0;
+			return E_syscall_failed;
+		}
+		keyPages = (const char *)addr;
+	}
+
+	indexLen = sizeof(shm_index_t) + (htSize - 1) * sizeof(int64_t);
+
+	shmfd = shm_open(shmName.c_str(), O_RDWR | O_CREAT, 0600);
+	if (shmfd < 0) {
+		LOG_SYSERR("SharedIndex", errno,
+			"failed to open shared memory %s", shmName.c_str());
+		close();
+		return E_open_failed;
+	}
+
+	if ((fstat(shmfd, &st) == 0) && (size_t(st.st_size) == indexLen)) {
+		addr = mmap(0, indexLen, PROT_READ, MAP_SHARED, shmfd, 0);
+		if (addr != MAP_FAILED) {
+			index = (shm_index_t *)addr;
+			if ((index->si_magic != SHM_INDEX_MAGIC) ||
+				(index->si_htsize != htSize) ||
+				(index->si_kpsize != kpSize) ||
+				(index->si_kfsize != keyPagesLen)) {
+				munmap(addr, indexLen);
+				index = 0;
+			}
+		}
+	}
+
+	if (index == 0) {
+		if ((ftruncate(shmfd, 0) < 0) ||
+			(ftruncate(shmfd, off_t(indexLen)) < 0)) {
+			LOG_SYSERR("SharedIndex", errno,
+				"failed to size shared memory %s", shmName.c_str());
+			retval = E_trunc_failed;
+		} else {
+			addr = mmap(0, indexLen, PROT_READ | PROT_WRITE, MAP_SHARED, shmfd, 0);
+			if (addr == MAP_FAILED) {
+				LOG_SYSERR("SharedIndex", errno,
+					"failed to map shared memory %s", shmName.c_str());
+				retval = E_syscall_failed;
+			} else {
+				index = (shm_index_t *)addr;
+				build();
+			}
+		}
+	} else {
+		LOG_DEBUG("SharedIndex", "attached shared index %s", shmName.c_str());
+	}
+
+	::close(shmfd);
+
+	if (retval != E_ok) {
+		close();
+	}
+
+	return retval;
+#endif
+}
+
+/**
+ * Finds the key in the shared index.
+ *
+ * @param [inout] ki - Key information. On success, the
+ *                     key index and the value offset
+ *                     are set.
+ *
+ * @return E_ok on success, E_not_found if the key is not
+ * found, -ve error code on failure.
+ */
+int
+SharedIndex::get(key_info_t *ki)
+{
+	ASSERT(((ki->ki_hash >= 0) && (ki->ki_hash < htSize)), "SharedIndex", 0,
+		"out-of-bound hash table index (%d), range [%d, %d)",
+		ki->ki_hash, 0, htSize);
+
+	int64_t offset = index->si_offsets[ki->ki_hash];
+
+	while (offset != -1L) {
+		if ((offset < 0) || ((offset + kpSize) > keyPagesLen)) {
+			LOG_ERROR("SharedIndex",
+				"invalid key page offset %" PRId64, offset);
+			return E_invalid_state;
+		}
+
+		key_page_t *kp = (key_page_t *)(keyPages + offset);
+
+		KeyRecords keyRec(kp, kpSize);
+		ki->ki_kidx = keyRec.get(ki);
+		if (ki->ki_kidx >= 0) {
+			ki->ki_voff = kp->kp_keys[ki->ki_kidx].kr_voff;
+			return E_ok;
+		}
+
+		offset = kp->kp_noff;
+	}
+
+	return E_not_found;
+}
+
+/**
+ * Unmaps the shared index and the key pages.
+ */
+void
+SharedIndex::close()
+{
+#if !defined(_WIN32)
+	if (index) {
+		munmap(index, indexLen);
+		index = 0;
+	}
+
+	if (keyPages) {
+		munmap((void *)keyPages, size_t(keyPagesLen));
+		keyPages = 0;
+	}
+#endif
+
+	indexLen = 0;
+	keyPagesLen = 0;
+}
+
+/**
+ * Removes the shared memory object for the key file.
+ * The processes that have it open continue to use it.
+ * It is called before the database is modified so
+ * that the next shared open rebuilds the index.
+ *
+ * @param [in] keyFile - Key file.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+SharedIndex::remove(const snf::file *keyFile)
+{
+#if defined(_WIN32)
+	return E_ok;
+#else
+	std::string name;
+
+	int retval = getName(keyFile, name);
+	if (retval == E_ok) {
+		if ((shm_unlink(name.c_str()) < 0) && (errno != ENOENT)) {
+			LOG_SYSERR("SharedIndex", errno,
+				"failed to remove shared memory %s", name.c_str());
+			retval = E_remove_failed;
+		}
+	}
+
+	return retval;
+#endif
+}
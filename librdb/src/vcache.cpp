@@ -0,0 +1,279 @@
+#include "error.h"
+#include "logmgr.h"
+#include "vcache.h"
+
+#define SKETCH_DEPTH    4
+#define SKETCH_MAXCOUNT 15
+
+static const uint64_t SketchSeeds[SKETCH_DEPTH] = {
+	0x9e3779b97f4a7c15ULL,
+	0xc2b2ae3d27d4eb4fULL,
+	0x165667b19e3779f9ULL,
+	0x27d4eb2f165667c5ULL
+};
+
+/**
+ * Constructs the frequency sketch.
+ *
+ * @param [in] size - Number of elements tracked by
+ *                    the cache using the sketch.
+ */
+FreqSketch::FreqSketch(int size)
+	: table(0),
+	  mask(0),
+	  additions(0)
+{
+	uint32_t width = 16;
+	while ((width < uint32_t(size)) && (width < 0x40000000U))
+		width <<= 1;
+
+	table = (uint8_t *)calloc(SKETCH_DEPTH, width);
+	ASSERT((table != 0), "FreqSketch", errno,
+		"unable to allocate memory for frequency sketch");
+
+	mask = width - 1;
+	sampleSize = 10 * size;
+}
+
+/*
+ * Gets the counter index for the value offset in
+ * the given row of the sketch.
+ */
+uint32_t
+FreqSketch::index(int64_t offset, int row) const
+{
+	uint64_t h = uint64_t(offset) * SketchSeeds[row];
+	h ^= (h >> 32);
+	return (uint32_t(row) * (mask + 1)) + (uint32_t(h) & mask);
+}
+
+/*
+ * Halves all the counters. This is the aging process
+ * that lets the sketch adapt to the changing access
+ * pattern.
+ */
+void
+FreqSketch::reset()
+{
+	size_t len = size_t(SKETCH_DEPTH) * (mask + 1);
+	for (size_t i = 0; i < len; ++i)
+		table[i] >>= 1;
+	additions /= 2;
+}
+
+/**
+ * Gets the estimated access frequency of the value
+ * page at the specified offset.
+ *
+ * @param [in] offset - Value page offset.
+ *
+ * @return the estimated frequency.
+ */
+int
+FreqSketch::frequency(int64_t offset) const
+{
+	int freq = SKETCH_MAXCOUNT;
+
+	for (int i = 0; i < SKETCH_DEPTH; ++i) {
+		int cnt = table[index(offset, i)];
+		if (cnt < freq)
+			freq = cnt;
+	}
+
+	return freq;
+}
+
+/**
+ * Records an access to the value page at the
+ * specified offset.
+ *
+ * @param [in] offset - Value page offset.
+ */
+void
+FreqSketch::increment(int64_t offset)
+{
+	for (int i = 0; i < SKETCH_DEPTH; ++i) {
+		uint8_t *cnt = table + index(offset, i);
+		if (*cnt < SKETCH_MAXCOUNT)
+			(*cnt)++;
+	}
+
+	if (++additions >= sampleSize)
+		reset();
+}
+
+ValueCache::ValueCache(int size)
+	: max(size),
+	  num(0),
+	  head(-1),
+	  tail(-1),
+	  freeSlot(-1)
+{
+	ASSERT((max > 0), "ValueCache", 0,
+		"invalid value cache size (%d)", max);
+
+	slots = (vslot_t *)malloc(max * sizeof(vslot_t));
+	ASSERT((slots != 0), "ValueCache", errno,
+		"unable to allocate memory for value cache slots");
+
+	pages = (value_page_t *)malloc(max * sizeof(value_page_t));
+	ASSERT((pages != 0), "ValueCache", errno,
+		"unable to allocate memory for value cache pages");
+
+	for (int i = max - 1; i >= 0; --i) {
+		slots[i].vs_offset = -1L;
+		slots[i].vs_prev = -1;
+		slots[i].vs_next = freeSlot;
+		freeSlot = i;
+	}
+
+	sketch = DBG_NEW FreqSketch(max);
+	slotMap.reserve(max);
+
+	DEBUG_STRM("ValueCache")
+		<< "number of cached value pages = " << max
+		<< snf::log::record::endl;
+}
+
+/*
+ * Unlinks the slot from the LRU list.
+ */
+void
+ValueCache::unlink(int i)
+{
+	vslot_t *vs = slots + i;
+
+	if (vs->vs_prev != -1)
+		slots[vs->vs_prev].vs_next = vs->vs_next;
+	else
+		head = vs->vs_next;
+
+	if (vs->vs_next != -1)
+		slots[vs->vs_next].vs_prev = vs->vs_prev;
+	else
+		tail = vs->vs_prev;
+
+	vs->vs_prev = vs->vs_next = -1;
+}
+
+/*
+ * Adds the slot to the front of the LRU list.
+ */
+void
+ValueCache::pushFront(int i)
+{
+	vslot_t *vs = slots + i;
+
+	vs->vs_prev = -1;
+	vs->vs_next = head;
+	if (head != -1)
+		slots[head].vs_prev = i;
+	else
+		tail = i;
+	head = i;
+}
+
+/*
+ * Removes the slot from the cache and puts it
+ * on the free list.
+ */
+void
+ValueCache::release(int i)
+{
+	unlink(i);
+	slotMap.erase(slots[i].vs_offset);
+	slots[i].vs_offset = -1L;
+	slots[i].vs_next = freeSlot;
+	freeSlot = i;
+	num--;
+}
+
+/**
+ * Gets the cached value page. The access is recorded
+ * in the frequency sketch whether or not the page is
+ * found in the cache.
+ *
+ * @param [in]  offset - Value page offset.
+ * @param [out] vp     - Value page.
+ *
+ * @return E_ok if the page is found in the cache,
+ * E_not_found otherwise.
+ */
+int
+ValueCache::get(int64_t offset, value_page_t *vp)
+{
+	std::lock_guard<std::mutex> guard(mutex);
+
+	sketch->increment(offset);
+
+	std::unordered_map<int64_t, int>::iterator it = slotMap.find(offset);
+	if (it == slotMap.end())
+		return E_not_found;
+
+	int i = it->second;
+	if (i != head) {
+		unlink(i);
+		pushFront(i);
+	}
+
+	memcpy(vp, pages + i, sizeof(value_page_t));
+	return E_ok;
+}
+
+/**
+ * Puts the value page in the cache. If the cache is
+ * full, the page is admitted only if it is accessed
+ * more frequently than the least recently used page,
+ * which is then evicted.
+ *
+ * @param [in] offset - Value page offset.
+ * @param [in] vp     - Value page.
+ */
+void
+ValueCache::put(int64_t offset, const value_page_t *vp)
+{
+	int i;
+
+	std::lock_guard<std::mutex> guard(mutex);
+
+	std::unordered_map<int64_t, int>::iterator it = slotMap.find(offset);
+	if (it != slotMap.end()) {
+		i = it->second;
+		if (i != head) {
+			unlink(i);
+			pushFront(i);
+		}
+		memcpy(pages + i, vp, sizeof(value_page_t));
+		return;
+	}
+
+	if (num >= max) {
+		if (sketch->frequency(offset) <= sketch->frequency(slots[tail].vs_offset))
+			return;
+		release(tail);
+	}
+
+	i = freeSlot;
+	freeSlot = slots[i].vs_next;
+
+	slots[i].vs_offset = offset;
+	memcpy(pages + i, vp, sizeof(value_page_t));
+	pushFront(i);
+	slotMap[offset] = i;
+	num++;
+}
+
+/**
+ * Removes the value page from the cache.
+ *
+ * @param [in] offset - Value page offset.
+ */
+void
+ValueCache::invalidate(int64_t offset)
+{
+	std::lock_guard<std::mutex> guard(mutex);
+
+	std::unordered_map<int64_t, int>::iterator it = slotMap.find(offset);
+	if (it != slotMap.end())
+		release(it->second);
+}
@@ -0,0 +1,213 @@
+#include "error.h"
+#include "filesystem.h"
+#include "rdb.h"
+
+#define BULK_LOAD_RECORDS   2000
+#define BULK_LOAD_UPDATES   100
+
+class SeqRecordReader : public RecordReader
+{
+private:
+	int next;
+
+public:
+	SeqRecordReader() : next(0) {}
+
+	// BULK_LOAD_RECORDS keys followed by updates
+	// of the first BULK_LOAD_UPDATES keys
+	int read(char *key, int *klen, char *val, int *vlen)
+	{
+		if (next >= (BULK_LOAD_RECORDS + BULK_LOAD_UPDATES))
+			return E_eof_detected;
+
+		if (next < BULK_LOAD_RECORDS) {
+			*klen = snprintf(key, *klen, "bk-%05d", next);
+			*vlen = snprintf(val, *vlen, "BV-%05d", next);
+		} else {
+			*klen = snprintf(key, *klen, "bk-%05d", next - BULK_LOAD_RECORDS);
+			*vlen = snprintf(val, *vlen, "BU-%05d", next - BULK_LOAD_RECORDS);
+		}
+
+		next++;
+		return E_ok;
+	}
+};
+
+class BulkLoadDB : public snf::tf::test
+{
+protected:
+	bool verify(Rdb &rdb)
+	{
+		char key[16];
+		char val[16];
+		char buf[32];
+		int  buflen;
+
+		for (int i = 0; i < BULK_LOAD_RECORDS; ++i) {
+			snprintf(key, sizeof(key), "bk-%05d", i);
+			if (i < BULK_LOAD_UPDATES)
+				snprintf(val, sizeof(val), "BU-%05d", i);
+			else
+				snprintf(val, sizeof(val), "BV-%05d", i);
+
+			buflen = (int)(sizeof(buf) - 1);
+			int retval = rdb.get(key, 8, buf, &buflen);
+			m_strm << "rdb get: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+			ASSERT_EQ(int, buflen, 8, "value length match");
+			ASSERT_MEM_EQ(buf, val, 8, "value match");
+		}
+
+		return true;
+	}
+
+public:
+	BulkLoadDB() : snf::tf::test() {}
+	~BulkLoadDB() {}
+
+	virtual const char *name() const
+	{
+		return "BulkLoadDB";
+	}
+
+	virtual const char *description() const
+	{
+		return "Bulk loads key/value pairs";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+		const char *dbName = conf->get("DBNAME");
+		ASSERT_NE(const char *, dbName, nullptr, "get DBNAME from config");
+
+		std::string bulkName(dbName);
+		bulkName += "-bulk";
+
+		const char *exts[] = { ".idx", ".db", ".attr", ".fdp" };
+		for (int i = 0; i < 4; ++i) {
+			std::string fname(dbPath);
+			fname += snf::pathsep();
+			fname += bulkName;
+			fname += exts[i];
+			snf::fs::remove_file(fname.c_str());
+		}
+
+		RdbOptions options;
+		options.setMemoryUsage(2);
+		options.syncDataFile(false);
+		Rdb rdb(dbPath, bulkName, 1024, 7, options);
+
+		SeqRecordReader reader;
+		int retval = rdb.bulkLoad(&reader);
+		ASSERT_EQ(int, retval, E_ok, "rdb bulk load");
+
+		retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open");
+
+		retval = rdb.bulkLoad(&reader);
+		ASSERT_EQ(int, retval, E_invalid_state, "rdb bulk load on open DB");
+
+		if (!verify(rdb))
+			return false;
+
+		retval = rdb.set("bk-new", 6, "BN-new", 6);
+		ASSERT_EQ(int, retval, E_ok, "rdb set: key = bk-new, value = BN-new");
+
+		retval = rdb.remove("bk-new", 6);
+		ASSERT_EQ(int, retval, E_ok, "rdb remove: key = bk-new");
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		SeqRecordReader reader2;
+		retval = rdb.bulkLoad(&reader2);
+		ASSERT_EQ(int, retval, E_invalid_state, "rdb bulk load on non-empty DB");
+
+		retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb reopen");
+
+		if (!verify(rdb))
+			return false;
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		return true;
+	}
+};
+
+class BulkLoadRunsDB : public BulkLoadDB
+{
+public:
+	BulkLoadRunsDB() : BulkLoadDB() {}
+	~BulkLoadRunsDB() {}
+
+	virtual const char *name() const
+	{
+		return "BulkLoadRunsDB";
+	}
+
+	virtual const char *description() const
+	{
+		return "Bulk loads key/value pairs sorted in runs spilled to files";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+		const char *dbName = conf->get("DBNAME");
+		ASSERT_NE(const char *, dbName, nullptr, "get DBNAME from config");
+
+		std::string bulkName(dbPath);
+		bulkName += snf::pathsep();
+		bulkName += dbName;
+		bulkName += "-bulkruns";
+
+		const char *exts[] = { ".idx", ".db", ".attr", ".fdp" };
+		for (int i = 0; i < 4; ++i) {
+			std::string fname(bulkName);
+			fname += exts[i];
+			snf::fs::remove_file(fname.c_str());
+		}
+
+		// The updates are in the last run, the keys they
+		// overwrite in the first one.
+		RdbOptions options;
+		options.setMemoryUsage(2);
+		options.syncDataFile(false);
+		ASSERT_EQ(int, options.setBulkLoadRunSize(1023), E_invalid_arg, "run size too small");
+		ASSERT_EQ(int, options.setBulkLoadRunSize(1024), E_ok, "run size set");
+		Rdb rdb(dbPath, std::string(dbName) + "-bulkruns", 1024, 7, options);
+
+		SeqRecordReader reader;
+		int retval = rdb.bulkLoad(&reader);
+		ASSERT_EQ(int, retval, E_ok, "rdb bulk load");
+
+		std::string spillName(bulkName);
+		spillName += ".bulk.0";
+		ASSERT_EQ(bool, snf::fs::exists(spillName.c_str()), false, "spill file removed");
+
+		std::string fdpName(bulkName);
+		fdpName += ".fdp";
+		ASSERT_EQ(int64_t, snf::fs::size(fdpName.c_str()),
+			int64_t((1 + BULK_LOAD_UPDATES) * sizeof(int64_t)),
+			"overwritten values freed");
+
+		retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open");
+
+		if (!verify(rdb))
+			return false;
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		return true;
+	}
+};
@@ -0,0 +1,101 @@
+#include <thread>
+#include <atomic>
+#include "error.h"
+#include "rdb.h"
+
+#define CONCURRENT_THREADS  4
+#define CONCURRENT_KEYS     500
+
+class ConcurrentSGR : public snf::tf::test
+{
+private:
+	static void worker(Rdb *rdb, int tid, std::atomic<int> *failures)
+	{
+		char key[16];
+		char val[16];
+		char buf[32];
+		int  buflen;
+
+		for (int i = 0; i < CONCURRENT_KEYS; ++i) {
+			snprintf(key, sizeof(key), "ct-%d-%05d", tid, i);
+			snprintf(val, sizeof(val), "CV-%d-%05d", tid, i);
+			if (rdb->set(key, 10, val, 10) != E_ok)
+				(*failures)++;
+		}
+
+		for (int i = 0; i < CONCURRENT_KEYS; ++i) {
+			snprintf(key, sizeof(key), "ct-%d-%05d", tid, i);
+			snprintf(val, sizeof(val), "CV-%d-%05d", tid, i);
+			buflen = (int)(sizeof(buf) - 1);
+			if ((rdb->get(key, 10, buf, &buflen) != E_ok) ||
+				(buflen != 10) || (memcmp(buf, val, 10) != 0))
+				(*failures)++;
+		}
+
+		for (int i = 0; i < CONCURRENT_KEYS; i += 2) {
+			snprintf(key, sizeof(key), "ct-%d-%05d", tid, i);
+			if (rdb->remove(key, 10) != E_ok)
+				(*failures)++;
+		}
+
+		for (int i = 0; i < CONCURRENT_KEYS; ++i) {
+			snprintf(key, sizeof(key), "ct-%d-%05d", tid, i);
+			buflen = (int)(sizeof(buf) - 1);
+			int retval = rdb->get(key, 10, buf, &buflen);
+			if (retval != (((i % 2) == 0) ? E_not_found : E_ok))
+				(*failures)++;
+		}
+
+		for (int i = 1; i < CONCURRENT_KEYS; i += 2) {
+			snprintf(key, sizeof(key), "ct-%d-%05d", tid, i);
+			if (rdb->remove(key, 10) != E_ok)
+				(*failures)++;
+		}
+	}
+
+public:
+	ConcurrentSGR() : snf::tf::test() {}
+	~ConcurrentSGR() {}
+
+	virtual const char *name() const
+	{
+		return "ConcurrentSGR";
+	}
+
+	virtual const char *description() const
+	{
+		return "Sets, gets, and removes key/value pairs from multiple threads";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+		const char *dbName = conf->get("DBNAME");
+		ASSERT_NE(const char *, dbName, nullptr, "get DBNAME from config");
+
+		RdbOptions options;
+		options.setMemoryUsage(2);
+		options.syncDataFile(false);
+		options.cacheAlignHashTable(true);
+		Rdb rdb(dbPath, dbName, 4096, 10, options);
+
+		int retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open");
+
+		std::atomic<int> failures(0);
+		std::vector<std::thread> workers;
+		for (int t = 0; t < CONCURRENT_THREADS; ++t)
+			workers.push_back(std::thread(worker, &rdb, t, &failures));
+		for (int t = 0; t < CONCURRENT_THREADS; ++t)
+			workers[t].join();
+
+		ASSERT_EQ(int, failures.load(), 0, "concurrent set/get/remove");
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		return true;
+	}
+};
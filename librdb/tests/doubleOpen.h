@@ -0,0 +1,105 @@
+#include "error.h"
+#include "filesystem.h"
+#include "rdb.h"
+
+class DoubleOpenDB : public snf::tf::test
+{
+public:
+	DoubleOpenDB() : snf::tf::test() {}
+	~DoubleOpenDB() {}
+
+	virtual const char *name() const
+	{
+		return "DoubleOpenDB";
+	}
+
+	virtual const char *description() const
+	{
+		return "Opens the same database twice in one process";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+		const char *dbName = conf->get("DBNAME");
+		ASSERT_NE(const char *, dbName, nullptr, "get DBNAME from config");
+
+		std::string twiceName(dbName);
+		twiceName += "-twice";
+
+		const char *exts[] = { ".idx", ".db", ".attr", ".fdp", ".lck" };
+		for (int i = 0; i < 5; ++i) {
+			std::string fname(dbPath);
+			fname += snf::pathsep();
+			fname += twiceName;
+			fname += exts[i];
+			snf::fs::remove_file(fname.c_str());
+		}
+
+		RdbOptions options;
+		options.setMemoryUsage(2);
+
+		RdbOptions shOptions;
+		shOptions.setMemoryUsage(2);
+		shOptions.sharedMode(true);
+
+		Rdb rdb1(dbPath, twiceName, 1024, 11, options);
+		int retval = rdb1.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb1 open");
+
+		retval = rdb1.set("twice", 5, "TWICE", 5);
+		ASSERT_EQ(int, retval, E_ok, "rdb1 set: key = twice, value = TWICE");
+
+		{
+			Rdb rdb2(dbPath, twiceName, 1024, 11, options);
+			retval = rdb2.open();
+			ASSERT_EQ(int, retval, E_try_again, "rdb2 open while rdb1 is open");
+
+			Rdb rdb3(dbPath, twiceName, shOptions);
+			retval = rdb3.open();
+			ASSERT_EQ(int, retval, E_try_again, "rdb3 shared open while rdb1 is open");
+		}
+
+		// The failed opens closed their lock files; rdb1 still holds its lock
+		Rdb rdb4(dbPath, twiceName, 1024, 11, options);
+		retval = rdb4.open();
+		ASSERT_EQ(int, retval, E_try_again, "rdb4 open after the failed opens");
+
+		retval = rdb1.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb1 close");
+
+		Rdb rdb5(dbPath, twiceName, shOptions);
+		retval = rdb5.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb5 shared open");
+
+		{
+			Rdb rdb6(dbPath, twiceName, shOptions);
+			retval = rdb6.open();
+			ASSERT_EQ(int, retval, E_ok, "rdb6 shared open");
+
+			char buf[16];
+			int  buflen = (int)(sizeof(buf) - 1);
+			retval = rdb6.get("twice", 5, buf, &buflen);
+			ASSERT_EQ(int, retval, E_ok, "rdb6 get: key = twice");
+			ASSERT_EQ(int, buflen, 5, "value length match");
+			ASSERT_MEM_EQ(buf, "TWICE", 5, "value match");
+		}
+
+		// rdb6 is closed; rdb5 still holds its shared lock
+		retval = rdb4.open();
+		ASSERT_EQ(int, retval, E_try_again, "rdb4 open while rdb5 is open");
+
+		retval = rdb5.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb5 close");
+
+		retval = rdb4.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb4 open after all are closed");
+
+		retval = rdb4.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb4 close");
+
+		return true;
+	}
+};
@@ -6,6 +6,11 @@
 #include "normalFD.h"
 #include "bigload.h"
 #include "rebuildDB.h"
+#include "valueCache.h"
+#include "bulkLoad.h"
+#include "sharedMode.h"
+#include "concurrentSGR.h"
+#include "doubleOpen.h"
 
 static int
 RandomInRange(unsigned int seed, int lo, int hi)
@@ -56,6 +61,12 @@ test *test_list[] = {
 	DBG_NEW MultipleKeyPageNodes(),
 	DBG_NEW NormalFairDistribution(),
 	DBG_NEW RebuildDB(),
+	DBG_NEW ValueCacheSGR(),
+	DBG_NEW BulkLoadDB(),
+	DBG_NEW BulkLoadRunsDB(),
+	DBG_NEW SharedModeDB(),
+	DBG_NEW ConcurrentSGR(),
+	DBG_NEW DoubleOpenDB(),
 	// DBG_NEW BigLoad(),
 	0
 };
@@ -0,0 +1,155 @@
+#include "error.h"
+#include "filesystem.h"
+#include "rdb.h"
+
+#define SHARED_MODE_RECORDS 500
+
+class SharedModeDB : public snf::tf::test
+{
+private:
+	bool verify(Rdb &rdb, int nrecs)
+	{
+		char key[16];
+		char val[16];
+		char buf[32];
+		int  buflen;
+
+		for (int i = 0; i < nrecs; ++i) {
+			snprintf(key, sizeof(key), "sh-%05d", i);
+			snprintf(val, sizeof(val), "SV-%05d", i);
+
+			buflen = (int)(sizeof(buf) - 1);
+			int retval = rdb.get(key, 8, buf, &buflen);
+			m_strm << "rdb get: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+			ASSERT_EQ(int, buflen, 8, "value length match");
+			ASSERT_MEM_EQ(buf, val, 8, "value match");
+		}
+
+		buflen = (int)(sizeof(buf) - 1);
+		int retval = rdb.get("sh-none", 7, buf, &buflen);
+		ASSERT_EQ(int, retval, E_not_found, "rdb get: key = sh-none should return E_not_found");
+
+		return true;
+	}
+
+public:
+	SharedModeDB() : snf::tf::test() {}
+	~SharedModeDB() {}
+
+	virtual const char *name() const
+	{
+		return "SharedModeDB";
+	}
+
+	virtual const char *description() const
+	{
+		return "Gets key/value pairs in shared mode";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+		const char *dbName = conf->get("DBNAME");
+		ASSERT_NE(const char *, dbName, nullptr, "get DBNAME from config");
+
+		std::string sharedName(dbName);
+		sharedName += "-shared";
+
+		const char *exts[] = { ".idx", ".db", ".attr", ".fdp", ".lck" };
+		for (int i = 0; i < 5; ++i) {
+			std::string fname(dbPath);
+			fname += snf::pathsep();
+			fname += sharedName;
+			fname += exts[i];
+			snf::fs::remove_file(fname.c_str());
+		}
+
+		RdbOptions shOptions;
+		shOptions.setMemoryUsage(2);
+		shOptions.sharedMode(true);
+
+		Rdb rdb0(dbPath, sharedName, 1024, 11, shOptions);
+		int retval = rdb0.open();
+		ASSERT_EQ(int, retval, E_not_found, "rdb shared open of non-existent DB");
+
+		RdbOptions options;
+		options.setMemoryUsage(2);
+		options.syncDataFile(false);
+		Rdb rdb(dbPath, sharedName, 1024, 11, options);
+
+		retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open");
+
+		char key[16];
+		char val[16];
+		for (int i = 0; i < SHARED_MODE_RECORDS; ++i) {
+			snprintf(key, sizeof(key), "sh-%05d", i);
+			snprintf(val, sizeof(val), "SV-%05d", i);
+			retval = rdb.set(key, 8, val, 8);
+			m_strm << "rdb set: key = " << key << ", value = " << val;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+		}
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		// The first one builds the shared index, the second one attaches it
+		Rdb rdb1(dbPath, sharedName, shOptions);
+		retval = rdb1.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb1 shared open");
+
+		Rdb rdb2(dbPath, sharedName, shOptions);
+		retval = rdb2.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb2 shared open");
+
+		if (!verify(rdb1, SHARED_MODE_RECORDS) || !verify(rdb2, SHARED_MODE_RECORDS))
+			return false;
+
+		retval = rdb1.set("sh-new", 6, "SN-new", 6);
+		ASSERT_EQ(int, retval, E_invalid_state, "rdb set in shared mode");
+
+		retval = rdb1.remove("sh-00000", 8);
+		ASSERT_EQ(int, retval, E_invalid_state, "rdb remove in shared mode");
+
+		retval = rdb1.rebuild();
+		ASSERT_EQ(int, retval, E_invalid_state, "rdb rebuild in shared mode");
+
+		retval = rdb2.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb2 close");
+
+		retval = rdb1.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb1 close");
+
+		// Update the database; the shared index is rebuilt on the next shared open
+		retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb reopen");
+
+		for (int i = SHARED_MODE_RECORDS; i < (2 * SHARED_MODE_RECORDS); ++i) {
+			snprintf(key, sizeof(key), "sh-%05d", i);
+			snprintf(val, sizeof(val), "SV-%05d", i);
+			retval = rdb.set(key, 8, val, 8);
+			m_strm << "rdb set: key = " << key << ", value = " << val;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+		}
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		retval = rdb1.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb1 shared reopen");
+
+		if (!verify(rdb1, 2 * SHARED_MODE_RECORDS))
+			return false;
+
+		retval = rdb1.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb1 close");
+
+		return true;
+	}
+};
@@ -0,0 +1,103 @@
+#include "error.h"
+#include "rdb.h"
+
+class ValueCacheSGR : public snf::tf::test
+{
+public:
+	ValueCacheSGR() : snf::tf::test() {}
+	~ValueCacheSGR() {}
+
+	virtual const char *name() const
+	{
+		return "ValueCacheSGR";
+	}
+
+	virtual const char *description() const
+	{
+		return "Sets, gets, updates, and removes key/value pairs with value cache";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+		const char *dbName = conf->get("DBNAME");
+		ASSERT_NE(const char *, dbName, nullptr, "get DBNAME from config");
+
+		RdbOptions options;
+		options.setMemoryUsage(2);
+		ASSERT_EQ(int, options.setValueCacheSize(-1), E_invalid_arg, "invalid value cache size");
+		ASSERT_EQ(int, options.setValueCacheSize(2), E_ok, "set value cache size");
+		Rdb rdb(dbPath, dbName, 4096, 10, options);
+
+		int retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open");
+
+		const char *keys[] = { "vc-key1", "vc-key2", "vc-key3", "vc-key4" };
+		const char *vals[] = { "value-1", "value-2", "value-3", "value-4" };
+
+		for (int i = 0; i < 4; ++i) {
+			retval = rdb.set(keys[i], 7, vals[i], 7);
+			m_strm << "rdb set: key = " << keys[i] << ", value = " << vals[i];
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+		}
+
+		char buf[32];
+		int  buflen;
+
+		// Read the keys a few times so that some of them are cached
+		for (int n = 0; n < 3; ++n) {
+			for (int i = 0; i < 4; ++i) {
+				buflen = (int)(sizeof(buf) - 1);
+				retval = rdb.get(keys[i], 7, buf, &buflen);
+				m_strm << "rdb get: key = " << keys[i];
+				ASSERT_EQ(int, retval, E_ok, m_strm.str());
+				m_strm.str("");
+				ASSERT_EQ(int, buflen, 7, "value length match");
+				ASSERT_MEM_EQ(buf, vals[i], 7, "value match");
+			}
+		}
+
+		retval = rdb.set(keys[0], 7, "updated-1", 9);
+		ASSERT_EQ(int, retval, E_ok, "rdb set: key = vc-key1, value = updated-1");
+
+		buflen = (int)(sizeof(buf) - 1);
+		retval = rdb.get(keys[0], 7, buf, &buflen);
+		ASSERT_EQ(int, retval, E_ok, "rdb get: key = vc-key1");
+		ASSERT_EQ(int, buflen, 9, "updated value length match");
+		ASSERT_MEM_EQ(buf, "updated-1", 9, "updated value match");
+
+		retval = rdb.remove(keys[1], 7);
+		ASSERT_EQ(int, retval, E_ok, "rdb remove: key = vc-key2");
+
+		buflen = (int)(sizeof(buf) - 1);
+		retval = rdb.get(keys[1], 7, buf, &buflen);
+		ASSERT_EQ(int, retval, E_not_found, "rdb get: key = vc-key2 should return E_not_found");
+
+		// The freed value page is reused for the new key
+		retval = rdb.set("vc-key5", 7, "value-5", 7);
+		ASSERT_EQ(int, retval, E_ok, "rdb set: key = vc-key5, value = value-5");
+
+		buflen = (int)(sizeof(buf) - 1);
+		retval = rdb.get("vc-key5", 7, buf, &buflen);
+		ASSERT_EQ(int, retval, E_ok, "rdb get: key = vc-key5");
+		ASSERT_EQ(int, buflen, 7, "value length match");
+		ASSERT_MEM_EQ(buf, "value-5", 7, "value match");
+
+		retval = rdb.remove(keys[0], 7);
+		ASSERT_EQ(int, retval, E_ok, "rdb remove: key = vc-key1");
+		retval = rdb.remove(keys[2], 7);
+		ASSERT_EQ(int, retval, E_ok, "rdb remove: key = vc-key3");
+		retval = rdb.remove(keys[3], 7);
+		ASSERT_EQ(int, retval, E_ok, "rdb remove: key = vc-key4");
+		retval = rdb.remove("vc-key5", 7);
+		ASSERT_EQ(int, retval, E_ok, "rdb remove: key = vc-key5");
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		return true;
+	}
+};